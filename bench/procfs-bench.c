@@ -0,0 +1,262 @@
+/*
+* procfs-bench.c, benchmark of the procfs record parser over a synthetic process table
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * Builds a fake proc tree (<root>/<pid>/cmdline and stat) with 100, 1000 and 10000
+ * processes and reports name -> PID lookups per second for the former stdio based
+ * scan and for ProcScanPidByName(), plus cmdline/stat records parsed per second.
+ *
+ * usage : procfs-bench [-r proc_root] [-n iterations]
+ *   -r : use an existing tree instead of generating one (e.g. -r /proc)
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "procfs.h"
+
+/* buffer size used by the former parser */
+#define BENCH_DIM_MAX 200
+
+/* Function responsible to return a monotonic timestamp in seconds */
+static double BenchNow()
+{
+  struct timespec l_ts;
+  clock_gettime(CLOCK_MONOTONIC, &l_ts);
+  return l_ts.tv_sec + l_ts.tv_nsec / 1e9;
+}
+
+/* Function responsible to write a file of the synthetic tree */
+static int BenchWriteFile(const char *p_path, const char *p_data, size_t p_len)
+{
+  int l_fd = open(p_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (l_fd < 0)
+    return -1;
+  if (write(l_fd, p_data, p_len) != (ssize_t)p_len) {
+    close(l_fd);
+    return -1;
+  }
+  return close(l_fd);
+}
+
+/* Function responsible to generate a synthetic proc tree with p_count processes */
+static int BenchMakeTree(const char *p_root, int p_count)
+{
+  /* file path */
+  char l_path[512];
+  /* record contents */
+  char l_rec[512];
+  /* record length */
+  int l_len, l_i;
+  for (l_i = 0; l_i < p_count; l_i++) {
+    /* pids start above the usual range of system daemons */
+    int l_pid = 1000 + l_i;
+    snprintf(l_path, sizeof(l_path), "%s/%d", p_root, l_pid);
+    if (mkdir(l_path, 0755) < 0 && errno != EEXIST)
+      return -1;
+    /* NUL separated argv, as the kernel exposes it */
+    l_len = snprintf(l_rec, sizeof(l_rec), "/usr/lib/apps/bench-app-%d", l_i) + 1;
+    l_len += snprintf(l_rec + l_len, sizeof(l_rec) - l_len, "--config") + 1;
+    l_len += snprintf(l_rec + l_len, sizeof(l_rec) - l_len, "/etc/bench/app-%d.conf", l_i) + 1;
+    snprintf(l_path, sizeof(l_path), "%s/%d/cmdline", p_root, l_pid);
+    if (BenchWriteFile(l_path, l_rec, l_len) < 0)
+      return -1;
+    l_len = snprintf(l_rec, sizeof(l_rec),
+                     "%d (bench-app-%d) S 1 %d %d 0 -1 4194560 120 0 0 0 1 2 0 0 20 0 1 0 100 4096 200\n",
+                     l_pid, l_i, l_pid, l_pid);
+    snprintf(l_path, sizeof(l_path), "%s/%d/stat", p_root, l_pid);
+    if (BenchWriteFile(l_path, l_rec, l_len) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+/* Function responsible to remove the synthetic proc tree */
+static void BenchRemoveTree(const char *p_root, int p_count)
+{
+  char l_path[512];
+  int l_i;
+  for (l_i = 0; l_i < p_count; l_i++) {
+    snprintf(l_path, sizeof(l_path), "%s/%d/cmdline", p_root, 1000 + l_i);
+    unlink(l_path);
+    snprintf(l_path, sizeof(l_path), "%s/%d/stat", p_root, 1000 + l_i);
+    unlink(l_path);
+    snprintf(l_path, sizeof(l_path), "%s/%d", p_root, 1000 + l_i);
+    rmdir(l_path);
+  }
+}
+
+/* The former AppPidFromName() scan : fopen + fgets + sscanf + strrchr/strchr/strncpy */
+static pid_t BenchLegacyPidFromName(const char *p_root, const char *p_app_name)
+{
+  DIR *l_dir;
+  struct dirent *l_next;
+  if (!(l_dir = opendir(p_root)))
+    return 0;
+  while ((l_next = readdir(l_dir)) != NULL) {
+    FILE *l_status;
+    char l_filename[BENCH_DIM_MAX * 2];
+    char l_buffer[BENCH_DIM_MAX];
+    char l_name[BENCH_DIM_MAX];
+    char l_aname[BENCH_DIM_MAX];
+    char *l_start_pos, *l_last_pos, *l_idx;
+    int l_len = 0;
+    if (!isdigit(*l_next->d_name))
+      continue;
+    snprintf(l_filename, sizeof(l_filename), "%s/%s/cmdline", p_root, l_next->d_name);
+    if (!(l_status = fopen(l_filename, "r")))
+      continue;
+    if (fgets(l_buffer, BENCH_DIM_MAX - 1, l_status) == NULL) {
+      fclose(l_status);
+      continue;
+    }
+    fclose(l_status);
+    sscanf(l_buffer, "%s", l_name);
+    l_start_pos = strrchr(l_name, '/');
+    l_idx = l_start_pos ? l_start_pos + 1 : l_name;
+    l_last_pos = strchr(l_name, ' ');
+    if (!l_last_pos)
+      l_len = strlen(l_idx);
+    else if (l_start_pos)
+      l_len = l_last_pos - l_start_pos;
+    else
+      l_len = l_last_pos - l_idx;
+    strncpy(l_aname, l_idx, l_len);
+    l_aname[l_len] = '\0';
+    if (strcmp(l_aname, p_app_name) == 0) {
+      /* the entry belongs to the directory stream */
+      pid_t l_pid = strtol(l_next->d_name, NULL, 0);
+      closedir(l_dir);
+      return l_pid;
+    }
+  }
+  closedir(l_dir);
+  return 0;
+}
+
+/* ProcScan() callback counting the processes */
+static int BenchCountOne(pid_t p_pid, const char *p_name, size_t p_name_len, void *p_data)
+{
+  (*(int *)p_data)++;
+  return 0;
+}
+
+/* Function responsible to run the benchmark over one tree */
+static void BenchRun(const char *p_root, int p_count, int p_iterations)
+{
+  /* reusable record buffer */
+  ProcBuffer l_buf;
+  /* looked up application; the scan order of readdir() is arbitrary */
+  char l_app[64];
+  /* timing */
+  double l_start, l_legacy, l_new, l_records;
+  /* lookup results, compared to validate the new parser */
+  pid_t l_old_pid = 0, l_new_pid = 0;
+  /* parsed stat record */
+  ProcStat l_stat;
+  int l_i, l_visited = 0, l_parsed = 0;
+  ProcBufferInit(&l_buf);
+  ProcSetRoot(p_root);
+  snprintf(l_app, sizeof(l_app), "bench-app-%d", p_count > 1 ? p_count / 2 : 0);
+
+  l_start = BenchNow();
+  for (l_i = 0; l_i < p_iterations; l_i++)
+    l_old_pid = BenchLegacyPidFromName(p_root, l_app);
+  l_legacy = BenchNow() - l_start;
+
+  l_start = BenchNow();
+  for (l_i = 0; l_i < p_iterations; l_i++)
+    l_new_pid = ProcScanPidByName(l_app, &l_buf);
+  l_new = BenchNow() - l_start;
+
+  /* raw record throughput : every cmdline and the stat of the found process once per iteration */
+  l_start = BenchNow();
+  for (l_i = 0; l_i < p_iterations; l_i++) {
+    ProcScan(BenchCountOne, &l_visited, &l_buf);
+    if (ProcReadRecord(l_new_pid, "stat", &l_buf) > 0 && ProcStatParse(l_buf.data, l_buf.len, &l_stat))
+      l_parsed++;
+  }
+  l_records = BenchNow() - l_start;
+
+  printf("%6d processes : legacy %10.1f lookups/s | procfs %10.1f lookups/s (x%.2f) | %12.0f cmdline records/s%s\n",
+         p_count, p_iterations / l_legacy, p_iterations / l_new, l_legacy / l_new,
+         l_visited / l_records,
+         (l_old_pid == l_new_pid && (l_new_pid == 0 || l_parsed == p_iterations)) ? "" : " [MISMATCH]");
+  ProcBufferFree(&l_buf);
+}
+
+int main(int argc, char **argv)
+{
+  /* synthetic tree sizes */
+  static const int l_sizes[] = { 100, 1000, 10000 };
+  /* user supplied root */
+  const char *l_root = NULL;
+  /* generated root */
+  char l_tmp[] = "/tmp/procfs-bench.XXXXXX";
+  int l_opt, l_i, l_iterations = 0;
+  while ((l_opt = getopt(argc, argv, "r:n:")) != -1) {
+    switch (l_opt) {
+    case 'r':
+      l_root = optarg;
+      break;
+    case 'n':
+      l_iterations = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage : %s [-r proc_root] [-n iterations]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (l_root) {
+    /* count the processes of the existing tree for the report */
+    ProcBuffer l_buf;
+    int l_count = 0;
+    ProcBufferInit(&l_buf);
+    ProcSetRoot(l_root);
+    ProcScan(BenchCountOne, &l_count, &l_buf);
+    ProcBufferFree(&l_buf);
+    BenchRun(l_root, l_count, l_iterations > 0 ? l_iterations : 100);
+    return 0;
+  }
+  if (!mkdtemp(l_tmp)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  for (l_i = 0; l_i < (int)(sizeof(l_sizes) / sizeof(l_sizes[0])); l_i++) {
+    if (BenchMakeTree(l_tmp, l_sizes[l_i]) < 0) {
+      perror("synthetic proc tree");
+      break;
+    }
+    /* keep the total work per size roughly constant */
+    BenchRun(l_tmp, l_sizes[l_i], l_iterations > 0 ? l_iterations : 200000 / l_sizes[l_i]);
+    BenchRemoveTree(l_tmp, l_sizes[l_i]);
+  }
+  rmdir(l_tmp);
+  return 0;
+}
@@ -33,7 +33,9 @@
 #define AL_SIGNAME_TASK_STARTED "TaskStarted"
 #define AL_SIGNAME_TASK_STOPPED "TaskStopped"
 #define AL_SIGNAME_NOTIFICATION "GlobalStateNotification"
+#define AL_SIGNAME_TASK_STATE_CHANGED "TaskStateChanged"
 #define DIM_MAX 200
+#define AL_MAX_UNIT_PIDS 512
 #define AL_VERSION "2.1"
 #define AL_GCONF_CURRENT_USER_KEY "/current_user"
 #define AL_GCONF_LAST_USER_MODE_KEY "/last_mode"
@@ -42,6 +44,10 @@
 #define SYSTEMD_INTERFACE            "org.freedesktop.systemd1.Manager"
 #define SYSTEMD_PATH                 "/org/freedesktop/systemd1"
 #define SYSTEMD_UNIT_INFO_TIMEOUT 2000
+/* signal dispatcher reconnection backoff, in ms; reset after a session lasting AL_BUS_STABLE_MS */
+#define AL_BUS_RETRY_MIN_MS 100
+#define AL_BUS_RETRY_MAX_MS 30000
+#define AL_BUS_STABLE_MS 10000
 
 /* add logging support */
 #include "al-log.h"
@@ -66,6 +72,7 @@ AL_SIG_TASK_STARTED,
 AL_SIG_TASK_STOPPED,
 AL_SIG_GLOBAL_NOTIFICATION,
 AL_SIG_CHANGE_STATE_COMPLETE,
+AL_SIG_TASK_STATE_CHANGED,
 AL_SIG_COUNT
 };
 
@@ -143,6 +150,18 @@ gboolean al_dbus_change_task_state(
 		DBusGMethodInvocation *context
 );
 
+gboolean al_dbus_list_available_apps(
+		ALDbus *server,
+		gchar *prefix,
+		DBusGMethodInvocation *context
+);
+
+gboolean al_dbus_run_many(
+		ALDbus *server,
+		GPtrArray *apps,
+		DBusGMethodInvocation *context
+);
+
 /* signals */
 
 gboolean al_dbus_global_state_notification(
@@ -168,6 +187,18 @@ gboolean al_dbus_change_task_state_complete(
 			gchar *app_state
 );
 
+gboolean al_dbus_task_state_changed(
+		ALDbus *server,
+		gchar *unit,
+		gchar *app_name,
+		guint load_state,
+		guint active_state,
+		guint sub_state,
+		gint app_pid,
+		gboolean foreground,
+		guint64 timestamp
+);
+
 /* Function responsible to initialize the AL Daemon DBus interface */
 
 gboolean initialize_al_dbus();
@@ -183,5 +214,7 @@ extern void AlPrintCLI();
 extern void AlParseCLIOptions(int argc, char *const *argv);
 /* Signal handler for the daemon */
 extern void AlSignalHandler(int sig);
+/* Function responsible to log the daemon performance counters (on SIGUSR1) */
+extern void AlLogCounters();
 
 #endif
@@ -0,0 +1,33 @@
+/*
+* app_handle.h, contains the declarations for the pidfd based handles of launched applications
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/* Function responsible to open a pidfd for a launched application and watch it for exit */
+extern int AppHandleOpen(pid_t pid, const char *unit, char *app_name);
+/* Function responsible to deliver a signal to an application, through its pidfd when one is held */
+extern int AppHandleSendSignal(pid_t pid, int sig);
+/* Function responsible to test that a PID still designates the application launched under it */
+extern int AppHandleValidate(pid_t pid);
+/*
+ * Function responsible to record the exit of a PID of a unit, from its pidfd or from the state
+ * systemd reports; returns 1 if the caller reports it, 0 if it was already reported
+ */
+extern int AppHandleClaimExit(const char *unit, pid_t pid);
+/* Function responsible to close all the held application handles */
+extern void AppHandleTerminate();
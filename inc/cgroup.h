@@ -0,0 +1,26 @@
+/*
+* cgroup.h, contains the declarations for the cgroup based application to PID resolution
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/* Function responsible to find the systemd unit owning a PID from /proc/<pid>/cgroup; fails if the name does not fit in size */
+extern int CgroupUnitFromPid(pid_t pid, char *unit, size_t size);
+/* Function responsible to list the PIDs of a unit from its cgroup.procs; returns the PID count or -1 */
+extern int CgroupPidsFromUnit(char *unit, pid_t *pids, int max_pids);
+/* Function responsible to release the unit to cgroup path cache */
+extern void CgroupTerminate();
@@ -18,20 +18,33 @@
 * 
 */
 
-/* High level interface for the AL Daemon */
-extern void Run(char *p_commandLine, int p_parentPID, bool p_isFg);
-extern void RunAs(char *p_commandLine, int p_parentPID, bool p_isFg, int p_euid, int p_egid);
+#include "sysd_job.h"
+
+/* request scoped lookups, see snapshot.h */
+struct AlSnapshot;
+/* resolved application units, see unit_desc.h */
+struct AlUnitDesc;
+
+/*
+ * High level interface for the AL Daemon; the unit operations return 0 once the systemd
+ * job is queued and then call p_done (if not NULL) with the job result
+ */
+extern int Run(struct AlUnitDesc *p_desc, int p_parentPID, bool p_isFg, SysdJobDoneFunc p_done, void *p_data);
+extern int RunAs(struct AlUnitDesc *p_desc, int p_parentPID, bool p_isFg, int p_euid, int p_egid,
+		 SysdJobDoneFunc p_done, void *p_data);
 extern void Suspend(int pid);
 extern void Resume(int pid);
-extern void Stop(int pid);
-extern void StopAs(int pid, int euid, int egid);
+extern int Stop(int pid, struct AlSnapshot *p_snap, SysdJobDoneFunc p_done, void *p_data);
+extern int StopAs(int pid, int euid, int egid, SysdJobDoneFunc p_done, void *p_data);
 extern void ChangeTaskState(int pid, bool isFg);
 /* Send start/stop signals over the bus to the clients */
 extern void TaskStarted(int p_pid, char *p_imagePath);
 extern void TaskStopped(int p_pid, char *p_imagePath);
 /* Function responsible with restarting an application when SHM detects an abnormal operation of the application */
-extern void Restart(char *app_name);
+extern int Restart(struct AlUnitDesc *p_desc, SysdJobDoneFunc p_done, void *p_data);
 /* Function responsible to dispatch and emit signals according to context */
 extern void al_dbus_signal_dispatcher();
+/* Function responsible to log the signal dispatcher connection counters */
+extern void AlSignalDispatcherLogCounters();
 /* Function responsible to monitor signals of interest for the daemon */
 extern int al_monitor_signals(DBusConnection *bus);
@@ -0,0 +1,46 @@
+/*
+* event_queue.h, contains the declarations for the handoff of events to the main loop
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_EVENT_QUEUE_H
+#define __AL_EVENT_QUEUE_H
+
+#include <stddef.h>
+
+/* slots of the queue, a power of two */
+#define EVENT_QUEUE_SLOTS 512
+/* largest payload an event carries */
+#define EVENT_QUEUE_PAYLOAD_MAX 512
+
+/* Function run on the main loop with a copy of the payload posted with it */
+typedef void (*AlEventFunc)(const void *payload);
+
+/* Function responsible to create the queue and its wake up watch on the main loop */
+extern int EventQueueInit();
+/* Function responsible to stop the queue; events still queued are dropped */
+extern void EventQueueTerminate();
+/*
+ * Function responsible to hand an event to the main loop from any thread, without locks;
+ * the payload is copied. Returns 0 on success, -1 if the queue is full or not active.
+ */
+extern int EventQueuePost(AlEventFunc func, const void *payload, size_t size);
+/* Function responsible to log the queue counters */
+extern void EventQueueLogCounters();
+
+#endif
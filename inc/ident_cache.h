@@ -0,0 +1,44 @@
+/*
+* ident_cache.h, contains the declarations for the cached user and group identities
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_IDENT_CACHE_H
+#define __AL_IDENT_CACHE_H
+
+#include <stddef.h>
+
+/* account databases whose changes refresh the cache */
+#define IDENT_CACHE_DIR "/etc"
+/* lookup result of an identity not known yet, being resolved in the background */
+#define IDENT_CACHE_PENDING -2
+
+/* Function responsible to load the identities in the background and watch the account databases */
+extern int IdentCacheInit();
+/* Function responsible to release the identities and the watch */
+extern void IdentCacheTerminate();
+/* Functions responsible to get the name of a uid/gid; return 0 on success, -1 if unknown, IDENT_CACHE_PENDING if not known yet */
+extern int IdentUserName(unsigned int uid, char *name, size_t size);
+extern int IdentGroupName(unsigned int gid, char *name, size_t size);
+/* Functions responsible to get the uid/gid of a user/group name or number; return 0 on success, -1 if unknown, IDENT_CACHE_PENDING if not known yet */
+extern int IdentUserId(const char *user, unsigned int *uid);
+extern int IdentGroupId(const char *group, unsigned int *gid);
+/* Function responsible to log the identity cache counters */
+extern void IdentCacheLogCounters();
+
+#endif
@@ -18,8 +18,106 @@
 * 
 */
 
+/* longest unit name and state strings kept in a unit state */
+#define AL_UNIT_NAME_MAX 256
+#define AL_UNIT_STATE_MAX 32
+
+/* default coalescing window of the state notifications of a unit, in ms */
+#define AL_NOTIFY_WINDOW_MS 30
+
+/* LoadState of a unit, as sent in TaskStateChanged */
+typedef enum
+{
+    AL_LOAD_UNKNOWN = 0,
+    AL_LOAD_STUB,
+    AL_LOAD_LOADED,
+    AL_LOAD_NOT_FOUND,
+    AL_LOAD_BAD_SETTING,
+    AL_LOAD_ERROR,
+    AL_LOAD_MERGED,
+    AL_LOAD_MASKED
+} AlLoadState;
+
+/* ActiveState of a unit, as sent in TaskStateChanged */
+typedef enum
+{
+    AL_ACTIVE_UNKNOWN = 0,
+    AL_ACTIVE_ACTIVE,
+    AL_ACTIVE_RELOADING,
+    AL_ACTIVE_INACTIVE,
+    AL_ACTIVE_FAILED,
+    AL_ACTIVE_ACTIVATING,
+    AL_ACTIVE_DEACTIVATING
+} AlActiveState;
+
+/* SubState of a service, target or timer unit, as sent in TaskStateChanged */
+typedef enum
+{
+    AL_SUB_UNKNOWN = 0,
+    AL_SUB_DEAD,
+    AL_SUB_CONDITION,
+    AL_SUB_START_PRE,
+    AL_SUB_START,
+    AL_SUB_START_POST,
+    AL_SUB_RUNNING,
+    AL_SUB_EXITED,
+    AL_SUB_RELOAD,
+    AL_SUB_STOP,
+    AL_SUB_STOP_WATCHDOG,
+    AL_SUB_STOP_SIGTERM,
+    AL_SUB_STOP_SIGKILL,
+    AL_SUB_STOP_POST,
+    AL_SUB_FINAL_SIGTERM,
+    AL_SUB_FINAL_SIGKILL,
+    AL_SUB_FAILED,
+    AL_SUB_AUTO_RESTART,
+    AL_SUB_ACTIVE,
+    AL_SUB_WAITING,
+    AL_SUB_ELAPSED
+} AlSubState;
+
+/* State of a unit, as fetched from systemd in one query */
+typedef struct AlUnitState
+{
+    /* unit name */
+    char name[AL_UNIT_NAME_MAX];
+    /* LoadState, ActiveState and SubState of the unit */
+    char load_state[AL_UNIT_STATE_MAX];
+    char active_state[AL_UNIT_STATE_MAX];
+    char sub_state[AL_UNIT_STATE_MAX];
+    /* the same states, decoded */
+    AlLoadState load;
+    AlActiveState active;
+    AlSubState sub;
+    /* ExecMainPID of a service, 0 otherwise */
+    unsigned int main_pid;
+    bool has_main_pid;
+    /* Foreground property of a service */
+    bool foreground;
+} AlUnitState;
+
+/* Function to fetch the state of a unit with a single round trip once its object path is known */
+extern int AlGetUnitState(DBusConnection * bus, const char *unit, AlUnitState * state);
+/* Function to get the load, active and sub state of a unit, without the main pid */
+extern int AlGetUnitRunState(DBusConnection * bus, const char *unit, AlUnitState * state);
 /* Function to extract the status of an application after starting it or that is already running in the system */
 extern int AlGetAppState(DBusConnection * bus, char *app_name, char *state_info);
+/* Function to turn the legacy GlobalStateNotification string signal on or off */
+extern void AlSetLegacyStateSignal(bool enabled);
+/* Function to broadcast the state of a unit with TaskStateChanged (and GlobalStateNotification) */
+extern void AlAppStateNotifier(DBusConnection * bus, char *name);
 /* Connect to the DBUS bus and send a broadcast signal regarding application state */
 extern void AlSendAppSignal(DBusConnection * bus, char *name);
+/* Function to set the window in which the state changes of a unit are notified once, in ms */
+extern void AlSetNotifyWindow(unsigned int window_ms);
+/* Function to notify a state change from the signal dispatcher, coalesced per unit and without waiting for systemd */
+extern void AlNotifyUnitState(DBusConnection * bus, const char *unit);
+/* Function to get the time the signal dispatcher may wait before the next notification is due, in ms (-1 : none) */
+extern int AlNotifyTimeout();
+/* Function to send the notifications that are due */
+extern void AlNotifyFlush(DBusConnection * bus);
+/* Function to notify, once subscribed again, the state transitions missed while the signals were not received */
+extern void AlNotifyResync(DBusConnection * bus);
+/* Function to log the notifier counters */
+extern void AlNotifierLogCounters();
 
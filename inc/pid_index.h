@@ -0,0 +1,28 @@
+/*
+* pid_index.h, contains the declarations for the in-daemon application name to PID index
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/* Function responsible to seed the PID index from /proc and attach the proc connector to the main loop */
+extern int PidIndexInit();
+/* Function responsible to release the PID index and close the proc connector */
+extern void PidIndexTerminate();
+/* Function responsible to test if the PID index is kept up to date by the proc connector */
+extern int PidIndexIsActive();
+/* Function responsible to lookup the PID of an application in the index (0 if not found) */
+extern pid_t PidIndexLookup(char *app_name);
@@ -0,0 +1,76 @@
+/*
+* procfs.h, contains the declarations for the procfs record reader and parser
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_PROCFS_H
+#define __AL_PROCFS_H
+
+#include <sys/types.h>
+
+/* default procfs mount point */
+#define PROC_DEFAULT_ROOT "/proc"
+/* initial size of a record buffer, enough for nearly every cmdline/stat */
+#define PROC_RECORD_SIZE 4096
+
+/* Reusable buffer receiving whole procfs records */
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t len;
+} ProcBuffer;
+
+/* Fields extracted from /proc/<pid>/stat */
+typedef struct
+{
+    pid_t pid;
+    /* points into the record buffer, not NUL terminated */
+    const char *comm;
+    size_t comm_len;
+    char state;
+    pid_t ppid;
+    /* start time after boot, in clock ticks (0 if the record is truncated) */
+    unsigned long long start_time;
+} ProcStat;
+
+/* Callback for ProcScan(); returning non zero stops the scan */
+typedef int (*ProcScanFunc)(pid_t pid, const char *name, size_t name_len, void *data);
+
+/* Function responsible to set the procfs root used by the reader (NULL restores /proc) */
+extern void ProcSetRoot(const char *root);
+/* Function responsible to get the procfs root used by the reader */
+extern const char *ProcGetRoot();
+/* Function responsible to initialize a reusable record buffer */
+extern void ProcBufferInit(ProcBuffer *buf);
+/* Function responsible to release a reusable record buffer */
+extern void ProcBufferFree(ProcBuffer *buf);
+/* Function responsible to read a whole /proc/<pid>/<entry> record, normally with a single read() */
+extern ssize_t ProcReadRecord(pid_t pid, const char *entry, ProcBuffer *buf);
+/* Function responsible to find the binary name (basename of the first token of argv[0]) in a cmdline record */
+extern int ProcCmdlineBinaryName(const char *rec, size_t len, const char **name, size_t *name_len);
+/* Function responsible to split a cmdline record into its NUL separated arguments; returns argc */
+extern int ProcCmdlineArgv(const char *rec, size_t len, const char **argv, size_t *argv_len, int max_args);
+/* Function responsible to parse the pid, comm, state, ppid and start time fields of a stat record */
+extern int ProcStatParse(const char *rec, size_t len, ProcStat *stat);
+/* Function responsible to walk the process table, calling the callback with every binary name */
+extern int ProcScan(ProcScanFunc func, void *data, ProcBuffer *buf);
+/* Function responsible to find the first process running a binary */
+extern pid_t ProcScanPidByName(const char *name, ProcBuffer *buf);
+
+#endif
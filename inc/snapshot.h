@@ -0,0 +1,64 @@
+/*
+* snapshot.h, contains the declarations for the request scoped process table and unit snapshot
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_SNAPSHOT_H
+#define __AL_SNAPSHOT_H
+
+/* resolved application units, see unit_desc.h */
+struct AlUnitDesc;
+
+/* Structure holding the lookups done on behalf of one method call */
+typedef struct AlSnapshot
+{
+    /* label used when logging the request counters */
+    const char *label;
+    /* application name -> PID, as resolved during the request */
+    GHashTable *pids;
+    /* PID -> application name, as resolved during the request */
+    GHashTable *names;
+    /* application name -> unit descriptor reference (NULL for unknown applications) */
+    GHashTable *descs;
+    /* binary name -> PID, filled by the single /proc scan when no index is available */
+    GHashTable *proc_table;
+    /* per request counters */
+    unsigned int pid_lookups;
+    unsigned int unit_lookups;
+    unsigned int proc_scans;
+    unsigned int unit_probes;
+} AlSnapshot;
+
+/* Function responsible to create the snapshot for a method call */
+extern AlSnapshot *SnapshotNew(const char *label);
+/* Function responsible to release the snapshot and account its counters */
+extern void SnapshotFree(AlSnapshot *snap);
+/* Function responsible to get the PID of an application as seen by the request */
+extern pid_t SnapshotPidFromName(AlSnapshot *snap, char *app_name);
+/* Function responsible to get the PID of an application the request just launched */
+extern pid_t SnapshotPidAfterLaunch(AlSnapshot *snap, char *app_name);
+/* Function responsible to get the application name of a PID as seen by the request */
+extern int SnapshotNameFromPid(AlSnapshot *snap, pid_t pid, char *app_name);
+/* Function responsible to get the unit descriptor of an application as seen by the request (owned by the snapshot, NULL without one) */
+extern struct AlUnitDesc *SnapshotUnitDesc(AlSnapshot *snap, char *app_name);
+/* Function responsible to get the unit type of an application as seen by the request */
+extern int SnapshotUnitType(AlSnapshot *snap, char *app_name);
+/* Function responsible to log the global snapshot counters */
+extern void SnapshotLogCounters();
+
+#endif
@@ -0,0 +1,113 @@
+/*
+* sysd_job.h, contains the declarations for the systemd unit job requests
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_SYSD_JOB_H
+#define __AL_SYSD_JOB_H
+
+/* job mode used for every unit operation, like systemctl does by default */
+#define SYSD_JOB_MODE "replace"
+/* transient units are unloaded once stopped, even failed, so the next RunAs can create them again */
+#define SYSD_TRANSIENT_COLLECT_MODE "inactive-or-failed"
+
+/* unit operations, in the order of the counters */
+typedef enum
+{
+    SYSD_JOB_START = 0,
+    SYSD_JOB_STOP,
+    SYSD_JOB_RESTART,
+    SYSD_JOB_RELOAD,
+    SYSD_JOB_START_TRANSIENT,
+    SYSD_JOB_OP_COUNT
+} SysdJobOp;
+
+/* job result of a completed job, other results are failures (failed, timeout, canceled, dependency, ...) */
+#define SYSD_JOB_RESULT_DONE "done"
+/* result reported when systemd refused to queue an asynchronously requested job */
+#define SYSD_JOB_RESULT_ERROR "error"
+/* result reported when no JobRemoved came for a tracked job within SYSD_JOB_TIMEOUT seconds */
+#define SYSD_JOB_RESULT_TIMEOUT "timeout"
+/* time a tracked job may take, above the default start timeout of systemd (90s) */
+#define SYSD_JOB_TIMEOUT 120
+
+/*
+ * Completion callback of a queued job, called once from the main loop with the result
+ * systemd reported in JobRemoved
+ */
+typedef void (*SysdJobDoneFunc)(const char *unit, const char *result, void *data);
+
+/*
+ * Settings of a transient service, as taken from the unit file of an application. Only these
+ * are carried over : Restart=, ExecStartPre/Post=, dependencies, resource limits and the
+ * drop-ins of the unit do not apply to an application started with RunAs.
+ */
+typedef struct SysdTransientProps
+{
+    /* unit description */
+    char *description;
+    /* ExecStart : binary, arguments (argv[0] included) and whether a failure exit status is ignored */
+    char *exec_path;
+    char **exec_argv;
+    int exec_ignore_failure;
+    /* optional service settings, NULL when not set */
+    char *type;
+    char *working_directory;
+    char **environment;
+    /* credentials of the service */
+    const char *user;
+    const char *group;
+} SysdTransientProps;
+
+/* Function responsible to track job completions on the daemon's systemd connection */
+extern int SysdJobInit();
+/* Function responsible to complete the outstanding jobs as canceled and stop tracking */
+extern void SysdJobTerminate();
+/* Function responsible to select the legacy "systemctl" command path instead of the bus calls */
+extern void SysdJobUseSystemctl(int use);
+/*
+ * Functions responsible to queue a start/stop/restart job for a unit; return 0 when the
+ * job was queued, in which case done (if not NULL) is called once the job completes
+ */
+extern int SysdStartUnit(const char *unit, SysdJobDoneFunc done, void *data);
+extern int SysdStopUnit(const char *unit, SysdJobDoneFunc done, void *data);
+extern int SysdRestartUnit(const char *unit, SysdJobDoneFunc done, void *data);
+/*
+ * Function responsible to request a start job without waiting for the reply of systemd; returns
+ * 0 when the request was sent, in which case done (if not NULL) is called with the job result,
+ * or SYSD_JOB_RESULT_ERROR when the job could not be queued
+ */
+extern int SysdStartUnitAsync(const char *unit, SysdJobDoneFunc done, void *data);
+/*
+ * Function responsible to create and start a transient service; returns 0 when the job was
+ * queued, in which case done (if not NULL) is called once the job completes
+ */
+extern int SysdStartTransientUnit(const char *unit, const SysdTransientProps *props,
+                                  SysdJobDoneFunc done, void *data);
+/* Function responsible to reload the systemd manager configuration; returns 0 on success */
+extern int SysdReload();
+/*
+ * Function responsible to request a manager reload without waiting for it; returns 0 when
+ * the request was sent, in which case done (if not NULL) is called with a NULL unit once
+ * systemd replied
+ */
+extern int SysdReloadAsync(SysdJobDoneFunc done, void *data);
+/* Function responsible to log the unit job counters */
+extern void SysdJobLogCounters();
+
+#endif
@@ -0,0 +1,54 @@
+/*
+* unit_catalog.h, contains the declarations for the in-memory systemd unit catalog
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_UNIT_CATALOG_H
+#define __AL_UNIT_CATALOG_H
+
+/* application types, as returned by AppExistsInSystem() */
+#define UNIT_CATALOG_NONE 0
+#define UNIT_CATALOG_SERVICE 1
+#define UNIT_CATALOG_TARGET 2
+
+/* systemd unit search path, highest precedence first */
+#define UNIT_CATALOG_PATH_ETC "/etc/systemd/system"
+#define UNIT_CATALOG_PATH_RUN "/run/systemd/system"
+#define UNIT_CATALOG_PATH_LIB "/lib/systemd/system"
+#define UNIT_CATALOG_PATH_USR_LIB "/usr/lib/systemd/system"
+
+/* Function responsible to build the unit catalog and watch the search path for changes */
+extern int UnitCatalogInit();
+/* Function responsible to release the unit catalog and its watches */
+extern void UnitCatalogTerminate();
+/* Function responsible to test if the catalog is built and kept up to date */
+extern int UnitCatalogIsActive();
+/* Function responsible to get the catalog generation, which changes whenever a unit is added, removed or modified */
+extern unsigned long UnitCatalogGeneration();
+/* Function responsible to find the unit file in effect for a unit name; returns 1 if found */
+extern int UnitCatalogPath(const char *unit, char *path, size_t size);
+/* Function responsible to get the type of an application (UNIT_CATALOG_*) */
+extern int UnitCatalogAppType(const char *app_name);
+/* Function responsible to list the launchable applications starting with a prefix (NULL terminated, g_strfreev) */
+extern char **UnitCatalogListApps(const char *prefix);
+/* Function responsible to list the cataloged units that can be started (NULL terminated, g_strfreev) */
+extern char **UnitCatalogListUnits();
+/* Function responsible to log the catalog counters */
+extern void UnitCatalogLogCounters();
+
+#endif
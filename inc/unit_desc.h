@@ -0,0 +1,62 @@
+/*
+* unit_desc.h, contains the declarations for the resolved application unit descriptors
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_UNIT_DESC_H
+#define __AL_UNIT_DESC_H
+
+#include <stdbool.h>
+
+/* Immutable description of the systemd unit behind an application; never modified once published */
+typedef struct AlUnitDesc
+{
+    /* application name as requested by the clients */
+    char *app_name;
+    /* unit driven by start/stop/restart, e.g. foo.service, foo@bar.service, grp.target, reboot.timer */
+    char *unit;
+    /* template prefix ("foo@") for template instances, NULL otherwise */
+    char *template_base;
+    /* unit file in effect for the application (the template file for instances), NULL if unknown */
+    char *file_path;
+    /* UNIT_CATALOG_SERVICE or UNIT_CATALOG_TARGET */
+    int type;
+    /* the application is started through its .timer (deferred reboot/poweroff) */
+    bool is_timer;
+    /* systemd object path of the unit, NULL unless its load state is "loaded" */
+    char *object_path;
+    /* systemd load state at resolution time */
+    const char *load_state;
+    /* catalog generation the descriptor was resolved against */
+    unsigned long generation;
+    /* references held by the cache and the users */
+    int refs;
+} AlUnitDesc;
+
+/* Function responsible to get the descriptor of an application (NULL if unknown); release it with UnitDescUnref() */
+extern AlUnitDesc *UnitDescGet(const char *app_name);
+/* Function responsible to take a reference on a descriptor */
+extern AlUnitDesc *UnitDescRef(AlUnitDesc *desc);
+/* Function responsible to release a reference on a descriptor */
+extern void UnitDescUnref(AlUnitDesc *desc);
+/* Function responsible to drop every cached descriptor */
+extern void UnitDescTerminate();
+/* Function responsible to log the descriptor cache counters */
+extern void UnitDescLogCounters();
+
+#endif
@@ -0,0 +1,57 @@
+/*
+* unit_dropin.h, contains the declarations for the unit drop-in files written by the daemon
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_UNIT_DROPIN_H
+#define __AL_UNIT_DROPIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "unit_catalog.h"
+
+/* drop-ins lost on reboot, used for the settings of the current boot */
+#define UNIT_DROPIN_RUNTIME UNIT_CATALOG_PATH_RUN
+/* drop-ins kept across reboots, never collected */
+#define UNIT_DROPIN_PERSISTENT UNIT_CATALOG_PATH_ETC
+/* prefix of the drop-ins written by the daemon, <dir>/<unit>.d/al-<name>.conf */
+#define UNIT_DROPIN_PREFIX "al-"
+
+/*
+ * Function responsible to set one key of a unit in its drop-in al-<name>.conf under dir; a NULL
+ * value removes the drop-in and reset first clears list settings (e.g. OnActiveSec) inherited
+ * from the unit file. The file is replaced atomically and path receives its name.
+ * Returns 1 if the drop-in changed, 0 if it was already in effect, -1 on error.
+ */
+extern int UnitDropInSet(const char *dir, const char *unit, const char *name, const char *section,
+                         const char *key, const char *value, bool reset, char *path, size_t size);
+/*
+ * Function responsible to atomically write a whole unit file under dir, used only for units
+ * missing from the system; returns 1 if the file changed, 0 if it was unchanged, -1 on error
+ */
+extern int UnitDropInWriteUnit(const char *dir, const char *unit, const char *content);
+/*
+ * Function responsible to remove the drop-ins and temporary files left by a former daemon
+ * instance under UNIT_DROPIN_RUNTIME; returns the number of removed drop-ins
+ */
+extern int UnitDropInCollect();
+/* Function responsible to log the drop-in counters */
+extern void UnitDropInLogCounters();
+
+#endif
@@ -0,0 +1,67 @@
+/*
+* unit_file.h, contains the declarations for the cache of parsed unit files
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_UNIT_FILE_H
+#define __AL_UNIT_FILE_H
+
+#include <sys/types.h>
+#include <time.h>
+
+/* most unit files kept parsed, the least recently used one is evicted beyond */
+#define UNIT_FILE_CACHE_MAX 128
+
+/*
+ * Settings of a unit file the daemon uses, as read from the file (last occurrence of a
+ * key, unescaped and stripped, specifiers not expanded); NULL when not set. Never
+ * modified once published.
+ */
+typedef struct AlUnitFileInfo
+{
+    /* unit file and the identity it was parsed from */
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    /* [Service] settings */
+    char *user;
+    char *group;
+    char *type;
+    char *exec_start;
+    char *working_directory;
+    char *environment;
+    /* catalog generation the identity was last checked against */
+    unsigned long generation;
+    /* last use, for the eviction */
+    unsigned long used;
+    /* references held by the cache and the users */
+    int refs;
+} AlUnitFileInfo;
+
+/* Function responsible to get the parsed settings of a unit file (NULL if unreadable); release them with UnitFileInfoUnref() */
+extern AlUnitFileInfo *UnitFileInfoGet(const char *path);
+/* Function responsible to release a reference on parsed unit file settings */
+extern void UnitFileInfoUnref(AlUnitFileInfo *info);
+/* Function responsible to drop every cached unit file */
+extern void UnitFileCacheTerminate();
+/* Function responsible to log the unit file cache counters */
+extern void UnitFileCacheLogCounters();
+
+#endif
@@ -0,0 +1,55 @@
+/*
+* unit_match.h, contains the declarations for the systemd signal match rules of the application units
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_UNIT_MATCH_H
+#define __AL_UNIT_MATCH_H
+
+#include <dbus/dbus.h>
+#include <stdbool.h>
+
+/* per unit rules before falling back to a single rule for every unit; the bus limits the rules of a connection */
+#define UNIT_MATCH_RULES_MAX 448
+
+/*
+ * Function responsible to install the match rules of the cataloged and launched units on
+ * the signal dispatcher connection; called by the signal dispatcher thread
+ */
+extern int UnitMatchAttach(DBusConnection *conn);
+/* Function responsible to remove the match rules from the signal dispatcher connection */
+extern void UnitMatchDetach();
+/*
+ * Function responsible to apply the catalog changes and the launched units to the match
+ * rules; called by the signal dispatcher thread whenever it wakes up
+ */
+extern void UnitMatchSync(DBusConnection *conn);
+/* Function responsible to have the signals of a unit about to be started received; any thread */
+extern void UnitMatchWatch(const char *unit);
+/* Function responsible to drop the match rule of a launched unit systemd unloaded (UnitRemoved signal) */
+extern void UnitMatchUnitRemoved(DBusConnection *conn, DBusMessage *signal);
+/* Function responsible to test if the PropertiesChanged signal of a unit is followed; counts it as processed or filtered */
+extern bool UnitMatchAccept(DBusMessage *signal);
+/* Function responsible to test if the signals of a unit are received, so that its cached state is current */
+extern bool UnitMatchCovers(const char *unit);
+/* Function responsible to drop the tracked units */
+extern void UnitMatchTerminate();
+/* Function responsible to log the match rule counters */
+extern void UnitMatchLogCounters();
+
+#endif
@@ -0,0 +1,38 @@
+/*
+* unit_path.h, contains the declarations for the cache of unit object paths
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_UNIT_PATH_H
+#define __AL_UNIT_PATH_H
+
+#include <dbus/dbus.h>
+
+/* cached paths before the cache is emptied */
+#define UNIT_PATH_CACHE_MAX 1024
+
+/* Function responsible to get the object path of a unit (NULL on failure); free the result with free() */
+extern char *UnitPathGet(DBusConnection *conn, const char *unit);
+/* Function responsible to remember the object path systemd reported for a unit */
+extern void UnitPathStore(const char *unit, const char *path);
+/* Function responsible to drop every cached path */
+extern void UnitPathTerminate();
+/* Function responsible to log the object path cache counters */
+extern void UnitPathLogCounters();
+
+#endif
@@ -0,0 +1,42 @@
+/*
+* unit_reload.h, contains the declarations for the coalesced systemd configuration reloads
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_UNIT_RELOAD_H
+#define __AL_UNIT_RELOAD_H
+
+#include "sysd_job.h"
+
+/* default time unit file edits are collected before systemd is reloaded, in milliseconds */
+#define UNIT_RELOAD_WINDOW_MS 50
+
+/* Function responsible to set the time unit file edits are collected before a reload */
+extern void UnitReloadSetWindow(unsigned int window_ms);
+/*
+ * Function responsible to record a unit file edit; systemd is reloaded once for all the
+ * edits of a window and done (if not NULL) is called from the main loop, with a NULL unit,
+ * once that reload covering the edit completed
+ */
+extern void UnitReloadRequest(const char *path, SysdJobDoneFunc done, void *data);
+/* Function responsible to cancel the pending reload and complete its waiters as canceled */
+extern void UnitReloadTerminate();
+/* Function responsible to log the reload counters */
+extern void UnitReloadLogCounters();
+
+#endif
@@ -0,0 +1,73 @@
+/*
+* unit_state.h, contains the declarations for the unit state cache fed by systemd signals
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+#ifndef __AL_UNIT_STATE_H
+#define __AL_UNIT_STATE_H
+
+#include <dbus/dbus.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* unit state, see notifier.h */
+struct AlUnitState;
+
+/* state properties, as a mask of the known, decoded or changed ones */
+#define UNIT_STATE_LOAD 0x1
+#define UNIT_STATE_ACTIVE 0x2
+#define UNIT_STATE_SUB 0x4
+#define UNIT_STATE_MAIN_PID 0x8
+#define UNIT_STATE_FOREGROUND 0x10
+/* properties describing the run state */
+#define UNIT_STATE_RUN (UNIT_STATE_LOAD | UNIT_STATE_ACTIVE | UNIT_STATE_SUB)
+
+/* unit types whose state is primed at startup */
+#define UNIT_STATE_PRIME_PATTERNS { "*.service", "*.target", "*.timer", NULL }
+
+/* Function responsible to decode the state properties of an a{sv} dictionary; returns the mask of the decoded ones */
+extern int UnitStateDecode(DBusMessageIter *dict, struct AlUnitState *state);
+/*
+ * Function responsible to turn the cache on once the PropertiesChanged signals of systemd
+ * are received, and off (dropping its content) when they may be missed
+ */
+extern void UnitStateTrack(bool tracking);
+/*
+ * Function responsible to apply a PropertiesChanged signal of a unit to the cache; unit
+ * receives the unit name. Returns the mask of the changed or invalidated properties, -1
+ * if the signal is not the one of a unit.
+ */
+extern int UnitStateApplySignal(DBusMessage *signal, char *unit, size_t size);
+/* Function responsible to get the cached state of a unit; returns 0 if the needed properties are known */
+extern int UnitStateLookup(const char *unit, struct AlUnitState *state, int needed);
+/* Function responsible to complete the cache with a state fetched from systemd; known is the mask of the fetched properties */
+extern void UnitStateStore(const struct AlUnitState *state, int known);
+/* Function responsible to drop the cached state of a unit whose signals are no longer received */
+extern void UnitStateForget(const char *unit);
+/*
+ * Function responsible to fill the cache, and the object path cache, with the state of
+ * every application unit in a single ListUnits call; returns the number of primed units
+ * or -1 on failure
+ */
+extern int UnitStatePrime(DBusConnection *conn);
+/* Function responsible to drop the cached states */
+extern void UnitStateTerminate();
+/* Function responsible to log the unit state cache counters */
+extern void UnitStateLogCounters();
+
+#endif
@@ -18,23 +18,47 @@
 * 
 */
 
+/* resolved application units, see unit_desc.h */
+struct AlUnitDesc;
+/* transient service settings, see sysd_job.h */
+struct SysdTransientProps;
+
+/* object path prefix of the systemd units */
+#define AL_SYSD_UNIT_PATH_PREFIX "/org/freedesktop/systemd1/unit/"
+
+/* prefix of the transient units of the applications started with RunAs */
+#define AL_RUNAS_UNIT_PREFIX "al-runas-"
+
 /* Function responsible with the daemonization procedure */
 extern void AlDaemonize();
 /* Function responsible to shutdown the daemon process */
 extern void AlDaemonShutdown();
+/* Function to extract the binary name (basename of argv[0]) of a process from its cmdline */
+extern int AppBinaryNameFromPid(pid_t pid, char *name);
+/* Function to extract the main PID of a service unit, 0 if it has no process */
+extern pid_t UnitMainPid(const char *unit);
+/* Function to extract the main PID of an application from its service unit cgroup */
+extern pid_t AppPidFromUnit(char *app_name);
 /* Function to extract PID value using the name of an application */
 extern pid_t AppPidFromName(char *app_name);
 /* Find application name from PID */
 extern int AppNameFromPid(int pid, char *app_name);
+/* Function responsible to form the transient unit name of an application started with RunAs */
+extern void RunAsUnitName(const char *app_name, int uid, int gid, char *unit, size_t size);
+/* Function responsible to split a RunAs transient unit name; returns 0 if the unit is not a RunAs unit */
+extern int RunAsUnitParse(const char *unit, char *app_name, int *uid, int *gid);
+/* Function responsible to read the command and service settings of a unit file for a transient service */
+extern int UnitFileTransientProps(char *file, const char *app_name, struct SysdTransientProps *props);
+/* Function responsible to release the properties read by UnitFileTransientProps() */
+extern void TransientPropsFree(struct SysdTransientProps *props);
 /* Function responsible to test if a given application exists in the system. */
 extern int AppExistsInSystem(char *app_name);
 /* Function responsible to parse the .timer unit and extract the triggering key */
 extern GKeyFile *ParseUnitFile(char *file);
-/* Function responsible to parse the .timer unit and setup the triggering key value */
-extern void SetupUnitFileKey(char *file, char *key, char *val, char *unit);
-/* Function responsible to setup the (fg/bg) state when starting the application
- * for the first time using Run or RunAs */
-extern int SetupApplicationStartupState(DBusConnection *p_conn, char *p_app, bool l_fg_state);
+/* Function responsible to setup a key of a .timer or .service unit in a runtime drop-in; returns 1 if it changed */
+extern int SetupUnitFileKey(char *file, char *key, char *val, char *unit, char *path, size_t size);
+/* Function responsible to send the (fg/bg) state of an application without waiting for the reply */
+extern int SendApplicationStartupState(DBusConnection *p_conn, struct AlUnitDesc *p_desc, bool p_fg_state);
 /* Function responsible to extract template name from service file name 
  * when running application with variable command line parameters.
  */
@@ -43,6 +67,10 @@ extern char *ExtractUnitNameTemplate(char *unit_name);
  * NOTE: result should be freed with free() 
  */
 extern char *GetUnitObjectPath(DBusConnection *p_conn, char *p_app_name);
+/* Function responsible to get the unit name of a systemd unit object path; returns 1 if the path is the one of a unit */
+extern int UnitNameFromObjectPath(const char *path, char *unit, size_t size);
+/* Function responsible to escape a unit name into its systemd object path; returns 0 on success */
+extern int UnitObjectPathFromName(const char *unit, char *path, size_t size);
 /* Function responsible to extract the service interface from the path.
  * Useful when determining which properties are available for the 
  * specific service of interest.
@@ -27,6 +27,7 @@
 #include <getopt.h>
 #include <glib/gstdio.h>
 #include <glib.h>
+#include <glib-unix.h>
 #include <grp.h>
 #include <libgen.h>
 #include <pwd.h>
@@ -46,6 +47,19 @@
 #include "notifier.h"
 #include "dbus_interface.h"
 #include "utils.h"
+#include "pid_index.h"
+#include "snapshot.h"
+#include "unit_catalog.h"
+#include "unit_desc.h"
+#include "sysd_job.h"
+#include "unit_reload.h"
+#include "unit_dropin.h"
+#include "unit_file.h"
+#include "ident_cache.h"
+#include "unit_state.h"
+#include "unit_path.h"
+#include "unit_match.h"
+#include "event_queue.h"
 
 /* Connection to the system bus */
 DBusGConnection *g_conn = NULL;
@@ -74,7 +88,12 @@ void AlPrintCLI()
 	  "   al-daemon --help|-H\n"
 	  "\n"
 	  "Options: \n"
-	  "  --verbose|-v prints the internal daemon log messages\n");
+	  "  --verbose|-v prints the internal daemon log messages\n"
+	  "  --systemctl|-s issues unit operations through systemctl instead of the systemd bus API\n"
+	  "  --reload-window|-w <ms> collects unit file edits for <ms> before reloading systemd (default %d)\n"
+	  "  --no-legacy-state|-n only sends TaskStateChanged, not the GlobalStateNotification string signal\n"
+	  "  --notify-window|-c <ms> notifies the state changes of a unit once per <ms> (default %d, 0 disables)\n",
+	  UNIT_RELOAD_WINDOW_MS, AL_NOTIFY_WINDOW_MS);
 }
 
 /* Function responsible with command line options parsing */
@@ -87,13 +106,17 @@ void AlParseCLIOptions(int argc, char *const *argv)
     {"help", 0, NULL, 'H'},
     {"version", 0, NULL, 'V'},
     {"verbose", 0, NULL, 'v'},
+    {"systemctl", 0, NULL, 's'},
+    {"reload-window", 1, NULL, 'w'},
+    {"no-legacy-state", 0, NULL, 'n'},
+    {"notify-window", 1, NULL, 'c'},
     {NULL, 0, NULL, 0}
   };
 
   int l_op;
   /* option parsing */
   while (1) {
-    l_op = getopt_long(argc, argv, "HKSVv", l_long_opts, (int *) 0);
+    l_op = getopt_long(argc, argv, "HKSVvsw:nc:", l_long_opts, (int *) 0);
 
     if (l_op == -1)
       break;
@@ -112,6 +135,18 @@ void AlParseCLIOptions(int argc, char *const *argv)
       exit(0);
     case 'v' :
       break;
+    case 's':			/* legacy systemctl unit operations */
+      SysdJobUseSystemctl(1);
+      break;
+    case 'w':			/* unit file edits collection window */
+      UnitReloadSetWindow((unsigned int) strtoul(optarg, NULL, 10));
+      break;
+    case 'n':			/* typed state signal only */
+      AlSetLegacyStateSignal(false);
+      break;
+    case 'c':			/* state notifications coalescing window */
+      AlSetNotifyWindow((unsigned int) strtoul(optarg, NULL, 10));
+      break;
     default:
       AlPrintCLI();
       return;
@@ -122,6 +157,35 @@ void AlParseCLIOptions(int argc, char *const *argv)
 }
 
 
+/* Function responsible to log the daemon performance counters */
+void AlLogCounters()
+{
+  SnapshotLogCounters();
+  UnitCatalogLogCounters();
+  UnitDescLogCounters();
+  SysdJobLogCounters();
+  UnitReloadLogCounters();
+  UnitDropInLogCounters();
+  UnitFileCacheLogCounters();
+  IdentCacheLogCounters();
+  UnitStateLogCounters();
+  UnitPathLogCounters();
+  UnitMatchLogCounters();
+  AlNotifierLogCounters();
+  AlSignalDispatcherLogCounters();
+  EventQueueLogCounters();
+}
+
+/*
+ * Main loop callback dumping the performance counters on SIGUSR1; the counters are
+ * guarded by locks the other threads hold, they cannot be logged from a signal handler
+ */
+static gboolean AlOnLogCountersSignal(gpointer p_data)
+{
+  AlLogCounters();
+  return TRUE;
+}
+
 /* Signal handler for the daemon */
 void AlSignalHandler(int p_sig)
 
@@ -161,6 +225,8 @@ int main(int argc, char **argv)
   /* handle signals */
   signal(SIGTERM, AlSignalHandler);
   signal(SIGKILL, AlSignalHandler);
+  /* SIGUSR1 dumps the counters once the main loop runs */
+  signal(SIGUSR1, SIG_IGN);
   
   /* parse cli options */
   AlParseCLIOptions(argc, argv);
@@ -175,8 +241,35 @@ int main(int argc, char **argv)
     AlDaemonize();
     log_message("Daemon process was started !\n", 0);
 
+    /* build the application name to PID index */
+    if (PidIndexInit() != 0) {
+      log_error_message("PID index unavailable, PID lookups will scan /proc !\n", 0);
+    }
+
+    /* catalog the units that can be launched */
+    if (UnitCatalogInit() != 0) {
+      log_error_message("Unit catalog unavailable, unit lookups will probe the file system !\n", 0);
+    }
+
+    /* resolve the users and groups off the main loop */
+    if (IdentCacheInit() != 0) {
+      log_error_message("Identity cache is not refreshed, identities are resolved on first use !\n", 0);
+    }
+
+    /* initialize SRM Daemon */
+	if(!initialize_al_dbus()){
+		log_error_message("Failed to initialize AL Daemon!\n Stopping daemon ...", 0);
+		terminate_al_dbus();
+		return 1;
+
+	}
+
+    /* settings of a former instance are stale, systemd forgets them with the next reload */
+    if (UnitDropInCollect() > 0)
+      UnitReloadRequest("stale drop-ins", NULL, NULL);
+
 #ifdef USE_LAST_USER_MODE
-    /* initialise the last user mode */
+    /* initialise the last user mode, its applications are started through the systemd proxy */
     if(!(l_ret=InitializeLastUserMode())){
       log_error_message("Last user mode initialization failed !\n", 0);
     }
@@ -184,13 +277,13 @@ int main(int argc, char **argv)
     }
 #endif
 
-    /* initialize SRM Daemon */
-	if(!initialize_al_dbus()){
-		log_error_message("Failed to initialize AL Daemon!\n Stopping daemon ...", 0);
+	/* the state notifications of the signal dispatching thread are emitted by the main loop */
+	if (EventQueueInit() != 0) {
+		log_error_message("Failed to create the main loop event queue!\n Stopping daemon ...", 0);
 		terminate_al_dbus();
 		return 1;
-
 	}
+
 	/* start the signal dispatching thread */
 	al_dbus_signal_dispatcher();
 	/* main loop */
@@ -200,6 +293,8 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	g_unix_signal_add(SIGUSR1, AlOnLogCountersSignal, NULL);
+
 	/* run the main loop */
 	g_main_loop_run(l_loop);
 
@@ -209,7 +304,16 @@ int main(int argc, char **argv)
   closelog ();
 
   /* free res */
+  PidIndexTerminate();
+  UnitDescTerminate();
+  UnitFileCacheTerminate();
+  IdentCacheTerminate();
+  UnitStateTerminate();
+  UnitPathTerminate();
+  UnitMatchTerminate();
+  UnitCatalogTerminate();
   terminate_al_dbus();
+  EventQueueTerminate();
 
   return 0;
 }
@@ -0,0 +1,234 @@
+/*
+* app_handle.c, contains the implementation of the pidfd based handles of launched applications
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * Every application launched by the daemon is pinned by a pidfd. Signals are sent
+ * through the pidfd, so a recycled PID can never receive them, and the pidfd is
+ * watched from the main loop so TaskStopped is emitted as soon as the process exits.
+ * The state change systemd reports for the unit may come first or second, so the
+ * exit reported last for each unit is remembered and TaskStopped is sent once.
+ */
+
+#include <errno.h>
+#include <glib.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "al-daemon.h"
+#include "app_handle.h"
+
+extern ALDbus *g_al_dbus;
+
+/* handle held for a launched application */
+typedef struct
+{
+  /* process file descriptor, the handle is dropped once the process exited */
+  int pidfd;
+  /* pid the handle was opened for */
+  pid_t pid;
+  /* unit the application was started with and name reported in TaskStopped */
+  char *unit;
+  char *name;
+  /* main loop watch on the pidfd */
+  guint watch;
+} AppHandle;
+
+/* PID -> AppHandle */
+static GHashTable *g_app_handles = NULL;
+/* unit name -> PID whose exit was last reported */
+static GHashTable *g_app_exits = NULL;
+/* protects the tables; systemd notifications consult them from the dispatcher thread */
+static pthread_mutex_t g_app_handle_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* pidfd system call wrappers; ENOSYS when the kernel headers lack them */
+static int AppHandlePidfdOpen(pid_t p_pid)
+{
+#ifdef __NR_pidfd_open
+  return syscall(__NR_pidfd_open, p_pid, 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+static int AppHandlePidfdSendSignal(int p_pidfd, int p_sig)
+{
+#ifdef __NR_pidfd_send_signal
+  return syscall(__NR_pidfd_send_signal, p_pidfd, p_sig, NULL, 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/* Function responsible to release a handle removed from the table */
+static void AppHandleFree(gpointer p_data)
+{
+  AppHandle *l_handle = (AppHandle *)p_data;
+  if (l_handle->watch)
+    g_source_remove(l_handle->watch);
+  if (l_handle->pidfd >= 0)
+    close(l_handle->pidfd);
+  free(l_handle->unit);
+  free(l_handle->name);
+  free(l_handle);
+}
+
+/* Function responsible to record the exit of a PID of a unit; lock must be held. Returns 1 if it was not reported yet */
+static int AppHandleClaimExitLocked(const char *p_unit, pid_t p_pid)
+{
+  /* pid whose exit was last reported for the unit */
+  gpointer l_last;
+  if (!g_app_exits)
+    g_app_exits = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  if (p_pid > 0 && g_hash_table_lookup_extended(g_app_exits, p_unit, NULL, &l_last)
+      && GPOINTER_TO_INT(l_last) == p_pid)
+    return 0;
+  g_hash_table_replace(g_app_exits, g_strdup(p_unit), GINT_TO_POINTER(p_pid));
+  return 1;
+}
+
+/* Main loop callback called when the process behind a pidfd exits */
+static gboolean AppHandleOnExit(GIOChannel *p_source, GIOCondition p_cond, gpointer p_data)
+{
+  /* pid the watch was registered for */
+  pid_t l_pid = (pid_t)GPOINTER_TO_INT(p_data);
+  /* exited handle */
+  AppHandle *l_handle;
+  /* copy of the application name for the signal */
+  char *l_name = NULL;
+  pthread_mutex_lock(&g_app_handle_lock);
+  if (g_app_handles
+      && (l_handle = g_hash_table_lookup(g_app_handles, GINT_TO_POINTER(l_pid))) != NULL) {
+    /* the source is destroyed by returning FALSE */
+    l_handle->watch = 0;
+    /* skipped when systemd reported the exit first */
+    if (AppHandleClaimExitLocked(l_handle->unit, l_pid))
+      l_name = strdup(l_handle->name);
+    g_hash_table_remove(g_app_handles, GINT_TO_POINTER(l_pid));
+  }
+  pthread_mutex_unlock(&g_app_handle_lock);
+  if (l_name) {
+    log_debug_message("Application Handle : %s (pid %d) exited\n", l_name, l_pid);
+    al_dbus_task_stopped(g_al_dbus, l_pid, l_name);
+    free(l_name);
+  }
+  return FALSE;
+}
+
+/* Function responsible to open a pidfd for a launched application and watch it for exit */
+int AppHandleOpen(pid_t p_pid, const char *p_unit, char *p_app_name)
+{
+  /* new handle */
+  AppHandle *l_handle;
+  /* process file descriptor */
+  int l_pidfd;
+  /* channel for the main loop watch */
+  GIOChannel *l_channel;
+  if (p_pid <= 0)
+    return -1;
+  if ((l_pidfd = AppHandlePidfdOpen(p_pid)) < 0) {
+    log_error_message("Application Handle : Cannot open pidfd for %s (pid %d) ! Err : %s\n",
+                      p_app_name, p_pid, strerror(errno));
+    return -1;
+  }
+  l_handle = malloc(sizeof(AppHandle));
+  l_handle->pidfd = l_pidfd;
+  l_handle->pid = p_pid;
+  l_handle->unit = strdup(p_unit);
+  l_handle->name = strdup(p_app_name);
+  /* a pidfd becomes readable when the process exits */
+  l_channel = g_io_channel_unix_new(l_pidfd);
+  l_handle->watch = g_io_add_watch(l_channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                   AppHandleOnExit, GINT_TO_POINTER(p_pid));
+  g_io_channel_unref(l_channel);
+  pthread_mutex_lock(&g_app_handle_lock);
+  if (!g_app_handles)
+    g_app_handles = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, AppHandleFree);
+  /* replaces any stale handle left for a recycled pid */
+  g_hash_table_insert(g_app_handles, GINT_TO_POINTER(p_pid), l_handle);
+  pthread_mutex_unlock(&g_app_handle_lock);
+  log_debug_message("Application Handle : Holding pidfd for %s (pid %d)\n", p_app_name, p_pid);
+  return 0;
+}
+
+/* Function responsible to deliver a signal to an application, through its pidfd when one is held */
+int AppHandleSendSignal(pid_t p_pid, int p_sig)
+{
+  /* held handle */
+  AppHandle *l_handle;
+  /* return code */
+  int l_ret;
+  pthread_mutex_lock(&g_app_handle_lock);
+  l_handle = g_app_handles ? g_hash_table_lookup(g_app_handles, GINT_TO_POINTER(p_pid)) : NULL;
+  if (l_handle) {
+    if ((l_ret = AppHandlePidfdSendSignal(l_handle->pidfd, p_sig)) < 0 && errno == ENOSYS)
+      l_ret = kill(p_pid, p_sig);
+    pthread_mutex_unlock(&g_app_handle_lock);
+    return l_ret;
+  }
+  pthread_mutex_unlock(&g_app_handle_lock);
+  /* not launched by the daemon */
+  return kill(p_pid, p_sig);
+}
+
+/* Function responsible to test that a PID still designates the application launched under it */
+int AppHandleValidate(pid_t p_pid)
+{
+  if (AppHandleSendSignal(p_pid, 0) < 0 && errno == ESRCH) {
+    log_error_message("Application Handle : pid %d no longer designates a running application !\n",
+                      p_pid);
+    return -1;
+  }
+  return 0;
+}
+
+/* Function responsible to record the exit of a PID of a unit; returns 1 if the caller reports it, 0 if it was already reported */
+int AppHandleClaimExit(const char *p_unit, pid_t p_pid)
+{
+  /* result */
+  int l_ret;
+  pthread_mutex_lock(&g_app_handle_lock);
+  l_ret = AppHandleClaimExitLocked(p_unit, p_pid);
+  pthread_mutex_unlock(&g_app_handle_lock);
+  return l_ret;
+}
+
+/* Function responsible to close all the held application handles */
+void AppHandleTerminate()
+{
+  pthread_mutex_lock(&g_app_handle_lock);
+  if (g_app_handles) {
+    g_hash_table_destroy(g_app_handles);
+    g_app_handles = NULL;
+  }
+  if (g_app_exits) {
+    g_hash_table_destroy(g_app_exits);
+    g_app_exits = NULL;
+  }
+  pthread_mutex_unlock(&g_app_handle_lock);
+}
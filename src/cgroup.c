@@ -0,0 +1,217 @@
+/*
+* cgroup.c, contains the implementation of the cgroup based application to PID resolution
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * systemd places every process of a unit in the unit's own cgroup, so the owner of
+ * a PID is the unit named in /proc/<pid>/cgroup and the processes of a unit are the
+ * ones listed in its cgroup.procs. The unit -> cgroup path mapping is cached.
+ */
+
+/* strchrnul() */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "al-daemon.h"
+#include "cgroup.h"
+
+/* mount point of the systemd hierarchy for legacy (v1) and unified (v2) layouts */
+#define CGROUP_V1_ROOT "/sys/fs/cgroup/systemd"
+#define CGROUP_V2_ROOT "/sys/fs/cgroup"
+/* buffer used to read cgroup files */
+#define CGROUP_BUF_SIZE 4096
+
+/* unit name -> cgroup path relative to the hierarchy root */
+static GHashTable *g_cgroup_paths = NULL;
+/* protects the path cache */
+static pthread_mutex_t g_cgroup_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Function responsible to read a small file, at most size - 1 bytes of it */
+static ssize_t CgroupReadFile(const char *p_path, char *p_buf, size_t p_size)
+{
+  /* file descriptor */
+  int l_fd;
+  /* read length */
+  ssize_t l_ret;
+  size_t l_len = 0;
+  if ((l_fd = open(p_path, O_RDONLY | O_CLOEXEC)) < 0)
+    return -1;
+  /* cgroup files are generated a page at a time */
+  while (l_len < p_size - 1) {
+    if ((l_ret = read(l_fd, p_buf + l_len, p_size - 1 - l_len)) < 0) {
+      if (errno == EINTR)
+        continue;
+      close(l_fd);
+      return -1;
+    }
+    if (l_ret == 0)
+      break;
+    l_len += l_ret;
+  }
+  close(l_fd);
+  p_buf[l_len] = '\0';
+  return l_len;
+}
+
+/* Function responsible to select the mount point of the systemd hierarchy */
+static const char *CgroupRoot()
+{
+  /* stat info */
+  struct stat l_st;
+  return (stat(CGROUP_V1_ROOT, &l_st) == 0) ? CGROUP_V1_ROOT : CGROUP_V2_ROOT;
+}
+
+/* Function responsible to remember the cgroup path of a unit */
+static void CgroupCachePath(const char *p_unit, const char *p_path)
+{
+  pthread_mutex_lock(&g_cgroup_lock);
+  if (!g_cgroup_paths)
+    g_cgroup_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  g_hash_table_replace(g_cgroup_paths, g_strdup(p_unit), g_strdup(p_path));
+  pthread_mutex_unlock(&g_cgroup_lock);
+}
+
+/* Function responsible to find the systemd unit owning a PID from /proc/<pid>/cgroup */
+int CgroupUnitFromPid(pid_t p_pid, char *p_unit, size_t p_size)
+{
+  /* file name and content */
+  char l_filename[DIM_MAX];
+  char l_buf[CGROUP_BUF_SIZE];
+  /* current line */
+  char *l_line, *l_save = NULL;
+  /* systemd hierarchy path of the pid */
+  char *l_path = NULL;
+  /* path components */
+  char *l_comp, *l_unit_end = NULL, *l_unit_start = NULL;
+  sprintf(l_filename, "/proc/%d/cgroup", p_pid);
+  if (CgroupReadFile(l_filename, l_buf, sizeof(l_buf)) <= 0)
+    return 0;
+  /* lines are hierarchy-id:controllers:path */
+  for (l_line = strtok_r(l_buf, "\n", &l_save); l_line; l_line = strtok_r(NULL, "\n", &l_save)) {
+    /* controllers field */
+    char *l_ctrl = strchr(l_line, ':');
+    if (!l_ctrl)
+      continue;
+    l_ctrl++;
+    if (strncmp(l_ctrl, "name=systemd:", 13) == 0) {
+      l_path = l_ctrl + 13;
+      break;
+    }
+    /* unified hierarchy, kept unless the legacy one is found */
+    if (strncmp(l_line, "0::", 3) == 0)
+      l_path = l_line + 3;
+  }
+  if (!l_path)
+    return 0;
+  /* the owner is the innermost component carrying a unit suffix */
+  for (l_comp = l_path; (l_comp = strchr(l_comp, '/')) != NULL; ) {
+    /* end of the component */
+    char *l_end;
+    l_comp++;
+    l_end = strchrnul(l_comp, '/');
+    if ((l_end - l_comp > 8 && strncmp(l_end - 8, ".service", 8) == 0)
+        || (l_end - l_comp > 6 && strncmp(l_end - 6, ".scope", 6) == 0)) {
+      l_unit_start = l_comp;
+      l_unit_end = l_end;
+    }
+  }
+  if (!l_unit_start || (size_t)(l_unit_end - l_unit_start) >= p_size)
+    return 0;
+  memcpy(p_unit, l_unit_start, l_unit_end - l_unit_start);
+  p_unit[l_unit_end - l_unit_start] = '\0';
+  /* remember where the unit lives for the reverse lookup */
+  *l_unit_end = '\0';
+  CgroupCachePath(p_unit, l_path);
+  return 1;
+}
+
+/* Function responsible to list the PIDs of a unit from its cgroup.procs; returns the PID count or -1 */
+int CgroupPidsFromUnit(char *p_unit, pid_t *p_pids, int p_max_pids)
+{
+  /* cached or guessed cgroup path */
+  char l_path[PATH_MAX];
+  /* cgroup.procs file name and content */
+  char l_filename[PATH_MAX];
+  char l_buf[CGROUP_BUF_SIZE];
+  /* cached path */
+  char *l_cached = NULL;
+  /* parse cursor */
+  char *l_cur, *l_next;
+  /* template prefix length */
+  char *l_at;
+  /* number of pids */
+  int l_count = 0;
+  pthread_mutex_lock(&g_cgroup_lock);
+  if (g_cgroup_paths && (l_cached = g_hash_table_lookup(g_cgroup_paths, p_unit)) != NULL)
+    snprintf(l_path, sizeof(l_path), "%s", l_cached);
+  pthread_mutex_unlock(&g_cgroup_lock);
+  if (!l_cached) {
+    /* default placement of system services; template instances get their own slice */
+    if ((l_at = strchr(p_unit, '@')) != NULL)
+      snprintf(l_path, sizeof(l_path), "/system.slice/system-%.*s.slice/%s",
+               (int)(l_at - p_unit), p_unit, p_unit);
+    else
+      snprintf(l_path, sizeof(l_path), "/system.slice/%s", p_unit);
+  }
+  snprintf(l_filename, sizeof(l_filename), "%s%s/cgroup.procs", CgroupRoot(), l_path);
+  if (CgroupReadFile(l_filename, l_buf, sizeof(l_buf)) < 0) {
+    /* the unit moved or is not running */
+    if (l_cached) {
+      pthread_mutex_lock(&g_cgroup_lock);
+      g_hash_table_remove(g_cgroup_paths, p_unit);
+      pthread_mutex_unlock(&g_cgroup_lock);
+    }
+    return -1;
+  }
+  if (!l_cached)
+    CgroupCachePath(p_unit, l_path);
+  /* one PID per line; a number cut by the end of the buffer has no newline */
+  for (l_cur = l_buf; *l_cur && l_count < p_max_pids; l_cur = l_next + 1) {
+    /* parsed pid */
+    long l_pid = strtol(l_cur, &l_next, 10);
+    if (l_next == l_cur || *l_next != '\n')
+      break;
+    if (l_pid > 0)
+      p_pids[l_count++] = (pid_t)l_pid;
+  }
+  return l_count;
+}
+
+/* Function responsible to release the unit to cgroup path cache */
+void CgroupTerminate()
+{
+  pthread_mutex_lock(&g_cgroup_lock);
+  if (g_cgroup_paths) {
+    g_hash_table_destroy(g_cgroup_paths);
+    g_cgroup_paths = NULL;
+  }
+  pthread_mutex_unlock(&g_cgroup_lock);
+}
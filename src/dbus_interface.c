@@ -39,6 +39,7 @@
 #include <sys/sysctl.h>
 #include <sys/types.h>
 #include <sys/user.h>
+#include <time.h>
 #include <unistd.h>
 #include <gio/gio.h>
 
@@ -46,9 +47,21 @@
 #include "utils.h"
 #include "notifier.h"
 #include "al-daemon.h"
+#include "app_handle.h"
+#include "cgroup.h"
+#include "ident_cache.h"
+#include "snapshot.h"
+#include "sysd_job.h"
+#include "unit_catalog.h"
+#include "unit_desc.h"
+#include "unit_file.h"
+#include "unit_reload.h"
+#include "unit_state.h"
+#include "unit_match.h"
 #include "al_dbus-glue.h"
 #include "task_info_custom_marshaller.c"
 #include "task_state_change_custom_marshaller.c"
+#include "task_state_changed_custom_marshaller.c"
 
 /* define the AL Daemon GLib Object */
 G_DEFINE_TYPE(ALDbus, al_dbus, G_TYPE_OBJECT);
@@ -105,6 +118,16 @@ static void al_dbus_class_init(ALDbusClass * class
 			 NULL,
 			 g_cclosure_marshal_VOID__STRING,
 			 G_TYPE_NONE, 1, G_TYPE_STRING);
+	class->ALSignals[AL_SIG_TASK_STATE_CHANGED] =
+	    g_signal_new("task_state_changed",
+			 G_OBJECT_CLASS_TYPE(class),
+			 (G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION),
+			 0,
+			 NULL,
+			 NULL,
+			 al_dbus_VOID__STRING_STRING_UINT_UINT_UINT_INT_BOOLEAN_UINT64,
+			 G_TYPE_NONE, 8, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_UINT, G_TYPE_UINT,
+			 G_TYPE_UINT, G_TYPE_INT, G_TYPE_BOOLEAN, G_TYPE_UINT64);
 }
 
 /*
@@ -208,147 +231,51 @@ static void al_dbus_finalize(ALDbus * server
 /* Function responsible to parse the service unit and extract ownership info */
 void ExtractOwnershipInfo(char *p_euid, char *p_egid, char *p_file)
 {
-  /* key file group length */
-  gsize l_groups_length;
-  /* store the groups in the keyfile */
-  char **l_groups;
-  /* local store of egid and euid */
-  char *l_gid = malloc(DIM_MAX*sizeof(l_gid));
-  char *l_uid = malloc(DIM_MAX*sizeof(l_uid));
-  log_debug_message("Unit File Parser : Creating new key file to support ownership info for %s \n", p_file);
-  /* the created GKeyFile for the given file on disk */
-  GKeyFile *l_out_new_key_file = g_key_file_new();
-  if(!l_out_new_key_file) {
-	log_error_message("Unit File Parser : The key file cannot be created for %s \n", p_file);
-	return;
-  }
-  log_debug_message("Unit File Parser : Initialize the error for uid/gid extraction for %s \n", p_file);
-  /* initialize the error */
-  GError *l_err = NULL;
-  log_debug_message("Unit File Parser : Load key file from disk for %s \n", p_file);
-  /* load key file structure from file on disk */
-  if (!g_key_file_load_from_file
-      (l_out_new_key_file, p_file, G_KEY_FILE_NONE, &l_err)) {
-          if(NULL!=l_err){
-              log_error_message
-	          ("Unit File Parser : Cannot load key structure from service unit key file! (%d: %s)\n",
-                   l_err->code, l_err->message);
-              g_error_free(l_err);
-          } else {
-              log_error_message
-	          ("Unit File Parser : Cannot load key structure from service unit key file!%s\n", "");
-          }
-    g_key_file_free(l_out_new_key_file);
+  /* parsed unit file, served from the unit file cache */
+  AlUnitFileInfo *l_info;
+  /* an unreadable file or an unset key gives no owner */
+  strcpy(p_euid, "");
+  strcpy(p_egid, "");
+  if (!(l_info = UnitFileInfoGet(p_file))) {
+    log_error_message("Ownership Info Extractor : Could not parse %s service unit file!\n", p_file);
     return;
   }
-  log_debug_message("Unit File Parser : Extracting groups from key file structure for %s \n", p_file);
-  /* extract groups from key file structure */
-  l_groups = g_key_file_get_groups(l_out_new_key_file, &l_groups_length);
-  log_debug_message
-	("Ownership Info Extractor : Extracted groups from key file for %s \n",
-	 p_file);
-  if (l_groups == NULL) {
-    log_error_message
-	("Ownership Info Extractor : Could not retrieve groups from %s service unit file!\n",
-	 p_file);
-      g_key_file_free(l_out_new_key_file);
-      return;
-  }
-  unsigned long l_i;
-  /* loop to get keys from key fle structure */
-  for (l_i = 0; l_i < l_groups_length; l_i++) {
-    gsize l_keys_length;
-    char **l_keys;
-    /* get current key from file */
-    l_keys =
-	g_key_file_get_keys(l_out_new_key_file, l_groups[l_i],
-			    &l_keys_length, &l_err);
-    log_debug_message
-	("Ownership Info Extractor : Extracted keys from key file for %s \n",
-	 p_file);
-    /* check if the file is properly structured */
-    if (l_keys == NULL) {
-        if(NULL!=l_err){
-            log_error_message
-	        ("Ownership Info Extractor : error in retrieving keys in service unit file! (%d: %s)", 
-                 l_err->code, l_err->message);
-            g_error_free(l_err);
-        } else {
-            log_error_message
-	        ("Ownership Info Extractor : error in retrieving keys in service unit file!%s", "");
-        }
-    } else {
-      unsigned long l_j;
-      /* loop to get key values */
-      for (l_j = 0; l_j < l_keys_length; l_j++) {
-	char *l_str_value;
-	/* extract current value for a given key */
-	l_str_value =
-	    g_key_file_get_string(l_out_new_key_file, l_groups[l_i],
-				  l_keys[l_j], &l_err); 
-        if(strcmp(l_keys[l_j], "User")==0){
-		l_uid = l_str_value;		
- 	}
-        if(strcmp(l_keys[l_j], "Group")==0){
-		l_gid = l_str_value;		
- 	}
-	/* check value validity */
-	if (l_str_value == NULL) {
-            if(NULL!=l_err){
-                log_error_message
-                    ("Ownership Info Extractor : Error retrieving key's value in service unit file. (%d, %s)\n",
-                     l_err->code, l_err->message);
-                g_error_free(l_err);
-            } else {
-                log_error_message
-                    ("Ownership Info Extractor : Error retrieving key's value in service unit file.%s\n", "");
-            }
-	}
-      }
-    }
-  }
-  /* the extracted ownership values */
-  log_debug_message("Ownership Info Extractor : Preparing keys to be returned for %s \n",
-	 p_file);
-  strcpy(p_egid, l_gid);
-  log_debug_message("Ownership Info Extractor : Extracted keys from key file for %s \n",
-	 p_file);
-  strcpy(p_euid, l_uid);
-  log_debug_message("Ownership Info Extractor : Extracted keys from key file for %s \n",
-	 p_file);
-  if(l_out_new_key_file) g_key_file_free(l_out_new_key_file);
+  if (l_info->user)
+    g_strlcpy(p_euid, l_info->user, DIM_MAX);
+  if (l_info->group)
+    g_strlcpy(p_egid, l_info->group, DIM_MAX);
+  log_debug_message("Ownership Info Extractor : Extracted keys from key file for %s \n", p_file);
+  UnitFileInfoUnref(l_info);
 }
 
 /* Function responsible to extract the user name from the uid */
 int MapUidToUser(int p_uid, char *p_user){
-  /* handler for passwd */
-  struct passwd *l_pwd;
-  /* storage for uid */
-  uid_t l_uid = (uid_t)p_uid;
-  /* check id existence */
-  if ((l_pwd = getpwuid(p_uid))==NULL){
-         log_error_message("UID to User Mapper : UID %d is not associated with any existing user !\n", p_uid);
-	 return -1;
-	 }
-  /* extract the user from the structure */
-  strcpy(p_user, l_pwd->pw_name);
+  /* lookup result */
+  int l_ret;
+  /* served from the identity cache */
+  if ((l_ret = IdentUserName((unsigned int)p_uid, p_user, DIM_MAX)) != 0) {
+	if (l_ret == IDENT_CACHE_PENDING)
+		log_error_message("UID to User Mapper : UID %d is not resolved yet, try again !\n", p_uid);
+	else
+		log_error_message("UID to User Mapper : UID %d is not associated with any existing user !\n", p_uid);
+	return -1;
+  }
   log_debug_message("UID to User Mapper : uid=%d(%s) \n", p_uid, p_user);
   return 0;
 }
 
 /* Function responsible to extract the group name from the gid */
 int MapGidToGroup(int p_gid, char *p_group){
-  /* handler for group info */
-  struct group *l_gp;
-  /* storage for gid */
-  gid_t l_gid = (gid_t)p_gid;
-  /* check group */
-  if ((l_gp = getgrgid(l_gid))==NULL){
-	log_error_message("GID to User Mapper : GID %d is not associated with any existing group !\n", p_gid);
-	return -1;	
-	}
-  /* extract guid information */
-  strcpy(p_group, l_gp->gr_name);
+  /* lookup result */
+  int l_ret;
+  /* served from the identity cache */
+  if ((l_ret = IdentGroupName((unsigned int)p_gid, p_group, DIM_MAX)) != 0) {
+	if (l_ret == IDENT_CACHE_PENDING)
+		log_error_message("GID to User Mapper : GID %d is not resolved yet, try again !\n", p_gid);
+	else
+		log_error_message("GID to User Mapper : GID %d is not associated with any existing group !\n", p_gid);
+	return -1;
+  }
   log_debug_message("GID to Group Mapper : gid=%d(%s) \n", p_gid, p_group);
   return 0;
 }
@@ -397,6 +324,10 @@ gboolean initialize_al_dbus()
 		log_error_message("Failed to get proxy to Systemd !", 0);
 		goto free_res;
 	}
+	/* complete the method calls when their systemd jobs are removed */
+	if (SysdJobInit() != 0) {
+		log_error_message("Init : Job completions are not tracked, methods will return once their job is queued !\n", 0);
+	}
 
 	if (success == TRUE)
 		log_debug_message("The AL Daemon was initialized ...\n", 0);
@@ -420,6 +351,14 @@ gboolean terminate_al_dbus()
 {
 	log_debug_message("Shutting down the AL Daemon ...\n", 0);
 
+	/* answer the method calls still waiting for their jobs */
+	UnitReloadTerminate();
+	SysdJobTerminate();
+	/* release the pidfds of the launched applications */
+	AppHandleTerminate();
+	/* release the unit cgroup path cache */
+	CgroupTerminate();
+
 	if (g_al_proxy) {
 		g_object_unref(g_al_proxy);
 		g_al_proxy = NULL;
@@ -443,6 +382,189 @@ gboolean terminate_al_dbus()
 
 /* API method calls */
 
+/*
+ * Function responsible to arm the timer of a deferred reboot/poweroff ("reboot <time>")
+ * and to strip the timing from the command line; returns the drop-in holding the timing
+ * when it changed, in which case systemd has to reload it before the timer is started,
+ * or NULL
+ */
+static const char *SetupDeferredCommand(gchar * p_command_line)
+{
+	/* tokenizer state */
+	char *l_save = NULL;
+	/* time until deferred triggering */
+	char *l_time = NULL;
+	/* drop-in holding the timing, valid until the next call */
+	static char l_path[PATH_MAX];
+	/* the timing changed */
+	int l_changed = 0;
+	if ((strstr(p_command_line, "reboot") == NULL)
+	    && (strstr(p_command_line, "poweroff") == NULL))
+		return NULL;
+	/* keep the command name in place and extract the timing */
+	strtok_r(p_command_line, " ", &l_save);
+	l_time = strtok_r(NULL, " ", &l_save);
+	/* if reboot / shutdown unit add deferred functionality in timer file */
+	if (strstr(p_command_line, "reboot") != NULL) {
+		l_changed = SetupUnitFileKey("/lib/systemd/system/reboot.timer",
+				 "OnActiveSec", l_time, "reboot", l_path, sizeof(l_path));
+	}
+	if (strstr(p_command_line, "poweroff") != NULL) {
+		l_changed = SetupUnitFileKey("/lib/systemd/system/poweroff.timer",
+				 "OnActiveSec", l_time, "poweroff", l_path, sizeof(l_path));
+	}
+	return (l_changed > 0) ? l_path : NULL;
+}
+
+/* Function responsible to test if a unit is up or on its way up or down, i.e. can be stopped or suspended */
+static bool AlUnitIsUp(const AlUnitState * p_state)
+{
+	return (p_state->active == AL_ACTIVE_ACTIVE) || (p_state->active == AL_ACTIVE_RELOADING)
+	    || (p_state->active == AL_ACTIVE_ACTIVATING) || (p_state->active == AL_ACTIVE_DEACTIVATING);
+}
+
+/*
+ * Function responsible to report why an application that already has a process is
+ * not started again; the state is fetched for the unit of the descriptor
+ */
+static void ReportAlreadyRunning(DBusConnection * p_conn, AlUnitDesc * p_desc)
+{
+	/* state of the unit */
+	AlUnitState l_state;
+	log_error_message("Method Call Listener : Cannot run %s !\n",
+			  p_desc->app_name);
+	if (AlGetUnitRunState(p_conn, p_desc->unit, &l_state) != 0) {
+		log_error_message("Failed to fetch app state for %s\n",
+				  p_desc->unit);
+		return;
+	}
+	log_debug_message("Fetched state for %s \n", p_desc->unit);
+	if (l_state.active == AL_ACTIVE_ACTIVE) {
+		log_error_message
+		    ("Method Call Listener : Cannot run %s !\n Application/application group %s is already running in the system (%s) !\n",
+		     p_desc->app_name, p_desc->app_name, l_state.sub_state);
+	}
+}
+
+/* error domain of the method calls whose systemd job did not complete successfully */
+#define AL_JOB_ERROR g_quark_from_static_string("al-daemon-job-error")
+
+/* Method call whose reply waits for the completion of its systemd job */
+typedef struct AlPendingReply
+{
+	/* invocation to complete */
+	DBusGMethodInvocation *context;
+	/* method name, used for logging and as snapshot label */
+	const char *method;
+	/* application the job was queued for */
+	char *app_name;
+	/* the reply carries the pid of the launched application */
+	bool reply_pid;
+	/* emit TaskStarted once the application runs */
+	bool task_started;
+} AlPendingReply;
+
+/* Function responsible to create the pending reply of a method call */
+static AlPendingReply *AlPendingReplyNew(DBusGMethodInvocation * p_context,
+					 const char *p_method, const char *p_app_name,
+					 bool p_reply_pid, bool p_task_started)
+{
+	AlPendingReply *l_reply = g_new0(AlPendingReply, 1);
+	l_reply->context = p_context;
+	l_reply->method = p_method;
+	l_reply->app_name = g_strdup(p_app_name);
+	l_reply->reply_pid = p_reply_pid;
+	l_reply->task_started = p_task_started;
+	return l_reply;
+}
+
+/* Function responsible to release a pending reply */
+static void AlPendingReplyFree(AlPendingReply * p_reply)
+{
+	g_free(p_reply->app_name);
+	g_free(p_reply);
+}
+
+/* Function responsible to reply to a method call once its systemd job completed */
+static void AlPendingReplyDone(const char *p_unit, const char *p_result, void *p_data)
+{
+	/* pending method call */
+	AlPendingReply *l_reply = (AlPendingReply *) p_data;
+	/* pid of the launched application */
+	int l_new_pid = 0;
+	/* lookups for the launched application */
+	AlSnapshot *l_snap;
+	/* error returned to the caller */
+	GError *l_err;
+	if (strcmp(p_result, SYSD_JOB_RESULT_DONE) != 0) {
+		log_error_message
+		    ("Method Call Listener : %s %s failed, job for %s finished with result %s !\n",
+		     l_reply->method, l_reply->app_name, p_unit, p_result);
+		l_err = g_error_new(AL_JOB_ERROR, 0, "Job for %s finished with result %s",
+				    p_unit, p_result);
+		dbus_g_method_return_error(l_reply->context, l_err);
+		g_error_free(l_err);
+		goto free_res;
+	}
+	if (!l_reply->reply_pid) {
+		dbus_g_method_return(l_reply->context);
+		goto free_res;
+	}
+	l_snap = SnapshotNew(l_reply->method);
+	/* a RunAs application runs in its transient unit, not in the one of its name */
+	if (RunAsUnitParse(p_unit, NULL, NULL, NULL))
+		l_new_pid = (int)UnitMainPid(p_unit);
+	else
+		l_new_pid = (int)SnapshotPidAfterLaunch(l_snap, l_reply->app_name);
+	/* pin the launched process and watch it for exit */
+	if (l_new_pid != 0)
+		AppHandleOpen(l_new_pid, p_unit, l_reply->app_name);
+	if (l_reply->task_started)
+		al_dbus_task_started(g_al_dbus, l_new_pid, l_reply->app_name);
+	SnapshotFree(l_snap);
+	dbus_g_method_return(l_reply->context, l_new_pid);
+
+free_res:
+	AlPendingReplyFree(l_reply);
+}
+
+/* Start of an application whose unit file was edited, queued once systemd reloaded the edit */
+typedef struct AlReloadedStart
+{
+	/* descriptor of the application, one reference held */
+	AlUnitDesc *desc;
+	/* completion of the start job */
+	SysdJobDoneFunc done;
+	void *data;
+} AlReloadedStart;
+
+/* Function responsible to queue the start job once the edit was reloaded */
+static void AlReloadedStartDone(const char *p_unit, const char *p_result, void *p_data)
+{
+	/* start waiting for the reload */
+	AlReloadedStart *l_start = (AlReloadedStart *) p_data;
+	if (strcmp(p_result, SYSD_JOB_RESULT_DONE) != 0)
+		l_start->done(l_start->desc->unit, p_result, l_start->data);
+	else if (SysdStartUnitAsync(l_start->desc->unit, l_start->done, l_start->data) != 0)
+		l_start->done(l_start->desc->unit, SYSD_JOB_RESULT_ERROR, l_start->data);
+	UnitDescUnref(l_start->desc);
+	g_free(l_start);
+}
+
+/*
+ * Function responsible to start an application once the reload covering the edit of its
+ * unit file completed; done is called with the start job result, or the reload result
+ */
+static void AlStartAfterReload(const char *p_file, AlUnitDesc * p_desc,
+			       SysdJobDoneFunc p_done, void *p_data)
+{
+	AlReloadedStart *l_start = g_new0(AlReloadedStart, 1);
+	l_start->desc = UnitDescRef(p_desc);
+	l_start->done = p_done;
+	l_start->data = p_data;
+	UnitReloadRequest(p_file, AlReloadedStartDone, l_start);
+}
+
 gboolean al_dbus_run(ALDbus * server,
 		     gchar * command_line,
 		     gint parent_pid,
@@ -450,227 +572,70 @@ gboolean al_dbus_run(ALDbus * server,
 {
 
 	gboolean success = TRUE;
-	/* return code */
-	int l_r;
 	/* new pid of the app */
-	int l_new_pid;
-	/* additional parameter processing and handling */
-	char *command_line_copy = malloc(sizeof(command_line));
-	/* used when extracting the deferred execution time */
-	char *command_line_deferred = malloc(sizeof(command_line));
-	/* time until deferred triggering */
-	char *l_time = NULL;
-	/* app state info container */
-	char l_state_info[DIM_MAX];
-	/* application status string copy */
-	char *l_state_info_copy = NULL;
-	/* active state and sub state containers */
-	char *l_active_state = NULL;
-	char *l_sub_state = NULL;
-	/* standard delimiter to use in service handling */
-	char l_delim_serv[] = " ";
-	/* error handler for dbus calls */
-	GError *l_err = NULL;
+	int l_new_pid = 0;
+	/* unit descriptor of the application, owned by the snapshot */
+	AlUnitDesc *l_desc;
+	/* reply sent when the start job completes */
+	AlPendingReply *l_pending;
+	/* timer file edited for a deferred command */
+	const char *l_timer_file;
 	/* handler for DBusConnection from DBusGConnection */
 	DBusConnection *l_conn =
 	    (DBusConnection *) dbus_g_connection_get_connection(g_conn);
+	/* lookups shared by the whole request */
+	AlSnapshot *l_snap = SnapshotNew("Run");
 	log_debug_message
 	    ("Method Call Listener Run: Arguments were extracted for %s\n",
 	     command_line);
 	/* check command line name for deferred binaries */
-	if ((strstr(command_line, "reboot") != NULL)
-	    || (strstr(command_line, "poweroff") != NULL)) {
-		/* make a copy of the string because will be altered */
-		strcpy(command_line_copy, command_line);
-		/* throw away the reboot/poweroff command name */
-		command_line_deferred = strtok(command_line_copy, " ");
-		/* extract the timing */
-		l_time = strtok(NULL, " ");
-		/* restore the command string for future use */
-		strcpy(command_line, command_line_copy);
-	/* if reboot / shutdown unit add deferred functionality in timer file */
-	if (strstr(command_line, "reboot") != NULL) {
-		SetupUnitFileKey("/lib/systemd/system/reboot.timer",
-				 "OnActiveSec", l_time, "reboot");
-	}
-	if (strstr(command_line, "poweroff") != NULL) {
-		SetupUnitFileKey("/lib/systemd/system/poweroff.timer",
-				 "OnActiveSec", l_time, "poweroff");
-		}
-        }
-	/* check for application service file existence */
-	if (AppExistsInSystem(command_line)==0) {
+	l_timer_file = SetupDeferredCommand(command_line);
+	/* classify the application once for the whole request */
+	if (!(l_desc = SnapshotUnitDesc(l_snap, command_line))) {
 		log_error_message
 		    ("Method Call Listener : Cannot run %s !\n Application %s is not found in the system !\n",
 		     command_line, command_line);
-			/* resources free */
-		if(command_line_copy){
-			free(command_line_copy);
-			command_line_copy = NULL;
-		}
-		l_new_pid = 0;
-		dbus_g_method_return(context, l_new_pid);
 		goto free_res;
-	} else {
-		if ((l_r = (int)AppPidFromName(command_line)) != 0) {
-			log_error_message
-			    ("Method Call Listener : Cannot run %s !\n",
-			     command_line);
-			/* check the application current state before starting it */
-			/* extract the application state for testing existence */
-			/* make a copy of the name to avoid additional postfix when calling run */
-			/* concatenate the appropiate string according the unit type i.e. service/target */
-			if (AppExistsInSystem(command_line) == 1) {
-				log_debug_message("Unit %s is service\n", command_line);
-				strcpy(command_line_copy, command_line);
-				if (AlGetAppState
-				    (l_conn,
-				     strcat(command_line_copy, ".service"),
-				     l_state_info) == 0) {
-					log_debug_message("Fetched state for service %s \n", command_line);
-					/* copy the state */
-					l_state_info_copy =
-					    strdup(l_state_info);
-					/* allocate state handlers */
-					l_active_state =
-					    malloc(sizeof(l_state_info_copy));
-					l_sub_state =
-					    malloc(sizeof(l_state_info_copy));
-
-					/* active state extraction from global state info */
-					l_active_state =
-					    strtok(l_state_info_copy,
-						   l_delim_serv);
-					l_active_state =
-					    strtok(NULL, l_delim_serv);
-					l_active_state =
-					    strtok(NULL, l_delim_serv);
-					l_sub_state =
-					    strtok(NULL, l_delim_serv);
-				}
-				else {
-					log_error_message("Failed to fetch app state for service %s\n", command_line);
-						/* resources free */
-					if(command_line_copy){
-						free(command_line_copy);
-						command_line_copy = NULL;
-					}
-					l_new_pid = (int)AppPidFromName(command_line);
-					dbus_g_method_return(context, l_new_pid);
-					goto free_res;
-				}
-			}else if (AppExistsInSystem(command_line) == 2) {
-				log_debug_message("Unit %s is target\n", command_line);
-				strcpy(command_line_copy, command_line);
-				if (AlGetAppState
-				    (l_conn,
-				     strcat(command_line_copy, ".target"),
-				     l_state_info) == 0) {
-					log_debug_message("Fetched state for target %s \n", command_line);
-					/* copy the state */
-					l_state_info_copy =
-					    strdup(l_state_info);
-					l_active_state =
-					    malloc(sizeof(l_state_info_copy));
-					l_sub_state =
-					    malloc(sizeof(l_state_info_copy));
-
-					/* active state extraction from global state info */
-					l_active_state =
-					    strtok(l_state_info_copy,
-						   l_delim_serv);
-					l_active_state =
-					    strtok(NULL, l_delim_serv);
-					l_active_state =
-					    strtok(NULL, l_delim_serv);
-					l_sub_state =
-					    strtok(NULL, l_delim_serv);
-				}
-			 	else {
-					log_error_message("Failed to fetch app state for target %s\n", command_line);
-						/* resources free */
-					if(command_line_copy){
-						free(command_line_copy);
-						command_line_copy = NULL;
-					}
-					l_new_pid = (int)AppPidFromName(command_line);
-					dbus_g_method_return(context, l_new_pid);
-					goto free_res;
-				}
-			} else {
-				log_error_message("Invalid unit state for %s\n", command_line);
-						/* resources free */
-					if(command_line_copy){
-						free(command_line_copy);
-						command_line_copy = NULL;
-					}
-					l_new_pid = (int)AppPidFromName(command_line);
-					dbus_g_method_return(context, l_new_pid);
-					goto free_res;
-			}
-			log_debug_message("Test complete active state for service %s \n", command_line);
-			if (strcmp(l_active_state, "active") == 0) {
-				if ((strcmp(l_sub_state, "exited") != 0)
-				    || (strcmp(l_sub_state, "dead") != 0)
-				    || (strcmp(l_sub_state, "failed") != 0)) {
-					log_error_message
-					    ("Method Call Listener : Cannot run %s !\n Application/application group %s is already running in the system !\n", command_line, command_line);
-				}
-		}
-		log_debug_message("Freeing the resources if the app %s is already running ... \n", command_line);
-		l_new_pid = (int)AppPidFromName(command_line);
-		dbus_g_method_return(context, l_new_pid);
+	}
+	/* check the application current state before starting it */
+	if ((l_new_pid = (int)SnapshotPidFromName(l_snap, command_line)) != 0) {
+		ReportAlreadyRunning(l_conn, l_desc);
 		goto free_res;
-	       }
-        }
+	}
 	log_debug_message("Preparing to start application %s \n", command_line);
-	/* ensure proper load state for the unit before starting it */
-	char *l_service_path = NULL;
-	/* temp to store full service name */
-	char *l_full_srv = malloc(sizeof(l_state_info));
-	strcpy(l_full_srv, command_line);
-	if ((strstr(command_line, "reboot") != NULL)
-	    || (strstr(command_line, "poweroff") != NULL)) {
-				strcat(l_full_srv, ".timer");
-	} else strcat(l_full_srv, ".service");
-	/* load unit info */
-	if (!dbus_g_proxy_call(sysd_proxy,
-			       "LoadUnit",
-			       &l_err,
-			       G_TYPE_STRING,
-			       l_full_srv,
-			       G_TYPE_INVALID,
-			       DBUS_TYPE_G_OBJECT_PATH,
-			       &l_service_path, G_TYPE_INVALID)) {
-		log_error_message("Method call failed: %s\n", l_err->message);
-		l_new_pid = 0;
-		dbus_g_method_return(context, l_new_pid);
+	/* the unit was loaded when the descriptor was resolved */
+	if (!l_desc->object_path) {
+		log_error_message
+		    ("Method Call Listener : Cannot run %s, unit %s is %s !\n",
+		     command_line, l_desc->unit, l_desc->load_state);
 		goto free_res;
 	}
-	/* free full service name string */
-	if(l_full_srv)
-		free(l_full_srv);
-	/* setup foreground property in systemd and wait for reply */
-	if (SetupApplicationStartupState(l_conn, command_line, foreground) != 0) {
+	/* the state is sent ahead of the start job on the same connection */
+	if (l_desc->type == UNIT_CATALOG_SERVICE && !l_desc->is_timer
+	    && SendApplicationStartupState(l_conn, l_desc, foreground) != 0) {
 		log_error_message
 		    ("Method Call Listener : Cannot setup fg/bg state for %s , application will run in former state or default state \n",
 		     command_line);
 	}
-	/* call the Run command */
-	Run(command_line, parent_pid, foreground);
-	l_new_pid = (int)AppPidFromName(command_line);
+	/* call the Run command, the pid is returned when the start job completes */
+	l_pending = AlPendingReplyNew(context, "Run", command_line, true, false);
+	/* a timer is started once systemd reloaded the timing just written */
+	if (l_timer_file) {
+		AlStartAfterReload(l_timer_file, l_desc, AlPendingReplyDone, l_pending);
+		goto deferred;
+	}
+	if (Run(l_desc, parent_pid, foreground, AlPendingReplyDone, l_pending) != 0) {
+		AlPendingReplyFree(l_pending);
+		goto free_res;
+	}
 	log_debug_message("Called Run  : [ %s | %s ]\n", command_line,
 		    (foreground == true) ? "true" : "false");
-	dbus_g_method_return(context, l_new_pid);
+	goto deferred;
 
 free_res:
-	if (l_err)
-		g_error_free(l_err);
-	/* free aux string */
-	if(command_line_deferred){
-		free(command_line_deferred);
-		command_line_deferred = NULL;
-	  }
+	dbus_g_method_return(context, l_new_pid);
+deferred:
+	SnapshotFree(l_snap);
 	return success;
 
 }
@@ -684,231 +649,68 @@ gboolean al_dbus_run_as(ALDbus * server,
 {
 
 	gboolean success = TRUE;
-	/* return code */
-	int l_r;
 	/* new app pid */
-	int l_new_pid;
-	/* additional parameter processing and handling */
-	char *command_line_copy = malloc(sizeof(command_line));
-	/* used when extracting the deferred execution time */
-	char *command_line_deferred = malloc(sizeof(command_line));
-	/* time until deferred triggering */
-	char *l_time = NULL;
-	/* app state info container */
-	char l_state_info[DIM_MAX];
-	/* application status string copy */
-	char *l_state_info_copy = NULL;
-	/* active state and sub state containers */
-	char *l_active_state = NULL;
-	char *l_sub_state = NULL;
-	/* standard delimiter to use in service handling */
-	char l_delim_serv[] = " ";
-	/* error handler for dbus calls */
-	GError *l_err = NULL;
+	int l_new_pid = 0;
+	/* unit descriptor of the application, owned by the snapshot */
+	AlUnitDesc *l_desc;
+	/* reply sent when the start job completes */
+	AlPendingReply *l_pending;
+	/* transient unit of the application under these credentials */
+	char l_unit[AL_UNIT_NAME_MAX];
+	AlUnitDesc l_transient;
 	/* handler for DBusConnection from DBusGConnection */
 	DBusConnection *l_conn =
 	    (DBusConnection *) dbus_g_connection_get_connection(g_conn);
+	/* lookups shared by the whole request */
+	AlSnapshot *l_snap = SnapshotNew("RunAs");
 	log_debug_message
 	    ("Method Call Listener RunAs: Arguments were extracted for %s\n",
 	     command_line);
-	/* check command line name for deferred binaries */
-	if ((strstr(command_line, "reboot") != NULL)
-	    || (strstr(command_line, "poweroff") != NULL)) {
-		/* make a copy of the string because will be altered */
-		strcpy(command_line_copy, command_line);
-		/* throw away the reboot/poweroff command name */
-		command_line_deferred = strtok(command_line_copy, " ");
-		/* extract the timing */
-		l_time = strtok(NULL, " ");
-		/* restore the command string for future use */
-		strcpy(command_line, command_line_copy);
-	/* if reboot / shutdown unit add deferred functionality in timer file */
-	if (strstr(command_line, "reboot") != NULL) {
-		SetupUnitFileKey("/lib/systemd/system/reboot.timer",
-				 "OnActiveSec", l_time, "reboot");
-	}
-	if (strstr(command_line, "poweroff") != NULL) {
-		SetupUnitFileKey("/lib/systemd/system/poweroff.timer",
-				 "OnActiveSec", l_time, "poweroff");
-		}
+	/* timers are not run as a user, refused before their timing is written */
+	if ((strstr(command_line, "reboot") != NULL) || (strstr(command_line, "poweroff") != NULL)) {
+		log_error_message
+		    ("Method Call Listener : Cannot runas %s !\n Deferred commands cannot be started with runas !\n",
+		     command_line);
+		goto free_res;
 	}
-	/* check for application service file existence */
-	if (AppExistsInSystem(command_line)==0) {
+	/* classify the application once for the whole request */
+	if (!(l_desc = SnapshotUnitDesc(l_snap, command_line))) {
 		log_error_message
 		    ("Method Call Listener : Cannot runas %s !\n Application %s is not found in the system !\n",
 		     command_line, command_line);
-			/* resources free */
-		if(command_line_copy){
-			free(command_line_copy);
-			command_line_copy = NULL;
-		}
-		l_new_pid = 0;
-		dbus_g_method_return(context, l_new_pid);
 		goto free_res;
-	} else {
-		if ((l_r = (int)AppPidFromName(command_line)) != 0) {
-			log_error_message
-			    ("Method Call Listener : Cannot runas %s !\n",
-			     command_line);
-			/* check the application current state before starting it */
-			/* extract the application state for testing existence */
-			/* make a copy of the name to avoid additional postfix when calling run */
-			/* concatenate the appropiate string according the unit type i.e. service/target */
-			if (AppExistsInSystem(command_line) == 1) {
-				log_debug_message("Unit %s is service\n", command_line);
-				strcpy(command_line_copy, command_line);
-				if (AlGetAppState
-				    (l_conn,
-				     strcat(command_line_copy, ".service"),
-				     l_state_info) == 0) {
-					log_debug_message("Fetched state for service %s \n", command_line);
-					/* copy the state */
-					l_state_info_copy =
-					    strdup(l_state_info);
-					/* allocate state handlers */
-					l_active_state =
-					    malloc(sizeof(l_state_info_copy));
-					l_sub_state =
-					    malloc(sizeof(l_state_info_copy));
-
-					/* active state extraction from global state info */
-					l_active_state =
-					    strtok(l_state_info_copy,
-						   l_delim_serv);
-					l_active_state =
-					    strtok(NULL, l_delim_serv);
-					l_active_state =
-					    strtok(NULL, l_delim_serv);
-					l_sub_state =
-					    strtok(NULL, l_delim_serv);
-				}
-				else {
-					log_error_message("Failed to fetch app state for service %s\n", command_line);
-						/* resources free */
-					if(command_line_copy){
-						free(command_line_copy);
-						command_line_copy = NULL;
-					}
-					l_new_pid = (int)AppPidFromName(command_line);
-					dbus_g_method_return(context, l_new_pid);
-					goto free_res;
-				}
-			}else if (AppExistsInSystem(command_line) == 2) {
-				log_debug_message("Unit %s is target\n", command_line);
-				strcpy(command_line_copy, command_line);
-				if (AlGetAppState
-				    (l_conn,
-				     strcat(command_line_copy, ".target"),
-				     l_state_info) == 0) {
-					log_debug_message("Fetched state for target %s \n", command_line);
-					/* copy the state */
-					l_state_info_copy =
-					    strdup(l_state_info);
-					l_active_state =
-					    malloc(sizeof(l_state_info_copy));
-					l_sub_state =
-					    malloc(sizeof(l_state_info_copy));
-
-					/* active state extraction from global state info */
-					l_active_state =
-					    strtok(l_state_info_copy,
-						   l_delim_serv);
-					l_active_state =
-					    strtok(NULL, l_delim_serv);
-					l_active_state =
-					    strtok(NULL, l_delim_serv);
-					l_sub_state =
-					    strtok(NULL, l_delim_serv);
-				}
-			 	else {
-					log_error_message("Failed to fetch app state for target %s\n", command_line);
-						/* resources free */
-					if(command_line_copy){
-						free(command_line_copy);
-						command_line_copy = NULL;
-					}
-					l_new_pid = (int)AppPidFromName(command_line);
-					dbus_g_method_return(context, l_new_pid);
-					goto free_res;
-				}
-			} else {
-				log_error_message("Invalid unit state for %s\n", command_line);
-						/* resources free */
-					if(command_line_copy){
-						free(command_line_copy);
-						command_line_copy = NULL;
-					}
-					l_new_pid = (int)AppPidFromName(command_line);
-					dbus_g_method_return(context, l_new_pid);
-					goto free_res;
-			}
-			log_debug_message("Test complete active state for service %s \n", command_line);
-			if (strcmp(l_active_state, "active") == 0) {
-				if ((strcmp(l_sub_state, "exited") != 0)
-				    || (strcmp(l_sub_state, "dead") != 0)
-				    || (strcmp(l_sub_state, "failed") != 0)) {
-					log_error_message
-					    ("Method Call Listener : Cannot run %s !\n Application/application group %s is already running in the system !\n", command_line, command_line);
-				}
-		}
-		log_debug_message("Freeing the resources if the app %s is already running ... \n", command_line);
-		l_new_pid = (int)AppPidFromName(command_line);
-		dbus_g_method_return(context, l_new_pid);
+	}
+	/* check the state of the transient unit before starting it */
+	RunAsUnitName(command_line, app_uid, app_gid, l_unit, sizeof(l_unit));
+	if ((l_new_pid = (int)UnitMainPid(l_unit)) != 0) {
+		l_transient = *l_desc;
+		l_transient.unit = l_unit;
+		ReportAlreadyRunning(l_conn, &l_transient);
 		goto free_res;
-	       }
-        }
+	}
 	log_debug_message("Preparing to start application %s \n", command_line);
-	/* ensure proper load state for the unit before starting it */
-	char *l_service_path = NULL;
-	/* temp to store full service name */
-	char *l_full_srv = malloc(sizeof(l_state_info));
-	strcpy(l_full_srv, command_line);
-	if ((strstr(command_line, "reboot") != NULL)
-	    || (strstr(command_line, "poweroff") != NULL)) {
-				strcat(l_full_srv, ".timer");
-	} else strcat(l_full_srv, ".service");
-	/* load unit info */
-	if (!dbus_g_proxy_call(sysd_proxy,
-			       "LoadUnit",
-			       &l_err,
-			       G_TYPE_STRING,
-			       l_full_srv,
-			       G_TYPE_INVALID,
-			       DBUS_TYPE_G_OBJECT_PATH,
-			       &l_service_path, G_TYPE_INVALID)) {
-		g_print("[%s] Method call failed: %s\n", __func__,
-			l_err->message);
-		l_new_pid = 0;
-		dbus_g_method_return(context, l_new_pid);
+	/* the unit was loaded when the descriptor was resolved */
+	if (!l_desc->object_path) {
+		log_error_message
+		    ("Method Call Listener : Cannot runas %s, unit %s is %s !\n",
+		     command_line, l_desc->unit, l_desc->load_state);
 		goto free_res;
 	}
-	/* free the full service name string */
-	if(l_full_srv)
-		free(l_full_srv);
 	log_debug_message("Called RunAs : [ %s | %s | %d | %d ]\n", command_line,
 		    (foreground == TRUE) ? "true" : "false", app_uid, app_gid);
-	RunAs(command_line, parent_pid, foreground, app_uid, app_gid);
-	/* setup the internal state information for the application */
-	if (SetupApplicationStartupState(l_conn, command_line, foreground) != 0) {
-		log_error_message
-		    ("Method Call Listener : Cannot setup fg/bg state for %s , application will runas %d in former state or default state \n",
-		     command_line, app_uid);
-		l_new_pid = (int)AppPidFromName(command_line);
-		dbus_g_method_return(context, l_new_pid);
+	/* the pid is returned and TaskStarted emitted when the start job completes */
+	l_pending = AlPendingReplyNew(context, "RunAs", command_line, true, true);
+	if (RunAs(l_desc, parent_pid, foreground, app_uid, app_gid,
+		  AlPendingReplyDone, l_pending) != 0) {
+		AlPendingReplyFree(l_pending);
 		goto free_res;
 	}
-	l_new_pid = (int)AppPidFromName(command_line);
-	al_dbus_task_started(g_al_dbus, l_new_pid, command_line);
-	dbus_g_method_return(context, l_new_pid);
+	goto deferred;
 
 free_res:
-	if (l_err)
-		g_error_free(l_err);
-	/* free aux string */
-	if(command_line_deferred){
-		free(command_line_deferred);
-		command_line_deferred = NULL;
-	  }
+	dbus_g_method_return(context, l_new_pid);
+deferred:
+	SnapshotFree(l_snap);
 	return success;
 }
 
@@ -921,137 +723,89 @@ gboolean al_dbus_stop(ALDbus * server,
 	/* return code */
 	int l_r, l_ret;
 	/* application name */
-	char *l_app = malloc(DIM_MAX * sizeof(l_app));
-	char *l_app_copy = malloc(DIM_MAX * sizeof(l_app));
-	/* variables for state extraction */
-	char *l_app_status;
-	/* app state info container */
-	char l_state_info[DIM_MAX];
-	/* application status string copy */
-	char *l_state_info_copy = NULL;
-	/* active state and sub state containers */
-	char *l_active_state = NULL;
-	char *l_sub_state = NULL;
-	/* standard delimiter to use in service handling */
-	char l_delim_serv[] = " ";
+	char l_app[DIM_MAX];
+	/* unit descriptor of the application, owned by the snapshot */
+	AlUnitDesc *l_desc;
+	/* reply sent when the stop job completes */
+	AlPendingReply *l_pending;
+	/* unit whose state is checked, the transient unit for applications started with runas */
+	char l_unit[AL_UNIT_NAME_MAX];
+	/* state of the unit */
+	AlUnitState l_state;
 	/* handler for DBusConnection from DBusGConnection */
 	DBusConnection *l_conn =
 	    (DBusConnection *) dbus_g_connection_get_connection(g_conn);
+	/* lookups shared by the whole request */
+	AlSnapshot *l_snap = SnapshotNew("Stop");
 	/* extract application name from pid */
-	l_r = (int)AppNameFromPid(app_pid, l_app);
+	l_r = SnapshotNameFromPid(l_snap, app_pid, l_app);
 	log_debug_message
 	    ("Method Call Listener : Stopping application with pid %d\n",
 	     app_pid);
 	if (l_r != 1) {
-		/* test for application service file existence */
-		if (!AppExistsInSystem(l_app)) {
-			log_error_message
-			    ("Method Call Listener : Cannot stop %s !\n Application %s is not found in the system !\n",
-			     l_app, l_app);
-			dbus_g_method_return(context);
-			goto free_res;
-		}
-	   log_error_message
-		    ("Method Call Listener : Cannot stop %s !\n",
-		     l_app);
-	   dbus_g_method_return(context);
-	   goto free_res;
-	}
-		/* check the application current state before stopping it */
-		/* extract the application state for testing existence */
-		/* make a copy of the name to avoid additional postfix when calling stop */
-		/* test if the unit is a service and react according to type */
-		if (AppExistsInSystem(l_app) == 1) {
-			strcpy(l_app_copy, l_app);
-			if (AlGetAppState
-			    (l_conn, strcat(l_app_copy, ".service"),
-			     l_state_info)
-			    == 0) {
-				/* copy the state */
-				l_app_status = strdup(l_state_info);
-				/* active state extraction from global state info */
-				l_active_state =
-				    strtok(l_app_status, l_delim_serv);
-				l_active_state = strtok(NULL, l_delim_serv);
-				l_active_state = strtok(NULL, l_delim_serv);
-				l_sub_state = strtok(NULL, l_delim_serv);
-			}
-		} else if (AppExistsInSystem(l_app) == 2) {
-			strcpy(l_app_copy, l_app);
-			if (AlGetAppState
-			    (l_conn, strcat(l_app_copy, ".target"),
-			     l_state_info)
-			    == 0) {
-				/* copy the state */
-				l_app_status = strdup(l_state_info);
-				/* active state extraction from global state info */
-				l_active_state =
-				    strtok(l_app_status, l_delim_serv);
-				l_active_state = strtok(NULL, l_delim_serv);
-				l_active_state = strtok(NULL, l_delim_serv);
-				l_sub_state = strtok(NULL, l_delim_serv);
-			}
-		} else {
-			log_error_message("Cannot determine unit type and cannot extract state\n", 0);
-			dbus_g_method_return(context);
-		        goto free_res;
-		}
-		/* state testing */
-		if ((strcmp(l_active_state, "active") != 0)
-		    && (strcmp(l_active_state, "reloading") != 0)
-		    && (strcmp(l_active_state, "activating") != 0)
-		    && (strcmp(l_active_state, "deactivating") != 0)) {
-			log_error_message
-			    ("AL Daemon Method Call Listener : Cannot stop %s !\n Application %s is already stopped !\n",
-			     l_app, l_app);
-			dbus_g_method_return(context);
-			goto free_res;
-		}
+		log_error_message
+		    ("Method Call Listener : Cannot stop application with pid %d !\n",
+		     app_pid);
+		goto free_res;
+	}
+	/* test for application service file existence */
+	if (!(l_desc = SnapshotUnitDesc(l_snap, l_app))) {
+		log_error_message
+		    ("Method Call Listener : Cannot stop %s !\n Application %s is not found in the system !\n",
+		     l_app, l_app);
+		goto free_res;
+	}
+	/* check the application current state before stopping it */
+	if (!CgroupUnitFromPid(app_pid, l_unit, sizeof(l_unit)) || !RunAsUnitParse(l_unit, NULL, NULL, NULL))
+		g_strlcpy(l_unit, l_desc->unit, sizeof(l_unit));
+	/* state testing */
+	if ((AlGetUnitRunState(l_conn, l_unit, &l_state) != 0) || !AlUnitIsUp(&l_state)) {
+		log_error_message
+		    ("AL Daemon Method Call Listener : Cannot stop %s !\n Application %s is already stopped !\n",
+		     l_app, l_app);
+		goto free_res;
+	}
+	/* the reply is sent when the stop job completes */
+	l_pending = AlPendingReplyNew(context, "Stop", l_app, false, false);
 	/* test if we have a service that will be stopped */
-	if ((AppExistsInSystem(l_app)) == 1) {
-		/* maintains the command line to pass to systemd */
-		char l_cmd[DIM_MAX];
+	if (l_desc->type == UNIT_CATALOG_SERVICE) {
 		/* if the name of the service corresponds to the name of the process to start call Stop */
-		if (AppPidFromName(l_app) != 0) {
-			Stop(app_pid);
-			dbus_g_method_return(context);
-			return success;
+		if (SnapshotPidFromName(l_snap, l_app) != 0) {
+			if (Stop(app_pid, l_snap, AlPendingReplyDone, l_pending) == 0)
+				goto deferred;
+			AlPendingReplyFree(l_pending);
+			goto free_res;
 		}
 		/* if the name of the service differs from the name of the process 
 		   to start (multiple ExecStart clauses service ) */
-		sprintf(l_cmd, "systemctl stop %s.service", l_app);
-		l_ret = system(l_cmd);
+		l_ret = SysdStopUnit(l_desc->unit, AlPendingReplyDone, l_pending);
 		if (l_ret != 0) {
 			log_error_message
 			    ("Method Call Listener : Cannot stop %s !\n Application %s is already stopped !\n",
 			     l_app, l_app);
-			dbus_g_method_return(context);
+			AlPendingReplyFree(l_pending);
 			goto free_res;
 		}
-		dbus_g_method_return(context);
-		return success;
+		goto deferred;
 	}
 	/* test if we have a target and stop all the applications started by it */
-	if (AppExistsInSystem(l_app) == 2) {
-		char l_cmd[DIM_MAX];
-		sprintf(l_cmd, "systemctl stop %s.target", l_app);
-		l_ret = system(l_cmd);
+	if (l_desc->type == UNIT_CATALOG_TARGET) {
+		l_ret = SysdStopUnit(l_desc->unit, AlPendingReplyDone, l_pending);
 		if (l_ret != 0) {
 			log_error_message
 			    ("Method Call Listener : Cannot stop %s !\n Application group %s is already stopped !\n",
 			     l_app, l_app);
-			dbus_g_method_return(context);
+			AlPendingReplyFree(l_pending);
 			goto free_res;
 		}
-		dbus_g_method_return(context);
-		return success;
+		goto deferred;
 	}
+	AlPendingReplyFree(l_pending);
 
 free_res:
-	if(l_app)
-		free(l_app);
-	if(l_app_copy)
-		free(l_app_copy);
+	dbus_g_method_return(context);
+deferred:
+	SnapshotFree(l_snap);
 
 	return success;
 
@@ -1062,81 +816,24 @@ gboolean al_dbus_resume(ALDbus * server,
 {
 
 	gboolean success = TRUE;
-	/* return code */
-	int l_r;
 	/* application name */
 	char *l_app = malloc(DIM_MAX * sizeof(l_app));
-	char *l_app_copy = malloc(DIM_MAX * sizeof(l_app));
-	/* app state info container */
-	char l_state_info[DIM_MAX];
-	/* variables for state extraction */
-	char *l_app_status;
-	/* application status string copy */
-	char *l_state_info_copy = NULL;
-	/* active state and sub state containers */
-	char *l_active_state = NULL;
-	char *l_sub_state = NULL;
-	/* standard delimiter to use in service handling */
-	char l_delim_serv[] = " ";
-	/* handler for DBusConnection from DBusGConnection */
-	DBusConnection *l_conn =
-	    (DBusConnection *) dbus_g_connection_get_connection(g_conn);
-	/* extract application name from pid */
-	l_r = (int)AppNameFromPid(app_pid, l_app);
+	/* extract application name from pid, resolved from the cgroup of the process */
+	if (AppNameFromPid(app_pid, l_app) != 1) {
+		log_error_message
+		    ("Method Call Listener : Cannot resume application with pid %d !\n Application is not found in the system !\n",
+		     app_pid);
+		goto free_res;
+	}
 	log_debug_message
 	    ("Method Call Listener : Resuming application %s\n",
 	     l_app);
-	if (l_r != 1) {
-		/* test for application service file existence */
-		if (!AppExistsInSystem(l_app)) {
-			log_error_message
-			    ("Method Call Listener : Cannot resume %s !\n Application %s is not found in the system !\n",
-			     l_app, l_app);
-			goto free_res;
-		}
-		log_error_message
-		    ("Method Call Listener : Cannot resume %s !\n",
-		     l_app);
-		/* check the application current state before starting it */
-		/* extract the application state for testing existence */
-		/* make a copy of the name to avoid additional postfix when calling resume */
-		strcpy(l_app_copy, l_app);
-		if (AlGetAppState
-		    (l_conn, strcat(l_app_copy, ".service"), l_state_info)
-		    == 0) {
-
-			/* copy the state */
-			l_app_status = strdup(l_state_info);
-
-			/* active state extraction from global state info */
-			l_active_state = strtok(l_app_status, l_delim_serv);
-			l_active_state = strtok(NULL, l_delim_serv);
-			l_active_state = strtok(NULL, l_delim_serv);
-			l_sub_state = strtok(NULL, l_delim_serv);
-
-		} else {
-			log_error_message("Cannot extract unit information\n", 0);
-			goto free_res;
-		}
-		if (strcmp(l_active_state, "active") == 0) {
-			if ((strcmp(l_sub_state, "exited") != 0)
-			    || (strcmp(l_sub_state, "dead") != 0)
-			    || (strcmp(l_sub_state, "failed") != 0)) {
-				log_error_message
-				    ("Method Call Listener : Cannot run %s !\n Application %s is already running in the system !\n",
-				     l_app, l_app);
-				goto free_res;
-			}
-		}
-	}
 	Resume(app_pid);
 	log_debug_message("Called Resume : [%d] \n", app_pid);
 
 free_res:
 	if(l_app)
 		free(l_app);
-	if(l_app_copy)
-		free(l_app_copy);
 
 	dbus_g_method_return(context);
 
@@ -1149,82 +846,24 @@ gboolean al_dbus_suspend(ALDbus * server,
 {
 
 	gboolean success = TRUE;
-	/* return code */
-	int l_r;
 	/* application name */
 	char *l_app = malloc(DIM_MAX * sizeof(l_app));
-	char *l_app_copy = malloc(DIM_MAX * sizeof(l_app));
-	/* variables for state extraction */
-	char *l_app_status;
-	/* app state info container */
-	char l_state_info[DIM_MAX];
-	/* application status string copy */
-	char *l_state_info_copy = NULL;
-	/* active state and sub state containers */
-	char *l_active_state = NULL;
-	char *l_sub_state = NULL;
-	/* standard delimiter to use in service handling */
-	char l_delim_serv[] = " ";
-	/* handler for DBusConnection from DBusGConnection */
-	DBusConnection *l_conn =
-	    (DBusConnection *) dbus_g_connection_get_connection(g_conn);
-	/* extract application name from pid */
-	l_r = (int)AppNameFromPid(app_pid, l_app);
+	/* extract application name from pid, resolved from the cgroup of the process */
+	if (AppNameFromPid(app_pid, l_app) != 1) {
+		log_error_message
+		    ("Method Call Listener : Cannot suspend application with pid %d !\n Application is not found in the system !\n",
+		     app_pid);
+		goto free_res;
+	}
 	log_debug_message
 	    ("Method Call Listener : Suspending application %s\n",
 	     l_app);
-	if (l_r != 1) {
-		/* test for application service file existence */
-		if (!AppExistsInSystem(l_app)) {
-			log_error_message
-			    ("Method Call Listener : Cannot suspend %s !\n Application %s is not found in the system !\n",
-			     l_app, l_app);
-			goto free_res;
-		}
-		log_error_message
-		    ("Method Call Listener : Cannot suspend %s !\n ",
-		     l_app);
-		/* check the application current state before starting it */
-		/* extract the application state for testing existence */
-		/* make a copy of the name to avoid additional suffix when calling suspend */
-		strcpy(l_app_copy, l_app);
-		if (AlGetAppState
-		    (l_conn, strcat(l_app_copy, ".service"), l_state_info)
-		    == 0) {
-
-			/* copy the state */
-			l_app_status = strdup(l_state_info);
-
-			/* active state extraction from global state info */
-			l_active_state = strtok(l_app_status, l_delim_serv);
-			l_active_state = strtok(NULL, l_delim_serv);
-			l_active_state = strtok(NULL, l_delim_serv);
-			l_sub_state = strtok(NULL, l_delim_serv);
-
-		} else {
-			log_error_message("Cannot extract unit information\n", 0);
-			goto free_res;
-		}
-
-		if ((strcmp(l_active_state, "active") != 0)
-		    && (strcmp(l_active_state, "reloading") != 0)
-		    && (strcmp(l_active_state, "activating") != 0)
-		    && (strcmp(l_active_state, "deactivating") != 0)) {
-
-			log_error_message
-			    ("Method Call Listener : Cannot suspend %s !\n Application %s is already suspended !\n",
-			     l_app, l_app);
-			goto free_res;
-		}
-	}
 	Suspend(app_pid);
 	log_debug_message("Called Suspend : [%d] \n", app_pid);
 
 free_res:
 	if(l_app)
 		free(l_app);
-	if(l_app_copy)
-		free(l_app_copy);
 
 	dbus_g_method_return(context);
 
@@ -1238,88 +877,35 @@ gboolean al_dbus_stop_as(ALDbus * server,
 {
 
 	gboolean success = TRUE;
-	/* return code */
-	int l_r;
 	/* application name */
-	char *l_app = malloc(DIM_MAX*sizeof(l_app));
-	char *l_app_copy = malloc(DIM_MAX*sizeof(l_app));;
-	/* application status */
-	char *l_app_status = malloc(DIM_MAX*sizeof(l_app_status));
-	/* app state info container */
-	char l_state_info[DIM_MAX];
-	/* application status string copy */
-	char *l_state_info_copy = NULL;
-	/* active state and sub state containers */
-	char *l_active_state = NULL;
-	char *l_sub_state = NULL;
-	/* standard delimiter to use in service handling */
-	char l_delim_serv[] = " ";
-	/* handler for DBusConnection from DBusGConnection */
-	DBusConnection *l_conn =
-	    (DBusConnection *) dbus_g_connection_get_connection(g_conn);
-	/* extract application name from pid */
-	l_r = (int)AppNameFromPid(app_pid, l_app);
-	log_debug_message
-	    ("Method Call Listener : Stopping application with pid %d using stopas !\n",
-	     app_pid);
-	if (l_r != 1) {
-		/* test for application service file existence */
-		if (!AppExistsInSystem(l_app)) {
-			log_error_message
-			    ("Method Call Listener : Cannot stop %s using stopas ! Application is not found in the system !\n",
-			     l_app);
-			goto free_res;
-		}
+	char *l_app = malloc(DIM_MAX * sizeof(l_app));
+	/* reply sent when the stop job completes */
+	AlPendingReply *l_pending;
+	/* extract application name from pid, resolved from the cgroup of the process */
+	if (AppNameFromPid(app_pid, l_app) != 1) {
 		log_error_message
-		    ("Method Call Listener : Cannot stopas %s !\n",
-		     l_app);
-		/* check the application current state before stopping it */
-		/* extract the application state for testing existence */
-		/* make a copy of the name to avoid additional postfix when calling stopas */
-		strcpy(l_app_copy, l_app);
-		if (AlGetAppState
-		    (l_conn, strcat(l_app_copy, ".service"), l_state_info)
-		    == 0) {
-
-			/* copy the state */
-			l_app_status = strdup(l_state_info);
-
-			/* active state extraction from global state info */
-			l_active_state = strtok(l_app_status, l_delim_serv);
-			l_active_state = strtok(NULL, l_delim_serv);
-			l_active_state = strtok(NULL, l_delim_serv);
-			l_sub_state = strtok(NULL, l_delim_serv);
-
-		} else {
-			log_error_message("Cannot extract unit information\n", 0);
-			goto free_res;
-		}
-		/* state testing */
-		if ((strcmp(l_active_state, "active") != 0)
-		    && (strcmp(l_active_state, "reloading") != 0)
-		    && (strcmp(l_active_state, "activating") != 0)
-		    && (strcmp(l_active_state, "deactivating") != 0)) {
-
-			log_error_message
-			    ("Method Call Listener : Cannot stopas %s !\n Application %s is already stopped !\n",
-			     l_app, l_app);
-			goto free_res;
-		}
+		    ("Method Call Listener : Cannot stopas application with pid %d !\n Application is not found in the system !\n",
+		     app_pid);
+		goto free_res;
+	}
+	log_debug_message
+	    ("Method Call Listener : Stopping application %s with pid %d using stopas !\n",
+	     l_app, app_pid);
+	/* stopas the application, the reply is sent when the stop job completes */
+	l_pending = AlPendingReplyNew(context, "StopAs", l_app, false, false);
+	if (StopAs(app_pid, app_uid, app_gid, AlPendingReplyDone, l_pending) != 0) {
+		AlPendingReplyFree(l_pending);
+		goto free_res;
 	}
-	/* stopas the application */
-	StopAs(app_pid, app_uid, app_gid);
 	log_debug_message("Called Stopas : [%d | %d | %d ] \n", app_pid, app_uid,
 		    app_gid);
+	goto deferred;
 
 free_res:
+	dbus_g_method_return(context);
+deferred:
 	if(l_app)
 		free(l_app);
-	if(l_app_copy)
-		free(l_app_copy);
-	if(l_app_status)
-		free(l_app_status);
-
-	dbus_g_method_return(context);
 
 	return success;
 }
@@ -1329,20 +915,34 @@ gboolean al_dbus_restart(ALDbus * server,
 {
 
 	gboolean success = TRUE;
+	/* lookups shared by the whole request */
+	AlSnapshot *l_snap = SnapshotNew("Restart");
 	log_debug_message("Method Call Listener : Restart app: %s\n",
 			  app_name);
+	/* unit descriptor of the application, owned by the snapshot */
+	AlUnitDesc *l_desc;
+	/* reply sent when the restart job completes */
+	AlPendingReply *l_pending;
 	/* check for application service file existence */
-	if (!AppExistsInSystem(app_name)) {
+	if (!(l_desc = SnapshotUnitDesc(l_snap, app_name))) {
 		log_error_message
 		    ("Method Call Listener : Cannot restart %s !\n Application %s is not found in the system !\n",
 		     app_name, app_name);
 		goto free_res;
 	}
-	Restart(app_name);
+	/* the reply is sent when the restart job completes */
+	l_pending = AlPendingReplyNew(context, "Restart", app_name, false, false);
+	if (Restart(l_desc, AlPendingReplyDone, l_pending) != 0) {
+		AlPendingReplyFree(l_pending);
+		goto free_res;
+	}
 	log_debug_message("Called Restart : [%s] \n", app_name);
+	goto deferred;
 
 free_res:
 	dbus_g_method_return(context);
+deferred:
+	SnapshotFree(l_snap);
 
 	return success;
 }
@@ -1356,11 +956,11 @@ gboolean al_dbus_change_task_state(ALDbus * server,
 	/* callback return code */
 	gboolean success = TRUE;
 	/* application path */
-	char *l_path;
+	char *l_path = NULL;
 	/* application name */
 	char *l_app_name = malloc(DIM_MAX*sizeof(l_app_name));
-	/* return code */
-	int l_ret;
+	/* unit owning the process, the transient one for RunAs */
+	char l_unit[AL_UNIT_NAME_MAX];
 	/* error for method calls */
 	GError * l_err = NULL;
 	/* interface to get the properties */
@@ -1371,21 +971,27 @@ gboolean al_dbus_change_task_state(ALDbus * server,
 	GValue l_set_value = {0,};
 	g_value_init(&l_set_value, G_TYPE_BOOLEAN);
 	g_value_set_boolean(&l_set_value, foreground);
+	/* refuse a pid whose launched application already exited */
+	if (AppHandleValidate(app_pid) != 0) {
+		log_error_message
+		    ("Change Task State : Cannot change state for pid %d, the application exited !\n",
+		     app_pid);
+		goto free_res;
+	}
 	/* get app name */
-	l_ret = AppNameFromPid(app_pid, l_app_name);
-	if (l_ret!=1) {
-	/* test for application service file existence */
-	if (!AppExistsInSystem(l_app_name)) {
+	if (AppNameFromPid(app_pid, l_app_name) != 1) {
 	  log_error_message
-	      ("Change Task State : Cannot change state for %s !\n Application %s is not found in the system !\n",
-	       l_app_name, l_app_name);
+	      ("Change Task State : Cannot change state for pid %d !\n Application is not found in the system !\n",
+	       app_pid);
 	  goto free_res;
-	   }
         }
-	if (NULL == (l_path = GetUnitObjectPath((DBusConnection*)dbus_g_connection_get_connection(g_conn), strcat(l_app_name, ".service"))))
+	/* the service the process runs in, its application unit if it is not started by systemd */
+	if (!CgroupUnitFromPid(app_pid, l_unit, sizeof(l_unit)) || !g_str_has_suffix(l_unit, ".service"))
+		snprintf(l_unit, sizeof(l_unit), "%s.service", l_app_name);
+	if (NULL == (l_path = GetUnitObjectPath((DBusConnection*)dbus_g_connection_get_connection(g_conn), l_unit)))
 	  {
           log_error_message
-                  ("Change Task State : Unable to extract object path for %s", l_app_name);
+                  ("Change Task State : Unable to extract object path for %s", l_unit);
           goto free_res;
   	}
 	/* get the interface for the current service */
@@ -1412,7 +1018,7 @@ gboolean al_dbus_change_task_state(ALDbus * server,
 		    (foreground == TRUE) ? "true" : "false");
         ChangeTaskState(app_pid, foreground);
 	/* emit task changed state complete */
-	al_dbus_change_task_state_complete(g_al_dbus, l_app_name, (foreground == TRUE) ? "true" : "false");
+	al_dbus_change_task_state_complete(g_al_dbus, strcat(l_app_name, ".service"), (foreground == TRUE) ? "true" : "false");
 	
 	dbus_g_method_return(context);
 
@@ -1439,6 +1045,178 @@ free_res:
 	return success;
 }
 
+gboolean al_dbus_list_available_apps(ALDbus * server,
+				     gchar * prefix, DBusGMethodInvocation * context)
+{
+
+	gboolean success = TRUE;
+	/* matching application names, served from the unit catalog */
+	gchar **l_apps = UnitCatalogListApps(prefix);
+	log_debug_message("Method Call Listener : List available apps with prefix: %s, found %u\n",
+			  prefix, g_strv_length(l_apps));
+	dbus_g_method_return(context, l_apps);
+	g_strfreev(l_apps);
+
+	return success;
+}
+
+/* Applications started by one RunMany call */
+typedef struct AlRunBatch
+{
+	/* invocation to complete */
+	DBusGMethodInvocation *context;
+	/* (app name, pid, result) GValueArray per requested application */
+	GPtrArray *results;
+	/* start jobs not completed yet, plus one while the batch is being sent */
+	guint outstanding;
+} AlRunBatch;
+
+/* Start job of one application of a batch */
+typedef struct AlRunBatchItem
+{
+	AlRunBatch *batch;
+	/* position of the application in the results */
+	guint index;
+	char *app_name;
+} AlRunBatchItem;
+
+/* Function responsible to append the result of an application to a batch */
+static void AlRunBatchResult(AlRunBatch * p_batch, const char *p_app_name, int p_pid,
+			     const char *p_result)
+{
+	/* result entry and its fields */
+	GValueArray *l_entry = g_value_array_new(3);
+	GValue l_val = { 0 };
+	g_value_init(&l_val, G_TYPE_STRING);
+	g_value_set_string(&l_val, p_app_name);
+	g_value_array_append(l_entry, &l_val);
+	g_value_unset(&l_val);
+	g_value_init(&l_val, G_TYPE_INT);
+	g_value_set_int(&l_val, p_pid);
+	g_value_array_append(l_entry, &l_val);
+	g_value_unset(&l_val);
+	g_value_init(&l_val, G_TYPE_STRING);
+	g_value_set_string(&l_val, p_result);
+	g_value_array_append(l_entry, &l_val);
+	g_value_unset(&l_val);
+	g_ptr_array_add(p_batch->results, l_entry);
+}
+
+/* Function responsible to release a batch reference and reply once every job completed */
+static void AlRunBatchRelease(AlRunBatch * p_batch)
+{
+	if (--p_batch->outstanding > 0)
+		return;
+	dbus_g_method_return(p_batch->context, p_batch->results);
+	g_ptr_array_foreach(p_batch->results, (GFunc) g_value_array_free, NULL);
+	g_ptr_array_free(p_batch->results, TRUE);
+	g_free(p_batch);
+}
+
+/* Function responsible to record the completion of the start job of a batch application */
+static void AlRunBatchDone(const char *p_unit, const char *p_result, void *p_data)
+{
+	/* completed application */
+	AlRunBatchItem *l_item = (AlRunBatchItem *) p_data;
+	/* its result entry */
+	GValueArray *l_entry = g_ptr_array_index(l_item->batch->results, l_item->index);
+	/* pid of the launched application */
+	int l_new_pid = 0;
+	if (strcmp(p_result, SYSD_JOB_RESULT_DONE) == 0) {
+		l_new_pid = (int)SnapshotPidAfterLaunch(NULL, l_item->app_name);
+		/* pin the launched process and watch it for exit */
+		if (l_new_pid != 0)
+			AppHandleOpen(l_new_pid, p_unit, l_item->app_name);
+	} else {
+		log_error_message
+		    ("Method Call Listener : RunMany cannot start %s, job for %s finished with result %s !\n",
+		     l_item->app_name, p_unit, p_result);
+	}
+	g_value_set_int(g_value_array_get_nth(l_entry, 1), l_new_pid);
+	g_value_set_string(g_value_array_get_nth(l_entry, 2), p_result);
+	AlRunBatchRelease(l_item->batch);
+	g_free(l_item->app_name);
+	g_free(l_item);
+}
+
+/*
+ * Function responsible to start a batch of applications: the batch is validated against one
+ * snapshot, every start job is sent without waiting for systemd and the reply is sent with
+ * the per application results once the last job completed
+ */
+gboolean al_dbus_run_many(ALDbus * server,
+			  GPtrArray * apps, DBusGMethodInvocation * context)
+{
+
+	gboolean success = TRUE;
+	/* batch state, replied when the last job completes */
+	AlRunBatch *l_batch = g_new0(AlRunBatch, 1);
+	/* current application */
+	GValueArray *l_entry;
+	char l_app[DIM_MAX];
+	gboolean l_fg;
+	guint l_idx;
+	/* pid of a running application */
+	int l_pid;
+	/* unit descriptor of the application, owned by the snapshot */
+	AlUnitDesc *l_desc;
+	/* start job of the application */
+	AlRunBatchItem *l_item;
+	/* timer file edited for a deferred command */
+	const char *l_timer_file;
+	/* handler for DBusConnection from DBusGConnection */
+	DBusConnection *l_conn =
+	    (DBusConnection *) dbus_g_connection_get_connection(g_conn);
+	/* lookups shared by the whole batch */
+	AlSnapshot *l_snap = SnapshotNew("RunMany");
+	l_batch->context = context;
+	l_batch->results = g_ptr_array_sized_new(apps->len);
+	l_batch->outstanding = 1;
+	log_debug_message("Method Call Listener : RunMany for %u applications\n", apps->len);
+	for (l_idx = 0; l_idx < apps->len; l_idx++) {
+		l_entry = g_ptr_array_index(apps, l_idx);
+		g_strlcpy(l_app, g_value_get_string(g_value_array_get_nth(l_entry, 0)), sizeof(l_app));
+		l_fg = g_value_get_boolean(g_value_array_get_nth(l_entry, 1));
+		/* check command line name for deferred binaries */
+		l_timer_file = SetupDeferredCommand(l_app);
+		if (!(l_desc = SnapshotUnitDesc(l_snap, l_app))) {
+			AlRunBatchResult(l_batch, l_app, 0, "not-found");
+			continue;
+		}
+		if ((l_pid = (int)SnapshotPidFromName(l_snap, l_app)) != 0) {
+			AlRunBatchResult(l_batch, l_app, l_pid, "running");
+			continue;
+		}
+		if (!l_desc->object_path) {
+			AlRunBatchResult(l_batch, l_app, 0, l_desc->load_state);
+			continue;
+		}
+		AlRunBatchResult(l_batch, l_app, 0, SYSD_JOB_RESULT_ERROR);
+		/* the state is sent ahead of the start job on the same connection */
+		if (l_desc->type == UNIT_CATALOG_SERVICE)
+			SendApplicationStartupState(l_conn, l_desc, l_fg);
+		l_item = g_new0(AlRunBatchItem, 1);
+		l_item->batch = l_batch;
+		l_item->index = l_idx;
+		l_item->app_name = g_strdup(l_app);
+		l_batch->outstanding++;
+		/* timers wait for the shared reload of the edited timer files */
+		if (l_timer_file) {
+			AlStartAfterReload(l_timer_file, l_desc, AlRunBatchDone, l_item);
+			continue;
+		}
+		if (SysdStartUnitAsync(l_desc->unit, AlRunBatchDone, l_item) != 0) {
+			l_batch->outstanding--;
+			g_free(l_item->app_name);
+			g_free(l_item);
+		}
+	}
+	SnapshotFree(l_snap);
+	AlRunBatchRelease(l_batch);
+
+	return success;
+}
+
 /* API signals */
 
 gboolean al_dbus_global_state_notification(ALDbus * server, gchar * app_status)
@@ -1493,106 +1271,96 @@ gboolean al_dbus_change_task_state_complete(ALDbus * server,
 	return success;
 }
 
+gboolean al_dbus_task_state_changed(ALDbus * server, gchar * unit, gchar * app_name,
+				    guint load_state, guint active_state, guint sub_state,
+				    gint app_pid, gboolean foreground, guint64 timestamp)
+{
+
+	gboolean success = TRUE;
+	ALDbusClass *klass = (ALDbusClass*)G_OBJECT_GET_CLASS(server);
+	g_signal_emit(server,
+		      klass->ALSignals[AL_SIG_TASK_STATE_CHANGED],
+		      0,
+		      unit,
+		      app_name,
+		      load_state,
+		      active_state,
+		      sub_state,
+		      app_pid,
+		      foreground,
+		      timestamp);
+	return success;
+}
+
+/* rule of the ownership changes of the systemd bus name */
+#define AL_SYSD_OWNER_RULE "type='signal',sender='org.freedesktop.DBus',path='/org/freedesktop/DBus'," \
+                           "interface='org.freedesktop.DBus',member='NameOwnerChanged',arg0='" SYSTEMD_SERVICE_NAME "'"
+
+/* systemd left or took the bus name again, its subscription is lost; signal dispatcher thread only */
+static bool g_sysd_owner_changed = false;
+/* signal dispatcher counters */
+static pthread_mutex_t g_dispatcher_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long g_dispatcher_connects = 0;
+static unsigned long g_dispatcher_subscribes = 0;
+static unsigned long g_dispatcher_failures = 0;
+static unsigned long g_dispatcher_disconnects = 0;
+static unsigned long g_dispatcher_owner_changes = 0;
+static unsigned long long g_dispatcher_outage_us = 0;
+/* end of the last session, or first failed attempt, while not subscribed (0 while subscribed or before the first session) */
+static unsigned long long g_dispatcher_down_us = 0;
+static unsigned long long g_dispatcher_max_outage_us = 0;
+
+/* Function responsible to return a monotonic timestamp in microseconds */
+static unsigned long long al_dbus_dispatcher_now()
+{
+	/* current time */
+	struct timespec l_ts;
+	clock_gettime(CLOCK_MONOTONIC, &l_ts);
+	return (unsigned long long)l_ts.tv_sec * 1000000ULL + l_ts.tv_nsec / 1000;
+}
+
 /* Filter function for system bus signals to be dispatched by the daemon */
 
 static DBusHandlerResult al_dbus_signal_filter(DBusConnection *connection, DBusMessage *message, void *data) {
-	/* error handler */
-        DBusError error;
-	/* messages */
-        DBusMessage *m = NULL, *reply = NULL;
-	/* error initialization */
-        dbus_error_init(&error);
+	/* name of the unit whose properties changed */
+        char unit[AL_UNIT_NAME_MAX];
+	/* changed state properties */
+        int changed;
 	/* check input message type */
         if (dbus_message_is_signal(message, DBUS_INTERFACE_LOCAL, "Disconnected")) {
                 log_error_message("Error! D-Bus connection terminated.\n",0);
+                UnitStateTrack(false);
                 dbus_connection_close(connection);
+        } else if (dbus_message_is_signal(message, DBUS_INTERFACE_DBUS, "NameOwnerChanged")) {
+                log_error_message("Signal Dispatcher Thread : systemd bus name owner changed, subscribing again !\n", 0);
+                UnitStateTrack(false);
+                g_sysd_owner_changed = true;
+        } else if (dbus_message_is_signal(message, "org.freedesktop.systemd1.Manager", "UnitRemoved")) {
+                UnitMatchUnitRemoved(connection, message);
         } else if (dbus_message_is_signal(message, "org.freedesktop.DBus.Properties", "PropertiesChanged")) {
-		/* extract useful info if a service property changed */
-                const char *path, *interface, *property = "Id";
-                DBusMessageIter iter, sub;
-		/* extract the service path */
-                path = dbus_message_get_path(message);
-		/* get service interface */
-                if (!dbus_message_get_args(message, &error,
-                                          DBUS_TYPE_STRING, &interface,
-                                          DBUS_TYPE_INVALID)) {
+		/* signals of the units not followed, received with the rule of every unit */
+                if (!UnitMatchAccept(message))
+                        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+		/* the payload carries the new values, the object path the unit name */
+                if ((changed = UnitStateApplySignal(message, unit, sizeof(unit))) < 0) {
                         log_error_message("Signal Dispatcher Thread : Failed to parse message when PropertiesChanged signal received !\n", 0);
-                        goto finish;
+                        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
                 }
-  		/* check for unit / job run state changes */
-                if ((strcmp(interface, "org.freedesktop.systemd1.Job")!=0) &&
-                    (strcmp(interface, "org.freedesktop.systemd1.Unit")!=0))
-                        goto finish;
-		/* get information about the changing property */
-                if (!(m = dbus_message_new_method_call(
-                              "org.freedesktop.systemd1",
-                              path,
-                              "org.freedesktop.DBus.Properties",
-                              "Get"))) {
-                        log_error_message("Signal Dispatcher Thread : Could not allocate message when Getting properties from systemd!\n", 0);
-                        goto oom;
-                }
-
-                if (!dbus_message_append_args(m,
-                                              DBUS_TYPE_STRING, &interface,
-                                              DBUS_TYPE_STRING, &property,
-                                              DBUS_TYPE_INVALID)) {
-                        log_error_message("Signal Dispatcher Thread : Could not append arguments to message when Getting properties from systemd!\n", 0);
-                        goto finish;
-                }
-
-                if (!(reply = dbus_connection_send_with_reply_and_block(connection, m, -1, &error))) {
-                        log_error_message("Signal Dispatcher Thread : Failed to parse reply when Getting properties from systemd!", 0);
-                        goto finish;
-                }
-		/* extract information from the reply */
-                if (!dbus_message_iter_init(reply, &iter) ||
-                    dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_VARIANT)  {
-                        log_error_message("Signal Dispatcher Thread : Failed to extract reply content when Getting properties from systemd!\n", 0);
-                        goto finish;
-                }
-
-                dbus_message_iter_recurse(&iter, &sub);
-		/* if a unit chnaged run state (started/stopped) */ 
-                if (strcmp(interface, "org.freedesktop.systemd1.Unit")==0) {
-                        const char *id;
-
-                        if (dbus_message_iter_get_arg_type(&sub) != DBUS_TYPE_STRING)  {
-                                log_error_message("Signal Dispatcher Thread : Failed to parse reply when getting unit type! \n",0);
-                                goto finish;
-                        }
-			/* get the name of the unit */
-                        dbus_message_iter_get_basic(&sub, &id);
-                        log_debug_message("Unit %s changed run state !\n", id);
-		        /* send global state notification signal */
-			AlAppStateNotifier(l_conn, id);
-			/* send task started/stopped signal */
-			AlSendAppSignal(l_conn, id);
+		/* if a unit changed run state (started/stopped) or foreground state */
+                if (changed & (UNIT_STATE_RUN | UNIT_STATE_FOREGROUND)) {
+                        log_debug_message("Unit %s changed run state !\n", unit);
+		        /* send the state notification signals once the burst of signals is over */
+			AlNotifyUnitState(l_conn, unit);
                 }
         }
-	/* if erroneous exit deallocate resources */
-finish:
-        if (m)
-                dbus_message_unref(m);
-
-        if (reply)
-                dbus_message_unref(reply);
-
-        dbus_error_free(&error);
         return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
-	/* if out of memory : dealocate resources and return proper value */
-oom:
-        if (m)
-                dbus_message_unref(m);
-
-        if (reply)
-                dbus_message_unref(reply);
-
-        dbus_error_free(&error);
-        return DBUS_HANDLER_RESULT_NEED_MEMORY;
 }
 
-/* Function that monitors signals on the bus and applies filter */
+/*
+ * Function that monitors signals on the bus and applies filter; returns 0 once subscribed,
+ * when the connection is lost or systemd left the bus, a negative value if it could not
+ * subscribe
+ */
 
 int al_dbus_monitor_signals(DBusConnection *bus) {
 	/* handler messages */
@@ -1600,29 +1368,34 @@ int al_dbus_monitor_signals(DBusConnection *bus) {
 	/* error handler */
         DBusError error;
         int r;
+	/* the filter is installed */
+        bool filtered = false;
 
 	/* error initialization */
         dbus_error_init(&error);
+        g_sysd_owner_changed = false;
 
-	/* add matcher for property change signals */
-                dbus_bus_add_match(bus,
-                                   "type='signal',"
-                                   "sender='org.freedesktop.systemd1',"
-                                   "interface='org.freedesktop.DBus.Properties',"
-                                   "member='PropertiesChanged'",
-                                   &error);
-
-                if (dbus_error_is_set(&error)) {
-                        log_error_message("Signal Dispatcher Thread : Failed to parse message when adding matcher on Properties interface\n", 0);
-                        r = -EIO;
-                        goto finish;
-                }
+	/* a new systemd instance does not know the subscription */
+        dbus_bus_add_match(bus, AL_SYSD_OWNER_RULE, &error);
+        if (dbus_error_is_set(&error)) {
+                log_error_message("Signal Dispatcher Thread : Failed to add the matcher on the systemd bus name ! Err : %s\n", error.message);
+                r = -EIO;
+                goto finish;
+        }
+
+	/* add matchers for the property change signals of the cataloged and launched units */
+        if (UnitMatchAttach(bus) != 0) {
+                log_error_message("Signal Dispatcher Thread : Failed to add the matchers on Properties interface\n", 0);
+                r = -EIO;
+                goto finish;
+        }
 	/* add the filter for the specific signals */
         if (!dbus_connection_add_filter(bus, al_dbus_signal_filter, NULL, NULL)) {
                 log_error_message("Signal Dispatcher Thread : Failed to add filter for systemd property changes signals!\n", 0);
                 r = -ENOMEM;
                 goto finish;
-        }	
+        }
+        filtered = true;
 	/* subscribe to systemd */
         if (!(m = dbus_message_new_method_call(
                               "org.freedesktop.systemd1",
@@ -1634,18 +1407,45 @@ int al_dbus_monitor_signals(DBusConnection *bus) {
                 goto finish;
         }
 
-        if (!(reply = dbus_connection_send_with_reply_and_block(bus, m, -1, &error))) {
+        if (!(reply = dbus_connection_send_with_reply_and_block(bus, m, SYSTEMD_UNIT_INFO_TIMEOUT, &error))) {
                 log_error_message("Signal Dispatcher Thread : Failed to parse reply after subscribing to systemd ! \n", 0);
                 r = -EIO;
                 goto finish;
         }
-	/* message processing */
-        while (dbus_connection_read_write_dispatch(bus, -1))
-                ;
+        pthread_mutex_lock(&g_dispatcher_lock);
+        g_dispatcher_subscribes++;
+        if (g_dispatcher_down_us) {
+                /* subscribed again : the outage is over */
+                unsigned long long outage = al_dbus_dispatcher_now() - g_dispatcher_down_us;
+                g_dispatcher_outage_us += outage;
+                if (outage > g_dispatcher_max_outage_us)
+                        g_dispatcher_max_outage_us = outage;
+                g_dispatcher_down_us = 0;
+                log_message("Signal Dispatcher Thread : Subscribed again after %llu ms, resyncing the unit states\n",
+                            outage / 1000);
+        }
+        pthread_mutex_unlock(&g_dispatcher_lock);
+	/* from now on the unit states follow the signals, starting from a snapshot */
+        UnitStateTrack(true);
+        UnitStatePrime(bus);
+	/* transitions missed while not subscribed */
+        AlNotifyResync(bus);
+	/* message processing, woken up when a notification window closes */
+        while (!g_sysd_owner_changed && dbus_connection_read_write_dispatch(bus, AlNotifyTimeout())) {
+                AlNotifyFlush(bus);
+                /* units started meanwhile, their job woke the thread up */
+                UnitMatchSync(bus);
+        }
+        UnitStateTrack(false);
 
         r = 0;
 
 finish:
+        UnitMatchDetach();
+        if (filtered)
+                dbus_connection_remove_filter(bus, al_dbus_signal_filter, NULL);
+        if (dbus_connection_get_is_connected(bus))
+                dbus_bus_remove_match(bus, AL_SYSD_OWNER_RULE, NULL);
         /* resources free */
         if (m)
                 dbus_message_unref(m);
@@ -1655,19 +1455,25 @@ finish:
         return r;
 }
 
-/* Function that connect to the system bus and listens to PropertiesChanged signal to enable daemon notification support */
+/*
+ * Function that connect to the system bus and listens to PropertiesChanged signal to enable daemon notification support.
+ * A lost connection, a systemd restart or a failed subscription are retried with an
+ * exponential backoff, from AL_BUS_RETRY_MIN_MS up to AL_BUS_RETRY_MAX_MS; the delay
+ * starts over once a session stayed up for AL_BUS_STABLE_MS. Every new session resyncs
+ * the unit states and notifies the transitions missed meanwhile.
+ */
 void *al_dbus_catch_signals(void *param){
     
     /* error handler*/
     DBusError l_err;
-    /* define message and reply */
-    DBusMessage *l_msg =  NULL, *l_reply = NULL, *l_msg_notif = NULL, *l_reply_notif = NULL;
     /* initialise the error value */
     dbus_error_init(&l_err);
     /* generic return code */
     int l_ret;
-    /* application name */
-    char *l_app;
+    /* delay before the next attempt, ms */
+    unsigned int l_backoff = AL_BUS_RETRY_MIN_MS;
+    /* start of the current attempt, us */
+    unsigned long long l_start;
     /* thread attributes setup */
     l_ret = pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     if (l_ret != 0) {
@@ -1679,35 +1485,67 @@ void *al_dbus_catch_signals(void *param){
         log_error_message("Signal Dispatcher Thread : Thread pthread_setcanceltype failed\n", 0);
         exit(EXIT_FAILURE);
     }
-    /* connect to the system bus and check for errors */
-    l_conn = dbus_bus_get_private(DBUS_BUS_SYSTEM, &l_err);
-    if (dbus_error_is_set(&l_err)) {
-        log_error_message("Signal Dispatcher Thread : Cannot connect to dbus! %s\n", l_err.message);
-        dbus_error_free(&l_err);
-    }
-   /* loop and listen for signals */
-   for(;l_conn!=NULL;){
-      if(al_dbus_monitor_signals(l_conn)!=0){
-	log_error_message("Signal Dispatcher Thread : An error occured ... restart signal listener", 0);
-	continue;
-     }
-   }
-  /* resources free */
-  if(l_msg)
-	dbus_message_unref(l_msg);
-  if(l_reply)
-	dbus_message_unref(l_reply);
-  if(l_msg_notif)
-	dbus_message_unref(l_msg_notif);
-  if(l_reply_notif)
-	dbus_message_unref(l_reply_notif);
-  /* close and unref private connection */
-  if (l_conn != NULL)
+   /* connect, subscribe and listen for signals until cancelled */
+   for (;;) {
+      l_start = al_dbus_dispatcher_now();
+      if (l_conn == NULL) {
+        /* connect to the system bus and check for errors */
+        if ((l_conn = dbus_bus_get_private(DBUS_BUS_SYSTEM, &l_err)) == NULL) {
+          log_error_message("Signal Dispatcher Thread : Cannot connect to dbus! %s\n",
+                            dbus_error_is_set(&l_err) ? l_err.message : "no connection");
+          dbus_error_free(&l_err);
+          l_ret = -EIO;
+        } else {
+          /* a lost bus is reconnected, it must not terminate the daemon */
+          dbus_connection_set_exit_on_disconnect(l_conn, FALSE);
+          pthread_mutex_lock(&g_dispatcher_lock);
+          g_dispatcher_connects++;
+          pthread_mutex_unlock(&g_dispatcher_lock);
+        }
+      }
+      if (l_conn != NULL)
+        l_ret = al_dbus_monitor_signals(l_conn);
+      pthread_mutex_lock(&g_dispatcher_lock);
+      if (l_ret == 0) {
+        /* the session ended, the outage starts */
+        g_dispatcher_down_us = al_dbus_dispatcher_now();
+        if (g_dispatcher_down_us - l_start >= AL_BUS_STABLE_MS * 1000ULL)
+          l_backoff = AL_BUS_RETRY_MIN_MS;
+      } else {
+        g_dispatcher_failures++;
+        if (!g_dispatcher_down_us)
+          g_dispatcher_down_us = l_start;
+      }
+      if (l_conn != NULL && !dbus_connection_get_is_connected(l_conn)) {
+        g_dispatcher_disconnects++;
+        /* close and unref private connection */
         dbus_connection_close(l_conn);
         dbus_connection_unref(l_conn);
+        l_conn = NULL;
+      } else if (l_ret == 0) {
+        g_dispatcher_owner_changes++;
+      }
+      pthread_mutex_unlock(&g_dispatcher_lock);
+      log_error_message("Signal Dispatcher Thread : Notifications interrupted, %s again in %u ms\n",
+                        l_conn ? "subscribing" : "connecting", l_backoff);
+      g_usleep(l_backoff * 1000UL);
+      l_backoff = MIN(l_backoff * 2, AL_BUS_RETRY_MAX_MS);
+   }
   pthread_exit(NULL);
 }
 
+/* Function responsible to log the signal dispatcher counters */
+void AlSignalDispatcherLogCounters()
+{
+	pthread_mutex_lock(&g_dispatcher_lock);
+	log_message("Signal Dispatcher : connected=%d connects=%lu subscribes=%lu failures=%lu disconnects=%lu "
+		    "systemd_restarts=%lu outage_ms=%llu max_outage_ms=%llu\n",
+		    l_conn != NULL, g_dispatcher_connects, g_dispatcher_subscribes, g_dispatcher_failures,
+		    g_dispatcher_disconnects, g_dispatcher_owner_changes, g_dispatcher_outage_us / 1000,
+		    g_dispatcher_max_outage_us / 1000);
+	pthread_mutex_unlock(&g_dispatcher_lock);
+}
+
 /* Function responsible to cancel the signal dispatcher thread */
 void cancel_signal_dispatcher(){
 	log_debug_message("Cancelling signal dispatcher thread\n", 0);
@@ -1729,161 +1567,123 @@ void al_dbus_signal_dispatcher()
 }
 
 /* High level interface for the AL Daemon */
-void Run(char *p_commandLine, int p_parentPID, bool p_isFg)
+int Run(AlUnitDesc *p_desc, int p_parentPID, bool p_isFg,
+	SysdJobDoneFunc p_done, void *p_data)
 {
 	/* store the return code */
 	int l_ret;
-	/* application PID */
-	int l_pid;
-	/* state string */
-	char *l_flag = malloc(DIM_MAX * sizeof(l_flag));
-	log_message("Run : %s started with run !\n", p_commandLine);
-	/* the command line for the application */
-	char l_cmd[DIM_MAX];
-	/* form the call string for systemd */
-	/* check if template / simple service will be started with run */
-	if ((AppExistsInSystem(p_commandLine)) == 1) {
-		sprintf(l_cmd, "systemctl start %s.service", p_commandLine);
-	}
-	/* check if target (group of apps) will be started with run */
-	if ((AppExistsInSystem(p_commandLine)) == 2) {
-		sprintf(l_cmd, "systemctl start %s.target", p_commandLine);
-	}
-	/* check if the unit has an associated timer and adjust the call string */
-	if (strcmp(p_commandLine, "reboot") == 0) {
-		sprintf(l_cmd, "systemctl start %s.timer", p_commandLine);
-	}
-	if (strcmp(p_commandLine, "shutdown") == 0) {
-		sprintf(l_cmd, "systemctl start %s.timer", p_commandLine);
-	}
-	if (strcmp(p_commandLine, "poweroff") == 0) {
-		sprintf(l_cmd, "systemctl start %s.timer", p_commandLine);
-	}
-
-	/* test application state */
-	if (p_isFg == TRUE)
-		strcpy(l_flag, "foreground");
-	else
-		strcpy(l_flag, "background");
+	log_message("Run : %s started with run !\n", p_desc->app_name);
 	/* change the state of the application given by pid */
 	log_message("Run : Application %s will run in %s \n",
-		    p_commandLine, l_flag);
-	/* systemd invocation */
-	l_ret = system(l_cmd);
-	if (l_ret == -1) {
-		if ((AppExistsInSystem(p_commandLine)) == 1) {
+		    p_desc->app_name, (p_isFg == TRUE) ? "foreground" : "background");
+	/* start job for the service, target or timer named by the descriptor */
+	l_ret = SysdStartUnit(p_desc->unit, p_done, p_data);
+	if (l_ret != 0) {
+		if (p_desc->type == UNIT_CATALOG_SERVICE) {
 			log_error_message
-			    ("Run : Application cannot be started with run! Err: %s\n",
-			     strerror(errno));
+			    ("Run : Application %s cannot be started with run!\n",
+			     p_desc->app_name);
 		}
-		if ((AppExistsInSystem(p_commandLine)) == 2) {
+		if (p_desc->type == UNIT_CATALOG_TARGET) {
 			log_error_message
-			    ("Run : Applications group cannot be started with run! Err: %s\n",
-			     strerror(errno));
+			    ("Run : Applications group %s cannot be started with run!\n",
+			     p_desc->app_name);
 		}
-		return;
+		return -1;
 	}
-	log_debug_message("Run : %s was started with run !\n",
-			  p_commandLine);
+	log_debug_message("Run : %s start job was queued !\n",
+			  p_desc->app_name);
+	return 0;
 }
 
-void RunAs(char *p_commandLine, int p_parentPID, bool p_isFg, int p_euid,
-	   int p_egid)
+int RunAs(AlUnitDesc *p_desc, int p_parentPID, bool p_isFg, int p_euid,
+	  int p_egid, SysdJobDoneFunc p_done, void *p_data)
 {
 	/* store the return code */
 	int l_ret;
-	/* application PID */
-	int l_pid;
-	/* local handlers for user and group to be written in the service file */
-	char *l_user = malloc(DIM_MAX * sizeof(l_user));
-	char *l_group = malloc(DIM_MAX * sizeof(l_group));
+	/* local handlers for user and group to be set on the transient unit */
+	char l_user[DIM_MAX];
+	char l_group[DIM_MAX];
+	/* transient unit carrying the credentials */
+	char l_unit[AL_UNIT_NAME_MAX];
+	/* settings of the transient unit */
+	SysdTransientProps l_props;
+	/* descriptor of the transient unit, for the foreground state */
+	AlUnitDesc l_transient;
+	/* handler for DBusConnection from DBusGConnection */
+	DBusConnection *l_conn =
+	    (DBusConnection *) dbus_g_connection_get_connection(g_conn);
 	log_message("RunAs : %s started with runas !\n",
-		    p_commandLine);
-	/* the command line for the application */
-	char l_cmd[DIM_MAX];
-	/* the service file path */
-	char l_srv_path[DIM_MAX];
-	/* string that will store the state */
-	char *l_flag = malloc(DIM_MAX * sizeof(l_flag));
-	/* check if template */
-	char *l_temp = ExtractUnitNameTemplate(p_commandLine);
-	if (l_temp == NULL) {
+		    p_desc->app_name);
+	/* only single services can run under other credentials */
+	if (p_desc->type != UNIT_CATALOG_SERVICE || p_desc->is_timer) {
 		log_error_message
-		    ("RunAs : Cannot allocate template handler for %s !\n",
-		     p_commandLine);
-		return;
-	}
-	sprintf(l_srv_path, "/lib/systemd/system/%s.service", l_temp);
-	/* form the call string for systemd */
-	sprintf(l_cmd, "systemctl start %s.service", l_temp);
-	/* check if the unit has an associated timer and adjust the call string */
-	if (strcmp(p_commandLine, "reboot") == 0) {
-		sprintf(l_cmd, "systemctl start %s.timer", p_commandLine);
+		    ("RunAs : %s is not a service and cannot be started with runas !\n",
+		     p_desc->app_name);
+		return -1;
 	}
-	if (strcmp(p_commandLine, "shutdown") == 0) {
-		sprintf(l_cmd, "systemctl start %s.timer", p_commandLine);
-	}
-	if (strcmp(p_commandLine, "poweroff") == 0) {
-		sprintf(l_cmd, "systemctl start %s.timer", p_commandLine);
+	/* the unit file in effect, the template file for template instances */
+	if (p_desc->file_path == NULL) {
+		log_error_message
+		    ("RunAs : Cannot find the unit file for %s !\n",
+		     p_desc->app_name);
+		return -1;
 	}
 	/* extract user name and group name from uid and gid */
 	if (MapUidToUser(p_euid, l_user) != 0) {
 		log_error_message
 		    ("RunAs : Cannot map uid to user for %s\n",
-		     p_commandLine);
-		return;
+		     p_desc->app_name);
+		return -1;
 	}
 	if (MapGidToGroup(p_egid, l_group) != 0) {
 		log_error_message
 		    ("RunAs : Cannot map gid to user for %s\n",
-		     p_commandLine);
-		return;
+		     p_desc->app_name);
+		return -1;
 	}
-	/* SetupUnitFileKey call to setup the key and corresponding values, if not existing will be created */
-	/* the service file will be updated with proper Group and User information */
-	SetupUnitFileKey(l_srv_path, "User", l_user, p_commandLine);
-	SetupUnitFileKey(l_srv_path, "Group", l_group, p_commandLine);
-	log_debug_message
-	    ("RunAs : Service file was updated with User=%s and Group=%s information !\n",
-	     l_user, l_group);
-	/* test application state */
-	if (p_isFg == TRUE)
-		strcpy(l_flag, "foreground");
-	else
-		strcpy(l_flag, "background");
-	/* issue daemon reload to apply and acknowledge modifications to the service file on the disk */
-	l_ret = system("systemctl daemon-reload --system");
-	if (l_ret == -1) {
+	/* the service settings are read from the unit file, which is left untouched */
+	if (UnitFileTransientProps(p_desc->file_path, p_desc->app_name, &l_props) != 0) {
 		log_error_message
-		    ("RunAs : After setting the service file reload systemd manager configuration failed ! Err: %s\n",
-		     strerror(errno));
-		return;
+		    ("RunAs : Cannot read the service settings of %s from %s !\n",
+		     p_desc->app_name, p_desc->file_path);
+		return -1;
 	}
-	/* change the state of the application given by pid */
+	l_props.user = l_user;
+	l_props.group = l_group;
+	/* the application runs in its own transient unit, no manager reload is needed */
+	RunAsUnitName(p_desc->app_name, p_euid, p_egid, l_unit, sizeof(l_unit));
 	log_debug_message
-	    ("RunAs : Application %s will runas %s in %s \n",
-	     p_commandLine, l_user, l_flag);
-
-	/* systemd invocation */
-	l_ret = system(l_cmd);
-	if (l_ret == -1) {
+	    ("RunAs : Application %s will runas %s in %s as %s \n",
+	     p_desc->app_name, l_user, (p_isFg == TRUE) ? "foreground" : "background", l_unit);
+	l_ret = SysdStartTransientUnit(l_unit, &l_props, p_done, p_data);
+	TransientPropsFree(&l_props);
+	if (l_ret != 0) {
 		log_error_message
-		    ("RunAs : Application cannot be started with runas! Err: %s\n",
-		     strerror(errno));
-		return;
+		    ("RunAs : Application %s cannot be started with runas!\n",
+		     p_desc->app_name);
+		return -1;
+	}
+	/* the foreground state is a property of the transient unit */
+	l_transient = *p_desc;
+	l_transient.unit = l_unit;
+	if ((l_transient.object_path = GetUnitObjectPath(l_conn, l_unit)) != NULL) {
+		SendApplicationStartupState(l_conn, &l_transient, p_isFg);
+		free(l_transient.object_path);
 	}
-	log_debug_message("RunAs : %s was started with runas !\n",
-			  p_commandLine);
+	log_debug_message("RunAs : %s start job was queued !\n",
+			  p_desc->app_name);
+	return 0;
 }
 
 void Suspend(int p_pid)
 {
 	/* return code */
 	int l_ret;
-	/* to suspend the application a SIGSTOP signal is sent */
-	if ((l_ret = kill(p_pid, SIGSTOP)) == -1) {
+	/* to suspend the application a SIGSTOP signal is sent through its handle */
+	if ((l_ret = AppHandleSendSignal(p_pid, SIGSTOP)) == -1) {
 		log_error_message
-		    ("Suspend : %s cannot be suspended ! Err : %s\n",
+		    ("Suspend : %d cannot be suspended ! Err : %s\n",
 		     p_pid, strerror(errno));
 	}
 }
@@ -1892,133 +1692,141 @@ void Resume(int p_pid)
 {
 	/* return code */
 	int l_ret;
-	/* to suspend the application a SIGSTOP signal is sent */
-	if ((l_ret = kill(p_pid, SIGCONT)) == -1) {
+	/* to resume the application a SIGCONT signal is sent through its handle */
+	if ((l_ret = AppHandleSendSignal(p_pid, SIGCONT)) == -1) {
 		log_error_message
-		    ("Resume : %s cannot be resumed ! Err : %s\n",
+		    ("Resume : %d cannot be resumed ! Err : %s\n",
 		     p_pid, strerror(errno));
 	}
 }
 
-void Stop(int p_pid)
+int Stop(int p_pid, AlSnapshot *p_snap, SysdJobDoneFunc p_done, void *p_data)
 {
 	/* store the return code */
-	int l_ret;
+	int l_ret = -1;
 	/* stores the application name */
-	char *l_app_name = malloc(DIM_MAX * sizeof(l_app_name));
-	/* command line for the application */
-	char *l_commandLine = malloc(DIM_MAX * sizeof(l_app_name));
-	l_ret = (int)AppNameFromPid(p_pid, l_app_name);
-	if (l_ret == 1) {
-		l_commandLine = l_app_name;
-		char l_cmd[DIM_MAX];
-		log_debug_message("Stop : %s stopped with stop !\n",
-				  l_commandLine);
-		/* form the systemd command line string */
-		/* check if single service will be stopped */
-		if ((AppExistsInSystem(l_commandLine)) == 1) {
-			sprintf(l_cmd, "systemctl stop %s.service",
-				l_commandLine);
-		}
-		/* call systemd */
-		l_ret = system(l_cmd);
-		if (l_ret != 0) {
+	char l_app_name[DIM_MAX];
+	/* unit descriptor of the application */
+	AlUnitDesc *l_desc = NULL;
+	/* unit owning the process */
+	char l_unit[AL_UNIT_NAME_MAX];
+	/* the pid may have been recycled since the client got it */
+	if (AppHandleValidate(p_pid) != 0)
+		return -1;
+	if (SnapshotNameFromPid(p_snap, p_pid, l_app_name) != 1) {
+		log_error_message
+		    ("Stop : Application with pid %d cannot be stopped because is already stopped !\n",
+		     p_pid);
+		return -1;
+	}
+	log_debug_message("Stop : %s stopped with stop !\n", l_app_name);
+	/* applications started with runas are stopped with their transient unit */
+	if (CgroupUnitFromPid(p_pid, l_unit, sizeof(l_unit)) && RunAsUnitParse(l_unit, NULL, NULL, NULL)) {
+		if ((l_ret = SysdStopUnit(l_unit, p_done, p_data)) != 0)
 			log_error_message
-			    ("Stop : Application cannot be stopped with stop! Err: %s\n",
-			     strerror(errno));
-		}
-	} else {
+			    ("Stop : Application %s cannot be stopped with stop!\n",
+			     l_app_name);
+		return l_ret;
+	}
+	/* the snapshot owns its descriptors, a direct lookup must be released */
+	l_desc = p_snap ? SnapshotUnitDesc(p_snap, l_app_name) : UnitDescGet(l_app_name);
+	/* only single services are stopped by pid */
+	if (!l_desc || l_desc->type != UNIT_CATALOG_SERVICE) {
+		log_error_message("Stop : %s is not a service and cannot be stopped by pid !\n",
+				  l_app_name);
+		goto free_res;
+	}
+	/* call systemd */
+	l_ret = SysdStopUnit(l_desc->unit, p_done, p_data);
+	if (l_ret != 0) {
 		log_error_message
-		    ("Stop : Application %s cannot be stopped because is already stopped !\n",
-		     l_commandLine);
+		    ("Stop : Application %s cannot be stopped with stop!\n",
+		     l_app_name);
 	}
+
+free_res:
+	if (!p_snap && l_desc)
+		UnitDescUnref(l_desc);
+	return l_ret;
 }
 
-void StopAs(int p_pid, int p_euid, int p_egid)
+int StopAs(int p_pid, int p_euid, int p_egid, SysdJobDoneFunc p_done, void *p_data)
 {
 	/* store the return code */
 	int l_ret;
 	/* stores the application name */
-	char *l_app_name = malloc(DIM_MAX*sizeof(l_app_name));
-	/* command line for the application */
-	char *l_commandLine = malloc(DIM_MAX * sizeof(l_commandLine));
+	char l_app_name[DIM_MAX];
+	/* unit to stop */
+	char l_cmd[AL_UNIT_NAME_MAX];
+	/* application service file path */
+	char l_srv_path[PATH_MAX];
 	/* extracted user and group values from service file */
-	char *l_group = malloc(DIM_MAX * sizeof(l_group));
-	char *l_user = malloc(DIM_MAX * sizeof(l_user));
-	/* application service fiel path */
-	char *l_srv_path = malloc(DIM_MAX*sizeof(l_srv_path));
-	/* group and user strings */
-	char *l_str_egid = malloc(DIM_MAX * sizeof(l_str_egid));
-	char *l_str_euid = malloc(DIM_MAX * sizeof(l_str_euid));
+	char l_user[DIM_MAX];
+	char l_group[DIM_MAX];
+	/* owner ids of the application and whether they are known */
+	int l_uid = 0, l_gid = 0;
+	bool l_has_uid = false, l_has_gid = false;
+	unsigned int l_id;
+	/* the pid may have been recycled since the client got it */
+	if (AppHandleValidate(p_pid) != 0)
+		return -1;
 	/* test if application runs in the system */
-	if (AppNameFromPid(p_pid, l_app_name) != 0) {
-		l_commandLine = l_app_name;
-		/* for the path to the application service */
-		sprintf(l_srv_path, "/lib/systemd/system/%s.service",
-			l_commandLine);
-		/* low level command to systemd */
-		char l_cmd[DIM_MAX];
-		log_debug_message
-		    ("StopAs : %s stopped with stopas !\n",
-		     l_app_name);
-		/* form the systemd command line string */
-		sprintf(l_cmd, "systemctl stop %s.service", l_commandLine);
-		/* test ownership and rights before stopping application */
-		log_debug_message
-		    ("StopAs : Extracting ownership info for %s\n",
-		     l_commandLine);
+	if (AppNameFromPid(p_pid, l_app_name) == 0) {
+		log_error_message
+		    ("StopAs : Application with pid %d cannot be stopped because is already stopped !\n",
+		     p_pid);
+		return -1;
+	}
+	log_debug_message
+	    ("StopAs : %s stopped with stopas !\n",
+	     l_app_name);
+	/* test ownership and rights before stopping application */
+	log_debug_message
+	    ("StopAs : Extracting ownership info for %s\n",
+	     l_app_name);
+	if (CgroupUnitFromPid(p_pid, l_cmd, sizeof(l_cmd))
+	    && RunAsUnitParse(l_cmd, NULL, &l_uid, &l_gid)) {
+		/* started with runas : the transient unit carries the credentials */
+		l_has_uid = l_has_gid = true;
+	} else {
+		/* form the unit name */
+		snprintf(l_cmd, sizeof(l_cmd), "%s.service", l_app_name);
+		/* the unit file in effect, the vendor one if the catalog does not know it */
+		if (!UnitCatalogPath(l_cmd, l_srv_path, sizeof(l_srv_path)))
+			snprintf(l_srv_path, sizeof(l_srv_path), "/lib/systemd/system/%s", l_cmd);
 		ExtractOwnershipInfo(l_user, l_group, l_srv_path);
 		log_debug_message
 		    ("StopAs : The ownership information was extracted properly [ user : %s ] and [ group : %s ]\n",
 		     l_user, l_group);
-		/* extract user name and group name from uid and gid */
-		if (MapUidToUser(p_euid, l_str_euid) != 0) {
-			log_error_message
-			    ("StopAs : Cannot map uid to user for %s\n",
-			     l_commandLine);
-			goto free_res;
+		/* names and numbers are compared as ids */
+		if (IdentUserId(l_user, &l_id) == 0) {
+			l_uid = (int)l_id;
+			l_has_uid = true;
 		}
-		if (MapGidToGroup(p_egid, l_str_egid) != 0) {
-			log_error_message
-			    ("StopAs : Cannot map gid to user for %s\n",
-			     l_commandLine);
-			goto free_res;
+		if (IdentGroupId(l_group, &l_id) == 0) {
+			l_gid = (int)l_id;
+			l_has_gid = true;
 		}
-		log_message
-		    ("StopAs : The input ownership information [ user: %s ] and [ group : %s ]\n",
-		     l_str_euid, l_str_egid);
-		if ((strcmp(l_user, l_str_euid) != 0)
-		    && (strcmp(l_group, l_str_egid) != 0)) {
-			log_error_message
-			    ("StopAs : The current user doesn't have permissions to stopas %s!\n",
-			     l_commandLine);
-			goto free_res;
-		}
-		/* call systemd */
-		l_ret = system(l_cmd);
-		if (l_ret != 0) {
-			log_error_message
-			    ("StopAs : Application cannot be stopped! Err:%s\n",
-			     strerror(errno));
-		    goto free_res;
-		}
-	} else {
+	}
+	log_message
+	    ("StopAs : The input ownership information [ uid: %d ] and [ gid : %d ]\n",
+	     p_euid, p_egid);
+	/* the caller must share the user or the group of the application */
+	if (!(l_has_uid && l_uid == p_euid) && !(l_has_gid && l_gid == p_egid)) {
 		log_error_message
-		    ("StopAs : Application %s cannot be stopped because is already stopped !\n",
-		     l_commandLine);
-		return;
+		    ("StopAs : The current user doesn't have permissions to stopas %s!\n",
+		     l_app_name);
+		return -1;
 	}
-	
-	return;
-free_res:
-	if(l_app_name) free(l_app_name);
-	if(l_commandLine) free(l_commandLine);
-	if(l_group) free(l_group);
-	if(l_user) free(l_user);
-	if(l_srv_path) free(l_srv_path);
-	if(l_str_egid) free(l_str_egid);
-	if(l_str_euid) free(l_str_euid);
-	return;
+	/* call systemd */
+	l_ret = SysdStopUnit(l_cmd, p_done, p_data);
+	if (l_ret != 0) {
+		log_error_message
+		    ("StopAs : Application %s cannot be stopped!\n",
+		     l_app_name);
+		return -1;
+	}
+	return 0;
 }
 
 void TaskStarted(int p_pid, char *p_imagePath)
@@ -2052,34 +1860,26 @@ void ChangeTaskState(int p_pid, bool p_isFg)
  * Function responsible with restarting an application when the SHM component detects
  * an abnormal operation of the application
  */
-void Restart(char *p_app_name)
+int Restart(AlUnitDesc *p_desc, SysdJobDoneFunc p_done, void *p_data)
 {
 	int l_ret;
-	/* the command line for the application */
-	char l_cmd[DIM_MAX];
 	log_debug_message("Restart : %s will be restarted !\n",
-			  p_app_name);
-	/* check if single service will be restarted */
-	if ((AppExistsInSystem(p_app_name)) == 1) {
-		sprintf(l_cmd, "systemctl restart %s.service", p_app_name);
-	}
-	/* check if target (group of apps) will be restarted */
-	if ((AppExistsInSystem(p_app_name)) == 2) {
-		sprintf(l_cmd, "systemctl restart %s.target", p_app_name);
-	}
+			  p_desc->app_name);
+	/* restart the service or the target (group of apps) */
 	/* systemd invocation */
-	l_ret = system(l_cmd);
+	l_ret = SysdRestartUnit(p_desc->unit, p_done, p_data);
 	if (l_ret != 0) {
-		if ((AppExistsInSystem(p_app_name)) == 1) {
+		if (p_desc->type == UNIT_CATALOG_SERVICE) {
 			log_error_message
-			    ("Restart : Application cannot be restarted with restart! Err: %s\n",
-			     strerror(errno));
+			    ("Restart : Application %s cannot be restarted with restart!\n",
+			     p_desc->app_name);
 		}
-		if ((AppExistsInSystem(p_app_name)) == 2) {
+		if (p_desc->type == UNIT_CATALOG_TARGET) {
 			log_error_message
-			    ("Restart : Applications group cannot be restarted with restart! Err: %s\n",
-			     strerror(errno));
+			    ("Restart : Applications group %s cannot be restarted with restart!\n",
+			     p_desc->app_name);
 		}
 	}
+	return l_ret;
 }
 
@@ -0,0 +1,215 @@
+/*
+* event_queue.c, contains the implementation of the handoff of events to the main loop
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * The AL Daemon GObject, and what its signals touch, belong to the main loop. Other
+ * threads hand their work to it through a bounded multi-producer, single-consumer ring :
+ * every slot carries a sequence number, a producer claims a position with one
+ * compare-and-swap on the tail and publishes the slot by advancing its sequence, the
+ * main loop consumes the slots whose sequence says they are published. An eventfd
+ * watched by the main loop is written only when no wake up is already pending.
+ */
+
+#include <errno.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "al-daemon.h"
+#include "event_queue.h"
+
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SLOTS - 1)
+
+/* one event of the ring */
+typedef struct EventQueueSlot
+{
+  /* position the slot may be claimed at (free) or consumed at (published, position + 1) */
+  size_t seq;
+  /* function run on the main loop and its payload */
+  AlEventFunc func;
+  size_t size;
+  /* time the event was posted (CLOCK_MONOTONIC, us) */
+  unsigned long long posted_us;
+  unsigned char payload[EVENT_QUEUE_PAYLOAD_MAX];
+} EventQueueSlot;
+
+/* ring of events, its positions and the wake up state */
+static EventQueueSlot g_event_slots[EVENT_QUEUE_SLOTS];
+static size_t g_event_head = 0;
+static size_t g_event_tail = 0;
+static int g_event_fd = -1;
+/* the queue accepts events */
+static int g_event_active = 0;
+static int g_event_wakeup = 0;
+static guint g_event_watch = 0;
+/* counters; updated with atomics by the producers, by the main loop otherwise */
+static unsigned long g_event_posted = 0;
+static unsigned long g_event_dropped = 0;
+static unsigned long g_event_handled = 0;
+static unsigned long g_event_wakeups = 0;
+static unsigned long g_event_max_depth = 0;
+static unsigned long long g_event_latency_us = 0;
+static unsigned long long g_event_max_latency_us = 0;
+
+/* Function responsible to return a monotonic timestamp in microseconds */
+static unsigned long long EventQueueNow()
+{
+  /* current time */
+  struct timespec l_ts;
+  clock_gettime(CLOCK_MONOTONIC, &l_ts);
+  return (unsigned long long)l_ts.tv_sec * 1000000ULL + l_ts.tv_nsec / 1000;
+}
+
+/* Function responsible to hand an event to the main loop */
+int EventQueuePost(AlEventFunc p_func, const void *p_payload, size_t p_size)
+{
+  /* claimed position and its slot */
+  size_t l_pos;
+  EventQueueSlot *l_slot;
+  /* distance between the slot sequence and the position */
+  intptr_t l_diff;
+  /* wake up counter for the eventfd */
+  uint64_t l_one = 1;
+  if (!__atomic_load_n(&g_event_active, __ATOMIC_ACQUIRE) || p_size > EVENT_QUEUE_PAYLOAD_MAX)
+    return -1;
+  l_pos = __atomic_load_n(&g_event_tail, __ATOMIC_RELAXED);
+  for (;;) {
+    l_slot = &g_event_slots[l_pos & EVENT_QUEUE_MASK];
+    l_diff = (intptr_t)__atomic_load_n(&l_slot->seq, __ATOMIC_ACQUIRE) - (intptr_t)l_pos;
+    if (l_diff == 0) {
+      if (__atomic_compare_exchange_n(&g_event_tail, &l_pos, l_pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (l_diff < 0) {
+      /* the main loop did not consume the slot of the previous round yet */
+      __atomic_fetch_add(&g_event_dropped, 1, __ATOMIC_RELAXED);
+      return -1;
+    } else {
+      l_pos = __atomic_load_n(&g_event_tail, __ATOMIC_RELAXED);
+    }
+  }
+  l_slot->func = p_func;
+  l_slot->size = p_size;
+  l_slot->posted_us = EventQueueNow();
+  if (p_size)
+    memcpy(l_slot->payload, p_payload, p_size);
+  __atomic_store_n(&l_slot->seq, l_pos + 1, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&g_event_posted, 1, __ATOMIC_RELAXED);
+  /* one write per wake up, whatever the number of events it covers */
+  if (!__atomic_exchange_n(&g_event_wakeup, 1, __ATOMIC_SEQ_CST)) {
+    while (write(g_event_fd, &l_one, sizeof(l_one)) < 0 && errno == EINTR)
+      ;
+  }
+  return 0;
+}
+
+/* Function responsible to run the published events on the main loop */
+static gboolean EventQueueOnWakeup(GIOChannel *p_source, GIOCondition p_cond, gpointer p_data)
+{
+  /* eventfd counter */
+  uint64_t l_count;
+  /* slot at the head */
+  EventQueueSlot *l_slot;
+  /* copy of the event, the slot is given back before running it */
+  AlEventFunc l_func;
+  unsigned char l_payload[EVENT_QUEUE_PAYLOAD_MAX];
+  /* handoff latency and queue depth */
+  unsigned long long l_latency;
+  unsigned long l_depth;
+  if (p_cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+    log_error_message("Event Queue : Wake up descriptor failed !\n", 0);
+    g_event_watch = 0;
+    return FALSE;
+  }
+  while (read(g_event_fd, &l_count, sizeof(l_count)) < 0 && errno == EINTR)
+    ;
+  /* cleared before draining : an event posted from now on wakes the loop up again */
+  __atomic_store_n(&g_event_wakeup, 0, __ATOMIC_SEQ_CST);
+  g_event_wakeups++;
+  l_depth = __atomic_load_n(&g_event_tail, __ATOMIC_RELAXED) - g_event_head;
+  if (l_depth > g_event_max_depth)
+    g_event_max_depth = l_depth;
+  for (;;) {
+    l_slot = &g_event_slots[g_event_head & EVENT_QUEUE_MASK];
+    if (__atomic_load_n(&l_slot->seq, __ATOMIC_ACQUIRE) != g_event_head + 1)
+      break;
+    l_func = l_slot->func;
+    memcpy(l_payload, l_slot->payload, l_slot->size);
+    l_latency = EventQueueNow() - l_slot->posted_us;
+    __atomic_store_n(&l_slot->seq, g_event_head + EVENT_QUEUE_SLOTS, __ATOMIC_RELEASE);
+    g_event_head++;
+    g_event_latency_us += l_latency;
+    if (l_latency > g_event_max_latency_us)
+      g_event_max_latency_us = l_latency;
+    g_event_handled++;
+    l_func(l_payload);
+  }
+  return TRUE;
+}
+
+/* Function responsible to create the queue and its wake up watch on the main loop */
+int EventQueueInit()
+{
+  /* main loop channel of the eventfd */
+  GIOChannel *l_channel;
+  /* slot index */
+  size_t l_i;
+  if ((g_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+    log_error_message("Event Queue : Cannot create the wake up descriptor ! Err : %s\n", strerror(errno));
+    return -1;
+  }
+  for (l_i = 0; l_i < EVENT_QUEUE_SLOTS; l_i++)
+    g_event_slots[l_i].seq = l_i;
+  g_event_head = g_event_tail = 0;
+  l_channel = g_io_channel_unix_new(g_event_fd);
+  g_event_watch = g_io_add_watch(l_channel, G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+                                 EventQueueOnWakeup, NULL);
+  g_io_channel_unref(l_channel);
+  __atomic_store_n(&g_event_active, 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/* Function responsible to stop the queue */
+void EventQueueTerminate()
+{
+  /* the signal dispatcher thread is not joined : the ring and the descriptor stay valid for it */
+  __atomic_store_n(&g_event_active, 0, __ATOMIC_RELEASE);
+  if (g_event_watch) {
+    g_source_remove(g_event_watch);
+    g_event_watch = 0;
+  }
+}
+
+/* Function responsible to log the queue counters */
+void EventQueueLogCounters()
+{
+  log_message("Event Queue : posted=%lu dropped=%lu handled=%lu wakeups=%lu depth=%lu max_depth=%lu "
+              "avg_latency_us=%llu max_latency_us=%llu\n",
+              __atomic_load_n(&g_event_posted, __ATOMIC_RELAXED),
+              __atomic_load_n(&g_event_dropped, __ATOMIC_RELAXED), g_event_handled, g_event_wakeups,
+              (unsigned long)(__atomic_load_n(&g_event_tail, __ATOMIC_RELAXED) - g_event_head),
+              g_event_max_depth, g_event_handled ? g_event_latency_us / g_event_handled : 0,
+              g_event_max_latency_us);
+}
@@ -0,0 +1,545 @@
+/*
+* ident_cache.c, contains the implementation of the cached user and group identities
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * RunAs and StopAs translate between user/group names and ids. The users and groups
+ * are enumerated by a background thread into id and name maps, swapped in at once, and
+ * enumerated again whenever /etc/passwd, /etc/group or /etc/nsswitch.conf change, so
+ * the lookups of the main loop are served from memory and never wait for NSS. An
+ * identity the enumeration did not return (NSS sources that cannot be enumerated, or
+ * lookups before the first load) is reported as pending and queued to a resolver thread,
+ * whose answer, unknown identities included, is kept until the next refresh.
+ */
+
+#include <errno.h>
+#include <glib.h>
+#include <grp.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "al-daemon.h"
+#include "ident_cache.h"
+
+/* size of the buffer used to receive inotify events */
+#define IDENT_CACHE_EVENT_SIZE 4096
+/* initial buffer of the reentrant NSS calls */
+#define IDENT_CACHE_NSS_BUF 1024
+
+/* identity kinds */
+enum
+{
+  IDENT_USER = 0,
+  IDENT_GROUP,
+  IDENT_KIND_COUNT
+};
+
+/* one identity, or the proof that an id or a name is unknown */
+typedef struct IdentEntry
+{
+  char *name;
+  unsigned int id;
+  bool found;
+} IdentEntry;
+
+/* identities of one kind */
+typedef struct IdentMap
+{
+  /* id -> IdentEntry */
+  GHashTable *by_id;
+  /* name -> IdentEntry */
+  GHashTable *by_name;
+} IdentMap;
+
+/* identity queued for the resolver thread */
+typedef struct IdentRequest
+{
+  int kind;
+  /* name to resolve, NULL to resolve the id */
+  char *name;
+  unsigned int id;
+  /* key in the pending set */
+  char *key;
+} IdentRequest;
+
+/* current maps, swapped by the refresh */
+static IdentMap *g_ident_maps[IDENT_KIND_COUNT] = { NULL, NULL };
+/* bumped when the maps are swapped, an NSS answer obtained before is not kept */
+static unsigned long g_ident_generation = 0;
+/* refresh thread state */
+static bool g_ident_refreshing = false;
+static bool g_ident_dirty = false;
+/* resolver thread state : queued IdentRequest and their keys */
+static GQueue *g_ident_requests = NULL;
+static GHashTable *g_ident_pending = NULL;
+static bool g_ident_resolving = false;
+/* protects the maps, the refresh and the resolver state */
+static pthread_mutex_t g_ident_lock = PTHREAD_MUTEX_INITIALIZER;
+/* inotify descriptor and main loop watch */
+static int g_ident_fd = -1;
+static guint g_ident_watch = 0;
+/* counters */
+static unsigned long g_ident_hits = 0;
+static unsigned long g_ident_deferred = 0;
+static unsigned long g_ident_nss_lookups = 0;
+static unsigned long g_ident_refreshes = 0;
+
+/* entry destructor */
+static void IdentEntryFree(gpointer p_entry)
+{
+  g_free(((IdentEntry *)p_entry)->name);
+  g_free(p_entry);
+}
+
+/* Function responsible to create an empty map */
+static IdentMap *IdentMapNew()
+{
+  IdentMap *l_map = g_new0(IdentMap, 1);
+  l_map->by_id = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, IdentEntryFree);
+  l_map->by_name = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, IdentEntryFree);
+  return l_map;
+}
+
+/* Function responsible to release a map */
+static void IdentMapFree(IdentMap *p_map)
+{
+  if (!p_map)
+    return;
+  g_hash_table_destroy(p_map->by_id);
+  g_hash_table_destroy(p_map->by_name);
+  g_free(p_map);
+}
+
+/* Function responsible to record an identity; a NULL name records an unknown id, found false an unknown name */
+static void IdentMapAdd(IdentMap *p_map, unsigned int p_id, const char *p_name, bool p_found)
+{
+  /* new entry */
+  IdentEntry *l_entry;
+  if (p_found || !p_name) {
+    l_entry = g_new0(IdentEntry, 1);
+    l_entry->name = g_strdup(p_name);
+    l_entry->id = p_id;
+    l_entry->found = p_found;
+    /* the first entry of an id wins, as with getpwuid() */
+    if (!g_hash_table_lookup(p_map->by_id, GUINT_TO_POINTER(p_id)))
+      g_hash_table_insert(p_map->by_id, GUINT_TO_POINTER(p_id), l_entry);
+    else
+      IdentEntryFree(l_entry);
+  }
+  if (p_name && !g_hash_table_lookup(p_map->by_name, p_name)) {
+    l_entry = g_new0(IdentEntry, 1);
+    l_entry->name = g_strdup(p_name);
+    l_entry->id = p_id;
+    l_entry->found = p_found;
+    g_hash_table_insert(p_map->by_name, l_entry->name, l_entry);
+  }
+}
+
+/* Function responsible to resolve an id through NSS; returns the name or NULL */
+static char *IdentNssName(int p_kind, unsigned int p_id)
+{
+  /* NSS buffer, grown on ERANGE */
+  size_t l_size = IDENT_CACHE_NSS_BUF;
+  char *l_buf = NULL;
+  /* answers */
+  struct passwd l_pwd, *l_pw = NULL;
+  struct group l_grp, *l_gr = NULL;
+  char *l_name = NULL;
+  int l_ret;
+  do {
+    l_buf = g_realloc(l_buf, l_size);
+    if (p_kind == IDENT_USER)
+      l_ret = getpwuid_r((uid_t)p_id, &l_pwd, l_buf, l_size, &l_pw);
+    else
+      l_ret = getgrgid_r((gid_t)p_id, &l_grp, l_buf, l_size, &l_gr);
+    l_size *= 2;
+  } while (l_ret == ERANGE);
+  if (l_pw)
+    l_name = g_strdup(l_pw->pw_name);
+  if (l_gr)
+    l_name = g_strdup(l_gr->gr_name);
+  g_free(l_buf);
+  return l_name;
+}
+
+/* Function responsible to resolve a name through NSS; returns true if found */
+static bool IdentNssId(int p_kind, const char *p_name, unsigned int *p_id)
+{
+  /* NSS buffer, grown on ERANGE */
+  size_t l_size = IDENT_CACHE_NSS_BUF;
+  char *l_buf = NULL;
+  /* answers */
+  struct passwd l_pwd, *l_pw = NULL;
+  struct group l_grp, *l_gr = NULL;
+  int l_ret;
+  do {
+    l_buf = g_realloc(l_buf, l_size);
+    if (p_kind == IDENT_USER)
+      l_ret = getpwnam_r(p_name, &l_pwd, l_buf, l_size, &l_pw);
+    else
+      l_ret = getgrnam_r(p_name, &l_grp, l_buf, l_size, &l_gr);
+    l_size *= 2;
+  } while (l_ret == ERANGE);
+  if (l_pw)
+    *p_id = l_pw->pw_uid;
+  if (l_gr)
+    *p_id = l_gr->gr_gid;
+  g_free(l_buf);
+  return l_pw || l_gr;
+}
+
+/* Function responsible to release a resolver request */
+static void IdentRequestFree(IdentRequest *p_req)
+{
+  g_free(p_req->name);
+  g_free(p_req->key);
+  g_free(p_req);
+}
+
+/* Function responsible to resolve the queued identities through NSS */
+static void *IdentResolve(void *p_data)
+{
+  /* request being resolved */
+  IdentRequest *l_req;
+  /* NSS answers and the generation they were obtained in */
+  char *l_name = NULL;
+  unsigned int l_id = 0;
+  bool l_found = false;
+  unsigned long l_generation;
+  pthread_mutex_lock(&g_ident_lock);
+  while ((l_req = g_queue_pop_head(g_ident_requests)) != NULL) {
+    l_generation = g_ident_generation;
+    pthread_mutex_unlock(&g_ident_lock);
+    if (l_req->name)
+      l_found = IdentNssId(l_req->kind, l_req->name, &l_id);
+    else
+      l_name = IdentNssName(l_req->kind, l_req->id);
+    pthread_mutex_lock(&g_ident_lock);
+    g_ident_nss_lookups++;
+    /* an answer obtained before the maps were swapped is not kept */
+    if (l_generation == g_ident_generation) {
+      if (!g_ident_maps[l_req->kind])
+        g_ident_maps[l_req->kind] = IdentMapNew();
+      if (l_req->name)
+        IdentMapAdd(g_ident_maps[l_req->kind], l_id, l_req->name, l_found);
+      else
+        IdentMapAdd(g_ident_maps[l_req->kind], l_req->id, l_name, l_name != NULL);
+    }
+    g_hash_table_remove(g_ident_pending, l_req->key);
+    IdentRequestFree(l_req);
+    g_free(l_name);
+    l_name = NULL;
+  }
+  g_ident_resolving = false;
+  pthread_mutex_unlock(&g_ident_lock);
+  return NULL;
+}
+
+/* Function responsible to queue an identity missing from the maps to the resolver thread; lock must be held */
+static void IdentResolveQueueLocked(int p_kind, const char *p_name, unsigned int p_id)
+{
+  /* queued request */
+  IdentRequest *l_req;
+  /* resolver thread */
+  pthread_t l_thread;
+  pthread_attr_t l_attr;
+  /* request key */
+  char *l_key = p_name ? g_strdup_printf("%d:%s", p_kind, p_name) : g_strdup_printf("%d#%u", p_kind, p_id);
+  if (!g_ident_pending) {
+    g_ident_pending = g_hash_table_new(g_str_hash, g_str_equal);
+    g_ident_requests = g_queue_new();
+  }
+  /* already on its way */
+  if (g_hash_table_lookup(g_ident_pending, l_key)) {
+    g_free(l_key);
+    return;
+  }
+  l_req = g_new0(IdentRequest, 1);
+  l_req->kind = p_kind;
+  l_req->name = g_strdup(p_name);
+  l_req->id = p_id;
+  l_req->key = l_key;
+  g_hash_table_insert(g_ident_pending, l_key, l_req);
+  g_queue_push_tail(g_ident_requests, l_req);
+  if (g_ident_resolving)
+    return;
+  pthread_attr_init(&l_attr);
+  pthread_attr_setdetachstate(&l_attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&l_thread, &l_attr, IdentResolve, NULL) == 0) {
+    g_ident_resolving = true;
+  } else {
+    log_error_message("Identity Cache : Cannot create resolver thread, %s is not resolved\n", l_key);
+    g_queue_remove(g_ident_requests, l_req);
+    g_hash_table_remove(g_ident_pending, l_key);
+    IdentRequestFree(l_req);
+  }
+  pthread_attr_destroy(&l_attr);
+}
+
+/* Function responsible to enumerate the users and groups and swap them in */
+static void *IdentRefresh(void *p_data)
+{
+  /* enumerated maps and the ones replaced */
+  IdentMap *l_maps[IDENT_KIND_COUNT];
+  IdentMap *l_old[IDENT_KIND_COUNT];
+  /* enumeration */
+  struct passwd *l_pw;
+  struct group *l_gr;
+  /* the databases changed during the enumeration */
+  bool l_again;
+  int l_i;
+  do {
+    pthread_mutex_lock(&g_ident_lock);
+    g_ident_dirty = false;
+    pthread_mutex_unlock(&g_ident_lock);
+    /* the enumeration state is used by this thread only */
+    l_maps[IDENT_USER] = IdentMapNew();
+    setpwent();
+    while ((l_pw = getpwent()) != NULL)
+      IdentMapAdd(l_maps[IDENT_USER], l_pw->pw_uid, l_pw->pw_name, true);
+    endpwent();
+    l_maps[IDENT_GROUP] = IdentMapNew();
+    setgrent();
+    while ((l_gr = getgrent()) != NULL)
+      IdentMapAdd(l_maps[IDENT_GROUP], l_gr->gr_gid, l_gr->gr_name, true);
+    endgrent();
+    pthread_mutex_lock(&g_ident_lock);
+    for (l_i = 0; l_i < IDENT_KIND_COUNT; l_i++) {
+      l_old[l_i] = g_ident_maps[l_i];
+      g_ident_maps[l_i] = l_maps[l_i];
+    }
+    g_ident_generation++;
+    g_ident_refreshes++;
+    l_again = g_ident_dirty;
+    if (!l_again)
+      g_ident_refreshing = false;
+    log_debug_message("Identity Cache : Loaded %u users and %u groups\n",
+                      g_hash_table_size(l_maps[IDENT_USER]->by_id), g_hash_table_size(l_maps[IDENT_GROUP]->by_id));
+    pthread_mutex_unlock(&g_ident_lock);
+    for (l_i = 0; l_i < IDENT_KIND_COUNT; l_i++)
+      IdentMapFree(l_old[l_i]);
+  } while (l_again);
+  return NULL;
+}
+
+/* Function responsible to start a refresh, or to have the running one enumerate again */
+static void IdentRefreshStart()
+{
+  /* refresh thread */
+  pthread_t l_thread;
+  pthread_attr_t l_attr;
+  pthread_mutex_lock(&g_ident_lock);
+  if (g_ident_refreshing) {
+    g_ident_dirty = true;
+    pthread_mutex_unlock(&g_ident_lock);
+    return;
+  }
+  g_ident_refreshing = true;
+  pthread_mutex_unlock(&g_ident_lock);
+  pthread_attr_init(&l_attr);
+  pthread_attr_setdetachstate(&l_attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&l_thread, &l_attr, IdentRefresh, NULL) != 0) {
+    log_error_message("Identity Cache : Cannot create refresh thread, dropping the cached identities\n", 0);
+    pthread_mutex_lock(&g_ident_lock);
+    IdentMapFree(g_ident_maps[IDENT_USER]);
+    IdentMapFree(g_ident_maps[IDENT_GROUP]);
+    g_ident_maps[IDENT_USER] = g_ident_maps[IDENT_GROUP] = NULL;
+    g_ident_generation++;
+    g_ident_refreshing = false;
+    pthread_mutex_unlock(&g_ident_lock);
+  }
+  pthread_attr_destroy(&l_attr);
+}
+
+/* inotify callback, dispatched from the main loop */
+static gboolean IdentCacheOnEvent(GIOChannel *p_source, GIOCondition p_cond, gpointer p_data)
+{
+  /* event buffer, aligned for struct inotify_event */
+  char l_buf[IDENT_CACHE_EVENT_SIZE] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *l_ev;
+  /* received length */
+  ssize_t l_len;
+  /* event cursor */
+  char *l_cur;
+  /* an account database changed */
+  bool l_changed = false;
+  if (p_cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+    log_error_message("Identity Cache : inotify descriptor failed, identities are not refreshed any more\n", 0);
+    g_ident_watch = 0;
+    return FALSE;
+  }
+  while ((l_len = read(g_ident_fd, l_buf, sizeof(l_buf))) > 0) {
+    for (l_cur = l_buf; l_cur < l_buf + l_len; l_cur += sizeof(struct inotify_event) + l_ev->len) {
+      l_ev = (const struct inotify_event *)l_cur;
+      if ((l_ev->mask & IN_Q_OVERFLOW)
+          || (l_ev->len > 0 && (strcmp(l_ev->name, "passwd") == 0 || strcmp(l_ev->name, "group") == 0
+                                || strcmp(l_ev->name, "nsswitch.conf") == 0)))
+        l_changed = true;
+    }
+  }
+  if (l_changed)
+    IdentRefreshStart();
+  return TRUE;
+}
+
+/* Function responsible to load the identities in the background and watch the account databases */
+int IdentCacheInit()
+{
+  /* channel for the main loop watch */
+  GIOChannel *l_channel;
+  if (g_ident_fd >= 0)
+    return 0;
+  /* watch before loading so no change can slip between the enumeration and the events */
+  if ((g_ident_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0
+      || inotify_add_watch(g_ident_fd, IDENT_CACHE_DIR, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+    log_error_message("Identity Cache : Cannot watch %s ! Err : %s\n", IDENT_CACHE_DIR, strerror(errno));
+    if (g_ident_fd >= 0)
+      close(g_ident_fd);
+    g_ident_fd = -1;
+    return -1;
+  }
+  l_channel = g_io_channel_unix_new(g_ident_fd);
+  g_ident_watch = g_io_add_watch(l_channel, G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+                                 IdentCacheOnEvent, NULL);
+  g_io_channel_unref(l_channel);
+  IdentRefreshStart();
+  return 0;
+}
+
+/* Function responsible to release the identities and the watch */
+void IdentCacheTerminate()
+{
+  /* kind index */
+  int l_i;
+  if (g_ident_watch) {
+    g_source_remove(g_ident_watch);
+    g_ident_watch = 0;
+  }
+  if (g_ident_fd >= 0) {
+    close(g_ident_fd);
+    g_ident_fd = -1;
+  }
+  pthread_mutex_lock(&g_ident_lock);
+  for (l_i = 0; l_i < IDENT_KIND_COUNT; l_i++) {
+    IdentMapFree(g_ident_maps[l_i]);
+    g_ident_maps[l_i] = NULL;
+  }
+  g_ident_generation++;
+  pthread_mutex_unlock(&g_ident_lock);
+}
+
+/* Function responsible to get the name of an id; returns 0 on success */
+static int IdentLookupName(int p_kind, unsigned int p_id, char *p_name, size_t p_size)
+{
+  /* cached entry */
+  IdentEntry *l_entry = NULL;
+  pthread_mutex_lock(&g_ident_lock);
+  if (g_ident_maps[p_kind])
+    l_entry = g_hash_table_lookup(g_ident_maps[p_kind]->by_id, GUINT_TO_POINTER(p_id));
+  if (l_entry) {
+    g_ident_hits++;
+    if (l_entry->found)
+      g_strlcpy(p_name, l_entry->name, p_size);
+    pthread_mutex_unlock(&g_ident_lock);
+    return l_entry->found ? 0 : -1;
+  }
+  /* resolved in the background for the next lookup */
+  g_ident_deferred++;
+  IdentResolveQueueLocked(p_kind, NULL, p_id);
+  pthread_mutex_unlock(&g_ident_lock);
+  log_debug_message("Identity Cache : %s %u is not known yet, resolving it\n",
+                    p_kind == IDENT_USER ? "uid" : "gid", p_id);
+  return IDENT_CACHE_PENDING;
+}
+
+/* Function responsible to get the id of a name or number; returns 0 on success */
+static int IdentLookupId(int p_kind, const char *p_name, unsigned int *p_id)
+{
+  /* cached entry */
+  IdentEntry *l_entry = NULL;
+  /* numeric value */
+  char *l_end;
+  unsigned long l_num;
+  if (!p_name || !*p_name)
+    return -1;
+  /* systemd accepts numeric User= and Group= values */
+  l_num = strtoul(p_name, &l_end, 10);
+  if (*l_end == '\0') {
+    *p_id = (unsigned int)l_num;
+    return 0;
+  }
+  pthread_mutex_lock(&g_ident_lock);
+  if (g_ident_maps[p_kind])
+    l_entry = g_hash_table_lookup(g_ident_maps[p_kind]->by_name, p_name);
+  if (l_entry) {
+    g_ident_hits++;
+    if (l_entry->found)
+      *p_id = l_entry->id;
+    pthread_mutex_unlock(&g_ident_lock);
+    return l_entry->found ? 0 : -1;
+  }
+  /* resolved in the background for the next lookup */
+  g_ident_deferred++;
+  IdentResolveQueueLocked(p_kind, p_name, 0);
+  pthread_mutex_unlock(&g_ident_lock);
+  log_debug_message("Identity Cache : %s %s is not known yet, resolving it\n",
+                    p_kind == IDENT_USER ? "user" : "group", p_name);
+  return IDENT_CACHE_PENDING;
+}
+
+/* Function responsible to get the name of a uid */
+int IdentUserName(unsigned int p_uid, char *p_name, size_t p_size)
+{
+  return IdentLookupName(IDENT_USER, p_uid, p_name, p_size);
+}
+
+/* Function responsible to get the name of a gid */
+int IdentGroupName(unsigned int p_gid, char *p_name, size_t p_size)
+{
+  return IdentLookupName(IDENT_GROUP, p_gid, p_name, p_size);
+}
+
+/* Function responsible to get the uid of a user name or number */
+int IdentUserId(const char *p_user, unsigned int *p_uid)
+{
+  return IdentLookupId(IDENT_USER, p_user, p_uid);
+}
+
+/* Function responsible to get the gid of a group name or number */
+int IdentGroupId(const char *p_group, unsigned int *p_gid)
+{
+  return IdentLookupId(IDENT_GROUP, p_group, p_gid);
+}
+
+/* Function responsible to log the identity cache counters */
+void IdentCacheLogCounters()
+{
+  pthread_mutex_lock(&g_ident_lock);
+  log_message("Identity Cache : users=%u groups=%u hits=%lu deferred=%lu nss_lookups=%lu refreshes=%lu\n",
+              g_ident_maps[IDENT_USER] ? g_hash_table_size(g_ident_maps[IDENT_USER]->by_id) : 0,
+              g_ident_maps[IDENT_GROUP] ? g_hash_table_size(g_ident_maps[IDENT_GROUP]->by_id) : 0,
+              g_ident_hits, g_ident_deferred, g_ident_nss_lookups, g_ident_refreshes);
+  pthread_mutex_unlock(&g_ident_lock);
+}
@@ -45,6 +45,7 @@
 #include "lum.h"
 #include "al-daemon.h"
 #include "dbus_interface.h"
+#include "unit_desc.h"
 
 /* 
  * Function responsible to get the current user as specified in the current_user GConf key.
@@ -96,6 +97,8 @@ int StartUserModeApps(GConfClient *p_client, char *p_user)
   int l_idx;
   /* current entry in application list */
   char *l_app;
+  /* unit descriptor of the application */
+  AlUnitDesc *l_desc;
   /* pid for currently started application in the list */
   int *l_app_pid;
   /* test user existence in gconftree file */
@@ -128,7 +131,12 @@ int StartUserModeApps(GConfClient *p_client, char *p_user)
 	 /* get app name */
 	 l_app = (char*)g_slist_nth_data(l_app_list, l_idx);
          /* run application */
- 	 Run(l_app, 0, TRUE);
+	 if((l_desc = UnitDescGet(l_app)) == NULL){
+		log_error_message("Start User Mode Apps : Application %s is not found in the system !\n", l_app);
+		continue;
+	 }
+ 	 Run(l_desc, 0, TRUE, NULL, NULL);
+	 UnitDescUnref(l_desc);
 	 log_debug_message("Start User Mode Apps : Started %s for user %s !\n", l_app, p_user);
   }
   log_debug_message("Start User Mode Apps : Last user mode applications for user %s was setup!\n", p_user);
@@ -39,515 +39,738 @@
 #include <sys/sysctl.h>
 #include <sys/types.h>
 #include <sys/user.h>
+#include <pthread.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "al-daemon.h"
 #include "notifier.h"
 #include "dbus_interface.h"
+#include "utils.h"
+#include "app_handle.h"
+#include "unit_state.h"
+#include "event_queue.h"
 
 extern ALDbus *g_al_dbus;
 
-/* 
- * Function responsible to extract the status of an application after starting it or that is already running in the system. 
- * This refers to extracting : Load State, Active State and Sub State.
- */
+/* the GlobalStateNotification string signal is sent along with TaskStateChanged */
+static bool g_legacy_state_signal = true;
 
-int AlGetAppState(DBusConnection * p_bus, char *p_app_name,
-		  char *p_state_info)
+/* Function responsible to create a GetAll call for one interface of a unit */
+static DBusMessage *AlUnitGetAll(const char *p_path, const char *p_interface)
+{
+  /* new method call */
+  DBusMessage *l_msg;
+  if (!(l_msg = dbus_message_new_method_call("org.freedesktop.systemd1", p_path,
+                                             "org.freedesktop.DBus.Properties", "GetAll")))
+    return NULL;
+  if (!dbus_message_append_args(l_msg, DBUS_TYPE_STRING, &p_interface, DBUS_TYPE_INVALID)) {
+    dbus_message_unref(l_msg);
+    return NULL;
+  }
+  return l_msg;
+}
+
+/* Function responsible to decode the properties of a GetAll reply into the unit state; returns the mask of the decoded ones */
+static int AlUnitStateDecode(DBusMessage *p_reply, AlUnitState *p_state)
+{
+  /* iterators over the reply and its a{sv} dictionary */
+  DBusMessageIter l_iter, l_dict;
+  if (dbus_message_get_type(p_reply) != DBUS_MESSAGE_TYPE_METHOD_RETURN
+      || !dbus_message_iter_init(p_reply, &l_iter)
+      || dbus_message_iter_get_arg_type(&l_iter) != DBUS_TYPE_ARRAY)
+    return -1;
+  dbus_message_iter_recurse(&l_iter, &l_dict);
+  return UnitStateDecode(&l_dict, p_state);
+}
+
+/*
+ * Function responsible to fetch the state of a unit : the Unit and Service properties are
+ * requested together with GetAll and the two replies are awaited afterwards, so a state
+ * query costs a single round trip once the object path is known. While the signals of
+ * systemd are followed, the state is served from the unit state cache instead as long as
+ * it knows the needed properties.
+ */
+static int AlQueryUnitState(DBusConnection * p_bus, const char *p_unit, AlUnitState * p_state, int p_needed)
 {
-  /* initialize message and reply */
-  DBusMessage *l_msg = NULL, *l_reply = NULL;
-  /* define interface to use and properties to fetch */
-  const char
-  *interface = "org.freedesktop.systemd1.Unit",
-      *l_as_property = "ActiveState",
-      *l_ls_property = "LoadState", *l_ss_property = "SubState";
-  /* store the state */
-  char *l_state;
+  /* GetAll calls for the Unit and Service interfaces and their replies */
+  DBusMessage *l_msg[2] = { NULL, NULL };
+  DBusMessage *l_reply[2] = { NULL, NULL };
+  DBusPendingCall *l_pending[2] = { NULL, NULL };
+  const char *l_interfaces[2] = { "org.freedesktop.systemd1.Unit", "org.freedesktop.systemd1.Service" };
+  /* unit object path */
+  char *l_path = NULL;
   /* return code */
   int l_ret = 0;
-  /* error definition and initialization */
-  DBusError l_error;
-  dbus_error_init(&l_error);
-  /* initialize the path */
-  char *l_path = NULL;
-  /* store the current global state attributes */
-  char *l_as_state = NULL, *l_ls_state = NULL, *l_ss_state = NULL;
-  DBusMessageIter l_iter, l_sub_iter;
-  /* image path and pid */
-  char *l_imagePath;
-  int l_pid;
+  /* call index and fetched properties */
+  int l_i, l_known, l_service;
+  if (UnitStateLookup(p_unit, p_state, p_needed) == 0)
+    return 0;
+  memset(p_state, 0, sizeof(*p_state));
+  g_strlcpy(p_state->name, p_unit, sizeof(p_state->name));
   /* get unit object path */
-  if (NULL == (l_path = GetUnitObjectPath(p_bus, p_app_name)))
-  {
-          log_error_message
-                  ("Active State Extractor : Unable to extract object path for %s", p_app_name);
-          l_ret = -1;
-          goto free_res;
-  }
-  log_debug_message
-          ("Active State Extractor : Extracted object path for %s\n",
-           p_app_name);
-  /* issue a new method call to extract properties for the unit */
-  if (!(l_msg = dbus_message_new_method_call("org.freedesktop.systemd1",
-					     l_path,
-					     "org.freedesktop.DBus.Properties",
-					     "Get"))) {
-    log_error_message
-	("Active State Extractor : Could not allocate message for %s \n",
-	 p_app_name);
-    l_ret = -ENOMEM;
-    goto free_res;
-  }
-  /* append the arguments; the active state will be needed */
-  if (!dbus_message_append_args(l_msg,
-				DBUS_TYPE_STRING, &interface,
-				DBUS_TYPE_STRING, &l_as_property,
-				DBUS_TYPE_INVALID)) {
-    log_error_message
-	("Active State Extractor : Could not append arguments to message for %s \n",
-	 p_app_name);
-    l_ret = -ENOMEM;
-    goto free_res;
-  }
-  /* send the message over the systemd bus and wait for a reply */
-  if (!(l_reply =
-	dbus_connection_send_with_reply_and_block(p_bus, l_msg, -1,
-						  &l_error))) {
-    log_error_message
-	("Active State Extractor : Failed to issue method call for %s\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
+  if (NULL == (l_path = GetUnitObjectPath(p_bus, (char *)p_unit))) {
+    log_error_message("State Extractor : Unable to extract object path for %s\n", p_unit);
+    return -1;
   }
-  /* parse reply and extract arguments */
-  if (!dbus_message_iter_init(l_reply, &l_iter) ||
-      dbus_message_iter_get_arg_type(&l_iter) != DBUS_TYPE_VARIANT) {
-    log_error_message
-	("Active State Extractor : Failed to parse reply for %s\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
-  }
-  /* sub iterator for reply  */
-  dbus_message_iter_recurse(&l_iter, &l_sub_iter);
-  /* argument type check */
-  if (dbus_message_iter_get_arg_type(&l_sub_iter) != DBUS_TYPE_STRING) {
-    log_error_message
-	("Active State Extractor : Failed to get arg type for %s when fetching active state\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
-  }
-  /* extract the argument as a basic type */
-  dbus_message_iter_get_basic(&l_sub_iter, &l_as_state);
-  /* allow reply unreference */
-  l_as_state = strdup(l_as_state);
-  /* unreference the message */
-  dbus_message_unref(l_msg);
-  /* new method call to fetch the application's properties */
-  if (!(l_msg = dbus_message_new_method_call("org.freedesktop.systemd1",
-					     l_path,
-					     "org.freedesktop.DBus.Properties",
-					     "Get"))) {
-    log_error_message
-	("Load State Extractor : Could not allocate message for %s \n",
-	 p_app_name);
-    l_ret = -ENOMEM;
-    goto free_res;
-  }
-  /* append arguments to request load state information */
-  if (!dbus_message_append_args(l_msg,
-				DBUS_TYPE_STRING, &interface,
-				DBUS_TYPE_STRING, &l_ls_property,
-				DBUS_TYPE_INVALID)) {
-    log_error_message
-	("Load State Extractor : Could not append arguments to message for %s \n",
-	 p_app_name);
-    l_ret = -ENOMEM;
-    goto free_res;
-  }
-  /* unreference reply */
-  dbus_message_unref(l_reply);
-  /* sends the message and waits for a reply */
-  if (!(l_reply =
-	dbus_connection_send_with_reply_and_block(p_bus, l_msg, -1,
-						  &l_error))) {
-    log_error_message
-	("Load State Extractor : Failed to issue method call for %s\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
-  }
-  /* initialize iterator and verify argument type */
-  if (!dbus_message_iter_init(l_reply, &l_iter) ||
-      dbus_message_iter_get_arg_type(&l_iter) != DBUS_TYPE_VARIANT) {
-    log_error_message
-	("Load State Extractor : Failed to parse reply for %s\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
-  }
-  /* recursive iterator for arguments */
-  dbus_message_iter_recurse(&l_iter, &l_sub_iter);
-  /* extracted argument type verification */
-  if (dbus_message_iter_get_arg_type(&l_sub_iter) != DBUS_TYPE_STRING) {
-    log_error_message
-	("Load State Extractor : Failed to get arg type for %s when fetching load state\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
-  }
-  /* get the argument and store it */
-  dbus_message_iter_get_basic(&l_sub_iter, &l_ls_state);
-  /* allow reply unreference */
-  l_ls_state = strdup(l_ls_state);
-  /* unreference message */
-  dbus_message_unref(l_msg);
-  /* issues a new method call to fetch application's properties */
-  if (!(l_msg = dbus_message_new_method_call("org.freedesktop.systemd1",
-					     l_path,
-					     "org.freedesktop.DBus.Properties",
-					     "Get"))) {
-    log_error_message
-	("Sub State Extractor : Could not allocate message for %s \n",
-	 p_app_name);
-    l_ret = -ENOMEM;
-    goto free_res;
-  }
-  /* append arguments */
-  if (!dbus_message_append_args(l_msg,
-				DBUS_TYPE_STRING, &interface,
-				DBUS_TYPE_STRING, &l_ss_property,
-				DBUS_TYPE_INVALID)) {
-    log_error_message
-	("Sub State Extractor : Could not append arguments to message for %s \n",
-	 p_app_name);
-    l_ret = -ENOMEM;
-    goto free_res;
+  /* both calls are on the wire before waiting for the first reply */
+  for (l_i = 0; l_i < 2; l_i++) {
+    if (!(l_msg[l_i] = AlUnitGetAll(l_path, l_interfaces[l_i]))
+        || !dbus_connection_send_with_reply(p_bus, l_msg[l_i], &l_pending[l_i], SYSTEMD_UNIT_INFO_TIMEOUT)
+        || !l_pending[l_i]) {
+      log_error_message("State Extractor : Could not issue GetAll(%s) for %s \n", l_interfaces[l_i], p_unit);
+      l_ret = -ENOMEM;
+      goto free_res;
+    }
   }
-  /* unreference the reply */
-  dbus_message_unref(l_reply);
-  /* send the message and wait for a reply */
-  if (!(l_reply =
-	dbus_connection_send_with_reply_and_block(p_bus, l_msg, -1,
-						  &l_error))) {
-    log_error_message
-	("Sub State Extractor : Failed to issue method call for %s\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
+  for (l_i = 0; l_i < 2; l_i++) {
+    dbus_pending_call_block(l_pending[l_i]);
+    l_reply[l_i] = dbus_pending_call_steal_reply(l_pending[l_i]);
   }
-  /* create iterator for reply parsing and verify argument type */
-  if (!dbus_message_iter_init(l_reply, &l_iter) ||
-      dbus_message_iter_get_arg_type(&l_iter) != DBUS_TYPE_VARIANT) {
-    log_error_message
-	("Sub State Extractor : Failed to parse reply for %s\n",
-	 p_app_name);
+  /* the unit properties are mandatory, the service ones only exist for services */
+  if (!l_reply[0] || (l_known = AlUnitStateDecode(l_reply[0], p_state)) < 0) {
+    log_error_message("State Extractor : Failed to fetch the unit properties of %s\n", p_unit);
     l_ret = -EIO;
     goto free_res;
   }
-  /* recurse sub-iterator for reply parsing */
-  dbus_message_iter_recurse(&l_iter, &l_sub_iter);
-  /* check extracted argument type validity */
-  if (dbus_message_iter_get_arg_type(&l_sub_iter) != DBUS_TYPE_STRING) {
-    log_error_message
-	("Sub State Extractor : Failed to get arg type for %s when fetching sub state\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
+  if (l_reply[1] && (l_service = AlUnitStateDecode(l_reply[1], p_state)) > 0)
+    l_known |= l_service;
+  UnitStateStore(p_state, l_known);
+  log_debug_message("State Extractor : %s is %s %s %s [ main pid : %u ]\n", p_unit, p_state->load_state,
+                    p_state->active_state, p_state->sub_state, p_state->main_pid);
+
+free_res:
+  for (l_i = 0; l_i < 2; l_i++) {
+    if (l_pending[l_i])
+      dbus_pending_call_unref(l_pending[l_i]);
+    if (l_msg[l_i])
+      dbus_message_unref(l_msg[l_i]);
+    if (l_reply[l_i])
+      dbus_message_unref(l_reply[l_i]);
   }
-  /* extract the sub state information for the application */
-  dbus_message_iter_get_basic(&l_sub_iter, &l_ss_state);
-  /* allow reply unreference */
-  l_ss_state = strdup(l_ss_state);
-  /* allocate the global state information string */
-  l_state = malloc(DIM_MAX * sizeof(l_state));
-  /* form the global state string */
-  strcpy(l_state, p_app_name);
-  strcat(l_state, " ");
-  strcat(l_state, l_ls_state);
-  strcat(l_state, " ");
-  strcat(l_state, l_as_state);
-  strcat(l_state, " ");
-  strcat(l_state, l_ss_state);
+  free(l_path);
+  return l_ret;
+}
+
+/* Function responsible to get the load, active and sub state of a unit, without the main pid */
+int AlGetUnitRunState(DBusConnection * p_bus, const char *p_unit, AlUnitState * p_state)
+{
+  return AlQueryUnitState(p_bus, p_unit, p_state, UNIT_STATE_RUN);
+}
+
+/* Function responsible to get the state of a unit, the main pid included for services */
+int AlGetUnitState(DBusConnection * p_bus, const char *p_unit, AlUnitState * p_state)
+{
+  return AlQueryUnitState(p_bus, p_unit, p_state,
+                          UNIT_STATE_RUN | (g_str_has_suffix(p_unit, ".service") ? UNIT_STATE_MAIN_PID : 0));
+}
 
+/* 
+ * Function responsible to extract the status of an application after starting it or that is already running in the system. 
+ * This refers to extracting : Load State, Active State and Sub State.
+ */
+
+int AlGetAppState(DBusConnection * p_bus, char *p_app_name,
+		  char *p_state_info)
+{
+  /* state of the unit, the main pid is not needed */
+  AlUnitState l_state;
+  if (AlGetUnitRunState(p_bus, p_app_name, &l_state) != 0)
+    return -1;
+  /* form the global state string */
+  snprintf(p_state_info, DIM_MAX, "%s %s %s %s", p_app_name, l_state.load_state,
+           l_state.active_state, l_state.sub_state);
   log_debug_message
       ("State Extractor : State information for %s is given by next string [ %s ] \n",
-       p_app_name, l_state);
-  /* copy into return variable */
-  strcpy(p_state_info, l_state);
+       p_app_name, p_state_info);
+  return 0;
+}
+
+/* Function responsible to turn the legacy GlobalStateNotification string signal on or off */
+void AlSetLegacyStateSignal(bool p_enabled)
+{
+  g_legacy_state_signal = p_enabled;
+}
+
+/* Function responsible to get the application name of a unit : the unit name without its suffix, or the application of a RunAs unit */
+static void AlAppNameFromUnit(const char *p_unit, char *p_app_name, size_t p_size)
+{
+  /* the transient units of RunAs carry the credentials in their name */
+  char l_app_name[AL_UNIT_NAME_MAX];
+  if (RunAsUnitParse(p_unit, l_app_name, NULL, NULL)) {
+    g_strlcpy(p_app_name, l_app_name, p_size);
+    return;
+  }
+  g_strlcpy(p_app_name, p_unit, p_size);
+  p_app_name[strcspn(p_app_name, ".")] = '\0';
+}
+
+/* Function responsible to emit TaskStateChanged, and GlobalStateNotification unless turned off */
+static void AlEmitTaskState(const AlUnitState *p_state)
+{
+  /* application name */
+  char l_app_name[DIM_MAX];
+  /* global state info */
+  char l_state_info[DIM_MAX];
+  /* time of the notification */
+  struct timespec l_ts;
+  AlAppNameFromUnit(p_state->name, l_app_name, sizeof(l_app_name));
+  clock_gettime(CLOCK_MONOTONIC, &l_ts);
+  /* notify clients about tasks state changes */
+  al_dbus_task_state_changed(g_al_dbus, (gchar *)p_state->name, l_app_name, p_state->load, p_state->active,
+                             p_state->sub, (gint)p_state->main_pid, p_state->foreground,
+                             (guint64)l_ts.tv_sec * 1000000ULL + l_ts.tv_nsec / 1000);
+  if (!g_legacy_state_signal)
+    return;
+  snprintf(l_state_info, sizeof(l_state_info), "%s %s %s %s", p_state->name, p_state->load_state,
+           p_state->active_state, p_state->sub_state);
+  al_dbus_global_state_notification(g_al_dbus, l_state_info);
+}
+
+/* Function responsible to emit TaskStarted or TaskStopped for a stable run state */
+static void AlEmitTaskSignal(const AlUnitState *p_state)
+{
+  /* application name */
+  char l_app_name[DIM_MAX];
+  /* application pid, kept by systemd after the process exited */
+  int l_pid = (int)p_state->main_pid;
+  AlAppNameFromUnit(p_state->name, l_app_name, sizeof(l_app_name));
 
   log_debug_message
-      ("State Extractor : State information for %s was extracted ! Returning to notifier function !\n",
-       p_app_name);
+      ("Send Active State Notification : Application state is %s %s %s %s \n",
+       p_state->name, p_state->load_state, p_state->active_state, p_state->sub_state);
 
-free_res:
-  /* free the messages */
-  if (l_msg)
-    dbus_message_unref(l_msg);
+  /* test if application was started and signal this event */
+  if (p_state->active == AL_ACTIVE_ACTIVE) {
+    /* emit signal */
+    al_dbus_task_started(g_al_dbus, l_pid, l_app_name);
+  }
 
-  if (l_reply)
-    dbus_message_unref(l_reply);
-  /* free the error */
-  dbus_error_free(&l_error);
+  /* test if application was stopped and became inactive and signal this event;
+     skip it when the exit was already signalled from the application pidfd */
+  if ((p_state->active == AL_ACTIVE_INACTIVE) && AppHandleClaimExit(p_state->name, l_pid)) {
+    /* emit signal */
+    al_dbus_task_stopped(g_al_dbus, l_pid, l_app_name);
+  }
 
-  return l_ret;
+  /* test if application failed and stopped and signal this event */
+  if ((p_state->active == AL_ACTIVE_FAILED) && AppHandleClaimExit(p_state->name, l_pid)) {
+     /* emit signal */
+    al_dbus_task_stopped(g_al_dbus, l_pid, l_app_name);
+  }
+
+  /* transitional states (activating, deactivating, reloading) are signalled once stable */
+  if ((p_state->active == AL_ACTIVE_ACTIVATING) || (p_state->active == AL_ACTIVE_DEACTIVATING)
+      || (p_state->active == AL_ACTIVE_RELOADING)) {
+    log_debug_message
+	("Send Active State Notification : The application %s is in %s state, the new state will be fetched after entering a stable state!\n",
+	 l_app_name, p_state->active_state);
+  }
+}
+
+/* state last notified for a unit */
+typedef struct AlEmittedState
+{
+  AlLoadState load;
+  AlActiveState active;
+  AlSubState sub;
+  bool foreground;
+} AlEmittedState;
+
+/* unit name -> AlEmittedState, used by the signal dispatcher thread only */
+static GHashTable *g_emitted_states = NULL;
+/* protects the counters */
+static pthread_mutex_t g_notifier_lock = PTHREAD_MUTEX_INITIALIZER;
+/* counters */
+static unsigned long g_notify_signals = 0;
+static unsigned long g_notify_coalesced = 0;
+static unsigned long g_notify_duplicates = 0;
+static unsigned long g_notify_emitted = 0;
+
+/* notifications of a state change, handed from the signal dispatcher thread to the main loop */
+typedef struct AlNotifyEvent
+{
+  AlUnitState state;
+  /* TaskStarted/TaskStopped are sent too */
+  bool task_signal;
+} AlNotifyEvent;
+
+/* Function responsible to emit, on the main loop, the notifications posted by AlEmitNotifications */
+static void AlNotifyEventRun(const void *p_payload)
+{
+  /* copy of the event, the payload is not aligned */
+  AlNotifyEvent l_event;
+  memcpy(&l_event, p_payload, sizeof(l_event));
+  AlEmitTaskState(&l_event.state);
+  if (l_event.task_signal)
+    AlEmitTaskSignal(&l_event.state);
+}
+
+/*
+ * Function responsible to emit the notifications of a state change, only if the state
+ * differs from the one last notified for the unit; TaskStarted/TaskStopped are only sent
+ * when the active state itself changed. The signals are emitted by the main loop, which
+ * owns the daemon object.
+ */
+static void AlEmitNotifications(const AlUnitState *p_state)
+{
+  /* event handed to the main loop */
+  AlNotifyEvent l_event;
+  /* state last notified */
+  AlEmittedState *l_last;
+  /* the active state changed */
+  bool l_active_changed;
+  if (!g_emitted_states)
+    g_emitted_states = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  if ((l_last = g_hash_table_lookup(g_emitted_states, p_state->name)) != NULL
+      && l_last->load == p_state->load && l_last->active == p_state->active && l_last->sub == p_state->sub
+      && l_last->foreground == p_state->foreground) {
+    pthread_mutex_lock(&g_notifier_lock);
+    g_notify_duplicates++;
+    pthread_mutex_unlock(&g_notifier_lock);
+    return;
+  }
+  if (!l_last) {
+    l_last = g_new0(AlEmittedState, 1);
+    g_hash_table_insert(g_emitted_states, g_strdup(p_state->name), l_last);
+    l_active_changed = true;
+  } else {
+    l_active_changed = (l_last->active != p_state->active);
+  }
+  l_last->load = p_state->load;
+  l_last->active = p_state->active;
+  l_last->sub = p_state->sub;
+  l_last->foreground = p_state->foreground;
+  pthread_mutex_lock(&g_notifier_lock);
+  g_notify_emitted++;
+  pthread_mutex_unlock(&g_notifier_lock);
+  l_event.state = *p_state;
+  l_event.task_signal = l_active_changed;
+  if (EventQueuePost(AlNotifyEventRun, &l_event, sizeof(l_event)) < 0) {
+    log_error_message("Notifier : Cannot hand the state of %s to the main loop, the notification is lost !\n",
+                      p_state->name);
+    /* notified again on its next change */
+    g_hash_table_remove(g_emitted_states, p_state->name);
+  }
 }
 
 /* 
  * Function responsible to broadcast the state of an application that started execution
- * or an application already running in the system. 
+ * or an application already running in the system : TaskStateChanged carries the typed
+ * state, GlobalStateNotification the "<unit> <load> <active> <sub>" string of the
+ * former clients unless it is turned off.
  */
 
 void AlAppStateNotifier(DBusConnection *p_conn, char *p_app_name)
 {
+  /* state of the unit */
+  AlUnitState l_state;
 
-  /* message to be sent */
-  DBusMessage *l_msg;
-  /* message arguments */
-  DBusMessageIter l_args;
-  /* return code */
-  int l_ret;
-  /* reply information */
-  dbus_uint32_t l_serial = 0;
-  /* global state info */
-  char l_state_info[DIM_MAX];
-  char *l_app_status;
-
-  log_debug_message
-      ("Send Notification : Sending signal with value %s\n",
-       p_app_name);
-
-  /* extract the information to broadcast */
   log_debug_message
       ("Send Notification : Getting application state for %s \n",
        p_app_name);
 
-
-  /* extract the application state  */
-  if (AlGetAppState(p_conn, p_app_name, l_state_info) == 0) {
-    /* notify clients about tasks global state changes */
-    al_dbus_global_state_notification(g_al_dbus, l_state_info);
-  }
+  /* extract the application state */
+  if (AlGetUnitState(p_conn, p_app_name, &l_state) != 0)
+    return;
+  AlEmitTaskState(&l_state);
 }
 
 /* Connect to the DBUS bus and send a broadcast signal about the state of the application */
 void AlSendAppSignal(DBusConnection * p_conn, char *p_app_name)
 {
-  /* message to be sent */
-  DBusMessage *l_msg, *l_reply;
-  /* message arguments */
-  DBusMessageIter l_args;
-  /* error */
-  DBusError l_err;
-  /* return code */
-  int l_ret;
-  /* reply information */
-  dbus_uint32_t l_serial = 0;
-  /* global state info */
-  char l_state_info[DIM_MAX];
-  char *l_app_status;
-  /* application start/stop auxiliary vars : active state, sub state, app name, 
-     global state, service name, message to send */
-  char *l_active_state = malloc(DIM_MAX * sizeof(l_active_state));
-  char *l_sub_state = malloc(DIM_MAX * sizeof(l_sub_state));
-  char *l_app_name = malloc(DIM_MAX * sizeof(l_app_name));
-  char *l_service_name = malloc(DIM_MAX * sizeof(l_service_name));
-  char *l_state_msg = malloc(DIM_MAX * sizeof(l_state_msg));
-  /* delimiters for service / application name extraction */
-  char l_delim_serv[] = " ";
-  char l_delim_app[] = ".";
-  /* application pid */
-  int l_pid;
-  char l_pid_string[DIM_MAX];
-  /* initialize the path */
-  char *l_path = NULL;
-  /* message iterators for pid extraction */
-  DBusMessageIter l_iter, l_sub_iter;
-
-  /* interface and method to acces application pid */
-  const char *l_interface =
-      "org.freedesktop.systemd1.Service", *l_pid_property = "ExecMainPID";
+  /* state of the unit, the main pid is kept by systemd after the process exited */
+  AlUnitState l_state;
 
   log_debug_message
-      ("Send Active State Notification : Sending signal for  %s\n",
+      ("Send Active State Notification : Getting application state for %s \n",
        p_app_name);
 
-  /* initialise the error value */
-  dbus_error_init(&l_err);
+  /* extract the application state and the pid in one go */
+  if (AlGetUnitState(p_conn, p_app_name, &l_state) != 0)
+    return;
+  AlEmitTaskSignal(&l_state);
+}
 
-  /* extract the information to broadcast */
-  log_debug_message
-      ("Send Active State Notification : Getting application state for %s \n",
-       p_app_name);
+/*
+ * The signal dispatcher must not wait for systemd : when a state change needs properties
+ * the unit state cache does not know (typically the main pid of a service primed from
+ * ListUnits), the GetAll calls are sent as pending calls with a bounded timeout and the
+ * notification is emitted from their completion. The changes of the same unit arriving
+ * meanwhile are queued behind the fetch, so the notifications of a unit keep their order
+ * while the other units are notified at once.
+ */
 
-  /* extract the PID for the application that will be stopped because it won't be available in /proc anymore */
+/* notification waiting for the state fetch of its unit */
+typedef struct AlQueuedNotification
+{
+  /* run state reported by the signal, without the fetched properties if not known */
+  AlUnitState state;
+  bool has_state;
+} AlQueuedNotification;
 
-  /* get unit object path */
-  if (NULL == (l_path = GetUnitObjectPath(p_conn, p_app_name)))
-  {
-          log_error_message
-                  ("Send Active State Notification : Unable to extract object path for %s", p_app_name);
-          l_ret = -1;
-          goto free_res;
+/* state fetch in flight for a unit */
+typedef struct AlStateFetch
+{
+  /* fetched state and its decoded properties */
+  AlUnitState state;
+  int known;
+  /* GetAll calls of the Unit and Service interfaces */
+  DBusPendingCall *pending[2];
+  int outstanding;
+  /* the Unit properties could not be fetched */
+  bool failed;
+  /* notifications waiting for the fetch, AlQueuedNotification */
+  GQueue *queue;
+} AlStateFetch;
+
+/* unit name -> AlStateFetch, used by the signal dispatcher thread only */
+static GHashTable *g_state_fetches = NULL;
+/* counters */
+static unsigned long g_notify_direct = 0;
+static unsigned long g_notify_fetched = 0;
+static unsigned long g_notify_queued = 0;
+static unsigned long g_notify_failures = 0;
+static unsigned long g_notify_max_in_flight = 0;
+static unsigned long g_notify_resyncs = 0;
+static unsigned long g_notify_resynced = 0;
+
+/* Function responsible to queue a notification behind the fetch of its unit */
+static void AlStateFetchQueue(AlStateFetch *p_fetch, const char *p_unit)
+{
+  /* queued notification */
+  AlQueuedNotification *l_item = g_new0(AlQueuedNotification, 1);
+  l_item->has_state = (UnitStateLookup(p_unit, &l_item->state, UNIT_STATE_RUN) == 0);
+  g_queue_push_tail(p_fetch->queue, l_item);
+}
+
+/* Function responsible to emit the notifications queued behind a completed fetch and release it */
+static void AlStateFetchComplete(const char *p_unit, AlStateFetch *p_fetch)
+{
+  /* queued notification */
+  AlQueuedNotification *l_item;
+  /* count of the emitted and dropped notifications */
+  unsigned long l_count = 0;
+  unsigned long l_dropped = 0;
+  if (!p_fetch->failed)
+    UnitStateStore(&p_fetch->state, p_fetch->known);
+  while ((l_item = g_queue_pop_head(p_fetch->queue)) != NULL) {
+    if (!p_fetch->failed) {
+      /* the run state of the signal, completed with the fetched properties */
+      if (!l_item->has_state)
+        l_item->state = p_fetch->state;
+      l_item->state.main_pid = p_fetch->state.main_pid;
+      l_item->state.has_main_pid = p_fetch->state.has_main_pid;
+    } else if (l_item->has_state) {
+      /* the run state of the signal is still worth sending, without a pid */
+      l_item->state.main_pid = 0;
+      l_item->state.has_main_pid = false;
+    } else {
+      l_dropped++;
+      g_free(l_item);
+      continue;
+    }
+    AlEmitNotifications(&l_item->state);
+    l_count++;
+    g_free(l_item);
   }
-  log_debug_message
-          ("Send Active State Notification : Extracted object path for %s\n",
-           p_app_name);
-
-  /* issue a new method call to extract properties for the unit */
-  if (!(l_msg = dbus_message_new_method_call("org.freedesktop.systemd1",
-					     l_path,
-					     "org.freedesktop.DBus.Properties",
-					     "Get"))) {
-    log_error_message
-	("Send Active State Notification : Could not allocate message for %s \n",
-	 p_app_name);
-    l_ret = -ENOMEM;
-    goto free_res;
+  if (p_fetch->failed)
+    log_error_message("Send Notification : Failed to fetch the state of %s, %lu notifications sent without pid, %lu dropped\n",
+                      p_unit, l_count, l_dropped);
+  pthread_mutex_lock(&g_notifier_lock);
+  g_notify_fetched += l_count;
+  if (p_fetch->failed)
+    g_notify_failures++;
+  pthread_mutex_unlock(&g_notifier_lock);
+  g_queue_free(p_fetch->queue);
+  /* releases the fetch and the unit name */
+  g_hash_table_remove(g_state_fetches, p_unit);
+}
+
+/* Function responsible to handle the reply, error or timeout of a GetAll pending call */
+static void AlStateFetchReply(DBusPendingCall *p_pending, void *p_data)
+{
+  /* name of the unit, the key of the fetch */
+  const char *l_unit = (const char *)p_data;
+  /* fetch in flight */
+  AlStateFetch *l_fetch = g_state_fetches ? g_hash_table_lookup(g_state_fetches, l_unit) : NULL;
+  /* reply, error or timeout */
+  DBusMessage *l_reply;
+  /* decoded properties */
+  int l_decoded;
+  if (!l_fetch)
+    return;
+  l_reply = dbus_pending_call_steal_reply(p_pending);
+  l_decoded = l_reply ? AlUnitStateDecode(l_reply, &l_fetch->state) : -1;
+  if (l_decoded >= 0)
+    l_fetch->known |= l_decoded;
+  /* the unit properties are mandatory, the service ones only exist for services */
+  else if (p_pending == l_fetch->pending[0])
+    l_fetch->failed = true;
+  if (l_reply)
+    dbus_message_unref(l_reply);
+  if (--l_fetch->outstanding == 0)
+    AlStateFetchComplete(l_unit, l_fetch);
+}
+
+/* cache value destructor */
+static void AlStateFetchFree(gpointer p_fetch)
+{
+  /* fetch to release */
+  AlStateFetch *l_fetch = (AlStateFetch *)p_fetch;
+  int l_i;
+  for (l_i = 0; l_i < 2; l_i++)
+    if (l_fetch->pending[l_i])
+      dbus_pending_call_unref(l_fetch->pending[l_i]);
+  g_free(l_fetch);
+}
+
+/* Function responsible to send the GetAll calls of a fetch; returns 0 if at least the Unit one is in flight */
+static int AlStateFetchStart(DBusConnection *p_conn, const char *p_unit, AlStateFetch *p_fetch)
+{
+  /* GetAll calls for the Unit and Service interfaces */
+  const char *l_interfaces[2] = { "org.freedesktop.systemd1.Unit", "org.freedesktop.systemd1.Service" };
+  DBusMessage *l_msg;
+  /* unit object path */
+  char *l_path;
+  /* key of the fetch, passed to the completion */
+  gpointer l_key = NULL;
+  int l_i;
+  if (!g_hash_table_lookup_extended(g_state_fetches, p_unit, &l_key, NULL)
+      || !(l_path = GetUnitObjectPath(p_conn, (char *)p_unit)))
+    return -1;
+  for (l_i = 0; l_i < 2; l_i++) {
+    if (!(l_msg = AlUnitGetAll(l_path, l_interfaces[l_i])))
+      break;
+    if (!dbus_connection_send_with_reply(p_conn, l_msg, &p_fetch->pending[l_i], SYSTEMD_UNIT_INFO_TIMEOUT)
+        || !p_fetch->pending[l_i]) {
+      dbus_message_unref(l_msg);
+      break;
+    }
+    dbus_message_unref(l_msg);
+    /* counted first, the reply may already be there */
+    p_fetch->outstanding++;
+    if (!dbus_pending_call_set_notify(p_fetch->pending[l_i], AlStateFetchReply, l_key, NULL)) {
+      p_fetch->outstanding--;
+      dbus_pending_call_cancel(p_fetch->pending[l_i]);
+      break;
+    }
   }
-  /* append the arguments; the main pid will be needed */
-  if (!dbus_message_append_args(l_msg,
-				DBUS_TYPE_STRING, &l_interface,
-				DBUS_TYPE_STRING, &l_pid_property,
-				DBUS_TYPE_INVALID)) {
-    log_error_message
-	("Send Active State Notification : Could not append arguments to message for %s \n",
-	 p_app_name);
-    l_ret = -ENOMEM;
-    goto free_res;
+  free(l_path);
+  return (l_i == 0) ? -1 : 0;
+}
+
+/* Function responsible to notify the state of a unit without waiting for systemd */
+static void AlNotifyDispatch(DBusConnection *p_conn, const char *p_unit)
+{
+  /* cached state */
+  AlUnitState l_state;
+  /* fetch in flight for the unit */
+  AlStateFetch *l_fetch;
+  /* properties the notifications need */
+  int l_needed = UNIT_STATE_RUN | (g_str_has_suffix(p_unit, ".service") ? UNIT_STATE_MAIN_PID : 0);
+  if (!g_state_fetches)
+    g_state_fetches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, AlStateFetchFree);
+  /* keep the order of the notifications of a unit */
+  if ((l_fetch = g_hash_table_lookup(g_state_fetches, p_unit)) != NULL) {
+    AlStateFetchQueue(l_fetch, p_unit);
+    pthread_mutex_lock(&g_notifier_lock);
+    g_notify_queued++;
+    pthread_mutex_unlock(&g_notifier_lock);
+    return;
   }
-  /* send the message over the systemd bus and wait for a reply */
-  if (!(l_reply =
-	dbus_connection_send_with_reply_and_block(p_conn, l_msg, -1,
-						  &l_err))) {
-    log_error_message
-	("Send Active State Notification : Failed to issue method call for %s\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
+  if (UnitStateLookup(p_unit, &l_state, l_needed) == 0) {
+    AlEmitNotifications(&l_state);
+    pthread_mutex_lock(&g_notifier_lock);
+    g_notify_direct++;
+    pthread_mutex_unlock(&g_notifier_lock);
+    return;
   }
-  /* parse reply and extract arguments */
-  if (!dbus_message_iter_init(l_reply, &l_iter) ||
-      dbus_message_iter_get_arg_type(&l_iter) != DBUS_TYPE_VARIANT) {
-    log_error_message
-	("Send Active State Notification : Failed to parse reply for %s\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
+  l_fetch = g_new0(AlStateFetch, 1);
+  g_strlcpy(l_fetch->state.name, p_unit, sizeof(l_fetch->state.name));
+  l_fetch->queue = g_queue_new();
+  AlStateFetchQueue(l_fetch, p_unit);
+  g_hash_table_insert(g_state_fetches, g_strdup(p_unit), l_fetch);
+  /* held while the calls are sent, a completion must not release the fetch before */
+  l_fetch->outstanding = 1;
+  if (AlStateFetchStart(p_conn, p_unit, l_fetch) != 0) {
+    log_error_message("Send Notification : Could not issue GetAll for %s \n", p_unit);
+    l_fetch->failed = true;
   }
-  /* sub iterator for reply  */
-  dbus_message_iter_recurse(&l_iter, &l_sub_iter);
-  /* argument type check */
-  if (dbus_message_iter_get_arg_type(&l_sub_iter) != DBUS_TYPE_UINT32) {
-    log_error_message
-	("Send Active State Notification : Failed to get arg type for %s when fetching pid!\n",
-	 p_app_name);
-    l_ret = -EIO;
-    goto free_res;
+  if (--l_fetch->outstanding == 0) {
+    AlStateFetchComplete(p_unit, l_fetch);
+    return;
   }
-  /* extract the argument as a basic type */
-  dbus_message_iter_get_basic(&l_sub_iter, &l_pid);
-
-  /* unreference the message */
-  dbus_message_unref(l_msg);
-
-  /* extract the application state  */
-  if (AlGetAppState(p_conn, p_app_name, l_state_info) == 0) {
+  pthread_mutex_lock(&g_notifier_lock);
+  if (g_hash_table_size(g_state_fetches) > g_notify_max_in_flight)
+    g_notify_max_in_flight = g_hash_table_size(g_state_fetches);
+  pthread_mutex_unlock(&g_notifier_lock);
+}
 
-    log_debug_message
-	("Send Active State Notification : Received application state for %s \n",
-	 p_app_name);
+/*
+ * systemd sends several PropertiesChanged signals per transition (Service then Unit
+ * interface, activating then active, ...). The first signal of a unit opens a window of
+ * g_notify_window_ms; the signals of the unit received before it closes are folded into
+ * it and the state is notified once, when the dispatcher loop flushes the window.
+ */
 
-    /* copy the state */
-    l_app_status = strdup(l_state_info);
+/* coalescing window of the state notifications, in ms (0 notifies every signal at once) */
+static unsigned int g_notify_window_ms = AL_NOTIFY_WINDOW_MS;
+/* unit name -> deadline of its window (CLOCK_MONOTONIC, us), used by the signal dispatcher thread only */
+static GHashTable *g_notify_windows = NULL;
 
-    log_debug_message
-	("Send Active State Notification : Global State information for %s -> [ %s ] \n",
-	 p_app_name, l_app_status);
+/* Function responsible to return a monotonic timestamp in microseconds */
+static unsigned long long AlNotifyNow()
+{
+  /* current time */
+  struct timespec l_ts;
+  clock_gettime(CLOCK_MONOTONIC, &l_ts);
+  return (unsigned long long)l_ts.tv_sec * 1000000ULL + l_ts.tv_nsec / 1000;
+}
 
-    log_debug_message
-	("Send Active State Notification : Application state is %s \n",
-	 l_app_status);
-
-    /* service name extraction from global state info */
-    l_service_name = strtok(l_app_status, l_delim_serv);
-    /* active state extraaction from global state info */
-    l_active_state = strtok(NULL, l_delim_serv);
-    l_active_state = strtok(NULL, l_delim_serv);
-    l_app_name = strtok(l_service_name, l_delim_app);
-
-    /* test if application was started and signal this event */
-    if (strcmp(l_active_state, "active") == 0) {
-      /* emit signal */
-      al_dbus_task_started(g_al_dbus, l_pid, l_app_name);
-    }
+/* Function responsible to set the coalescing window of the state notifications */
+void AlSetNotifyWindow(unsigned int p_window_ms)
+{
+  g_notify_window_ms = p_window_ms;
+}
 
-    /* test if application was stopped and became inactive and signal this event */
-    if (strcmp(l_active_state, "inactive") == 0) {
-      /* emit signal */
-      al_dbus_task_stopped(g_al_dbus, l_pid, l_app_name);
-    }
+/* Function responsible to notify a state change of a unit, once per window */
+void AlNotifyUnitState(DBusConnection *p_conn, const char *p_unit)
+{
+  /* deadline of the window */
+  unsigned long long *l_deadline;
+  pthread_mutex_lock(&g_notifier_lock);
+  g_notify_signals++;
+  pthread_mutex_unlock(&g_notifier_lock);
+  if (g_notify_window_ms == 0) {
+    AlNotifyDispatch(p_conn, p_unit);
+    return;
+  }
+  if (!g_notify_windows)
+    g_notify_windows = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  if (g_hash_table_lookup(g_notify_windows, p_unit)) {
+    pthread_mutex_lock(&g_notifier_lock);
+    g_notify_coalesced++;
+    pthread_mutex_unlock(&g_notifier_lock);
+    return;
+  }
+  l_deadline = g_new(unsigned long long, 1);
+  *l_deadline = AlNotifyNow() + g_notify_window_ms * 1000ULL;
+  g_hash_table_insert(g_notify_windows, g_strdup(p_unit), l_deadline);
+}
 
-    /* test if application failed and stopped and signal this event */
-    if (strcmp(l_active_state, "failed") == 0) {
-       /* emit signal */
-      al_dbus_task_stopped(g_al_dbus, l_pid, l_app_name);
-    }
+/* Function responsible to get the time to wait for the next window to close, in ms (-1 if none is open) */
+int AlNotifyTimeout()
+{
+  /* window iterator */
+  GHashTableIter l_iter;
+  gpointer l_key, l_value;
+  /* earliest deadline */
+  unsigned long long l_next = 0, l_now;
+  if (!g_notify_windows || g_hash_table_size(g_notify_windows) == 0)
+    return -1;
+  g_hash_table_iter_init(&l_iter, g_notify_windows);
+  while (g_hash_table_iter_next(&l_iter, &l_key, &l_value))
+    if (l_next == 0 || *(unsigned long long *)l_value < l_next)
+      l_next = *(unsigned long long *)l_value;
+  l_now = AlNotifyNow();
+  /* rounded up, waking up before the deadline would spin */
+  return (l_next <= l_now) ? 0 : (int)((l_next - l_now + 999) / 1000);
+}
 
-    /* test if application is in a transitional state to activation */
-    if (strcmp(l_active_state, "activating") == 0) {
-      /* the task is in a transitional state to active */
-      log_debug_message
-	  ("Send Active State Notification : The application %s is in %s state and will be activated !",
-	   l_app_name, l_active_state);
-      log_debug_message
-	  ("Send Active State Notification : The new state for %s will be fetched after entering a stable state!",
-	   l_app_name);
-      return;
-    }
+/* Function responsible to notify the units whose window closed */
+void AlNotifyFlush(DBusConnection *p_conn)
+{
+  /* window iterator */
+  GHashTableIter l_iter;
+  gpointer l_key, l_value;
+  /* units whose window closed */
+  GPtrArray *l_due;
+  unsigned long long l_now;
+  guint l_i;
+  if (!g_notify_windows || g_hash_table_size(g_notify_windows) == 0)
+    return;
+  l_now = AlNotifyNow();
+  l_due = g_ptr_array_new_with_free_func(g_free);
+  g_hash_table_iter_init(&l_iter, g_notify_windows);
+  while (g_hash_table_iter_next(&l_iter, &l_key, &l_value)) {
+    if (*(unsigned long long *)l_value > l_now)
+      continue;
+    g_ptr_array_add(l_due, g_strdup((const char *)l_key));
+    g_hash_table_iter_remove(&l_iter);
+  }
+  /* notified once the table is consistent, a notification may open a new window */
+  for (l_i = 0; l_i < l_due->len; l_i++)
+    AlNotifyDispatch(p_conn, (const char *)g_ptr_array_index(l_due, l_i));
+  g_ptr_array_free(l_due, TRUE);
+}
 
-    /* test if application is in a transitional state to deactivation */
-    if (strcmp(l_active_state, "deactivating") == 0) {
-      /* the task is in a transitional state to active */
-      log_debug_message
-	  ("Send Active State Notification : The application %s is in %s state and will be deactivated !",
-	   l_app_name, l_active_state);
-      log_debug_message
-	  ("Send Active State Notification : The new state for %s will be fetched after entering a stable state!",
-	   l_app_name);
-       return;
+/*
+ * Function responsible to notify the transitions missed while the signals were not
+ * received : the fetches sent on the former connection are dropped, and every unit
+ * already notified whose run state differs from the one last notified, or is not
+ * known, is notified again through a window
+ */
+void AlNotifyResync(DBusConnection *p_conn)
+{
+  /* table iterator */
+  GHashTableIter l_iter;
+  gpointer l_key, l_value;
+  /* units to release or to notify */
+  GPtrArray *l_units;
+  /* fetch to drop */
+  AlStateFetch *l_fetch;
+  /* primed state */
+  AlUnitState l_state;
+  /* state last notified */
+  AlEmittedState *l_last;
+  guint l_i;
+  int l_j;
+  l_units = g_ptr_array_new_with_free_func(g_free);
+  if (g_state_fetches) {
+    g_hash_table_iter_init(&l_iter, g_state_fetches);
+    while (g_hash_table_iter_next(&l_iter, &l_key, &l_value))
+      g_ptr_array_add(l_units, g_strdup((const char *)l_key));
+    /* their replies will never come */
+    for (l_i = 0; l_i < l_units->len; l_i++) {
+      l_fetch = g_hash_table_lookup(g_state_fetches, g_ptr_array_index(l_units, l_i));
+      for (l_j = 0; l_j < 2; l_j++)
+        if (l_fetch->pending[l_j])
+          dbus_pending_call_cancel(l_fetch->pending[l_j]);
+      l_fetch->failed = true;
+      AlStateFetchComplete(g_ptr_array_index(l_units, l_i), l_fetch);
     }
-
-    /* test if application is in a transitional state to reload */
-    if (strcmp(l_active_state, "reloading") == 0) {
-      /* the task is in a transitional state to active */
-      log_debug_message
-	  ("Send Active State Notification : The application %s is in %s state and will be reloaded !",
-	   l_app_name, l_active_state);
-      log_debug_message
-	  ("Send Active State Notification : The new state for %s will be fetched after entering a stable state!",
-	   l_app_name);
-	return;
+    g_ptr_array_set_size(l_units, 0);
+  }
+  if (g_emitted_states) {
+    g_hash_table_iter_init(&l_iter, g_emitted_states);
+    while (g_hash_table_iter_next(&l_iter, &l_key, &l_value)) {
+      l_last = l_value;
+      if (UnitStateLookup(l_key, &l_state, UNIT_STATE_RUN) == 0 && l_state.load == l_last->load
+          && l_state.active == l_last->active && l_state.sub == l_last->sub)
+        continue;
+      g_ptr_array_add(l_units, g_strdup((const char *)l_key));
     }
   }
- 
-  return;
-
-free_res:
-  /* resources free */
-  if(l_active_state) free(l_active_state);
-  if(l_sub_state) free(l_sub_state);
-  if(l_app_name) free(l_app_name);
-  if(l_service_name) free(l_service_name);
-  if(l_state_msg) free(l_state_msg);
-  if(dbus_error_is_set(&l_err))
-    /* free the error */
-    dbus_error_free(&l_err);
-  /* free unit object path string */
-  if (NULL != l_path)
-          free(l_path);
-  return;
+  for (l_i = 0; l_i < l_units->len; l_i++)
+    AlNotifyUnitState(p_conn, g_ptr_array_index(l_units, l_i));
+  pthread_mutex_lock(&g_notifier_lock);
+  g_notify_resyncs++;
+  g_notify_resynced += l_units->len;
+  pthread_mutex_unlock(&g_notifier_lock);
+  if (l_units->len)
+    log_message("Notifier : %u units changed state while the signals were not received\n", l_units->len);
+  g_ptr_array_free(l_units, TRUE);
 }
 
+/* Function responsible to log the notifier counters */
+void AlNotifierLogCounters()
+{
+  pthread_mutex_lock(&g_notifier_lock);
+  log_message("Notifier : window_ms=%u signals=%lu coalesced=%lu duplicates=%lu emitted=%lu direct=%lu "
+              "fetched=%lu queued=%lu failed_fetches=%lu max_in_flight=%lu resyncs=%lu resynced=%lu\n",
+              g_notify_window_ms, g_notify_signals, g_notify_coalesced, g_notify_duplicates,
+              g_notify_emitted, g_notify_direct, g_notify_fetched, g_notify_queued, g_notify_failures,
+              g_notify_max_in_flight, g_notify_resyncs, g_notify_resynced);
+  pthread_mutex_unlock(&g_notifier_lock);
+}
@@ -0,0 +1,334 @@
+/*
+* pid_index.c, contains the implementation of the in-daemon application name to PID index
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * The index maps the binary name of every process (the basename of argv[0], the
+ * same key AppPidFromName() always used) to the PIDs running it. It is seeded once
+ * from /proc and then kept up to date from the fork/exec/exit notifications of the
+ * kernel proc connector, so lookups never walk /proc on the request path.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+#include "al-daemon.h"
+#include "utils.h"
+#include "pid_index.h"
+#include "procfs.h"
+
+/* size of the buffer used to receive proc connector notifications */
+#define PID_INDEX_RECV_SIZE 4096
+
+/* PID -> application name (owned) */
+static GHashTable *g_pid_to_name = NULL;
+/* application name (owned) -> GQueue of PIDs, oldest first */
+static GHashTable *g_name_to_pids = NULL;
+/* protects both tables; lookups may come from any thread */
+static pthread_mutex_t g_pid_index_lock = PTHREAD_MUTEX_INITIALIZER;
+/* netlink socket connected to the proc connector */
+static int g_pid_index_sock = -1;
+/* main loop watch for the netlink socket */
+static guint g_pid_index_watch = 0;
+
+/* Function responsible to drop a PID from the index; lock must be held */
+static void PidIndexRemoveLocked(pid_t p_pid)
+{
+  /* name registered for the pid */
+  char *l_name;
+  /* PIDs registered for the name */
+  GQueue *l_pids;
+  if (!(l_name = g_hash_table_lookup(g_pid_to_name, GINT_TO_POINTER(p_pid))))
+    return;
+  if ((l_pids = g_hash_table_lookup(g_name_to_pids, l_name)) != NULL) {
+    g_queue_remove(l_pids, GINT_TO_POINTER(p_pid));
+    if (g_queue_is_empty(l_pids))
+      g_hash_table_remove(g_name_to_pids, l_name);
+  }
+  g_hash_table_remove(g_pid_to_name, GINT_TO_POINTER(p_pid));
+}
+
+/* Function responsible to (re)register a PID under a name; lock must be held */
+static void PidIndexAddLocked(pid_t p_pid, const char *p_name)
+{
+  /* PIDs registered for the name */
+  GQueue *l_pids;
+  PidIndexRemoveLocked(p_pid);
+  if (!(l_pids = g_hash_table_lookup(g_name_to_pids, p_name))) {
+    l_pids = g_queue_new();
+    g_hash_table_insert(g_name_to_pids, g_strdup(p_name), l_pids);
+  }
+  g_queue_push_tail(l_pids, GINT_TO_POINTER(p_pid));
+  g_hash_table_insert(g_pid_to_name, GINT_TO_POINTER(p_pid), g_strdup(p_name));
+}
+
+/* Function responsible to release a PID queue stored in the index */
+static void PidIndexFreeQueue(gpointer p_queue)
+{
+  g_queue_free((GQueue *)p_queue);
+}
+
+/* ProcScan() callback adding one process to the index */
+static int PidIndexSeedOne(pid_t p_pid, const char *p_name, size_t p_name_len, void *p_data)
+{
+  /* NUL terminated binary name */
+  char l_name[DIM_MAX];
+  if (p_name_len >= DIM_MAX)
+    p_name_len = DIM_MAX - 1;
+  memcpy(l_name, p_name, p_name_len);
+  l_name[p_name_len] = '\0';
+  PidIndexAddLocked(p_pid, l_name);
+  return 0;
+}
+
+/* Function responsible to (re)build the index from a single walk of /proc */
+static int PidIndexSeed()
+{
+  /* record buffer for the walk */
+  ProcBuffer l_buf;
+  /* number of indexed processes */
+  int l_count;
+  ProcBufferInit(&l_buf);
+  pthread_mutex_lock(&g_pid_index_lock);
+  g_hash_table_remove_all(g_name_to_pids);
+  g_hash_table_remove_all(g_pid_to_name);
+  l_count = ProcScan(PidIndexSeedOne, NULL, &l_buf);
+  pthread_mutex_unlock(&g_pid_index_lock);
+  ProcBufferFree(&l_buf);
+  if (l_count < 0) {
+    log_error_message("PID Index : Cannot walk /proc for seeding !\n", 0);
+    return -1;
+  }
+  log_debug_message("PID Index : Seeded index with %d processes\n", l_count);
+  return 0;
+}
+
+/* Function responsible to apply one proc connector event to the index */
+static void PidIndexHandleEvent(struct proc_event *p_ev)
+{
+  /* extracted binary name */
+  char l_name[DIM_MAX];
+  /* parent name for forked children */
+  char *l_parent;
+  switch (p_ev->what) {
+  case PROC_EVENT_FORK:
+    /* only new processes, threads share the leader entry */
+    if (p_ev->event_data.fork.child_pid != p_ev->event_data.fork.child_tgid)
+      break;
+    /* until exec the child runs the parent image */
+    pthread_mutex_lock(&g_pid_index_lock);
+    if ((l_parent = g_hash_table_lookup(g_pid_to_name,
+                                        GINT_TO_POINTER(p_ev->event_data.fork.parent_tgid))) != NULL) {
+      strcpy(l_name, l_parent);
+      PidIndexAddLocked(p_ev->event_data.fork.child_tgid, l_name);
+    }
+    pthread_mutex_unlock(&g_pid_index_lock);
+    break;
+  case PROC_EVENT_EXEC:
+    if (AppBinaryNameFromPid(p_ev->event_data.exec.process_tgid, l_name)) {
+      pthread_mutex_lock(&g_pid_index_lock);
+      PidIndexAddLocked(p_ev->event_data.exec.process_tgid, l_name);
+      pthread_mutex_unlock(&g_pid_index_lock);
+    }
+    break;
+  case PROC_EVENT_EXIT:
+    if (p_ev->event_data.exit.process_pid != p_ev->event_data.exit.process_tgid)
+      break;
+    pthread_mutex_lock(&g_pid_index_lock);
+    PidIndexRemoveLocked(p_ev->event_data.exit.process_tgid);
+    pthread_mutex_unlock(&g_pid_index_lock);
+    break;
+  default:
+    break;
+  }
+}
+
+/* Main loop callback draining the proc connector socket */
+static gboolean PidIndexOnEvent(GIOChannel *p_source, GIOCondition p_cond, gpointer p_data)
+{
+  /* receive buffer */
+  char l_buf[PID_INDEX_RECV_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+  /* netlink header iterator */
+  struct nlmsghdr *l_hdr;
+  /* received length */
+  ssize_t l_len;
+  if (p_cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+    log_error_message("PID Index : Proc connector socket failed, falling back to /proc scans\n", 0);
+    /* the watch is destroyed by returning FALSE */
+    g_pid_index_watch = 0;
+    PidIndexTerminate();
+    return FALSE;
+  }
+  for (;;) {
+    l_len = recv(g_pid_index_sock, l_buf, sizeof(l_buf), MSG_DONTWAIT);
+    if (l_len < 0) {
+      if (errno == EINTR)
+        continue;
+      /* the kernel dropped events : the index cannot be trusted any more */
+      if (errno == ENOBUFS) {
+        log_error_message("PID Index : Proc connector overrun, reseeding the index\n", 0);
+        PidIndexSeed();
+        continue;
+      }
+      break;
+    }
+    if (l_len == 0)
+      break;
+    for (l_hdr = (struct nlmsghdr *)l_buf; NLMSG_OK(l_hdr, (size_t)l_len);
+         l_hdr = NLMSG_NEXT(l_hdr, l_len)) {
+      /* connector message */
+      struct cn_msg *l_cn;
+      if (l_hdr->nlmsg_type == NLMSG_NOOP || l_hdr->nlmsg_type == NLMSG_ERROR)
+        continue;
+      l_cn = (struct cn_msg *)NLMSG_DATA(l_hdr);
+      if (l_cn->id.idx != CN_IDX_PROC || l_cn->id.val != CN_VAL_PROC)
+        continue;
+      PidIndexHandleEvent((struct proc_event *)l_cn->data);
+    }
+  }
+  return TRUE;
+}
+
+/* Function responsible to subscribe/unsubscribe to the proc connector multicast group */
+static int PidIndexSetListen(int p_sock, enum proc_cn_mcast_op p_op)
+{
+  /* netlink message carrying the connector operation */
+  struct __attribute__((aligned(NLMSG_ALIGNTO))) {
+    struct nlmsghdr l_hdr;
+    struct __attribute__((__packed__)) {
+      struct cn_msg l_cn;
+      enum proc_cn_mcast_op l_op;
+    } l_body;
+  } l_msg;
+  memset(&l_msg, 0, sizeof(l_msg));
+  l_msg.l_hdr.nlmsg_len = sizeof(l_msg);
+  l_msg.l_hdr.nlmsg_pid = getpid();
+  l_msg.l_hdr.nlmsg_type = NLMSG_DONE;
+  l_msg.l_body.l_cn.id.idx = CN_IDX_PROC;
+  l_msg.l_body.l_cn.id.val = CN_VAL_PROC;
+  l_msg.l_body.l_cn.len = sizeof(enum proc_cn_mcast_op);
+  l_msg.l_body.l_op = p_op;
+  if (send(p_sock, &l_msg, sizeof(l_msg), 0) < 0)
+    return -1;
+  return 0;
+}
+
+/* Function responsible to seed the PID index from /proc and attach the proc connector to the main loop */
+int PidIndexInit()
+{
+  /* netlink address */
+  struct sockaddr_nl l_addr;
+  /* channel for the main loop watch */
+  GIOChannel *l_channel;
+  if (g_pid_index_sock >= 0)
+    return 0;
+  g_pid_to_name = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  g_name_to_pids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, PidIndexFreeQueue);
+  /* connect to the proc connector; requires CAP_NET_ADMIN */
+  if ((g_pid_index_sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR)) < 0) {
+    log_error_message("PID Index : Cannot open proc connector socket ! Err : %s\n",
+                      strerror(errno));
+    goto free_res;
+  }
+  memset(&l_addr, 0, sizeof(l_addr));
+  l_addr.nl_family = AF_NETLINK;
+  l_addr.nl_groups = CN_IDX_PROC;
+  l_addr.nl_pid = getpid();
+  if (bind(g_pid_index_sock, (struct sockaddr *)&l_addr, sizeof(l_addr)) < 0) {
+    log_error_message("PID Index : Cannot bind proc connector socket ! Err : %s\n",
+                      strerror(errno));
+    goto free_res;
+  }
+  /* subscribe before seeding so no process can slip between scan and events */
+  if (PidIndexSetListen(g_pid_index_sock, PROC_CN_MCAST_LISTEN) != 0) {
+    log_error_message("PID Index : Cannot subscribe to proc events ! Err : %s\n",
+                      strerror(errno));
+    goto free_res;
+  }
+  if (PidIndexSeed() != 0)
+    goto free_res;
+  /* dispatch the notifications from the main loop */
+  l_channel = g_io_channel_unix_new(g_pid_index_sock);
+  g_pid_index_watch = g_io_add_watch(l_channel, G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+                                     PidIndexOnEvent, NULL);
+  g_io_channel_unref(l_channel);
+  log_debug_message("PID Index : Proc connector index is active\n", 0);
+  return 0;
+
+free_res:
+  PidIndexTerminate();
+  return -1;
+}
+
+/* Function responsible to release the PID index and close the proc connector */
+void PidIndexTerminate()
+{
+  if (g_pid_index_watch) {
+    g_source_remove(g_pid_index_watch);
+    g_pid_index_watch = 0;
+  }
+  if (g_pid_index_sock >= 0) {
+    PidIndexSetListen(g_pid_index_sock, PROC_CN_MCAST_IGNORE);
+    close(g_pid_index_sock);
+    g_pid_index_sock = -1;
+  }
+  pthread_mutex_lock(&g_pid_index_lock);
+  if (g_name_to_pids) {
+    g_hash_table_destroy(g_name_to_pids);
+    g_name_to_pids = NULL;
+  }
+  if (g_pid_to_name) {
+    g_hash_table_destroy(g_pid_to_name);
+    g_pid_to_name = NULL;
+  }
+  pthread_mutex_unlock(&g_pid_index_lock);
+}
+
+/* Function responsible to test if the PID index is kept up to date by the proc connector */
+int PidIndexIsActive()
+{
+  return g_pid_index_watch != 0;
+}
+
+/* Function responsible to lookup the PID of an application in the index (0 if not found) */
+pid_t PidIndexLookup(char *p_app_name)
+{
+  /* PIDs registered for the name */
+  GQueue *l_pids;
+  /* found pid */
+  pid_t l_pid = 0;
+  pthread_mutex_lock(&g_pid_index_lock);
+  if (g_name_to_pids
+      && (l_pids = g_hash_table_lookup(g_name_to_pids, p_app_name)) != NULL)
+    l_pid = (pid_t)GPOINTER_TO_INT(g_queue_peek_head(l_pids));
+  pthread_mutex_unlock(&g_pid_index_lock);
+  return l_pid;
+}
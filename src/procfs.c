@@ -0,0 +1,280 @@
+/*
+* procfs.c, contains the implementation of the procfs record reader and parser
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * Records are read whole into a caller owned buffer that is reused between reads,
+ * and delimiters are located with memchr()/memrchr(), which glibc implements with
+ * vector instructions, instead of stdio, sscanf and per-character loops. The module
+ * only depends on libc so it can be benchmarked on its own (bench/procfs-bench.c).
+ */
+
+/* memrchr() */
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "al-log.h"
+#include "procfs.h"
+
+/* procfs root in use */
+static char g_proc_root[256] = PROC_DEFAULT_ROOT;
+
+/* Function responsible to set the procfs root used by the reader (NULL restores /proc) */
+void ProcSetRoot(const char *p_root)
+{
+  snprintf(g_proc_root, sizeof(g_proc_root), "%s", p_root ? p_root : PROC_DEFAULT_ROOT);
+}
+
+/* Function responsible to get the procfs root used by the reader */
+const char *ProcGetRoot()
+{
+  return g_proc_root;
+}
+
+/* Function responsible to initialize a reusable record buffer */
+void ProcBufferInit(ProcBuffer *p_buf)
+{
+  p_buf->data = NULL;
+  p_buf->size = 0;
+  p_buf->len = 0;
+}
+
+/* Function responsible to release a reusable record buffer */
+void ProcBufferFree(ProcBuffer *p_buf)
+{
+  free(p_buf->data);
+  ProcBufferInit(p_buf);
+}
+
+/* Function responsible to read a whole record from an open descriptor */
+static ssize_t ProcReadFd(int p_fd, ProcBuffer *p_buf)
+{
+  /* read length */
+  ssize_t l_len;
+  if (!p_buf->data) {
+    if (!(p_buf->data = malloc(PROC_RECORD_SIZE)))
+      return -1;
+    p_buf->size = PROC_RECORD_SIZE;
+  }
+  p_buf->len = 0;
+  for (;;) {
+    /* keep room for a terminating NUL */
+    l_len = read(p_fd, p_buf->data + p_buf->len, p_buf->size - p_buf->len - 1);
+    if (l_len < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    p_buf->len += l_len;
+    /* a short read means the whole record was returned */
+    if (l_len == 0 || p_buf->len < p_buf->size - 1)
+      break;
+    /* the record did not fit : grow and read the rest */
+    {
+      char *l_data = realloc(p_buf->data, p_buf->size * 2);
+      if (!l_data)
+        return -1;
+      p_buf->data = l_data;
+      p_buf->size *= 2;
+    }
+  }
+  p_buf->data[p_buf->len] = '\0';
+  return (ssize_t)p_buf->len;
+}
+
+/* Function responsible to read a record relative to an open procfs root */
+static ssize_t ProcReadRecordAt(int p_dirfd, const char *p_pid, const char *p_entry, ProcBuffer *p_buf)
+{
+  /* relative record path; the entry name comes from readdir() */
+  char l_path[NAME_MAX + 64];
+  /* file descriptor */
+  int l_fd;
+  /* read length */
+  ssize_t l_len;
+  snprintf(l_path, sizeof(l_path), "%s/%s", p_pid, p_entry);
+  if ((l_fd = openat(p_dirfd, l_path, O_RDONLY | O_CLOEXEC)) < 0)
+    return -1;
+  l_len = ProcReadFd(l_fd, p_buf);
+  close(l_fd);
+  return l_len;
+}
+
+/* Function responsible to read a whole /proc/<pid>/<entry> record, normally with a single read() */
+ssize_t ProcReadRecord(pid_t p_pid, const char *p_entry, ProcBuffer *p_buf)
+{
+  /* absolute record path */
+  char l_path[512];
+  /* file descriptor */
+  int l_fd;
+  /* read length */
+  ssize_t l_len;
+  snprintf(l_path, sizeof(l_path), "%s/%d/%s", g_proc_root, (int)p_pid, p_entry);
+  if ((l_fd = open(l_path, O_RDONLY | O_CLOEXEC)) < 0)
+    return -1;
+  l_len = ProcReadFd(l_fd, p_buf);
+  close(l_fd);
+  return l_len;
+}
+
+/* Function responsible to find the binary name (basename of the first token of argv[0]) in a cmdline record */
+int ProcCmdlineBinaryName(const char *p_rec, size_t p_len, const char **p_name, size_t *p_name_len)
+{
+  /* end of argv[0] and of its first token */
+  const char *l_end, *l_tok;
+  /* start of the basename */
+  const char *l_start;
+  if (p_len == 0)
+    return 0;
+  /* argv[0] ends at the first NUL */
+  if ((l_end = memchr(p_rec, '\0', p_len)) == NULL)
+    l_end = p_rec + p_len;
+  /* processes rewriting their title put blanks in argv[0] */
+  if ((l_tok = memchr(p_rec, ' ', l_end - p_rec)) != NULL)
+    l_end = l_tok;
+  if ((l_tok = memchr(p_rec, '\t', l_end - p_rec)) != NULL)
+    l_end = l_tok;
+  /* strip the directory */
+  l_start = memrchr(p_rec, '/', l_end - p_rec);
+  l_start = l_start ? l_start + 1 : p_rec;
+  if (l_start == l_end)
+    return 0;
+  *p_name = l_start;
+  *p_name_len = l_end - l_start;
+  return 1;
+}
+
+/* Function responsible to split a cmdline record into its NUL separated arguments; returns argc */
+int ProcCmdlineArgv(const char *p_rec, size_t p_len, const char **p_argv, size_t *p_argv_len, int p_max_args)
+{
+  /* argument cursor and end */
+  const char *l_cur = p_rec, *l_end = p_rec + p_len, *l_nul;
+  /* argument count */
+  int l_argc = 0;
+  while (l_cur < l_end && l_argc < p_max_args) {
+    if ((l_nul = memchr(l_cur, '\0', l_end - l_cur)) == NULL)
+      l_nul = l_end;
+    p_argv[l_argc] = l_cur;
+    p_argv_len[l_argc] = l_nul - l_cur;
+    l_argc++;
+    l_cur = l_nul + 1;
+  }
+  return l_argc;
+}
+
+/* Function responsible to parse the pid, comm, state, ppid and start time fields of a stat record */
+int ProcStatParse(const char *p_rec, size_t p_len, ProcStat *p_stat)
+{
+  /* comm delimiters; comm itself may contain parentheses */
+  const char *l_open, *l_close;
+  /* numeric field end */
+  char *l_next;
+  /* current field and its number */
+  const char *l_field;
+  int l_i;
+  if ((l_open = memchr(p_rec, '(', p_len)) == NULL
+      || (l_close = memrchr(p_rec, ')', p_len)) == NULL || l_close < l_open)
+    return 0;
+  /* " S ppid" must follow the comm */
+  if ((size_t)(l_close - p_rec) + 4 >= p_len)
+    return 0;
+  p_stat->pid = (pid_t)strtol(p_rec, NULL, 10);
+  p_stat->comm = l_open + 1;
+  p_stat->comm_len = l_close - l_open - 1;
+  p_stat->state = l_close[2];
+  p_stat->ppid = (pid_t)strtol(l_close + 4, &l_next, 10);
+  /* starttime is field 22, the state being field 3 */
+  p_stat->start_time = 0;
+  for (l_field = l_close + 2, l_i = 3; l_i < 22 && l_field; l_i++)
+    if ((l_field = memchr(l_field, ' ', p_rec + p_len - l_field)) != NULL)
+      l_field++;
+  if (l_field && l_field < p_rec + p_len)
+    p_stat->start_time = strtoull(l_field, NULL, 10);
+  return 1;
+}
+
+/* Function responsible to walk the process table, calling the callback with every binary name */
+int ProcScan(ProcScanFunc p_func, void *p_data, ProcBuffer *p_buf)
+{
+  /* procfs root */
+  DIR *l_dir;
+  /* current entry */
+  struct dirent *l_next;
+  /* binary name */
+  const char *l_name;
+  size_t l_name_len;
+  /* number of processes visited */
+  int l_count = 0;
+  if (!(l_dir = opendir(g_proc_root))) {
+    log_error_message("Procfs Reader : Cannot open %s ! Err : %s\n", g_proc_root, strerror(errno));
+    return -1;
+  }
+  while ((l_next = readdir(l_dir)) != NULL) {
+    if (l_next->d_name[0] < '0' || l_next->d_name[0] > '9')
+      continue;
+    /* kernel threads and vanished processes have no cmdline */
+    if (ProcReadRecordAt(dirfd(l_dir), l_next->d_name, "cmdline", p_buf) <= 0)
+      continue;
+    if (!ProcCmdlineBinaryName(p_buf->data, p_buf->len, &l_name, &l_name_len))
+      continue;
+    l_count++;
+    if (p_func((pid_t)strtol(l_next->d_name, NULL, 10), l_name, l_name_len, p_data))
+      break;
+  }
+  closedir(l_dir);
+  return l_count;
+}
+
+/* lookup state for ProcScanPidByName() */
+typedef struct
+{
+  const char *name;
+  size_t name_len;
+  pid_t pid;
+} ProcNameLookup;
+
+/* ProcScan() callback matching one binary name */
+static int ProcMatchName(pid_t p_pid, const char *p_name, size_t p_name_len, void *p_data)
+{
+  ProcNameLookup *l_lookup = (ProcNameLookup *)p_data;
+  if (p_name_len != l_lookup->name_len || memcmp(p_name, l_lookup->name, p_name_len) != 0)
+    return 0;
+  l_lookup->pid = p_pid;
+  return 1;
+}
+
+/* Function responsible to find the first process running a binary */
+pid_t ProcScanPidByName(const char *p_name, ProcBuffer *p_buf)
+{
+  /* lookup state */
+  ProcNameLookup l_lookup;
+  l_lookup.name = p_name;
+  l_lookup.name_len = strlen(p_name);
+  l_lookup.pid = 0;
+  ProcScan(ProcMatchName, &l_lookup, p_buf);
+  return l_lookup.pid;
+}
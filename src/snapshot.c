@@ -0,0 +1,229 @@
+/*
+* snapshot.c, contains the implementation of the request scoped process table and unit snapshot
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * A snapshot is created at the start of a method call and passed down the Run,
+ * RunAs, Stop and Restart paths. Every PID, name and unit type lookup made during
+ * the call is resolved once and then served from the snapshot; when neither the
+ * unit cgroup nor the PID index can answer, /proc is walked once for all the
+ * lookups of the call (and once more only to find a process the call launched).
+ */
+
+#include <errno.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "al-daemon.h"
+#include "utils.h"
+#include "pid_index.h"
+#include "snapshot.h"
+#include "procfs.h"
+#include "unit_desc.h"
+
+/* global counters over all the requests */
+static unsigned long g_snapshot_requests = 0;
+static unsigned long g_snapshot_pid_lookups = 0;
+static unsigned long g_snapshot_unit_lookups = 0;
+static unsigned long g_snapshot_proc_scans = 0;
+static unsigned long g_snapshot_unit_probes = 0;
+static unsigned int g_snapshot_max_scans = 0;
+
+/* snapshot value destructor for the unit descriptors (NULL marks an unknown application) */
+static void SnapshotDropDesc(gpointer p_desc)
+{
+  if (p_desc)
+    UnitDescUnref((AlUnitDesc *)p_desc);
+}
+
+/* Function responsible to create the snapshot for a method call */
+AlSnapshot *SnapshotNew(const char *p_label)
+{
+  AlSnapshot *l_snap = calloc(1, sizeof(AlSnapshot));
+  l_snap->label = p_label;
+  l_snap->pids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  l_snap->names = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  l_snap->descs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, SnapshotDropDesc);
+  return l_snap;
+}
+
+/* Function responsible to release the snapshot and account its counters */
+void SnapshotFree(AlSnapshot *p_snap)
+{
+  if (!p_snap)
+    return;
+  g_snapshot_requests++;
+  if (p_snap->proc_scans > g_snapshot_max_scans)
+    g_snapshot_max_scans = p_snap->proc_scans;
+  log_debug_message("Request Snapshot : %s did %u pid lookups, %u unit lookups, %u /proc scans, %u unit probes\n",
+                    p_snap->label, p_snap->pid_lookups, p_snap->unit_lookups,
+                    p_snap->proc_scans, p_snap->unit_probes);
+  g_hash_table_destroy(p_snap->pids);
+  g_hash_table_destroy(p_snap->names);
+  g_hash_table_destroy(p_snap->descs);
+  if (p_snap->proc_table)
+    g_hash_table_destroy(p_snap->proc_table);
+  free(p_snap);
+}
+
+/* ProcScan() callback recording one process in the snapshot table */
+static int SnapshotScanOne(pid_t p_pid, const char *p_name, size_t p_name_len, void *p_data)
+{
+  /* binary name -> PID table */
+  GHashTable *l_table = (GHashTable *)p_data;
+  /* NUL terminated binary name */
+  char *l_name = g_strndup(p_name, p_name_len);
+  /* keep the first process found for a name, like AppPidFromName() */
+  if (!g_hash_table_lookup(l_table, l_name))
+    g_hash_table_insert(l_table, l_name, GINT_TO_POINTER(p_pid));
+  else
+    g_free(l_name);
+  return 0;
+}
+
+/* Function responsible to capture the process table with a single walk of /proc */
+static void SnapshotScanProc(AlSnapshot *p_snap)
+{
+  /* record buffer for the walk */
+  ProcBuffer l_buf;
+  if (p_snap->proc_table)
+    g_hash_table_remove_all(p_snap->proc_table);
+  else
+    p_snap->proc_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  p_snap->proc_scans++;
+  g_snapshot_proc_scans++;
+  ProcBufferInit(&l_buf);
+  ProcScan(SnapshotScanOne, p_snap->proc_table, &l_buf);
+  ProcBufferFree(&l_buf);
+}
+
+/* Function responsible to resolve a PID without the request memo */
+static pid_t SnapshotResolvePid(AlSnapshot *p_snap, char *p_app_name, bool p_fresh)
+{
+  /* resolved pid */
+  pid_t l_pid;
+  /* exact answer from the unit cgroup */
+  if ((l_pid = AppPidFromUnit(p_app_name)) != 0)
+    return l_pid;
+  /* constant time answer from the proc connector index */
+  if (PidIndexIsActive())
+    return PidIndexLookup(p_app_name);
+  /* last resort : one walk of /proc for the whole request */
+  if (!p_snap->proc_table || p_fresh)
+    SnapshotScanProc(p_snap);
+  return (pid_t)GPOINTER_TO_INT(g_hash_table_lookup(p_snap->proc_table, p_app_name));
+}
+
+/* Function responsible to get the PID of an application as seen by the request */
+pid_t SnapshotPidFromName(AlSnapshot *p_snap, char *p_app_name)
+{
+  /* memoized value */
+  gpointer l_val;
+  /* resolved pid */
+  pid_t l_pid;
+  if (!p_snap)
+    return AppPidFromName(p_app_name);
+  p_snap->pid_lookups++;
+  g_snapshot_pid_lookups++;
+  if (g_hash_table_lookup_extended(p_snap->pids, p_app_name, NULL, &l_val))
+    return (pid_t)GPOINTER_TO_INT(l_val);
+  l_pid = SnapshotResolvePid(p_snap, p_app_name, false);
+  g_hash_table_insert(p_snap->pids, g_strdup(p_app_name), GINT_TO_POINTER(l_pid));
+  return l_pid;
+}
+
+/* Function responsible to get the PID of an application the request just launched */
+pid_t SnapshotPidAfterLaunch(AlSnapshot *p_snap, char *p_app_name)
+{
+  /* resolved pid */
+  pid_t l_pid;
+  if (!p_snap)
+    return AppPidFromName(p_app_name);
+  p_snap->pid_lookups++;
+  g_snapshot_pid_lookups++;
+  /* the launch changed the process table, the memo is stale */
+  l_pid = SnapshotResolvePid(p_snap, p_app_name, true);
+  g_hash_table_replace(p_snap->pids, g_strdup(p_app_name), GINT_TO_POINTER(l_pid));
+  return l_pid;
+}
+
+/* Function responsible to get the application name of a PID as seen by the request */
+int SnapshotNameFromPid(AlSnapshot *p_snap, pid_t p_pid, char *p_app_name)
+{
+  /* memoized name */
+  char *l_name;
+  /* return code */
+  int l_ret;
+  if (!p_snap)
+    return AppNameFromPid(p_pid, p_app_name);
+  p_snap->pid_lookups++;
+  g_snapshot_pid_lookups++;
+  if ((l_name = g_hash_table_lookup(p_snap->names, GINT_TO_POINTER(p_pid))) != NULL) {
+    strcpy(p_app_name, l_name);
+    return 1;
+  }
+  if ((l_ret = AppNameFromPid(p_pid, p_app_name)) == 1)
+    g_hash_table_insert(p_snap->names, GINT_TO_POINTER(p_pid), g_strdup(p_app_name));
+  return l_ret;
+}
+
+/* Function responsible to get the unit descriptor of an application as seen by the request (owned by the snapshot, NULL without one) */
+AlUnitDesc *SnapshotUnitDesc(AlSnapshot *p_snap, char *p_app_name)
+{
+  /* memoized value */
+  gpointer l_val;
+  /* resolved descriptor */
+  AlUnitDesc *l_desc;
+  /* nothing would own a direct lookup, the caller uses UnitDescGet() */
+  if (!p_snap)
+    return NULL;
+  p_snap->unit_lookups++;
+  g_snapshot_unit_lookups++;
+  if (g_hash_table_lookup_extended(p_snap->descs, p_app_name, NULL, &l_val))
+    return (AlUnitDesc *)l_val;
+  p_snap->unit_probes++;
+  g_snapshot_unit_probes++;
+  l_desc = UnitDescGet(p_app_name);
+  g_hash_table_insert(p_snap->descs, g_strdup(p_app_name), l_desc);
+  return l_desc;
+}
+
+/* Function responsible to get the unit type of an application as seen by the request */
+int SnapshotUnitType(AlSnapshot *p_snap, char *p_app_name)
+{
+  /* resolved descriptor */
+  AlUnitDesc *l_desc;
+  if (!p_snap)
+    return AppExistsInSystem(p_app_name);
+  l_desc = SnapshotUnitDesc(p_snap, p_app_name);
+  return l_desc ? l_desc->type : 0;
+}
+
+/* Function responsible to log the global snapshot counters */
+void SnapshotLogCounters()
+{
+  log_message("Request Snapshot : requests=%lu pid_lookups=%lu unit_lookups=%lu proc_scans=%lu unit_probes=%lu max_scans_per_request=%u\n",
+              g_snapshot_requests, g_snapshot_pid_lookups, g_snapshot_unit_lookups,
+              g_snapshot_proc_scans, g_snapshot_unit_probes, g_snapshot_max_scans);
+}
@@ -0,0 +1,688 @@
+/*
+* sysd_job.c, contains the implementation of the systemd unit job requests
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * Unit operations are issued as StartUnit/StopUnit/RestartUnit/Reload calls on the
+ * daemon's systemd proxy: one bus round trip per operation instead of a shell, a
+ * systemctl process and its own bus connection. The former systemctl path is kept
+ * behind the --systemctl option so both can be compared with the counters logged
+ * on SIGUSR1 (operations, failures, mean/max latency and operations per second).
+ *
+ * Queuing a job does not wait for it. The job path returned by systemd is kept in a
+ * table together with the caller's completion callback, and the JobRemoved signal
+ * received on the same connection (dispatched by the main loop) completes it with
+ * the job result. Jobs must therefore be queued from the main loop thread when a
+ * callback is given, so the signal cannot be dispatched before the job is tracked.
+ * Requests for a unit that already has a job pending may be merged into that job by
+ * systemd, so the waiters of one job path are chained.
+ *
+ * The asynchronous variants do not wait for the reply to StartUnit either, so a batch
+ * of jobs is sent in one go and costs about one round trip; systemd answers the calls
+ * in order, before it emits the JobRemoved signals of the queued jobs.
+ */
+
+#include <dbus/dbus.h>
+#include <errno.h>
+#include <glib.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "al-daemon.h"
+#include "sysd_job.h"
+#include "unit_match.h"
+
+extern DBusGConnection *g_conn;
+extern DBusGProxy *sysd_proxy;
+
+/* JobRemoved signal of the systemd manager */
+#define SYSD_JOB_MATCH_RULE "type='signal',sender='org.freedesktop.systemd1'," \
+                            "interface='org.freedesktop.systemd1.Manager',member='JobRemoved'"
+/* ownership changes of the systemd bus name, a new manager does not know our subscription */
+#define SYSD_JOB_OWNER_RULE "type='signal',sender='org.freedesktop.DBus',path='/org/freedesktop/DBus'," \
+                            "interface='org.freedesktop.DBus',member='NameOwnerChanged',arg0='" SYSTEMD_SERVICE_NAME "'"
+
+/* Outstanding job waiting for its completion */
+typedef struct SysdJobWaiter
+{
+    /* operation and unit of the job */
+    SysdJobOp op;
+    char *unit;
+    /* result known without JobRemoved (systemctl path or untracked jobs) */
+    const char *result;
+    /* completion callback and its data */
+    SysdJobDoneFunc done;
+    void *data;
+    /* time the job was requested */
+    unsigned long long start;
+    /* timeout source of the job, held by the first waiter of the chain */
+    guint timeout;
+    /* next waiter of the same job */
+    struct SysdJobWaiter *next;
+} SysdJobWaiter;
+
+/* manager methods and systemctl verbs of the operations */
+static const char *g_sysd_job_methods[SYSD_JOB_OP_COUNT] = { "StartUnit", "StopUnit", "RestartUnit", "Reload",
+                                                              "StartTransientUnit" };
+static const char *g_sysd_job_verbs[SYSD_JOB_OP_COUNT] = { "start", "stop", "restart", "daemon-reload", "start" };
+/* use the former systemctl command path */
+static int g_sysd_job_systemctl = 0;
+/* job object path -> SysdJobWaiter */
+static GHashTable *g_sysd_jobs = NULL;
+/* protects the job table */
+static pthread_mutex_t g_sysd_job_lock = PTHREAD_MUTEX_INITIALIZER;
+/* JobRemoved is received and filtered on the daemon connection */
+static int g_sysd_job_tracking = 0;
+/* per operation counters */
+static unsigned long g_sysd_job_calls[SYSD_JOB_OP_COUNT];
+static unsigned long g_sysd_job_failures[SYSD_JOB_OP_COUNT];
+static unsigned long long g_sysd_job_total_us[SYSD_JOB_OP_COUNT];
+static unsigned long long g_sysd_job_max_us[SYSD_JOB_OP_COUNT];
+static unsigned long g_sysd_job_completed[SYSD_JOB_OP_COUNT];
+static unsigned long g_sysd_job_unsuccessful[SYSD_JOB_OP_COUNT];
+static unsigned long long g_sysd_job_completion_us[SYSD_JOB_OP_COUNT];
+
+/* Function responsible to return a monotonic timestamp in microseconds */
+static unsigned long long SysdJobNow()
+{
+  /* current time */
+  struct timespec l_ts;
+  clock_gettime(CLOCK_MONOTONIC, &l_ts);
+  return (unsigned long long)l_ts.tv_sec * 1000000ULL + l_ts.tv_nsec / 1000;
+}
+
+/* Function responsible to account one operation */
+static void SysdJobAccount(SysdJobOp p_op, unsigned long long p_start, int p_ret)
+{
+  /* operation latency */
+  unsigned long long l_us = SysdJobNow() - p_start;
+  g_sysd_job_calls[p_op]++;
+  if (p_ret != 0)
+    g_sysd_job_failures[p_op]++;
+  g_sysd_job_total_us[p_op] += l_us;
+  if (l_us > g_sysd_job_max_us[p_op])
+    g_sysd_job_max_us[p_op] = l_us;
+}
+
+/* Function responsible to create a waiter for a job */
+static SysdJobWaiter *SysdJobWaiterNew(SysdJobOp p_op, const char *p_unit, SysdJobDoneFunc p_done,
+                                       void *p_data, unsigned long long p_start)
+{
+  /* new waiter */
+  SysdJobWaiter *l_waiter = g_new0(SysdJobWaiter, 1);
+  l_waiter->op = p_op;
+  l_waiter->unit = g_strdup(p_unit);
+  l_waiter->done = p_done;
+  l_waiter->data = p_data;
+  l_waiter->start = p_start;
+  return l_waiter;
+}
+
+/* Function responsible to account the completion of a job, call its callback and release it */
+static void SysdJobComplete(SysdJobWaiter *p_waiter, const char *p_result)
+{
+  g_sysd_job_completed[p_waiter->op]++;
+  if (strcmp(p_result, SYSD_JOB_RESULT_DONE) != 0)
+    g_sysd_job_unsuccessful[p_waiter->op]++;
+  g_sysd_job_completion_us[p_waiter->op] += SysdJobNow() - p_waiter->start;
+  log_debug_message("Systemd Job : %s %s completed with result %s\n", g_sysd_job_methods[p_waiter->op],
+                    p_waiter->unit ? p_waiter->unit : "", p_result);
+  if (p_waiter->done)
+    p_waiter->done(p_waiter->unit, p_result, p_waiter->data);
+  g_free(p_waiter->unit);
+  g_free(p_waiter);
+}
+
+/* Function responsible to complete the chained waiters of a job */
+static void SysdJobCompleteAll(SysdJobWaiter *p_waiter, const char *p_result)
+{
+  /* next waiter of the job */
+  SysdJobWaiter *l_next;
+  for (; p_waiter; p_waiter = l_next) {
+    l_next = p_waiter->next;
+    SysdJobComplete(p_waiter, p_result);
+  }
+}
+
+/* main loop callback completing a job whose result is already known */
+static gboolean SysdJobCompleteIdle(gpointer p_waiter)
+{
+  SysdJobComplete((SysdJobWaiter *)p_waiter, ((SysdJobWaiter *)p_waiter)->result);
+  return FALSE;
+}
+
+/* main loop callback completing a tracked job whose JobRemoved never came */
+static gboolean SysdJobTimeout(gpointer p_job)
+{
+  /* tracked job */
+  SysdJobWaiter *l_waiter = NULL;
+  pthread_mutex_lock(&g_sysd_job_lock);
+  if (g_sysd_jobs && (l_waiter = g_hash_table_lookup(g_sysd_jobs, p_job)) != NULL) {
+    /* the source is destroyed once this callback returns */
+    l_waiter->timeout = 0;
+    g_hash_table_remove(g_sysd_jobs, p_job);
+  }
+  pthread_mutex_unlock(&g_sysd_job_lock);
+  if (l_waiter) {
+    log_error_message("Systemd Job : %s %s not removed after %d s !\n", g_sysd_job_methods[l_waiter->op],
+                      l_waiter->unit ? l_waiter->unit : "", SYSD_JOB_TIMEOUT);
+    SysdJobCompleteAll(l_waiter, SYSD_JOB_RESULT_TIMEOUT);
+  }
+  return FALSE;
+}
+
+/* Function responsible to remove the timeout of a job no longer tracked */
+static void SysdJobCancelTimeout(SysdJobWaiter *p_waiter)
+{
+  if (p_waiter && p_waiter->timeout) {
+    g_source_remove(p_waiter->timeout);
+    p_waiter->timeout = 0;
+  }
+}
+
+/* Function responsible to wait for the removal of a queued job; takes the job path */
+static void SysdJobTrack(char *p_job, SysdJobWaiter *p_waiter)
+{
+  pthread_mutex_lock(&g_sysd_job_lock);
+  if (g_sysd_job_tracking && p_job) {
+    /* the job may be shared with an earlier request for the unit, which already armed its timeout */
+    if ((p_waiter->next = g_hash_table_lookup(g_sysd_jobs, p_job)) != NULL) {
+      p_waiter->timeout = p_waiter->next->timeout;
+      p_waiter->next->timeout = 0;
+    } else {
+      p_waiter->timeout = g_timeout_add_seconds_full(G_PRIORITY_DEFAULT, SYSD_JOB_TIMEOUT, SysdJobTimeout,
+                                                     g_strdup(p_job), g_free);
+    }
+    g_hash_table_replace(g_sysd_jobs, p_job, p_waiter);
+    p_job = NULL;
+    p_waiter = NULL;
+  }
+  pthread_mutex_unlock(&g_sysd_job_lock);
+  g_free(p_job);
+  /* without JobRemoved the job is reported as soon as it is queued */
+  if (p_waiter) {
+    p_waiter->result = SYSD_JOB_RESULT_DONE;
+    g_idle_add(SysdJobCompleteIdle, p_waiter);
+  }
+}
+
+/* Function responsible to subscribe again to a systemd manager which took the bus name */
+static void SysdJobOwnerChanged(DBusMessage *p_msg)
+{
+  /* signal arguments */
+  const char *l_name, *l_old, *l_new;
+  if (!dbus_message_get_args(p_msg, NULL, DBUS_TYPE_STRING, &l_name, DBUS_TYPE_STRING, &l_old,
+                             DBUS_TYPE_STRING, &l_new, DBUS_TYPE_INVALID)
+      || strcmp(l_name, SYSTEMD_SERVICE_NAME) != 0 || !*l_new)
+    return;
+  /* the jobs of the former manager are left to their timeout */
+  log_error_message("Systemd Job : systemd bus name owner changed, subscribing again !\n", 0);
+  dbus_g_proxy_call_no_reply(sysd_proxy, "Subscribe", G_TYPE_INVALID);
+}
+
+/* Filter function completing the tracked jobs on JobRemoved */
+static DBusHandlerResult SysdJobFilter(DBusConnection *p_conn, DBusMessage *p_msg, void *p_data)
+{
+  /* signal arguments */
+  dbus_uint32_t l_id;
+  const char *l_path, *l_unit, *l_result;
+  /* tracked job */
+  SysdJobWaiter *l_waiter = NULL;
+  if (dbus_message_is_signal(p_msg, DBUS_INTERFACE_DBUS, "NameOwnerChanged")) {
+    SysdJobOwnerChanged(p_msg);
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  }
+  if (!dbus_message_is_signal(p_msg, "org.freedesktop.systemd1.Manager", "JobRemoved"))
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  /* older managers do not send the unit name */
+  if (!dbus_message_get_args(p_msg, NULL, DBUS_TYPE_UINT32, &l_id, DBUS_TYPE_OBJECT_PATH, &l_path,
+                             DBUS_TYPE_STRING, &l_unit, DBUS_TYPE_STRING, &l_result, DBUS_TYPE_INVALID)
+      && !dbus_message_get_args(p_msg, NULL, DBUS_TYPE_UINT32, &l_id, DBUS_TYPE_OBJECT_PATH, &l_path,
+                                DBUS_TYPE_STRING, &l_result, DBUS_TYPE_INVALID)) {
+    log_error_message("Systemd Job : Cannot parse JobRemoved signal %s !\n", dbus_message_get_signature(p_msg));
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  }
+  pthread_mutex_lock(&g_sysd_job_lock);
+  if (g_sysd_jobs && (l_waiter = g_hash_table_lookup(g_sysd_jobs, l_path)) != NULL) {
+    g_hash_table_remove(g_sysd_jobs, l_path);
+    SysdJobCancelTimeout(l_waiter);
+  }
+  pthread_mutex_unlock(&g_sysd_job_lock);
+  SysdJobCompleteAll(l_waiter, l_result);
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+/* Function responsible to run an operation through the systemctl command */
+static int SysdJobSystemctl(SysdJobOp p_op, const char *p_unit)
+{
+  /* systemctl command line */
+  char l_cmd[DIM_MAX];
+  /* return code */
+  int l_ret;
+  if (p_unit)
+    snprintf(l_cmd, sizeof(l_cmd), "systemctl %s %s", g_sysd_job_verbs[p_op], p_unit);
+  else
+    snprintf(l_cmd, sizeof(l_cmd), "systemctl %s --system", g_sysd_job_verbs[p_op]);
+  if ((l_ret = system(l_cmd)) != 0) {
+    log_error_message("Systemd Job : \"%s\" failed ! Err : %s\n", l_cmd,
+                      l_ret == -1 ? strerror(errno) : "non zero exit status");
+    return -1;
+  }
+  return 0;
+}
+
+/* Function responsible to queue a job for a unit on the systemd manager */
+static int SysdJobQueue(SysdJobOp p_op, const char *p_unit, SysdJobDoneFunc p_done, void *p_data)
+{
+  /* queued job object path */
+  char *l_job = NULL;
+  /* error handler for dbus calls */
+  GError *l_err = NULL;
+  /* operation start time */
+  unsigned long long l_start = SysdJobNow();
+  /* return code */
+  int l_ret = 0;
+  /* completion of the job */
+  SysdJobWaiter *l_waiter;
+  if (g_sysd_job_systemctl) {
+    l_ret = SysdJobSystemctl(p_op, p_unit);
+    SysdJobAccount(p_op, l_start, l_ret);
+    /* systemctl waited for the job, complete it from the main loop like a signal would */
+    if (l_ret == 0 && p_done) {
+      l_waiter = SysdJobWaiterNew(p_op, p_unit, p_done, p_data, l_start);
+      l_waiter->result = SYSD_JOB_RESULT_DONE;
+      g_idle_add(SysdJobCompleteIdle, l_waiter);
+    }
+    return l_ret;
+  }
+  if (!sysd_proxy) {
+    log_error_message("Systemd Job : No systemd proxy to %s %s !\n", g_sysd_job_methods[p_op],
+                      p_unit ? p_unit : "");
+    l_ret = -1;
+  } else if (p_unit) {
+    if (!dbus_g_proxy_call(sysd_proxy, g_sysd_job_methods[p_op], &l_err,
+                           G_TYPE_STRING, p_unit, G_TYPE_STRING, SYSD_JOB_MODE, G_TYPE_INVALID,
+                           DBUS_TYPE_G_OBJECT_PATH, &l_job, G_TYPE_INVALID))
+      l_ret = -1;
+  } else {
+    if (!dbus_g_proxy_call(sysd_proxy, g_sysd_job_methods[p_op], &l_err,
+                           G_TYPE_INVALID, G_TYPE_INVALID))
+      l_ret = -1;
+  }
+  SysdJobAccount(p_op, l_start, l_ret);
+  if (l_ret != 0 && l_err) {
+    log_error_message("Systemd Job : %s %s failed ! Err : %s\n", g_sysd_job_methods[p_op],
+                      p_unit ? p_unit : "", l_err->message);
+  } else if (l_job) {
+    log_debug_message("Systemd Job : %s %s queued job %s\n", g_sysd_job_methods[p_op],
+                      p_unit, l_job);
+  }
+  if (l_err)
+    g_error_free(l_err);
+  if (l_ret == 0 && p_done) {
+    SysdJobTrack(l_job, SysdJobWaiterNew(p_op, p_unit, p_done, p_data, l_start));
+    l_job = NULL;
+  }
+  g_free(l_job);
+  return l_ret;
+}
+
+/* Reply callback of an asynchronous job request */
+static void SysdJobQueued(DBusGProxy *p_proxy, DBusGProxyCall *p_call, gpointer p_waiter)
+{
+  /* request of the job */
+  SysdJobWaiter *l_waiter = (SysdJobWaiter *)p_waiter;
+  /* queued job object path */
+  char *l_job = NULL;
+  /* error handler for dbus calls */
+  GError *l_err = NULL;
+  /* call outcome; a reload has no job, it is complete when systemd replies */
+  gboolean l_ok = (l_waiter->op == SYSD_JOB_RELOAD)
+                  ? dbus_g_proxy_end_call(p_proxy, p_call, &l_err, G_TYPE_INVALID)
+                  : dbus_g_proxy_end_call(p_proxy, p_call, &l_err, DBUS_TYPE_G_OBJECT_PATH, &l_job, G_TYPE_INVALID);
+  if (!l_ok) {
+    SysdJobAccount(l_waiter->op, l_waiter->start, -1);
+    log_error_message("Systemd Job : %s %s failed ! Err : %s\n", g_sysd_job_methods[l_waiter->op],
+                      l_waiter->unit ? l_waiter->unit : "", l_err ? l_err->message : "no reply");
+    if (l_err)
+      g_error_free(l_err);
+    SysdJobComplete(l_waiter, SYSD_JOB_RESULT_ERROR);
+    return;
+  }
+  if (l_waiter->op == SYSD_JOB_RELOAD) {
+    SysdJobAccount(l_waiter->op, l_waiter->start, 0);
+    SysdJobComplete(l_waiter, SYSD_JOB_RESULT_DONE);
+    return;
+  }
+  SysdJobAccount(l_waiter->op, l_waiter->start, 0);
+  log_debug_message("Systemd Job : %s %s queued job %s\n", g_sysd_job_methods[l_waiter->op],
+                    l_waiter->unit, l_job);
+  SysdJobTrack(l_job, l_waiter);
+}
+
+/* Function responsible to request a job for a unit without waiting for the reply */
+static int SysdJobQueueAsync(SysdJobOp p_op, const char *p_unit, SysdJobDoneFunc p_done, void *p_data)
+{
+  /* the systemctl command only reports once the job completed */
+  if (g_sysd_job_systemctl)
+    return SysdJobQueue(p_op, p_unit, p_done, p_data);
+  if (!sysd_proxy) {
+    log_error_message("Systemd Job : No systemd proxy to %s %s !\n", g_sysd_job_methods[p_op],
+                      p_unit ? p_unit : "");
+    return -1;
+  }
+  if (p_unit)
+    dbus_g_proxy_begin_call(sysd_proxy, g_sysd_job_methods[p_op], SysdJobQueued,
+                            SysdJobWaiterNew(p_op, p_unit, p_done, p_data, SysdJobNow()), NULL,
+                            G_TYPE_STRING, p_unit, G_TYPE_STRING, SYSD_JOB_MODE, G_TYPE_INVALID);
+  else
+    dbus_g_proxy_begin_call(sysd_proxy, g_sysd_job_methods[p_op], SysdJobQueued,
+                            SysdJobWaiterNew(p_op, NULL, p_done, p_data, SysdJobNow()), NULL,
+                            G_TYPE_INVALID);
+  return 0;
+}
+
+/* Function responsible to track job completions on the daemon's systemd connection */
+int SysdJobInit()
+{
+  /* daemon connection */
+  DBusConnection *l_conn;
+  /* error handlers */
+  DBusError l_dbus_err;
+  GError *l_err = NULL;
+  if (!g_conn || !sysd_proxy) {
+    log_error_message("Systemd Job : No systemd connection, job completions are not tracked !\n", 0);
+    return -1;
+  }
+  l_conn = (DBusConnection *)dbus_g_connection_get_connection(g_conn);
+  dbus_error_init(&l_dbus_err);
+  dbus_bus_add_match(l_conn, SYSD_JOB_MATCH_RULE, &l_dbus_err);
+  if (dbus_error_is_set(&l_dbus_err)) {
+    log_error_message("Systemd Job : Cannot add match for JobRemoved ! Err : %s\n", l_dbus_err.message);
+    dbus_error_free(&l_dbus_err);
+    return -1;
+  }
+  dbus_bus_add_match(l_conn, SYSD_JOB_OWNER_RULE, &l_dbus_err);
+  if (dbus_error_is_set(&l_dbus_err)) {
+    log_error_message("Systemd Job : Cannot add match for NameOwnerChanged ! Err : %s\n", l_dbus_err.message);
+    dbus_error_free(&l_dbus_err);
+    dbus_bus_remove_match(l_conn, SYSD_JOB_MATCH_RULE, NULL);
+    return -1;
+  }
+  if (!dbus_connection_add_filter(l_conn, SysdJobFilter, NULL, NULL)) {
+    log_error_message("Systemd Job : Cannot add filter for JobRemoved !\n", 0);
+    dbus_bus_remove_match(l_conn, SYSD_JOB_OWNER_RULE, NULL);
+    dbus_bus_remove_match(l_conn, SYSD_JOB_MATCH_RULE, NULL);
+    return -1;
+  }
+  /* systemd only emits job signals while a client is subscribed, without them jobs complete once queued */
+  if (!dbus_g_proxy_call(sysd_proxy, "Subscribe", &l_err, G_TYPE_INVALID, G_TYPE_INVALID)) {
+    log_error_message("Systemd Job : Subscribe failed ! Err : %s\n", l_err->message);
+    g_error_free(l_err);
+    dbus_connection_remove_filter(l_conn, SysdJobFilter, NULL);
+    dbus_bus_remove_match(l_conn, SYSD_JOB_OWNER_RULE, NULL);
+    dbus_bus_remove_match(l_conn, SYSD_JOB_MATCH_RULE, NULL);
+    return -1;
+  }
+  pthread_mutex_lock(&g_sysd_job_lock);
+  g_sysd_jobs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  g_sysd_job_tracking = 1;
+  pthread_mutex_unlock(&g_sysd_job_lock);
+  log_debug_message("Systemd Job : Tracking job completions\n", 0);
+  return 0;
+}
+
+/* Function responsible to complete the outstanding jobs as canceled and stop tracking */
+void SysdJobTerminate()
+{
+  /* outstanding jobs */
+  GHashTable *l_jobs;
+  /* table iterator */
+  GHashTableIter l_iter;
+  gpointer l_waiter;
+  pthread_mutex_lock(&g_sysd_job_lock);
+  l_jobs = g_sysd_jobs;
+  g_sysd_jobs = NULL;
+  g_sysd_job_tracking = 0;
+  pthread_mutex_unlock(&g_sysd_job_lock);
+  if (!l_jobs)
+    return;
+  if (g_conn)
+    dbus_connection_remove_filter((DBusConnection *)dbus_g_connection_get_connection(g_conn),
+                                  SysdJobFilter, NULL);
+  g_hash_table_iter_init(&l_iter, l_jobs);
+  while (g_hash_table_iter_next(&l_iter, NULL, &l_waiter)) {
+    SysdJobCancelTimeout((SysdJobWaiter *)l_waiter);
+    SysdJobCompleteAll((SysdJobWaiter *)l_waiter, "canceled");
+  }
+  g_hash_table_destroy(l_jobs);
+}
+
+/* Function responsible to select the legacy "systemctl" command path instead of the bus calls */
+void SysdJobUseSystemctl(int p_use)
+{
+  g_sysd_job_systemctl = p_use;
+}
+
+/* Function responsible to queue a start job for a unit; returns 0 when queued */
+int SysdStartUnit(const char *p_unit, SysdJobDoneFunc p_done, void *p_data)
+{
+  UnitMatchWatch(p_unit);
+  return SysdJobQueue(SYSD_JOB_START, p_unit, p_done, p_data);
+}
+
+/* Function responsible to queue a stop job for a unit; returns 0 when queued */
+int SysdStopUnit(const char *p_unit, SysdJobDoneFunc p_done, void *p_data)
+{
+  return SysdJobQueue(SYSD_JOB_STOP, p_unit, p_done, p_data);
+}
+
+/* Function responsible to queue a restart job for a unit; returns 0 when queued */
+int SysdRestartUnit(const char *p_unit, SysdJobDoneFunc p_done, void *p_data)
+{
+  UnitMatchWatch(p_unit);
+  return SysdJobQueue(SYSD_JOB_RESTART, p_unit, p_done, p_data);
+}
+
+/* Function responsible to request a start job for a unit without waiting for systemd; returns 0 when sent */
+int SysdStartUnitAsync(const char *p_unit, SysdJobDoneFunc p_done, void *p_data)
+{
+  UnitMatchWatch(p_unit);
+  return SysdJobQueueAsync(SYSD_JOB_START, p_unit, p_done, p_data);
+}
+
+/* Function responsible to append a string property to a transient unit property array */
+static int SysdAppendStringProp(DBusMessageIter *p_props, const char *p_name, const char *p_val)
+{
+  /* property and variant iterators */
+  DBusMessageIter l_prop, l_var;
+  return dbus_message_iter_open_container(p_props, DBUS_TYPE_STRUCT, NULL, &l_prop)
+         && dbus_message_iter_append_basic(&l_prop, DBUS_TYPE_STRING, &p_name)
+         && dbus_message_iter_open_container(&l_prop, DBUS_TYPE_VARIANT, "s", &l_var)
+         && dbus_message_iter_append_basic(&l_var, DBUS_TYPE_STRING, &p_val)
+         && dbus_message_iter_close_container(&l_prop, &l_var)
+         && dbus_message_iter_close_container(p_props, &l_prop);
+}
+
+/* Function responsible to append a string array to an open container */
+static int SysdAppendStrv(DBusMessageIter *p_iter, char **p_strv)
+{
+  /* array iterator */
+  DBusMessageIter l_arr;
+  if (!dbus_message_iter_open_container(p_iter, DBUS_TYPE_ARRAY, "s", &l_arr))
+    return 0;
+  for (; p_strv && *p_strv; p_strv++)
+    if (!dbus_message_iter_append_basic(&l_arr, DBUS_TYPE_STRING, p_strv))
+      return 0;
+  return dbus_message_iter_close_container(p_iter, &l_arr);
+}
+
+/* Function responsible to append a string array property to a transient unit property array */
+static int SysdAppendStrvProp(DBusMessageIter *p_props, const char *p_name, char **p_val)
+{
+  /* property and variant iterators */
+  DBusMessageIter l_prop, l_var;
+  return dbus_message_iter_open_container(p_props, DBUS_TYPE_STRUCT, NULL, &l_prop)
+         && dbus_message_iter_append_basic(&l_prop, DBUS_TYPE_STRING, &p_name)
+         && dbus_message_iter_open_container(&l_prop, DBUS_TYPE_VARIANT, "as", &l_var)
+         && SysdAppendStrv(&l_var, p_val)
+         && dbus_message_iter_close_container(&l_prop, &l_var)
+         && dbus_message_iter_close_container(p_props, &l_prop);
+}
+
+/* Function responsible to append the ExecStart property, a(sasb), to a transient unit property array */
+static int SysdAppendExecProp(DBusMessageIter *p_props, const SysdTransientProps *p_tprops)
+{
+  /* property, variant, command array and command iterators */
+  DBusMessageIter l_prop, l_var, l_cmds, l_cmd;
+  /* property name and ignore failure flag */
+  const char *l_name = "ExecStart";
+  dbus_bool_t l_ignore = p_tprops->exec_ignore_failure ? TRUE : FALSE;
+  return dbus_message_iter_open_container(p_props, DBUS_TYPE_STRUCT, NULL, &l_prop)
+         && dbus_message_iter_append_basic(&l_prop, DBUS_TYPE_STRING, &l_name)
+         && dbus_message_iter_open_container(&l_prop, DBUS_TYPE_VARIANT, "a(sasb)", &l_var)
+         && dbus_message_iter_open_container(&l_var, DBUS_TYPE_ARRAY, "(sasb)", &l_cmds)
+         && dbus_message_iter_open_container(&l_cmds, DBUS_TYPE_STRUCT, NULL, &l_cmd)
+         && dbus_message_iter_append_basic(&l_cmd, DBUS_TYPE_STRING, &p_tprops->exec_path)
+         && SysdAppendStrv(&l_cmd, p_tprops->exec_argv)
+         && dbus_message_iter_append_basic(&l_cmd, DBUS_TYPE_BOOLEAN, &l_ignore)
+         && dbus_message_iter_close_container(&l_cmds, &l_cmd)
+         && dbus_message_iter_close_container(&l_var, &l_cmds)
+         && dbus_message_iter_close_container(&l_prop, &l_var)
+         && dbus_message_iter_close_container(p_props, &l_prop);
+}
+
+/* Function responsible to build the StartTransientUnit call of a transient service */
+static DBusMessage *SysdTransientMessage(const char *p_unit, const SysdTransientProps *p_tprops)
+{
+  /* method call */
+  DBusMessage *l_msg;
+  /* argument, property array and auxiliary unit iterators */
+  DBusMessageIter l_iter, l_props, l_aux;
+  /* job mode */
+  const char *l_mode = SYSD_JOB_MODE;
+  if (!(l_msg = dbus_message_new_method_call("org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+                                             "org.freedesktop.systemd1.Manager", "StartTransientUnit")))
+    return NULL;
+  dbus_message_iter_init_append(l_msg, &l_iter);
+  if (!dbus_message_iter_append_basic(&l_iter, DBUS_TYPE_STRING, &p_unit)
+      || !dbus_message_iter_append_basic(&l_iter, DBUS_TYPE_STRING, &l_mode)
+      || !dbus_message_iter_open_container(&l_iter, DBUS_TYPE_ARRAY, "(sv)", &l_props)
+      || (p_tprops->description && !SysdAppendStringProp(&l_props, "Description", p_tprops->description))
+      || !SysdAppendExecProp(&l_props, p_tprops)
+      || (p_tprops->type && !SysdAppendStringProp(&l_props, "Type", p_tprops->type))
+      || (p_tprops->working_directory
+          && !SysdAppendStringProp(&l_props, "WorkingDirectory", p_tprops->working_directory))
+      || (p_tprops->environment && !SysdAppendStrvProp(&l_props, "Environment", p_tprops->environment))
+      || (p_tprops->user && !SysdAppendStringProp(&l_props, "User", p_tprops->user))
+      || (p_tprops->group && !SysdAppendStringProp(&l_props, "Group", p_tprops->group))
+      || !SysdAppendStringProp(&l_props, "CollectMode", SYSD_TRANSIENT_COLLECT_MODE)
+      || !dbus_message_iter_close_container(&l_iter, &l_props)
+      || !dbus_message_iter_open_container(&l_iter, DBUS_TYPE_ARRAY, "(sa(sv))", &l_aux)
+      || !dbus_message_iter_close_container(&l_iter, &l_aux)) {
+    dbus_message_unref(l_msg);
+    return NULL;
+  }
+  return l_msg;
+}
+
+/* Function responsible to create and start a transient service; returns 0 when the job was queued */
+int SysdStartTransientUnit(const char *p_unit, const SysdTransientProps *p_tprops,
+                           SysdJobDoneFunc p_done, void *p_data)
+{
+  /* method call and reply */
+  DBusMessage *l_msg = NULL, *l_reply = NULL;
+  /* error handler */
+  DBusError l_err;
+  /* queued job object path */
+  const char *l_job = NULL;
+  /* operation start time */
+  unsigned long long l_start = SysdJobNow();
+  /* return code */
+  int l_ret = -1;
+  dbus_error_init(&l_err);
+  if (!g_conn) {
+    log_error_message("Systemd Job : No systemd connection to start %s !\n", p_unit);
+    goto free_res;
+  }
+  if (!(l_msg = SysdTransientMessage(p_unit, p_tprops))) {
+    log_error_message("Systemd Job : Cannot build the StartTransientUnit call for %s !\n", p_unit);
+    goto free_res;
+  }
+  UnitMatchWatch(p_unit);
+  if (!(l_reply = dbus_connection_send_with_reply_and_block(
+              (DBusConnection *)dbus_g_connection_get_connection(g_conn), l_msg, SYSTEMD_UNIT_INFO_TIMEOUT, &l_err))
+      || !dbus_message_get_args(l_reply, &l_err, DBUS_TYPE_OBJECT_PATH, &l_job, DBUS_TYPE_INVALID)) {
+    log_error_message("Systemd Job : StartTransientUnit %s failed ! Err : %s\n", p_unit,
+                      dbus_error_is_set(&l_err) ? l_err.message : "no reply");
+    goto free_res;
+  }
+  l_ret = 0;
+  log_debug_message("Systemd Job : StartTransientUnit %s queued job %s\n", p_unit, l_job);
+  if (p_done)
+    SysdJobTrack(g_strdup(l_job), SysdJobWaiterNew(SYSD_JOB_START_TRANSIENT, p_unit, p_done, p_data, l_start));
+
+free_res:
+  if (l_msg) {
+    SysdJobAccount(SYSD_JOB_START_TRANSIENT, l_start, l_ret);
+    dbus_message_unref(l_msg);
+  }
+  if (l_reply)
+    dbus_message_unref(l_reply);
+  dbus_error_free(&l_err);
+  return l_ret;
+}
+
+/* Function responsible to reload the systemd manager configuration; returns 0 on success */
+int SysdReload()
+{
+  return SysdJobQueue(SYSD_JOB_RELOAD, NULL, NULL, NULL);
+}
+
+/* Function responsible to request a manager reload without waiting for it; returns 0 when sent */
+int SysdReloadAsync(SysdJobDoneFunc p_done, void *p_data)
+{
+  return SysdJobQueueAsync(SYSD_JOB_RELOAD, NULL, p_done, p_data);
+}
+
+/* Function responsible to log the unit job counters */
+void SysdJobLogCounters()
+{
+  /* operation index */
+  int l_op;
+  pthread_mutex_lock(&g_sysd_job_lock);
+  log_message("Systemd Job : outstanding=%u tracking=%d\n", g_sysd_jobs ? g_hash_table_size(g_sysd_jobs) : 0,
+              g_sysd_job_tracking);
+  pthread_mutex_unlock(&g_sysd_job_lock);
+  for (l_op = 0; l_op < SYSD_JOB_OP_COUNT; l_op++) {
+    /* mean latency and throughput */
+    double l_mean_us = g_sysd_job_calls[l_op] ? (double)g_sysd_job_total_us[l_op] / g_sysd_job_calls[l_op] : 0;
+    log_message("Systemd Job : %s via %s calls=%lu failures=%lu mean_us=%.0f max_us=%llu ops_per_sec=%.1f\n",
+                g_sysd_job_methods[l_op], g_sysd_job_systemctl ? "systemctl" : "bus",
+                g_sysd_job_calls[l_op], g_sysd_job_failures[l_op], l_mean_us,
+                g_sysd_job_max_us[l_op], l_mean_us > 0 ? 1000000.0 / l_mean_us : 0.0);
+    if (g_sysd_job_completed[l_op])
+      log_message("Systemd Job : %s jobs completed=%lu unsuccessful=%lu mean_completion_us=%llu\n",
+                  g_sysd_job_methods[l_op], g_sysd_job_completed[l_op], g_sysd_job_unsuccessful[l_op],
+                  g_sysd_job_completion_us[l_op] / g_sysd_job_completed[l_op]);
+  }
+}
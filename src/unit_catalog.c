@@ -0,0 +1,465 @@
+/*
+* unit_catalog.c, contains the implementation of the in-memory systemd unit catalog
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * The catalog maps every .service, .target and .timer unit name found in the systemd
+ * search path to the unit file in effect, honouring the same precedence as systemd
+ * (/etc overrides /run which overrides the vendor directories) and masking through
+ * /dev/null links. It is built once at startup and kept fresh by inotify events
+ * dispatched from the main loop; a changed name is simply resolved again. The
+ * launchable application names are also kept in a sorted array for prefix queries.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "al-daemon.h"
+#include "unit_catalog.h"
+
+/* size of the buffer used to receive inotify events */
+#define UNIT_CATALOG_EVENT_SIZE 4096
+/* events changing the unit files of a directory */
+#define UNIT_CATALOG_EVENT_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB)
+
+/* search path, highest precedence first */
+static const char *g_catalog_dirs[] = {
+  UNIT_CATALOG_PATH_ETC,
+  UNIT_CATALOG_PATH_RUN,
+  UNIT_CATALOG_PATH_LIB,
+  UNIT_CATALOG_PATH_USR_LIB
+};
+#define UNIT_CATALOG_DIR_COUNT (sizeof(g_catalog_dirs) / sizeof(g_catalog_dirs[0]))
+
+/* Catalog entry for one unit name */
+typedef struct
+{
+    /* unit file in effect; NULL when the unit is masked */
+    char *path;
+    /* index of the search path directory providing the unit */
+    int dir;
+} UnitCatalogEntry;
+
+/* unit name (owned) -> UnitCatalogEntry */
+static GHashTable *g_catalog_units = NULL;
+/* sorted launchable application names, rebuilt when the catalog changed */
+static GPtrArray *g_catalog_apps = NULL;
+static bool g_catalog_apps_dirty = true;
+/* bumped on every change so that users of catalog data can tell when it is stale */
+static volatile unsigned long g_catalog_generation = 1;
+/* protects the catalog; lookups may come from any thread */
+static pthread_mutex_t g_catalog_lock = PTHREAD_MUTEX_INITIALIZER;
+/* inotify descriptor, per directory watches and main loop watch */
+static int g_catalog_fd = -1;
+static int g_catalog_wds[UNIT_CATALOG_DIR_COUNT];
+static guint g_catalog_watch = 0;
+/* counters */
+static unsigned long g_catalog_lookups = 0;
+static unsigned long g_catalog_misses = 0;
+static unsigned long g_catalog_events = 0;
+static unsigned long g_catalog_rebuilds = 0;
+
+/* Function responsible to test if a file name is a unit kept in the catalog */
+static bool UnitCatalogIsUnitName(const char *p_name)
+{
+  return g_str_has_suffix(p_name, ".service") || g_str_has_suffix(p_name, ".target")
+      || g_str_has_suffix(p_name, ".timer");
+}
+
+/* Function responsible to release a catalog entry */
+static void UnitCatalogFreeEntry(gpointer p_entry)
+{
+  g_free(((UnitCatalogEntry *)p_entry)->path);
+  g_free(p_entry);
+}
+
+/* Function responsible to test one search path directory for a unit; returns 1 if the directory provides it */
+static int UnitCatalogProbe(int p_dir, const char *p_unit, char **p_path)
+{
+  /* unit file path and link target */
+  char l_path[PATH_MAX];
+  char l_target[PATH_MAX];
+  /* stat info */
+  struct stat l_st;
+  /* link target length */
+  ssize_t l_len;
+  snprintf(l_path, sizeof(l_path), "%s/%s", g_catalog_dirs[p_dir], p_unit);
+  if (lstat(l_path, &l_st) != 0)
+    return 0;
+  if (S_ISLNK(l_st.st_mode)) {
+    /* a link to /dev/null masks the unit in every lower directory */
+    if ((l_len = readlink(l_path, l_target, sizeof(l_target) - 1)) > 0) {
+      l_target[l_len] = '\0';
+      if (strcmp(l_target, "/dev/null") == 0) {
+        *p_path = NULL;
+        return 1;
+      }
+    }
+    /* dangling links do not provide the unit */
+    if (stat(l_path, &l_st) != 0)
+      return 0;
+  }
+  if (!S_ISREG(l_st.st_mode))
+    return 0;
+  *p_path = g_strdup(l_path);
+  return 1;
+}
+
+/* Function responsible to resolve a unit name over the whole search path; lock must be held */
+static void UnitCatalogResolveLocked(const char *p_unit)
+{
+  /* search path index */
+  unsigned int l_i;
+  /* unit file in effect */
+  char *l_path;
+  g_hash_table_remove(g_catalog_units, p_unit);
+  g_catalog_apps_dirty = true;
+  g_catalog_generation++;
+  for (l_i = 0; l_i < UNIT_CATALOG_DIR_COUNT; l_i++) {
+    if (UnitCatalogProbe(l_i, p_unit, &l_path)) {
+      UnitCatalogEntry *l_entry = g_new0(UnitCatalogEntry, 1);
+      l_entry->path = l_path;
+      l_entry->dir = l_i;
+      g_hash_table_insert(g_catalog_units, g_strdup(p_unit), l_entry);
+      return;
+    }
+  }
+}
+
+/* Function responsible to (re)build the catalog from the search path; lock must be held */
+static void UnitCatalogBuildLocked()
+{
+  /* search path index */
+  unsigned int l_i;
+  /* directory being read */
+  DIR *l_dir;
+  /* current directory entry */
+  struct dirent *l_next;
+  g_hash_table_remove_all(g_catalog_units);
+  g_catalog_apps_dirty = true;
+  g_catalog_generation++;
+  g_catalog_rebuilds++;
+  for (l_i = 0; l_i < UNIT_CATALOG_DIR_COUNT; l_i++) {
+    if (!(l_dir = opendir(g_catalog_dirs[l_i])))
+      continue;
+    while ((l_next = readdir(l_dir)) != NULL) {
+      /* unit file in effect */
+      char *l_path;
+      /* names already provided by a higher precedence directory are kept */
+      if (!UnitCatalogIsUnitName(l_next->d_name)
+          || g_hash_table_lookup(g_catalog_units, l_next->d_name))
+        continue;
+      if (UnitCatalogProbe(l_i, l_next->d_name, &l_path)) {
+        UnitCatalogEntry *l_entry = g_new0(UnitCatalogEntry, 1);
+        l_entry->path = l_path;
+        l_entry->dir = l_i;
+        g_hash_table_insert(g_catalog_units, g_strdup(l_next->d_name), l_entry);
+      }
+    }
+    closedir(l_dir);
+  }
+  log_debug_message("Unit Catalog : Cataloged %u units\n", g_hash_table_size(g_catalog_units));
+}
+
+/* Function responsible to compare two application names for sorting */
+static gint UnitCatalogCompareApps(gconstpointer p_a, gconstpointer p_b)
+{
+  return strcmp(*(char *const *)p_a, *(char *const *)p_b);
+}
+
+/* Function responsible to rebuild the sorted application names; lock must be held */
+static void UnitCatalogSortAppsLocked()
+{
+  /* table iterator */
+  GHashTableIter l_iter;
+  gpointer l_key, l_val;
+  /* read and write positions used to drop duplicates */
+  guint l_i, l_j;
+  if (!g_catalog_apps_dirty)
+    return;
+  g_ptr_array_set_size(g_catalog_apps, 0);
+  g_hash_table_iter_init(&l_iter, g_catalog_units);
+  while (g_hash_table_iter_next(&l_iter, &l_key, &l_val)) {
+    /* unit name and suffix */
+    const char *l_unit = l_key;
+    const char *l_dot = strrchr(l_unit, '.');
+    /* masked units, timers and bare templates cannot be run */
+    if (!((UnitCatalogEntry *)l_val)->path || g_str_has_suffix(l_unit, ".timer")
+        || l_dot == l_unit || l_dot[-1] == '@')
+      continue;
+    g_ptr_array_add(g_catalog_apps, g_strndup(l_unit, l_dot - l_unit));
+  }
+  g_ptr_array_sort(g_catalog_apps, UnitCatalogCompareApps);
+  /* an application may have both a service and a target */
+  for (l_i = 0, l_j = 0; l_i < g_catalog_apps->len; l_i++) {
+    if (l_j > 0 && strcmp(g_catalog_apps->pdata[l_i], g_catalog_apps->pdata[l_j - 1]) == 0) {
+      g_free(g_catalog_apps->pdata[l_i]);
+      continue;
+    }
+    g_catalog_apps->pdata[l_j++] = g_catalog_apps->pdata[l_i];
+  }
+  g_catalog_apps->len = l_j;
+  g_catalog_apps_dirty = false;
+}
+
+/* Main loop callback applying the search path changes to the catalog */
+static gboolean UnitCatalogOnEvent(GIOChannel *p_source, GIOCondition p_cond, gpointer p_data)
+{
+  /* receive buffer */
+  char l_buf[UNIT_CATALOG_EVENT_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+  /* current event */
+  const struct inotify_event *l_ev;
+  /* received length */
+  ssize_t l_len;
+  /* event cursor */
+  char *l_cur;
+  if (p_cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+    log_error_message("Unit Catalog : inotify descriptor failed, falling back to file system probes\n", 0);
+    /* the watch is destroyed by returning FALSE */
+    g_catalog_watch = 0;
+    UnitCatalogTerminate();
+    return FALSE;
+  }
+  while ((l_len = read(g_catalog_fd, l_buf, sizeof(l_buf))) > 0) {
+    pthread_mutex_lock(&g_catalog_lock);
+    for (l_cur = l_buf; l_cur < l_buf + l_len; l_cur += sizeof(struct inotify_event) + l_ev->len) {
+      l_ev = (const struct inotify_event *)l_cur;
+      g_catalog_events++;
+      /* events were dropped : the catalog cannot be trusted any more */
+      if (l_ev->mask & IN_Q_OVERFLOW) {
+        log_error_message("Unit Catalog : inotify queue overflow, rebuilding the catalog\n", 0);
+        UnitCatalogBuildLocked();
+        continue;
+      }
+      if (l_ev->len > 0 && UnitCatalogIsUnitName(l_ev->name))
+        UnitCatalogResolveLocked(l_ev->name);
+    }
+    pthread_mutex_unlock(&g_catalog_lock);
+  }
+  return TRUE;
+}
+
+/* Function responsible to build the unit catalog and watch the search path for changes */
+int UnitCatalogInit()
+{
+  /* search path index */
+  unsigned int l_i;
+  /* channel for the main loop watch */
+  GIOChannel *l_channel;
+  if (g_catalog_fd >= 0)
+    return 0;
+  for (l_i = 0; l_i < UNIT_CATALOG_DIR_COUNT; l_i++)
+    g_catalog_wds[l_i] = -1;
+  if ((g_catalog_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+    log_error_message("Unit Catalog : Cannot create inotify descriptor ! Err : %s\n",
+                      strerror(errno));
+    return -1;
+  }
+  /* watch before building so no change can slip between the scan and the events */
+  for (l_i = 0; l_i < UNIT_CATALOG_DIR_COUNT; l_i++) {
+    if ((g_catalog_wds[l_i] = inotify_add_watch(g_catalog_fd, g_catalog_dirs[l_i],
+                                                UNIT_CATALOG_EVENT_MASK)) < 0)
+      log_debug_message("Unit Catalog : Not watching %s ! Err : %s\n",
+                        g_catalog_dirs[l_i], strerror(errno));
+  }
+  pthread_mutex_lock(&g_catalog_lock);
+  g_catalog_units = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, UnitCatalogFreeEntry);
+  g_catalog_apps = g_ptr_array_new_with_free_func(g_free);
+  UnitCatalogBuildLocked();
+  pthread_mutex_unlock(&g_catalog_lock);
+  /* dispatch the notifications from the main loop */
+  l_channel = g_io_channel_unix_new(g_catalog_fd);
+  g_catalog_watch = g_io_add_watch(l_channel, G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+                                   UnitCatalogOnEvent, NULL);
+  g_io_channel_unref(l_channel);
+  log_debug_message("Unit Catalog : Catalog is active\n", 0);
+  return 0;
+}
+
+/* Function responsible to release the unit catalog and its watches */
+void UnitCatalogTerminate()
+{
+  if (g_catalog_watch) {
+    g_source_remove(g_catalog_watch);
+    g_catalog_watch = 0;
+  }
+  if (g_catalog_fd >= 0) {
+    close(g_catalog_fd);
+    g_catalog_fd = -1;
+  }
+  pthread_mutex_lock(&g_catalog_lock);
+  if (g_catalog_units) {
+    g_hash_table_destroy(g_catalog_units);
+    g_catalog_units = NULL;
+  }
+  if (g_catalog_apps) {
+    g_ptr_array_free(g_catalog_apps, TRUE);
+    g_catalog_apps = NULL;
+  }
+  g_catalog_apps_dirty = true;
+  pthread_mutex_unlock(&g_catalog_lock);
+}
+
+/* Function responsible to test if the catalog is built and kept up to date */
+int UnitCatalogIsActive()
+{
+  return g_catalog_watch != 0;
+}
+
+/* Function responsible to get the catalog generation, which changes whenever a unit is added, removed or modified */
+unsigned long UnitCatalogGeneration()
+{
+  return g_catalog_generation;
+}
+
+/* Function responsible to find the unit file in effect for a unit name; returns 1 if found */
+int UnitCatalogPath(const char *p_unit, char *p_path, size_t p_size)
+{
+  /* catalog entry */
+  UnitCatalogEntry *l_entry;
+  /* search path index */
+  unsigned int l_i;
+  /* probed unit file */
+  char *l_path = NULL;
+  /* return code */
+  int l_ret = 0;
+  pthread_mutex_lock(&g_catalog_lock);
+  g_catalog_lookups++;
+  if (g_catalog_units) {
+    if ((l_entry = g_hash_table_lookup(g_catalog_units, p_unit)) != NULL && l_entry->path) {
+      snprintf(p_path, p_size, "%s", l_entry->path);
+      l_ret = 1;
+    }
+    pthread_mutex_unlock(&g_catalog_lock);
+    return l_ret;
+  }
+  g_catalog_misses++;
+  pthread_mutex_unlock(&g_catalog_lock);
+  /* no catalog : probe the search path directly */
+  for (l_i = 0; l_i < UNIT_CATALOG_DIR_COUNT; l_i++) {
+    if (UnitCatalogProbe(l_i, p_unit, &l_path)) {
+      if (l_path) {
+        snprintf(p_path, p_size, "%s", l_path);
+        g_free(l_path);
+        l_ret = 1;
+      }
+      break;
+    }
+  }
+  return l_ret;
+}
+
+/* Function responsible to get the type of an application (UNIT_CATALOG_*) */
+int UnitCatalogAppType(const char *p_app_name)
+{
+  /* unit names and found path */
+  char l_unit[DIM_MAX];
+  char l_path[PATH_MAX];
+  /* template marker */
+  const char *l_at;
+  /* instances of a template are provided by the template unit */
+  if ((l_at = strchr(p_app_name, '@')) != NULL)
+    snprintf(l_unit, sizeof(l_unit), "%.*s.service", (int)(l_at - p_app_name + 1), p_app_name);
+  else
+    snprintf(l_unit, sizeof(l_unit), "%s.service", p_app_name);
+  if (UnitCatalogPath(l_unit, l_path, sizeof(l_path)))
+    return UNIT_CATALOG_SERVICE;
+  snprintf(l_unit, sizeof(l_unit), "%s.target", p_app_name);
+  if (UnitCatalogPath(l_unit, l_path, sizeof(l_path)))
+    return UNIT_CATALOG_TARGET;
+  return UNIT_CATALOG_NONE;
+}
+
+/* Function responsible to list the launchable applications starting with a prefix (NULL terminated, g_strfreev) */
+char **UnitCatalogListApps(const char *p_prefix)
+{
+  /* matching names */
+  GPtrArray *l_out = g_ptr_array_new();
+  /* prefix length */
+  size_t l_len = p_prefix ? strlen(p_prefix) : 0;
+  /* binary search bounds */
+  guint l_lo = 0, l_hi, l_mid;
+  pthread_mutex_lock(&g_catalog_lock);
+  if (g_catalog_apps) {
+    UnitCatalogSortAppsLocked();
+    /* first name not sorting before the prefix */
+    for (l_hi = g_catalog_apps->len; l_lo < l_hi; ) {
+      l_mid = l_lo + (l_hi - l_lo) / 2;
+      if (strncmp(g_catalog_apps->pdata[l_mid], p_prefix ? p_prefix : "", l_len) < 0)
+        l_lo = l_mid + 1;
+      else
+        l_hi = l_mid;
+    }
+    /* the matches are contiguous */
+    for (; l_lo < g_catalog_apps->len
+           && strncmp(g_catalog_apps->pdata[l_lo], p_prefix ? p_prefix : "", l_len) == 0; l_lo++)
+      g_ptr_array_add(l_out, g_strdup(g_catalog_apps->pdata[l_lo]));
+  }
+  pthread_mutex_unlock(&g_catalog_lock);
+  g_ptr_array_add(l_out, NULL);
+  return (char **)g_ptr_array_free(l_out, FALSE);
+}
+
+/* Function responsible to list the cataloged units that can be started (NULL terminated, g_strfreev) */
+char **UnitCatalogListUnits()
+{
+  /* cataloged unit names */
+  GPtrArray *l_out = g_ptr_array_new();
+  /* table iterator */
+  GHashTableIter l_iter;
+  gpointer l_key, l_val;
+  pthread_mutex_lock(&g_catalog_lock);
+  if (g_catalog_units) {
+    g_hash_table_iter_init(&l_iter, g_catalog_units);
+    while (g_hash_table_iter_next(&l_iter, &l_key, &l_val)) {
+      /* unit name and suffix */
+      const char *l_unit = l_key;
+      const char *l_dot = strrchr(l_unit, '.');
+      /* masked units and bare templates */
+      if (!((UnitCatalogEntry *)l_val)->path || l_dot == l_unit || l_dot[-1] == '@')
+        continue;
+      g_ptr_array_add(l_out, g_strdup(l_unit));
+    }
+  }
+  pthread_mutex_unlock(&g_catalog_lock);
+  g_ptr_array_add(l_out, NULL);
+  return (char **)g_ptr_array_free(l_out, FALSE);
+}
+
+/* Function responsible to log the catalog counters */
+void UnitCatalogLogCounters()
+{
+  pthread_mutex_lock(&g_catalog_lock);
+  log_message("Unit Catalog : units=%u lookups=%lu uncataloged_lookups=%lu inotify_events=%lu rebuilds=%lu\n",
+              g_catalog_units ? g_hash_table_size(g_catalog_units) : 0, g_catalog_lookups,
+              g_catalog_misses, g_catalog_events, g_catalog_rebuilds);
+  pthread_mutex_unlock(&g_catalog_lock);
+}
@@ -0,0 +1,250 @@
+/*
+* unit_desc.c, contains the implementation of the resolved application unit descriptors
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * An application name is classified once: unit type, unit name, template base, unit
+ * file and systemd object path (the unit is loaded with LoadUnit at that moment).
+ * The result is published as a reference counted, read-only descriptor and cached
+ * per application until the unit catalog reports a change in the search path, after
+ * which the next lookup resolves it again. Holders keep their descriptor valid even
+ * when the cache replaces it.
+ */
+
+#include <glib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "al-daemon.h"
+#include "notifier.h"
+#include "unit_catalog.h"
+#include "unit_desc.h"
+#include "unit_state.h"
+
+extern DBusGProxy *sysd_proxy;
+
+/* application name -> AlUnitDesc (one reference owned by the cache) */
+static GHashTable *g_unit_descs = NULL;
+/* protects the cache and the reference counts */
+static pthread_mutex_t g_unit_desc_lock = PTHREAD_MUTEX_INITIALIZER;
+/* counters */
+static unsigned long g_unit_desc_hits = 0;
+static unsigned long g_unit_desc_resolutions = 0;
+static unsigned long g_unit_desc_loads = 0;
+
+/* Function responsible to release a descriptor; lock must be held */
+static void UnitDescUnrefLocked(AlUnitDesc *p_desc)
+{
+  if (!p_desc || --p_desc->refs > 0)
+    return;
+  g_free(p_desc->app_name);
+  g_free(p_desc->unit);
+  g_free(p_desc->template_base);
+  g_free(p_desc->file_path);
+  g_free(p_desc->object_path);
+  g_free(p_desc);
+}
+
+/* systemd load states, kept by the descriptors */
+static const char *g_unit_desc_load_states[] = { "stub", "loaded", "not-found", "bad-setting", "error", "merged",
+                                                 "masked", NULL };
+
+/* Function responsible to get the LoadState of a unit, from the unit state cache or with one Get call */
+static const char *UnitDescLoadState(const char *p_unit, const char *p_object_path)
+{
+  /* cached state */
+  AlUnitState l_state;
+  /* properties proxy of the unit and the fetched value */
+  DBusGProxy *l_prop_proxy;
+  GValue l_value = { 0, };
+  /* load state name */
+  const char *l_name = NULL;
+  /* error handler for dbus calls */
+  GError *l_err = NULL;
+  /* name index */
+  int l_i;
+  if (UnitStateLookup(p_unit, &l_state, UNIT_STATE_LOAD) == 0) {
+    l_name = l_state.load_state;
+  } else if ((l_prop_proxy = dbus_g_proxy_new_from_proxy(sysd_proxy, "org.freedesktop.DBus.Properties",
+                                                         p_object_path)) != NULL) {
+    if (dbus_g_proxy_call(l_prop_proxy, "Get", &l_err, G_TYPE_STRING, "org.freedesktop.systemd1.Unit",
+                          G_TYPE_STRING, "LoadState", G_TYPE_INVALID, G_TYPE_VALUE, &l_value, G_TYPE_INVALID)) {
+      if (G_VALUE_HOLDS_STRING(&l_value))
+        l_name = g_value_get_string(&l_value);
+    } else {
+      log_error_message("Unit Descriptor : Cannot get the load state of %s ! Err : %s\n", p_unit, l_err->message);
+      g_error_free(l_err);
+    }
+    g_object_unref(l_prop_proxy);
+  }
+  for (l_i = 0; l_name && g_unit_desc_load_states[l_i]; l_i++)
+    if (strcmp(g_unit_desc_load_states[l_i], l_name) == 0)
+      break;
+  if (G_IS_VALUE(&l_value))
+    g_value_unset(&l_value);
+  return (l_name && g_unit_desc_load_states[l_i]) ? g_unit_desc_load_states[l_i] : "not-loaded";
+}
+
+/* cache value destructor */
+static void UnitDescDrop(gpointer p_desc)
+{
+  UnitDescUnrefLocked((AlUnitDesc *)p_desc);
+}
+
+/* Function responsible to classify an application and load its unit */
+static AlUnitDesc *UnitDescResolve(const char *p_app_name)
+{
+  /* descriptor under construction */
+  AlUnitDesc *l_desc;
+  /* unit file unit name and path */
+  char l_file_unit[DIM_MAX];
+  char l_path[PATH_MAX];
+  /* template marker */
+  const char *l_at;
+  /* loaded object path */
+  char *l_object_path = NULL;
+  /* error handler for dbus calls */
+  GError *l_err = NULL;
+  /* type of the application */
+  int l_type = UnitCatalogAppType(p_app_name);
+  if (l_type == UNIT_CATALOG_NONE)
+    return NULL;
+  l_desc = g_new0(AlUnitDesc, 1);
+  l_desc->refs = 1;
+  l_desc->generation = UnitCatalogGeneration();
+  l_desc->app_name = g_strdup(p_app_name);
+  l_desc->type = l_type;
+  if (l_type == UNIT_CATALOG_SERVICE && (l_at = strchr(p_app_name, '@')) != NULL)
+    l_desc->template_base = g_strndup(p_app_name, l_at - p_app_name + 1);
+  /* the deferred system commands are started through their timer */
+  l_desc->is_timer = (strcmp(p_app_name, "reboot") == 0) || (strcmp(p_app_name, "shutdown") == 0)
+                     || (strcmp(p_app_name, "poweroff") == 0);
+  if (l_desc->is_timer)
+    l_desc->unit = g_strconcat(p_app_name, ".timer", NULL);
+  else
+    l_desc->unit = g_strconcat(p_app_name, l_type == UNIT_CATALOG_SERVICE ? ".service" : ".target", NULL);
+  /* the unit file of an instance is the one of its template */
+  snprintf(l_file_unit, sizeof(l_file_unit), "%s%s",
+           l_desc->template_base ? l_desc->template_base : p_app_name,
+           l_type == UNIT_CATALOG_SERVICE ? ".service" : ".target");
+  if (UnitCatalogPath(l_file_unit, l_path, sizeof(l_path)))
+    l_desc->file_path = g_strdup(l_path);
+  /* ensure proper load state for the unit before it is used */
+  g_unit_desc_loads++;
+  if (sysd_proxy && dbus_g_proxy_call(sysd_proxy, "LoadUnit", &l_err,
+                                      G_TYPE_STRING, l_desc->unit, G_TYPE_INVALID,
+                                      DBUS_TYPE_G_OBJECT_PATH, &l_object_path, G_TYPE_INVALID)) {
+    /* LoadUnit also succeeds for a missing, masked or broken unit */
+    l_desc->load_state = UnitDescLoadState(l_desc->unit, l_object_path);
+    if (strcmp(l_desc->load_state, "loaded") == 0) {
+      l_desc->object_path = l_object_path;
+    } else {
+      log_error_message("Unit Descriptor : Unit %s is %s !\n", l_desc->unit, l_desc->load_state);
+      g_free(l_object_path);
+    }
+  } else {
+    log_error_message("Unit Descriptor : Cannot load unit %s ! Err : %s\n", l_desc->unit,
+                      l_err ? l_err->message : "no systemd proxy");
+    l_desc->load_state = "not-loaded";
+  }
+  if (l_err)
+    g_error_free(l_err);
+  log_debug_message("Unit Descriptor : Resolved %s to %s [ file : %s | path : %s ]\n",
+                    p_app_name, l_desc->unit, l_desc->file_path ? l_desc->file_path : "-",
+                    l_desc->object_path ? l_desc->object_path : "-");
+  return l_desc;
+}
+
+/* Function responsible to get the descriptor of an application (NULL if unknown); release it with UnitDescUnref() */
+AlUnitDesc *UnitDescGet(const char *p_app_name)
+{
+  /* cached or resolved descriptor */
+  AlUnitDesc *l_desc;
+  pthread_mutex_lock(&g_unit_desc_lock);
+  if (g_unit_descs && (l_desc = g_hash_table_lookup(g_unit_descs, p_app_name)) != NULL
+      && l_desc->generation == UnitCatalogGeneration()) {
+    l_desc->refs++;
+    g_unit_desc_hits++;
+    pthread_mutex_unlock(&g_unit_desc_lock);
+    return l_desc;
+  }
+  g_unit_desc_resolutions++;
+  pthread_mutex_unlock(&g_unit_desc_lock);
+  /* resolved without the lock, LoadUnit is a round trip to systemd */
+  if (!(l_desc = UnitDescResolve(p_app_name))) {
+    pthread_mutex_lock(&g_unit_desc_lock);
+    if (g_unit_descs)
+      g_hash_table_remove(g_unit_descs, p_app_name);
+    pthread_mutex_unlock(&g_unit_desc_lock);
+    return NULL;
+  }
+  /* only cache what is known to be current and loaded; the catalog must watch for changes */
+  if (!l_desc->object_path || !UnitCatalogIsActive())
+    return l_desc;
+  pthread_mutex_lock(&g_unit_desc_lock);
+  if (!g_unit_descs)
+    g_unit_descs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, UnitDescDrop);
+  l_desc->refs++;
+  g_hash_table_replace(g_unit_descs, g_strdup(p_app_name), l_desc);
+  pthread_mutex_unlock(&g_unit_desc_lock);
+  return l_desc;
+}
+
+/* Function responsible to take a reference on a descriptor */
+AlUnitDesc *UnitDescRef(AlUnitDesc *p_desc)
+{
+  pthread_mutex_lock(&g_unit_desc_lock);
+  if (p_desc)
+    p_desc->refs++;
+  pthread_mutex_unlock(&g_unit_desc_lock);
+  return p_desc;
+}
+
+/* Function responsible to release a reference on a descriptor */
+void UnitDescUnref(AlUnitDesc *p_desc)
+{
+  pthread_mutex_lock(&g_unit_desc_lock);
+  UnitDescUnrefLocked(p_desc);
+  pthread_mutex_unlock(&g_unit_desc_lock);
+}
+
+/* Function responsible to drop every cached descriptor */
+void UnitDescTerminate()
+{
+  pthread_mutex_lock(&g_unit_desc_lock);
+  if (g_unit_descs) {
+    g_hash_table_destroy(g_unit_descs);
+    g_unit_descs = NULL;
+  }
+  pthread_mutex_unlock(&g_unit_desc_lock);
+}
+
+/* Function responsible to log the descriptor cache counters */
+void UnitDescLogCounters()
+{
+  pthread_mutex_lock(&g_unit_desc_lock);
+  log_message("Unit Descriptor : cached=%u hits=%lu resolutions=%lu load_unit_calls=%lu\n",
+              g_unit_descs ? g_hash_table_size(g_unit_descs) : 0, g_unit_desc_hits,
+              g_unit_desc_resolutions, g_unit_desc_loads);
+  pthread_mutex_unlock(&g_unit_desc_lock);
+}
@@ -0,0 +1,250 @@
+/*
+* unit_dropin.c, contains the implementation of the unit drop-in files written by the daemon
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * The daemon never rewrites the unit files of the system. A setting is a small drop-in
+ * <dir>/<unit>.d/al-<name>.conf holding a single key, which systemd merges over the unit
+ * file. Files are written to a temporary file of the same directory, synced and renamed
+ * over the previous version, so a reader (or a power loss) sees either the old or the new
+ * content. Content equal to the file in place is not written again, so the caller can skip
+ * the reload as well.
+ */
+
+/* mkostemp() */
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "al-daemon.h"
+#include "unit_dropin.h"
+
+/* counters */
+static unsigned long g_dropin_writes = 0;
+static unsigned long g_dropin_unchanged = 0;
+static unsigned long g_dropin_removals = 0;
+static unsigned long g_dropin_collected = 0;
+static unsigned long g_dropin_failures = 0;
+static unsigned long g_dropin_bytes = 0;
+
+/* Function responsible to make a directory durable after an entry changed in it */
+static void UnitDropInSyncDir(const char *p_dir)
+{
+  /* directory descriptor */
+  int l_fd;
+  if ((l_fd = open(p_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+    return;
+  fsync(l_fd);
+  close(l_fd);
+}
+
+/* Function responsible to test if a file already has the given content */
+static bool UnitDropInSame(const char *p_path, const char *p_content, size_t p_len)
+{
+  /* content in place */
+  gchar *l_data = NULL;
+  gsize l_len = 0;
+  /* comparison result */
+  bool l_same;
+  if (!g_file_get_contents(p_path, &l_data, &l_len, NULL))
+    return false;
+  l_same = (l_len == p_len) && (memcmp(l_data, p_content, p_len) == 0);
+  g_free(l_data);
+  return l_same;
+}
+
+/* Function responsible to replace a file atomically; returns 1 if written, 0 if unchanged, -1 on error */
+static int UnitDropInReplace(const char *p_dir, const char *p_path, const char *p_content)
+{
+  /* temporary file, renamed over the target */
+  char l_tmp[PATH_MAX];
+  int l_fd;
+  /* write progress */
+  size_t l_len = strlen(p_content);
+  size_t l_done = 0;
+  ssize_t l_ret;
+  if (UnitDropInSame(p_path, p_content, l_len)) {
+    g_dropin_unchanged++;
+    return 0;
+  }
+  if (mkdir(p_dir, 0755) != 0 && errno != EEXIST) {
+    log_error_message("Unit Drop-in : Cannot create %s ! Err : %s\n", p_dir, strerror(errno));
+    g_dropin_failures++;
+    return -1;
+  }
+  snprintf(l_tmp, sizeof(l_tmp), "%s/.%sXXXXXX", p_dir, UNIT_DROPIN_PREFIX);
+  if ((l_fd = mkostemp(l_tmp, O_CLOEXEC)) < 0) {
+    log_error_message("Unit Drop-in : Cannot create a temporary file in %s ! Err : %s\n", p_dir, strerror(errno));
+    g_dropin_failures++;
+    return -1;
+  }
+  while (l_done < l_len) {
+    if ((l_ret = write(l_fd, p_content + l_done, l_len - l_done)) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    l_done += l_ret;
+  }
+  /* unit files are world readable, mkstemp creates the file private */
+  if (l_done < l_len || fchmod(l_fd, 0644) != 0 || fsync(l_fd) != 0) {
+    log_error_message("Unit Drop-in : Cannot write %s ! Err : %s\n", l_tmp, strerror(errno));
+    close(l_fd);
+    unlink(l_tmp);
+    g_dropin_failures++;
+    return -1;
+  }
+  close(l_fd);
+  if (rename(l_tmp, p_path) != 0) {
+    log_error_message("Unit Drop-in : Cannot rename %s to %s ! Err : %s\n", l_tmp, p_path, strerror(errno));
+    unlink(l_tmp);
+    g_dropin_failures++;
+    return -1;
+  }
+  UnitDropInSyncDir(p_dir);
+  g_dropin_writes++;
+  g_dropin_bytes += l_len;
+  return 1;
+}
+
+/* Function responsible to set one key of a unit in its drop-in al-<name>.conf under dir */
+int UnitDropInSet(const char *p_dir, const char *p_unit, const char *p_name, const char *p_section,
+                  const char *p_key, const char *p_value, bool p_reset, char *p_path, size_t p_size)
+{
+  /* drop-in directory of the unit */
+  char l_dir[PATH_MAX];
+  /* drop-in content */
+  char *l_content;
+  /* write result */
+  int l_ret;
+  snprintf(l_dir, sizeof(l_dir), "%s/%s.d", p_dir, p_unit);
+  snprintf(p_path, p_size, "%s/%s%s.conf", l_dir, UNIT_DROPIN_PREFIX, p_name);
+  if (!p_value) {
+    if (unlink(p_path) != 0) {
+      if (errno == ENOENT)
+        return 0;
+      log_error_message("Unit Drop-in : Cannot remove %s ! Err : %s\n", p_path, strerror(errno));
+      g_dropin_failures++;
+      return -1;
+    }
+    UnitDropInSyncDir(l_dir);
+    g_dropin_removals++;
+    log_debug_message("Unit Drop-in : Removed %s\n", p_path);
+    return 1;
+  }
+  if (p_reset)
+    l_content = g_strdup_printf("[%s]\n%s=\n%s=%s\n", p_section, p_key, p_key, p_value);
+  else
+    l_content = g_strdup_printf("[%s]\n%s=%s\n", p_section, p_key, p_value);
+  if ((l_ret = UnitDropInReplace(l_dir, p_path, l_content)) > 0)
+    log_debug_message("Unit Drop-in : %s sets %s=%s for %s\n", p_path, p_key, p_value, p_unit);
+  g_free(l_content);
+  return l_ret;
+}
+
+/* Function responsible to atomically write a whole unit file under dir */
+int UnitDropInWriteUnit(const char *p_dir, const char *p_unit, const char *p_content)
+{
+  /* unit file path */
+  char l_path[PATH_MAX];
+  snprintf(l_path, sizeof(l_path), "%s/%s", p_dir, p_unit);
+  return UnitDropInReplace(p_dir, l_path, p_content);
+}
+
+/* Function responsible to remove the daemon files of one drop-in directory; returns the number of drop-ins removed */
+static int UnitDropInCollectDir(const char *p_dir)
+{
+  /* directory being read */
+  DIR *l_dir;
+  /* current directory entry */
+  struct dirent *l_next;
+  /* entry path */
+  char l_path[PATH_MAX];
+  /* removed drop-ins */
+  int l_count = 0;
+  if (!(l_dir = opendir(p_dir)))
+    return 0;
+  while ((l_next = readdir(l_dir)) != NULL) {
+    /* temporary files of an interrupted write */
+    bool l_tmp = (l_next->d_name[0] == '.')
+                 && (strncmp(l_next->d_name + 1, UNIT_DROPIN_PREFIX, strlen(UNIT_DROPIN_PREFIX)) == 0);
+    if (!l_tmp && !(strncmp(l_next->d_name, UNIT_DROPIN_PREFIX, strlen(UNIT_DROPIN_PREFIX)) == 0
+                    && g_str_has_suffix(l_next->d_name, ".conf")))
+      continue;
+    snprintf(l_path, sizeof(l_path), "%s/%s", p_dir, l_next->d_name);
+    if (unlink(l_path) != 0) {
+      log_error_message("Unit Drop-in : Cannot remove stale %s ! Err : %s\n", l_path, strerror(errno));
+      continue;
+    }
+    log_debug_message("Unit Drop-in : Removed stale %s\n", l_path);
+    if (!l_tmp)
+      l_count++;
+  }
+  closedir(l_dir);
+  /* the directory goes away with its last drop-in */
+  rmdir(p_dir);
+  return l_count;
+}
+
+/*
+ * Function responsible to remove the drop-ins and temporary files left by a former daemon instance;
+ * only the runtime directory is collected, the persistent drop-ins are meant to outlive the daemon
+ */
+int UnitDropInCollect()
+{
+  /* directory being read */
+  DIR *l_dir;
+  /* current directory entry */
+  struct dirent *l_next;
+  /* drop-in directory path */
+  char l_path[PATH_MAX];
+  /* removed drop-ins */
+  int l_count = 0;
+  if ((l_dir = opendir(UNIT_DROPIN_RUNTIME)) != NULL) {
+    while ((l_next = readdir(l_dir)) != NULL) {
+      if (!g_str_has_suffix(l_next->d_name, ".d"))
+        continue;
+      snprintf(l_path, sizeof(l_path), "%s/%s", UNIT_DROPIN_RUNTIME, l_next->d_name);
+      l_count += UnitDropInCollectDir(l_path);
+    }
+    closedir(l_dir);
+  }
+  g_dropin_collected += l_count;
+  if (l_count > 0)
+    log_message("Unit Drop-in : Removed %d stale drop-in(s)\n", l_count);
+  return l_count;
+}
+
+/* Function responsible to log the drop-in counters */
+void UnitDropInLogCounters()
+{
+  log_message("Unit Drop-in : writes=%lu unchanged=%lu removals=%lu collected=%lu failures=%lu bytes=%lu\n",
+              g_dropin_writes, g_dropin_unchanged, g_dropin_removals, g_dropin_collected,
+              g_dropin_failures, g_dropin_bytes);
+}
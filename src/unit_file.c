@@ -0,0 +1,232 @@
+/*
+* unit_file.c, contains the implementation of the cache of parsed unit files
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * A unit file is parsed once and the few settings the daemon reads are kept per path,
+ * together with the inode, size and modification time the file had. While the unit
+ * catalog watches the search path and reports no change, an entry is used as is; after
+ * a change the file is stat'ed again and only parsed if its identity differs. Files
+ * outside of the catalog are stat'ed on every lookup.
+ *
+ * Only the [Service] settings of the ownership checks and of the RunAs transient units are
+ * kept. The Foreground state is read from and set on systemd over the bus, and the timing of
+ * the deferred timers is written as a drop-in, so neither reads its unit file.
+ */
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "al-daemon.h"
+#include "unit_catalog.h"
+#include "unit_file.h"
+#include "utils.h"
+
+/* path -> AlUnitFileInfo (one reference owned by the cache) */
+static GHashTable *g_unit_files = NULL;
+/* protects the cache and the reference counts */
+static pthread_mutex_t g_unit_file_lock = PTHREAD_MUTEX_INITIALIZER;
+/* use clock of the eviction */
+static unsigned long g_unit_file_clock = 0;
+/* counters */
+static unsigned long g_unit_file_hits = 0;
+static unsigned long g_unit_file_misses = 0;
+static unsigned long g_unit_file_revalidations = 0;
+static unsigned long g_unit_file_evictions = 0;
+
+/* Function responsible to release parsed settings; lock must be held */
+static void UnitFileInfoUnrefLocked(AlUnitFileInfo *p_info)
+{
+  if (!p_info || --p_info->refs > 0)
+    return;
+  g_free(p_info->path);
+  g_free(p_info->user);
+  g_free(p_info->group);
+  g_free(p_info->type);
+  g_free(p_info->exec_start);
+  g_free(p_info->working_directory);
+  g_free(p_info->environment);
+  g_free(p_info);
+}
+
+/* cache value destructor */
+static void UnitFileInfoDrop(gpointer p_info)
+{
+  UnitFileInfoUnrefLocked((AlUnitFileInfo *)p_info);
+}
+
+/* Function responsible to test if the catalog vouches for a file not having changed */
+static int UnitFileWatched(const char *p_path)
+{
+  return UnitCatalogIsActive()
+      && (g_str_has_prefix(p_path, UNIT_CATALOG_PATH_ETC "/") || g_str_has_prefix(p_path, UNIT_CATALOG_PATH_RUN "/")
+          || g_str_has_prefix(p_path, UNIT_CATALOG_PATH_LIB "/") || g_str_has_prefix(p_path, UNIT_CATALOG_PATH_USR_LIB "/"));
+}
+
+/* Function responsible to test if cached settings were parsed from the file as it is on disk */
+static int UnitFileSame(const AlUnitFileInfo *p_info, const struct stat *p_st)
+{
+  return p_info->dev == p_st->st_dev && p_info->ino == p_st->st_ino && p_info->size == p_st->st_size
+      && p_info->mtime.tv_sec == p_st->st_mtim.tv_sec && p_info->mtime.tv_nsec == p_st->st_mtim.tv_nsec;
+}
+
+/* Function responsible to read an optional [Service] setting */
+static char *UnitFileServiceKey(GKeyFile *p_key_file, const char *p_key)
+{
+  /* value as read */
+  char *l_val = g_key_file_get_string(p_key_file, "Service", p_key, NULL);
+  return l_val ? g_strstrip(l_val) : NULL;
+}
+
+/* Function responsible to parse a unit file */
+static AlUnitFileInfo *UnitFileParse(const char *p_path, const struct stat *p_st)
+{
+  /* parsed settings */
+  AlUnitFileInfo *l_info;
+  /* parsed unit file */
+  GKeyFile *l_key_file;
+  if (!(l_key_file = ParseUnitFile((char *)p_path)))
+    return NULL;
+  l_info = g_new0(AlUnitFileInfo, 1);
+  l_info->refs = 1;
+  l_info->path = g_strdup(p_path);
+  l_info->dev = p_st->st_dev;
+  l_info->ino = p_st->st_ino;
+  l_info->size = p_st->st_size;
+  l_info->mtime = p_st->st_mtim;
+  l_info->user = UnitFileServiceKey(l_key_file, "User");
+  l_info->group = UnitFileServiceKey(l_key_file, "Group");
+  l_info->type = UnitFileServiceKey(l_key_file, "Type");
+  l_info->exec_start = UnitFileServiceKey(l_key_file, "ExecStart");
+  l_info->working_directory = UnitFileServiceKey(l_key_file, "WorkingDirectory");
+  l_info->environment = UnitFileServiceKey(l_key_file, "Environment");
+  g_key_file_free(l_key_file);
+  return l_info;
+}
+
+/* Function responsible to make room for a new entry; lock must be held */
+static void UnitFileEvictLocked()
+{
+  /* cache iterator */
+  GHashTableIter l_iter;
+  gpointer l_key, l_value;
+  /* least recently used entry */
+  const char *l_oldest = NULL;
+  unsigned long l_oldest_used = 0;
+  if (g_hash_table_size(g_unit_files) < UNIT_FILE_CACHE_MAX)
+    return;
+  g_hash_table_iter_init(&l_iter, g_unit_files);
+  while (g_hash_table_iter_next(&l_iter, &l_key, &l_value)) {
+    if (!l_oldest || ((AlUnitFileInfo *)l_value)->used < l_oldest_used) {
+      l_oldest = (const char *)l_key;
+      l_oldest_used = ((AlUnitFileInfo *)l_value)->used;
+    }
+  }
+  if (l_oldest) {
+    g_hash_table_remove(g_unit_files, l_oldest);
+    g_unit_file_evictions++;
+  }
+}
+
+/* Function responsible to get the parsed settings of a unit file (NULL if unreadable); release them with UnitFileInfoUnref() */
+AlUnitFileInfo *UnitFileInfoGet(const char *p_path)
+{
+  /* cached or parsed settings */
+  AlUnitFileInfo *l_info;
+  /* identity of the file on disk */
+  struct stat l_st;
+  /* catalog state at the lookup */
+  unsigned long l_generation = UnitCatalogGeneration();
+  int l_watched = UnitFileWatched(p_path);
+  pthread_mutex_lock(&g_unit_file_lock);
+  if (g_unit_files && (l_info = g_hash_table_lookup(g_unit_files, p_path)) != NULL) {
+    /* nothing changed in the search path since the file was checked */
+    if (l_watched && l_info->generation == l_generation) {
+      l_info->refs++;
+      l_info->used = ++g_unit_file_clock;
+      g_unit_file_hits++;
+      pthread_mutex_unlock(&g_unit_file_lock);
+      return l_info;
+    }
+    g_unit_file_revalidations++;
+    if (stat(p_path, &l_st) == 0 && UnitFileSame(l_info, &l_st)) {
+      l_info->generation = l_generation;
+      l_info->refs++;
+      l_info->used = ++g_unit_file_clock;
+      g_unit_file_hits++;
+      pthread_mutex_unlock(&g_unit_file_lock);
+      return l_info;
+    }
+  }
+  g_unit_file_misses++;
+  pthread_mutex_unlock(&g_unit_file_lock);
+  /* parsed without the lock */
+  if (stat(p_path, &l_st) != 0 || !(l_info = UnitFileParse(p_path, &l_st))) {
+    pthread_mutex_lock(&g_unit_file_lock);
+    if (g_unit_files)
+      g_hash_table_remove(g_unit_files, p_path);
+    pthread_mutex_unlock(&g_unit_file_lock);
+    return NULL;
+  }
+  l_info->generation = l_generation;
+  pthread_mutex_lock(&g_unit_file_lock);
+  if (!g_unit_files)
+    g_unit_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, UnitFileInfoDrop);
+  g_hash_table_remove(g_unit_files, p_path);
+  UnitFileEvictLocked();
+  l_info->refs++;
+  l_info->used = ++g_unit_file_clock;
+  g_hash_table_insert(g_unit_files, g_strdup(p_path), l_info);
+  pthread_mutex_unlock(&g_unit_file_lock);
+  return l_info;
+}
+
+/* Function responsible to release a reference on parsed unit file settings */
+void UnitFileInfoUnref(AlUnitFileInfo *p_info)
+{
+  pthread_mutex_lock(&g_unit_file_lock);
+  UnitFileInfoUnrefLocked(p_info);
+  pthread_mutex_unlock(&g_unit_file_lock);
+}
+
+/* Function responsible to drop every cached unit file */
+void UnitFileCacheTerminate()
+{
+  pthread_mutex_lock(&g_unit_file_lock);
+  if (g_unit_files) {
+    g_hash_table_destroy(g_unit_files);
+    g_unit_files = NULL;
+  }
+  pthread_mutex_unlock(&g_unit_file_lock);
+}
+
+/* Function responsible to log the unit file cache counters */
+void UnitFileCacheLogCounters()
+{
+  pthread_mutex_lock(&g_unit_file_lock);
+  log_message("Unit File Cache : cached=%u hits=%lu misses=%lu revalidations=%lu evictions=%lu\n",
+              g_unit_files ? g_hash_table_size(g_unit_files) : 0, g_unit_file_hits,
+              g_unit_file_misses, g_unit_file_revalidations, g_unit_file_evictions);
+  pthread_mutex_unlock(&g_unit_file_lock);
+}
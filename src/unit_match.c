@@ -0,0 +1,368 @@
+/*
+* unit_match.c, contains the implementation of the systemd signal match rules of the application units
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * The signal dispatcher only receives the PropertiesChanged signals of the units in the
+ * catalog and of the units the daemon started, through one match rule per unit object
+ * path, so that mounts, devices, sockets, scopes and slices do not wake it up. A unit
+ * started by the daemon is flagged from the thread queueing the job; the JobNew signal
+ * systemd sends for the job wakes the dispatcher up, which installs the rule and fetches
+ * the state once so that the changes sent before the rule are not lost. The rule of a
+ * unit outside the catalog is removed when systemd unloads the unit. Past
+ * UNIT_MATCH_RULES_MAX rules a single rule for every unit is used instead, the signals
+ * of the other units being dropped by UnitMatchAccept().
+ *
+ * The state cache only holds the units whose signals are received : the state of any
+ * other unit is fetched from systemd.
+ */
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "al-daemon.h"
+#include "notifier.h"
+#include "unit_catalog.h"
+#include "unit_match.h"
+#include "unit_state.h"
+#include "utils.h"
+
+/* rule of the signals of one unit, completed by its object path */
+#define UNIT_MATCH_UNIT_RULE "type='signal',sender='org.freedesktop.systemd1'," \
+                             "interface='org.freedesktop.DBus.Properties',member='PropertiesChanged',path='%s'"
+/* rule of the signals of every unit */
+#define UNIT_MATCH_ALL_RULE "type='signal',sender='org.freedesktop.systemd1'," \
+                            "interface='org.freedesktop.DBus.Properties',member='PropertiesChanged'"
+/* rules of the manager signals following the jobs and the unloaded units */
+#define UNIT_MATCH_JOB_RULE "type='signal',sender='org.freedesktop.systemd1',path='/org/freedesktop/systemd1'," \
+                            "interface='org.freedesktop.systemd1.Manager',member='JobNew'"
+#define UNIT_MATCH_REMOVED_RULE "type='signal',sender='org.freedesktop.systemd1',path='/org/freedesktop/systemd1'," \
+                                "interface='org.freedesktop.systemd1.Manager',member='UnitRemoved'"
+
+/* unit followed by the dispatcher */
+typedef struct UnitMatchEntry
+{
+  /* the unit file is in the catalog */
+  bool cataloged;
+  /* the unit was started by the daemon and is not unloaded yet */
+  bool launched;
+  /* a rule of its own is installed */
+  bool rule;
+} UnitMatchEntry;
+
+/* unit name -> UnitMatchEntry */
+static GHashTable *g_match_units = NULL;
+/* signal dispatcher connection, NULL when not attached */
+static DBusConnection *g_match_conn = NULL;
+/* the rule of every unit is installed */
+static bool g_match_all = false;
+/* units are waiting for their rule */
+static bool g_match_pending = false;
+/* catalog generation the rules follow */
+static unsigned long g_match_generation = 0;
+/* installed unit rules */
+static unsigned int g_match_rules = 0;
+/* protects the units; launched units are flagged from the main loop */
+static pthread_mutex_t g_match_lock = PTHREAD_MUTEX_INITIALIZER;
+/* counters */
+static unsigned long g_match_added = 0;
+static unsigned long g_match_removed = 0;
+static unsigned long g_match_processed = 0;
+static unsigned long g_match_filtered = 0;
+static unsigned long g_match_fallbacks = 0;
+
+/* Function responsible to install or remove the rule of a unit; returns 0 on success */
+static int UnitMatchRule(DBusConnection *p_conn, const char *p_unit, bool p_add)
+{
+  /* unit object path and rule */
+  char l_path[sizeof(AL_SYSD_UNIT_PATH_PREFIX) + 3 * AL_UNIT_NAME_MAX];
+  char l_rule[sizeof(UNIT_MATCH_UNIT_RULE) + sizeof(l_path)];
+  if (UnitObjectPathFromName(p_unit, l_path, sizeof(l_path)) != 0)
+    return -1;
+  snprintf(l_rule, sizeof(l_rule), UNIT_MATCH_UNIT_RULE, l_path);
+  /* not waiting for the bus : the rules are processed in order with the calls that follow */
+  if (p_add)
+    dbus_bus_add_match(p_conn, l_rule, NULL);
+  else
+    dbus_bus_remove_match(p_conn, l_rule, NULL);
+  return 0;
+}
+
+/* Function responsible to get the entry of a unit, created if missing; lock must be held */
+static UnitMatchEntry *UnitMatchEntryLocked(const char *p_unit)
+{
+  /* tracked entry */
+  UnitMatchEntry *l_entry;
+  if (!g_match_units)
+    g_match_units = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  if (!(l_entry = g_hash_table_lookup(g_match_units, p_unit))) {
+    l_entry = g_new0(UnitMatchEntry, 1);
+    g_hash_table_insert(g_match_units, g_strdup(p_unit), l_entry);
+  }
+  return l_entry;
+}
+
+/* Function responsible to give up the rule of a unit nobody follows anymore; lock must be held */
+static void UnitMatchDropLocked(const char *p_unit, UnitMatchEntry *p_entry)
+{
+  if (p_entry->rule && g_match_conn) {
+    UnitMatchRule(g_match_conn, p_unit, false);
+    g_match_rules--;
+    g_match_removed++;
+  }
+  p_entry->rule = false;
+}
+
+/* Function responsible to switch to the rule of every unit; lock must be held */
+static void UnitMatchFallbackLocked(DBusConnection *p_conn)
+{
+  dbus_bus_add_match(p_conn, UNIT_MATCH_ALL_RULE, NULL);
+  g_match_all = true;
+  g_match_fallbacks++;
+  log_error_message("Unit Match : More than %d units are followed, the signals of every unit are received !\n",
+                    UNIT_MATCH_RULES_MAX);
+}
+
+/* Function responsible to apply the catalog changes and the launched units to the match rules */
+void UnitMatchSync(DBusConnection *p_conn)
+{
+  /* current catalog generation and its units */
+  unsigned long l_generation = UnitCatalogGeneration();
+  char **l_cataloged = NULL;
+  /* units whose state is fetched, or dropped, once the lock is released */
+  GPtrArray *l_fetch, *l_forget;
+  /* table iterator */
+  GHashTableIter l_iter;
+  gpointer l_key, l_val;
+  guint l_i;
+  pthread_mutex_lock(&g_match_lock);
+  if (p_conn != g_match_conn || (!g_match_pending && l_generation == g_match_generation)) {
+    pthread_mutex_unlock(&g_match_lock);
+    return;
+  }
+  pthread_mutex_unlock(&g_match_lock);
+  /* listed without the lock, the catalog may be rebuilding */
+  if (l_generation != g_match_generation)
+    l_cataloged = UnitCatalogListUnits();
+  l_fetch = g_ptr_array_new_with_free_func(g_free);
+  l_forget = g_ptr_array_new_with_free_func(g_free);
+  pthread_mutex_lock(&g_match_lock);
+  if (!g_match_units)
+    g_match_units = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  if (l_cataloged) {
+    g_hash_table_iter_init(&l_iter, g_match_units);
+    while (g_hash_table_iter_next(&l_iter, &l_key, &l_val))
+      ((UnitMatchEntry *)l_val)->cataloged = false;
+    for (l_i = 0; l_cataloged[l_i]; l_i++)
+      UnitMatchEntryLocked(l_cataloged[l_i])->cataloged = true;
+    g_match_generation = l_generation;
+  }
+  g_hash_table_iter_init(&l_iter, g_match_units);
+  while (g_hash_table_iter_next(&l_iter, &l_key, &l_val)) {
+    /* tracked unit */
+    UnitMatchEntry *l_entry = l_val;
+    if (!l_entry->cataloged && !l_entry->launched) {
+      /* removed from the catalog; its cached state goes stale */
+      UnitMatchDropLocked(l_key, l_entry);
+      g_ptr_array_add(l_forget, g_strdup(l_key));
+      g_hash_table_iter_remove(&l_iter);
+      continue;
+    }
+    if (l_entry->rule || g_match_all)
+      continue;
+    if (g_match_rules >= UNIT_MATCH_RULES_MAX)
+      UnitMatchFallbackLocked(p_conn);
+    else if (UnitMatchRule(p_conn, l_key, true) == 0) {
+      l_entry->rule = true;
+      g_match_rules++;
+      g_match_added++;
+    } else {
+      continue;
+    }
+    /* the changes of a started unit sent before its rule are missed */
+    if (l_entry->launched)
+      g_ptr_array_add(l_fetch, g_strdup(l_key));
+  }
+  g_match_pending = false;
+  pthread_mutex_unlock(&g_match_lock);
+  for (l_i = 0; l_i < l_forget->len; l_i++)
+    UnitStateForget(l_forget->pdata[l_i]);
+  for (l_i = 0; l_i < l_fetch->len; l_i++)
+    AlNotifyUnitState(p_conn, l_fetch->pdata[l_i]);
+  g_ptr_array_free(l_forget, TRUE);
+  g_ptr_array_free(l_fetch, TRUE);
+  g_strfreev(l_cataloged);
+}
+
+/* Function responsible to install the match rules on the signal dispatcher connection */
+int UnitMatchAttach(DBusConnection *p_conn)
+{
+  /* error handler */
+  DBusError l_error;
+  dbus_error_init(&l_error);
+  /* the units started from now on are announced by their job */
+  dbus_bus_add_match(p_conn, UNIT_MATCH_JOB_RULE, &l_error);
+  if (!dbus_error_is_set(&l_error))
+    dbus_bus_add_match(p_conn, UNIT_MATCH_REMOVED_RULE, &l_error);
+  if (dbus_error_is_set(&l_error)) {
+    log_error_message("Unit Match : Cannot add the systemd manager match rules ! Err : %s\n", l_error.message);
+    dbus_error_free(&l_error);
+    return -1;
+  }
+  pthread_mutex_lock(&g_match_lock);
+  g_match_conn = p_conn;
+  g_match_all = false;
+  g_match_rules = 0;
+  /* every rule is installed again */
+  g_match_generation = 0;
+  g_match_pending = true;
+  pthread_mutex_unlock(&g_match_lock);
+  UnitMatchSync(p_conn);
+  log_message("Unit Match : Following the signals of %u units\n", g_match_rules);
+  return 0;
+}
+
+/* Function responsible to remove the match rules from the signal dispatcher connection */
+void UnitMatchDetach()
+{
+  /* table iterator */
+  GHashTableIter l_iter;
+  gpointer l_key, l_val;
+  pthread_mutex_lock(&g_match_lock);
+  if (g_match_conn && !dbus_connection_get_is_connected(g_match_conn))
+    g_match_conn = NULL;
+  if (g_match_units) {
+    g_hash_table_iter_init(&l_iter, g_match_units);
+    while (g_hash_table_iter_next(&l_iter, &l_key, &l_val))
+      UnitMatchDropLocked(l_key, l_val);
+  }
+  if (g_match_conn) {
+    dbus_bus_remove_match(g_match_conn, UNIT_MATCH_JOB_RULE, NULL);
+    dbus_bus_remove_match(g_match_conn, UNIT_MATCH_REMOVED_RULE, NULL);
+    if (g_match_all)
+      dbus_bus_remove_match(g_match_conn, UNIT_MATCH_ALL_RULE, NULL);
+  }
+  g_match_conn = NULL;
+  g_match_all = false;
+  g_match_rules = 0;
+  pthread_mutex_unlock(&g_match_lock);
+}
+
+/* Function responsible to have the signals of a unit about to be started received */
+void UnitMatchWatch(const char *p_unit)
+{
+  /* tracked entry */
+  UnitMatchEntry *l_entry;
+  pthread_mutex_lock(&g_match_lock);
+  l_entry = UnitMatchEntryLocked(p_unit);
+  if (!l_entry->launched) {
+    l_entry->launched = true;
+    /* installed by the dispatcher when the job wakes it up */
+    if (!l_entry->rule)
+      g_match_pending = true;
+  }
+  pthread_mutex_unlock(&g_match_lock);
+}
+
+/* Function responsible to drop the match rule of a launched unit systemd unloaded */
+void UnitMatchUnitRemoved(DBusConnection *p_conn, DBusMessage *p_signal)
+{
+  /* unloaded unit */
+  const char *l_unit;
+  /* tracked entry */
+  UnitMatchEntry *l_entry;
+  if (!dbus_message_get_args(p_signal, NULL, DBUS_TYPE_STRING, &l_unit, DBUS_TYPE_INVALID))
+    return;
+  pthread_mutex_lock(&g_match_lock);
+  if (g_match_units && (l_entry = g_hash_table_lookup(g_match_units, l_unit)) != NULL) {
+    l_entry->launched = false;
+    if (!l_entry->cataloged) {
+      UnitMatchDropLocked(l_unit, l_entry);
+      g_hash_table_remove(g_match_units, l_unit);
+    }
+  }
+  pthread_mutex_unlock(&g_match_lock);
+  /* loaded again with its state on next access */
+  UnitStateForget(l_unit);
+}
+
+/* Function responsible to test if the units are followed; lock must be held */
+static bool UnitMatchCoversLocked(const char *p_unit)
+{
+  /* tracked entry */
+  UnitMatchEntry *l_entry;
+  if (!g_match_conn || !g_match_units || !(l_entry = g_hash_table_lookup(g_match_units, p_unit)))
+    return false;
+  return l_entry->rule || g_match_all;
+}
+
+/* Function responsible to test if the PropertiesChanged signal of a unit is followed */
+bool UnitMatchAccept(DBusMessage *p_signal)
+{
+  /* unit whose properties changed */
+  char l_unit[AL_UNIT_NAME_MAX];
+  /* the unit is followed */
+  bool l_accept;
+  if (!UnitNameFromObjectPath(dbus_message_get_path(p_signal), l_unit, sizeof(l_unit)))
+    return false;
+  pthread_mutex_lock(&g_match_lock);
+  if ((l_accept = UnitMatchCoversLocked(l_unit)))
+    g_match_processed++;
+  else
+    g_match_filtered++;
+  pthread_mutex_unlock(&g_match_lock);
+  return l_accept;
+}
+
+/* Function responsible to test if the signals of a unit are received */
+bool UnitMatchCovers(const char *p_unit)
+{
+  /* the unit is followed */
+  bool l_covers;
+  pthread_mutex_lock(&g_match_lock);
+  l_covers = UnitMatchCoversLocked(p_unit);
+  pthread_mutex_unlock(&g_match_lock);
+  return l_covers;
+}
+
+/* Function responsible to drop the tracked units */
+void UnitMatchTerminate()
+{
+  pthread_mutex_lock(&g_match_lock);
+  if (g_match_units) {
+    g_hash_table_destroy(g_match_units);
+    g_match_units = NULL;
+  }
+  pthread_mutex_unlock(&g_match_lock);
+}
+
+/* Function responsible to log the match rule counters */
+void UnitMatchLogCounters()
+{
+  pthread_mutex_lock(&g_match_lock);
+  log_message("Unit Match : units=%u rules=%u all_units=%d added=%lu removed=%lu processed=%lu filtered=%lu "
+              "fallbacks=%lu\n",
+              g_match_units ? g_hash_table_size(g_match_units) : 0, g_match_rules, g_match_all,
+              g_match_added, g_match_removed, g_match_processed, g_match_filtered, g_match_fallbacks);
+  pthread_mutex_unlock(&g_match_lock);
+}
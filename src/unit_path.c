@@ -0,0 +1,188 @@
+/*
+* unit_path.c, contains the implementation of the cache of unit object paths
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * systemd publishes a unit under /org/freedesktop/systemd1/unit/ followed by its escaped
+ * name, and loads the unit on the first access to that path. The path of a well formed
+ * unit name is therefore computed locally instead of asking GetUnit, which also fails
+ * for units that are not loaded yet. Only names systemd would not accept as is are
+ * resolved with LoadUnit. Either way the path is kept per unit name.
+ */
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "al-daemon.h"
+#include "unit_path.h"
+#include "utils.h"
+
+/* longest unit name accepted by systemd */
+#define UNIT_PATH_NAME_MAX 255
+
+/* unit name -> object path */
+static GHashTable *g_unit_paths = NULL;
+/* protects the cache; used by the main loop and the signal dispatcher */
+static pthread_mutex_t g_unit_path_lock = PTHREAD_MUTEX_INITIALIZER;
+/* counters */
+static unsigned long g_unit_path_hits = 0;
+static unsigned long g_unit_path_computed = 0;
+static unsigned long g_unit_path_loads = 0;
+static unsigned long g_unit_path_failures = 0;
+
+/* Function responsible to test if a unit name is one systemd resolves from its escaped path */
+static bool UnitPathNameValid(const char *p_unit)
+{
+  /* unit types */
+  static const char *l_types[] = { "service", "socket", "target", "device", "mount", "automount",
+                                   "swap", "timer", "path", "slice", "scope", NULL };
+  /* type suffix */
+  const char *l_dot, *l_c;
+  int l_i;
+  if (!p_unit || !*p_unit || strlen(p_unit) > UNIT_PATH_NAME_MAX || !(l_dot = strrchr(p_unit, '.'))
+      || l_dot == p_unit)
+    return false;
+  for (l_c = p_unit; *l_c; l_c++)
+    if (!g_ascii_isalnum(*l_c) && !strchr(":-_.\\@", *l_c))
+      return false;
+  for (l_i = 0; l_types[l_i]; l_i++)
+    if (strcmp(l_dot + 1, l_types[l_i]) == 0)
+      return true;
+  return false;
+}
+
+/* Function responsible to ask systemd for the object path of a unit, loading it if needed */
+static char *UnitPathLoad(DBusConnection *p_conn, const char *p_unit)
+{
+  /* method call and reply */
+  DBusMessage *l_msg = NULL, *l_reply = NULL;
+  /* error handler */
+  DBusError l_error;
+  /* object path in the reply */
+  const char *l_path = NULL;
+  /* resulting path */
+  char *l_ret = NULL;
+  dbus_error_init(&l_error);
+  if (!(l_msg = dbus_message_new_method_call("org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+                                             "org.freedesktop.systemd1.Manager", "LoadUnit"))
+      || !dbus_message_append_args(l_msg, DBUS_TYPE_STRING, &p_unit, DBUS_TYPE_INVALID)) {
+    log_error_message("Get Unit Object Path : Could not allocate message for %s\n", p_unit);
+    goto free_res;
+  }
+  if (!(l_reply = dbus_connection_send_with_reply_and_block(p_conn, l_msg, SYSTEMD_UNIT_INFO_TIMEOUT, &l_error))
+      || !dbus_message_get_args(l_reply, &l_error, DBUS_TYPE_OBJECT_PATH, &l_path, DBUS_TYPE_INVALID)) {
+    log_error_message("Get Unit Object Path : Unknown information for %s [%s]\n", p_unit,
+                      dbus_error_is_set(&l_error) ? l_error.message : "no reply");
+    goto free_res;
+  }
+  l_ret = g_strdup(l_path);
+
+free_res:
+  if (l_msg)
+    dbus_message_unref(l_msg);
+  if (l_reply)
+    dbus_message_unref(l_reply);
+  dbus_error_free(&l_error);
+  return l_ret;
+}
+
+/* Function responsible to cache a path, taking ownership of it; lock must be held */
+static void UnitPathInsertLocked(const char *p_unit, char *p_path)
+{
+  if (!g_unit_paths)
+    g_unit_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  /* template instances are not bounded, start over rather than grow */
+  if (g_hash_table_size(g_unit_paths) >= UNIT_PATH_CACHE_MAX && !g_hash_table_lookup(g_unit_paths, p_unit))
+    g_hash_table_remove_all(g_unit_paths);
+  g_hash_table_replace(g_unit_paths, g_strdup(p_unit), p_path);
+}
+
+/* Function responsible to get the object path of a unit */
+char *UnitPathGet(DBusConnection *p_conn, const char *p_unit)
+{
+  /* cached, computed or loaded path */
+  char *l_path;
+  char l_buf[sizeof(AL_SYSD_UNIT_PATH_PREFIX) + 3 * UNIT_PATH_NAME_MAX];
+  if (!p_unit)
+    return NULL;
+  pthread_mutex_lock(&g_unit_path_lock);
+  if (g_unit_paths && (l_path = g_hash_table_lookup(g_unit_paths, p_unit)) != NULL) {
+    g_unit_path_hits++;
+    l_path = strdup(l_path);
+    pthread_mutex_unlock(&g_unit_path_lock);
+    return l_path;
+  }
+  pthread_mutex_unlock(&g_unit_path_lock);
+  if (UnitPathNameValid(p_unit) && UnitObjectPathFromName(p_unit, l_buf, sizeof(l_buf)) == 0) {
+    l_path = g_strdup(l_buf);
+    pthread_mutex_lock(&g_unit_path_lock);
+    g_unit_path_computed++;
+    pthread_mutex_unlock(&g_unit_path_lock);
+  } else {
+    /* resolved without the lock, LoadUnit is a round trip to systemd */
+    l_path = p_conn ? UnitPathLoad(p_conn, p_unit) : NULL;
+    pthread_mutex_lock(&g_unit_path_lock);
+    g_unit_path_loads++;
+    if (!l_path)
+      g_unit_path_failures++;
+    pthread_mutex_unlock(&g_unit_path_lock);
+    if (!l_path)
+      return NULL;
+  }
+  pthread_mutex_lock(&g_unit_path_lock);
+  UnitPathInsertLocked(p_unit, l_path);
+  l_path = strdup(l_path);
+  pthread_mutex_unlock(&g_unit_path_lock);
+  return l_path;
+}
+
+/* Function responsible to remember the object path systemd reported for a unit */
+void UnitPathStore(const char *p_unit, const char *p_path)
+{
+  if (!p_unit || !p_path)
+    return;
+  pthread_mutex_lock(&g_unit_path_lock);
+  UnitPathInsertLocked(p_unit, g_strdup(p_path));
+  pthread_mutex_unlock(&g_unit_path_lock);
+}
+
+/* Function responsible to drop every cached path */
+void UnitPathTerminate()
+{
+  pthread_mutex_lock(&g_unit_path_lock);
+  if (g_unit_paths) {
+    g_hash_table_destroy(g_unit_paths);
+    g_unit_paths = NULL;
+  }
+  pthread_mutex_unlock(&g_unit_path_lock);
+}
+
+/* Function responsible to log the object path cache counters */
+void UnitPathLogCounters()
+{
+  pthread_mutex_lock(&g_unit_path_lock);
+  log_message("Unit Object Path : cached=%u hits=%lu computed=%lu load_unit_calls=%lu failures=%lu\n",
+              g_unit_paths ? g_hash_table_size(g_unit_paths) : 0, g_unit_path_hits,
+              g_unit_path_computed, g_unit_path_loads, g_unit_path_failures);
+  pthread_mutex_unlock(&g_unit_path_lock);
+}
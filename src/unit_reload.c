@@ -0,0 +1,164 @@
+/*
+* unit_reload.c, contains the implementation of the coalesced systemd configuration reloads
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * A systemd reload re-reads every unit file, so the edits made by the daemon are not
+ * followed by one reload each. The first edit opens a window; the edits made during
+ * the window are covered by a single Reload, issued when it expires, and whoever
+ * depends on an edit waits for that shared reload. Edits made while a reload is in
+ * flight may not be seen by it and wait for the next one. Everything runs on the
+ * main loop.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "al-daemon.h"
+#include "unit_reload.h"
+
+/* waiter of a reload */
+typedef struct UnitReloadWaiter
+{
+  SysdJobDoneFunc done;
+  void *data;
+} UnitReloadWaiter;
+
+/* collection window, in milliseconds */
+static unsigned int g_unit_reload_window = UNIT_RELOAD_WINDOW_MS;
+/* waiters and number of the edits not covered by a reload yet */
+static GSList *g_unit_reload_pending = NULL;
+static unsigned long g_unit_reload_pending_edits = 0;
+/* waiters of the reload in flight */
+static GSList *g_unit_reload_inflight = NULL;
+static int g_unit_reload_busy = 0;
+/* window timer, 0 when no window is open */
+static guint g_unit_reload_timer = 0;
+/* counters */
+static unsigned long g_unit_reload_edits = 0;
+static unsigned long g_unit_reload_reloads = 0;
+static unsigned long g_unit_reload_failures = 0;
+static unsigned long g_unit_reload_max_batch = 0;
+
+static gboolean UnitReloadFire(gpointer p_data);
+
+/* Function responsible to open a collection window if none is open */
+static void UnitReloadSchedule()
+{
+  if (!g_unit_reload_timer)
+    g_unit_reload_timer = g_timeout_add(g_unit_reload_window, UnitReloadFire, NULL);
+}
+
+/* Function responsible to complete a list of waiters */
+static void UnitReloadComplete(GSList *p_waiters, const char *p_result)
+{
+  /* waiter iterator */
+  GSList *l_it;
+  for (l_it = p_waiters; l_it; l_it = l_it->next) {
+    UnitReloadWaiter *l_waiter = (UnitReloadWaiter *)l_it->data;
+    l_waiter->done(NULL, p_result, l_waiter->data);
+    g_free(l_waiter);
+  }
+  g_slist_free(p_waiters);
+}
+
+/* reload completion */
+static void UnitReloadDone(const char *p_unit, const char *p_result, void *p_data)
+{
+  /* waiters of the completed reload */
+  GSList *l_waiters = g_unit_reload_inflight;
+  g_unit_reload_inflight = NULL;
+  g_unit_reload_busy = 0;
+  if (strcmp(p_result, SYSD_JOB_RESULT_DONE) != 0) {
+    g_unit_reload_failures++;
+    log_error_message("Unit Reload : Reload of the systemd configuration failed with result %s !\n", p_result);
+  }
+  UnitReloadComplete(g_slist_reverse(l_waiters), p_result);
+  /* the edits made during the reload need another one */
+  if (g_unit_reload_pending_edits)
+    UnitReloadSchedule();
+}
+
+/* window expiry : reload once for the collected edits */
+static gboolean UnitReloadFire(gpointer p_data)
+{
+  g_unit_reload_timer = 0;
+  /* still reloading, the completion opens the next window */
+  if (g_unit_reload_busy)
+    return FALSE;
+  log_debug_message("Unit Reload : Reloading systemd for %lu edit(s)\n", g_unit_reload_pending_edits);
+  if (g_unit_reload_pending_edits > g_unit_reload_max_batch)
+    g_unit_reload_max_batch = g_unit_reload_pending_edits;
+  g_unit_reload_inflight = g_unit_reload_pending;
+  g_unit_reload_pending = NULL;
+  g_unit_reload_pending_edits = 0;
+  g_unit_reload_busy = 1;
+  g_unit_reload_reloads++;
+  if (SysdReloadAsync(UnitReloadDone, NULL) != 0)
+    UnitReloadDone(NULL, SYSD_JOB_RESULT_ERROR, NULL);
+  return FALSE;
+}
+
+/* Function responsible to set the time unit file edits are collected before a reload */
+void UnitReloadSetWindow(unsigned int p_window_ms)
+{
+  g_unit_reload_window = p_window_ms;
+}
+
+/* Function responsible to record a unit file edit and wait for the reload covering it */
+void UnitReloadRequest(const char *p_path, SysdJobDoneFunc p_done, void *p_data)
+{
+  /* new waiter */
+  UnitReloadWaiter *l_waiter;
+  g_unit_reload_edits++;
+  g_unit_reload_pending_edits++;
+  log_debug_message("Unit Reload : Edit of %s waits for the next reload\n", p_path ? p_path : "-");
+  if (p_done) {
+    l_waiter = g_new0(UnitReloadWaiter, 1);
+    l_waiter->done = p_done;
+    l_waiter->data = p_data;
+    g_unit_reload_pending = g_slist_prepend(g_unit_reload_pending, l_waiter);
+  }
+  if (!g_unit_reload_busy)
+    UnitReloadSchedule();
+}
+
+/* Function responsible to cancel the pending reload and complete its waiters as canceled */
+void UnitReloadTerminate()
+{
+  /* waiters of the edits not reloaded */
+  GSList *l_waiters = g_unit_reload_pending;
+  if (g_unit_reload_timer) {
+    g_source_remove(g_unit_reload_timer);
+    g_unit_reload_timer = 0;
+  }
+  g_unit_reload_pending = NULL;
+  g_unit_reload_pending_edits = 0;
+  UnitReloadComplete(g_slist_reverse(l_waiters), "canceled");
+}
+
+/* Function responsible to log the reload counters */
+void UnitReloadLogCounters()
+{
+  log_message("Unit Reload : window_ms=%u edits=%lu reloads=%lu failures=%lu max_batch=%lu pending=%lu\n",
+              g_unit_reload_window, g_unit_reload_edits, g_unit_reload_reloads,
+              g_unit_reload_failures, g_unit_reload_max_batch, g_unit_reload_pending_edits);
+}
@@ -0,0 +1,441 @@
+/*
+* unit_state.c, contains the implementation of the unit state cache fed by systemd signals
+*
+* Copyright (c) 2011 Wind River Systems, Inc.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+*/
+
+/*
+ * The signal dispatcher thread receives the PropertiesChanged signals of the units it
+ * follows (see unit_match.c); their payload carries the new LoadState/ActiveState/SubState (Unit interface) and
+ * ExecMainPID (Service interface). The cache keeps these per unit name, derived from
+ * the object path, so that the notifications and the state checks of the method calls
+ * are answered from memory. A property is only trusted while the signals are received:
+ * properties systemd invalidates, units never seen in a signal, units not followed and
+ * everything while the dispatcher is not subscribed are fetched from systemd, the fetched values only
+ * filling what no signal reported yet. Once subscribed, the run state of all the
+ * application units is primed with one ListUnits call; main pids are not part of it
+ * and are fetched on demand.
+ */
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "al-daemon.h"
+#include "notifier.h"
+#include "unit_match.h"
+#include "unit_path.h"
+#include "unit_state.h"
+#include "utils.h"
+
+/* cached state of one unit */
+typedef struct UnitStateEntry
+{
+  AlUnitState state;
+  /* mask of the properties known to be current */
+  int known;
+} UnitStateEntry;
+
+/* unit name -> UnitStateEntry */
+static GHashTable *g_unit_states = NULL;
+/* the PropertiesChanged signals are received */
+static bool g_unit_state_tracking = false;
+/* protects the cache; signals come from the dispatcher thread, lookups from the main loop */
+static pthread_mutex_t g_unit_state_lock = PTHREAD_MUTEX_INITIALIZER;
+/* counters */
+static unsigned long g_unit_state_signals = 0;
+static unsigned long g_unit_state_hits = 0;
+static unsigned long g_unit_state_misses = 0;
+static unsigned long g_unit_state_primes = 0;
+static unsigned long g_unit_state_primed = 0;
+static unsigned long long g_unit_state_prime_us = 0;
+
+/* Function responsible to return a monotonic timestamp in microseconds */
+static unsigned long long UnitStateNow()
+{
+  /* current time */
+  struct timespec l_ts;
+  clock_gettime(CLOCK_MONOTONIC, &l_ts);
+  return (unsigned long long)l_ts.tv_sec * 1000000ULL + l_ts.tv_nsec / 1000;
+}
+
+/* Function responsible to get the mask bit of a property name, 0 if it is not kept */
+static int UnitStateField(const char *p_name)
+{
+  if (strcmp(p_name, "LoadState") == 0)
+    return UNIT_STATE_LOAD;
+  if (strcmp(p_name, "ActiveState") == 0)
+    return UNIT_STATE_ACTIVE;
+  if (strcmp(p_name, "SubState") == 0)
+    return UNIT_STATE_SUB;
+  if (strcmp(p_name, "ExecMainPID") == 0)
+    return UNIT_STATE_MAIN_PID;
+  if (strcmp(p_name, "Foreground") == 0)
+    return UNIT_STATE_FOREGROUND;
+  return 0;
+}
+
+/* systemd state names, in the order of the AlLoadState, AlActiveState and AlSubState values after UNKNOWN */
+static const char *g_unit_load_states[] = { "stub", "loaded", "not-found", "bad-setting", "error", "merged",
+                                            "masked", NULL };
+static const char *g_unit_active_states[] = { "active", "reloading", "inactive", "failed", "activating",
+                                              "deactivating", NULL };
+static const char *g_unit_sub_states[] = { "dead", "condition", "start-pre", "start", "start-post", "running",
+                                           "exited", "reload", "stop", "stop-watchdog", "stop-sigterm",
+                                           "stop-sigkill", "stop-post", "final-sigterm", "final-sigkill",
+                                           "failed", "auto-restart", "active", "waiting", "elapsed", NULL };
+
+/* Function responsible to get the enum value of a state name, 0 (unknown) if not listed */
+static int UnitStateValue(const char **p_names, const char *p_name)
+{
+  /* name index */
+  int l_i;
+  for (l_i = 0; p_names[l_i]; l_i++)
+    if (strcmp(p_names[l_i], p_name) == 0)
+      return l_i + 1;
+  return 0;
+}
+
+/* Function responsible to set a state property, its name and decoded value */
+static void UnitStateSet(AlUnitState *p_state, int p_field, const char *p_value)
+{
+  switch (p_field) {
+  case UNIT_STATE_LOAD:
+    g_strlcpy(p_state->load_state, p_value, AL_UNIT_STATE_MAX);
+    p_state->load = (AlLoadState)UnitStateValue(g_unit_load_states, p_value);
+    break;
+  case UNIT_STATE_ACTIVE:
+    g_strlcpy(p_state->active_state, p_value, AL_UNIT_STATE_MAX);
+    p_state->active = (AlActiveState)UnitStateValue(g_unit_active_states, p_value);
+    break;
+  case UNIT_STATE_SUB:
+    g_strlcpy(p_state->sub_state, p_value, AL_UNIT_STATE_MAX);
+    p_state->sub = (AlSubState)UnitStateValue(g_unit_sub_states, p_value);
+    break;
+  }
+}
+
+/* Function responsible to decode the state properties of an a{sv} dictionary */
+int UnitStateDecode(DBusMessageIter *p_dict, AlUnitState *p_state)
+{
+  /* iterators over the entries and their variants */
+  DBusMessageIter l_entry, l_variant;
+  /* property name and string value */
+  const char *l_name, *l_str;
+  /* decoded properties */
+  int l_field, l_decoded = 0;
+  /* boolean property */
+  dbus_bool_t l_bool;
+  for (; dbus_message_iter_get_arg_type(p_dict) == DBUS_TYPE_DICT_ENTRY; dbus_message_iter_next(p_dict)) {
+    dbus_message_iter_recurse(p_dict, &l_entry);
+    dbus_message_iter_get_basic(&l_entry, &l_name);
+    dbus_message_iter_next(&l_entry);
+    dbus_message_iter_recurse(&l_entry, &l_variant);
+    if (!(l_field = UnitStateField(l_name)))
+      continue;
+    if (l_field == UNIT_STATE_MAIN_PID) {
+      if (dbus_message_iter_get_arg_type(&l_variant) != DBUS_TYPE_UINT32)
+        continue;
+      dbus_message_iter_get_basic(&l_variant, &p_state->main_pid);
+      p_state->has_main_pid = true;
+    } else if (l_field == UNIT_STATE_FOREGROUND) {
+      if (dbus_message_iter_get_arg_type(&l_variant) != DBUS_TYPE_BOOLEAN)
+        continue;
+      dbus_message_iter_get_basic(&l_variant, &l_bool);
+      p_state->foreground = l_bool ? true : false;
+    } else {
+      if (dbus_message_iter_get_arg_type(&l_variant) != DBUS_TYPE_STRING)
+        continue;
+      dbus_message_iter_get_basic(&l_variant, &l_str);
+      UnitStateSet(p_state, l_field, l_str);
+    }
+    l_decoded |= l_field;
+  }
+  return l_decoded;
+}
+
+/* Function responsible to copy properties into an entry; returns the mask of the changed ones; lock must be held */
+static int UnitStateMergeLocked(UnitStateEntry *p_entry, const AlUnitState *p_state, int p_fields, bool p_overwrite)
+{
+  /* changed properties */
+  int l_changed = 0;
+  if (!p_overwrite)
+    p_fields &= ~p_entry->known;
+  if ((p_fields & UNIT_STATE_LOAD) && strcmp(p_entry->state.load_state, p_state->load_state) != 0) {
+    UnitStateSet(&p_entry->state, UNIT_STATE_LOAD, p_state->load_state);
+    l_changed |= UNIT_STATE_LOAD;
+  }
+  if ((p_fields & UNIT_STATE_ACTIVE) && strcmp(p_entry->state.active_state, p_state->active_state) != 0) {
+    UnitStateSet(&p_entry->state, UNIT_STATE_ACTIVE, p_state->active_state);
+    l_changed |= UNIT_STATE_ACTIVE;
+  }
+  if ((p_fields & UNIT_STATE_SUB) && strcmp(p_entry->state.sub_state, p_state->sub_state) != 0) {
+    UnitStateSet(&p_entry->state, UNIT_STATE_SUB, p_state->sub_state);
+    l_changed |= UNIT_STATE_SUB;
+  }
+  if ((p_fields & UNIT_STATE_MAIN_PID) && p_entry->state.main_pid != p_state->main_pid) {
+    p_entry->state.main_pid = p_state->main_pid;
+    l_changed |= UNIT_STATE_MAIN_PID;
+  }
+  if (p_fields & UNIT_STATE_MAIN_PID)
+    p_entry->state.has_main_pid = true;
+  if ((p_fields & UNIT_STATE_FOREGROUND) && p_entry->state.foreground != p_state->foreground) {
+    p_entry->state.foreground = p_state->foreground;
+    l_changed |= UNIT_STATE_FOREGROUND;
+  }
+  /* a property seen for the first time is a change as well */
+  l_changed |= p_fields & ~p_entry->known;
+  p_entry->known |= p_fields;
+  return l_changed;
+}
+
+/* Function responsible to get the entry of a unit, created if missing; lock must be held */
+static UnitStateEntry *UnitStateEntryLocked(const char *p_unit)
+{
+  /* cached entry */
+  UnitStateEntry *l_entry;
+  if (!g_unit_states)
+    g_unit_states = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  if (!(l_entry = g_hash_table_lookup(g_unit_states, p_unit))) {
+    l_entry = g_new0(UnitStateEntry, 1);
+    g_strlcpy(l_entry->state.name, p_unit, sizeof(l_entry->state.name));
+    g_hash_table_insert(g_unit_states, g_strdup(p_unit), l_entry);
+  }
+  return l_entry;
+}
+
+/* Function responsible to turn the cache on or off */
+void UnitStateTrack(bool p_tracking)
+{
+  pthread_mutex_lock(&g_unit_state_lock);
+  g_unit_state_tracking = p_tracking;
+  if (!p_tracking && g_unit_states)
+    g_hash_table_remove_all(g_unit_states);
+  pthread_mutex_unlock(&g_unit_state_lock);
+  log_debug_message("Unit State Cache : %s\n", p_tracking ? "following the unit signals" : "disabled");
+}
+
+/* Function responsible to apply a PropertiesChanged signal of a unit to the cache */
+int UnitStateApplySignal(DBusMessage *p_signal, char *p_unit, size_t p_size)
+{
+  /* iterators over the arguments, the changed and the invalidated properties */
+  DBusMessageIter l_iter, l_dict, l_invalidated;
+  /* interface of the properties and invalidated property name */
+  const char *l_interface, *l_name;
+  /* decoded properties */
+  AlUnitState l_state;
+  int l_decoded, l_dropped = 0, l_changed;
+  /* cached entry */
+  UnitStateEntry *l_entry;
+  if (!UnitNameFromObjectPath(dbus_message_get_path(p_signal), p_unit, p_size))
+    return -1;
+  if (!dbus_message_iter_init(p_signal, &l_iter) || dbus_message_iter_get_arg_type(&l_iter) != DBUS_TYPE_STRING)
+    return -1;
+  dbus_message_iter_get_basic(&l_iter, &l_interface);
+  if (strcmp(l_interface, "org.freedesktop.systemd1.Unit") != 0
+      && strcmp(l_interface, "org.freedesktop.systemd1.Service") != 0)
+    return 0;
+  if (!dbus_message_iter_next(&l_iter) || dbus_message_iter_get_arg_type(&l_iter) != DBUS_TYPE_ARRAY)
+    return -1;
+  memset(&l_state, 0, sizeof(l_state));
+  dbus_message_iter_recurse(&l_iter, &l_dict);
+  l_decoded = UnitStateDecode(&l_dict, &l_state);
+  /* properties whose new value is not carried by the signal */
+  if (dbus_message_iter_next(&l_iter) && dbus_message_iter_get_arg_type(&l_iter) == DBUS_TYPE_ARRAY) {
+    dbus_message_iter_recurse(&l_iter, &l_invalidated);
+    for (; dbus_message_iter_get_arg_type(&l_invalidated) == DBUS_TYPE_STRING;
+         dbus_message_iter_next(&l_invalidated)) {
+      dbus_message_iter_get_basic(&l_invalidated, &l_name);
+      l_dropped |= UnitStateField(l_name);
+    }
+  }
+  pthread_mutex_lock(&g_unit_state_lock);
+  g_unit_state_signals++;
+  if (g_unit_state_tracking) {
+    l_entry = UnitStateEntryLocked(p_unit);
+    l_changed = UnitStateMergeLocked(l_entry, &l_state, l_decoded, true);
+    l_entry->known &= ~l_dropped;
+  } else {
+    l_changed = l_decoded;
+  }
+  pthread_mutex_unlock(&g_unit_state_lock);
+  return l_changed | l_dropped;
+}
+
+/* Function responsible to get the cached state of a unit; returns 0 if the needed properties are known */
+int UnitStateLookup(const char *p_unit, AlUnitState *p_state, int p_needed)
+{
+  /* cached entry */
+  UnitStateEntry *l_entry = NULL;
+  /* the state of a unit whose signals are not received is not kept current */
+  bool l_covered = UnitMatchCovers(p_unit);
+  pthread_mutex_lock(&g_unit_state_lock);
+  if (l_covered && g_unit_state_tracking && g_unit_states)
+    l_entry = g_hash_table_lookup(g_unit_states, p_unit);
+  if (!l_entry || (l_entry->known & p_needed) != p_needed) {
+    g_unit_state_misses++;
+    pthread_mutex_unlock(&g_unit_state_lock);
+    return -1;
+  }
+  *p_state = l_entry->state;
+  g_unit_state_hits++;
+  pthread_mutex_unlock(&g_unit_state_lock);
+  return 0;
+}
+
+/* Function responsible to complete the cache with a state fetched from systemd */
+void UnitStateStore(const AlUnitState *p_state, int p_known)
+{
+  /* the state of a unit whose signals are not received is not kept current */
+  bool l_covered = UnitMatchCovers(p_state->name);
+  pthread_mutex_lock(&g_unit_state_lock);
+  /* values reported by the signals since are at least as recent */
+  if (l_covered && g_unit_state_tracking)
+    UnitStateMergeLocked(UnitStateEntryLocked(p_state->name), p_state, p_known, false);
+  pthread_mutex_unlock(&g_unit_state_lock);
+}
+
+/* Function responsible to drop the cached state of a unit */
+void UnitStateForget(const char *p_unit)
+{
+  pthread_mutex_lock(&g_unit_state_lock);
+  if (g_unit_states)
+    g_hash_table_remove(g_unit_states, p_unit);
+  pthread_mutex_unlock(&g_unit_state_lock);
+}
+
+/* Function responsible to call ListUnitsByPatterns, or ListUnits on systemd versions without it */
+static DBusMessage *UnitStateListUnits(DBusConnection *p_conn, DBusError *p_error)
+{
+  /* method call and reply */
+  DBusMessage *l_msg, *l_reply = NULL;
+  /* unit name patterns */
+  static const char *l_patterns[] = UNIT_STATE_PRIME_PATTERNS;
+  /* array iterators */
+  DBusMessageIter l_iter, l_array;
+  int l_i;
+  if ((l_msg = dbus_message_new_method_call("org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+                                            "org.freedesktop.systemd1.Manager", "ListUnitsByPatterns"))) {
+    dbus_message_iter_init_append(l_msg, &l_iter);
+    /* any unit state */
+    dbus_message_iter_open_container(&l_iter, DBUS_TYPE_ARRAY, "s", &l_array);
+    dbus_message_iter_close_container(&l_iter, &l_array);
+    dbus_message_iter_open_container(&l_iter, DBUS_TYPE_ARRAY, "s", &l_array);
+    for (l_i = 0; l_patterns[l_i]; l_i++)
+      dbus_message_iter_append_basic(&l_array, DBUS_TYPE_STRING, &l_patterns[l_i]);
+    dbus_message_iter_close_container(&l_iter, &l_array);
+    l_reply = dbus_connection_send_with_reply_and_block(p_conn, l_msg, SYSTEMD_UNIT_INFO_TIMEOUT, p_error);
+    dbus_message_unref(l_msg);
+  }
+  if (l_reply || !dbus_error_has_name(p_error, DBUS_ERROR_UNKNOWN_METHOD))
+    return l_reply;
+  dbus_error_free(p_error);
+  if (!(l_msg = dbus_message_new_method_call("org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+                                             "org.freedesktop.systemd1.Manager", "ListUnits")))
+    return NULL;
+  l_reply = dbus_connection_send_with_reply_and_block(p_conn, l_msg, SYSTEMD_UNIT_INFO_TIMEOUT, p_error);
+  dbus_message_unref(l_msg);
+  return l_reply;
+}
+
+/* Function responsible to fill the caches with the state of every application unit */
+int UnitStatePrime(DBusConnection *p_conn)
+{
+  /* ListUnits reply */
+  DBusMessage *l_reply;
+  DBusError l_error;
+  /* iterators over the a(ssssssouso) array and its structures */
+  DBusMessageIter l_iter, l_array, l_unit;
+  /* unit name, state strings and object path */
+  const char *l_fields[7];
+  /* primed state */
+  AlUnitState l_state;
+  /* primed units and field index */
+  int l_count = 0, l_i;
+  /* call duration */
+  unsigned long long l_start = UnitStateNow();
+  dbus_error_init(&l_error);
+  if (!(l_reply = UnitStateListUnits(p_conn, &l_error))) {
+    log_error_message("Unit State Cache : Cannot list the units ! Err : %s\n",
+                      dbus_error_is_set(&l_error) ? l_error.message : "no reply");
+    dbus_error_free(&l_error);
+    return -1;
+  }
+  if (!dbus_message_iter_init(l_reply, &l_iter) || dbus_message_iter_get_arg_type(&l_iter) != DBUS_TYPE_ARRAY) {
+    log_error_message("Unit State Cache : Unexpected ListUnits reply !\n", 0);
+    dbus_message_unref(l_reply);
+    return -1;
+  }
+  dbus_message_iter_recurse(&l_iter, &l_array);
+  pthread_mutex_lock(&g_unit_state_lock);
+  for (; dbus_message_iter_get_arg_type(&l_array) == DBUS_TYPE_STRUCT; dbus_message_iter_next(&l_array)) {
+    /* name, description, load, active and sub state, followed unit, object path */
+    dbus_message_iter_recurse(&l_array, &l_unit);
+    for (l_i = 0; l_i < 7; l_i++) {
+      dbus_message_iter_get_basic(&l_unit, &l_fields[l_i]);
+      dbus_message_iter_next(&l_unit);
+    }
+    /* ListUnits is not filtered by systemd */
+    if (!g_str_has_suffix(l_fields[0], ".service") && !g_str_has_suffix(l_fields[0], ".target")
+        && !g_str_has_suffix(l_fields[0], ".timer"))
+      continue;
+    memset(&l_state, 0, sizeof(l_state));
+    g_strlcpy(l_state.name, l_fields[0], sizeof(l_state.name));
+    UnitStateSet(&l_state, UNIT_STATE_LOAD, l_fields[2]);
+    UnitStateSet(&l_state, UNIT_STATE_ACTIVE, l_fields[3]);
+    UnitStateSet(&l_state, UNIT_STATE_SUB, l_fields[4]);
+    if (g_unit_state_tracking && UnitMatchCovers(l_state.name))
+      UnitStateMergeLocked(UnitStateEntryLocked(l_state.name), &l_state, UNIT_STATE_RUN, false);
+    UnitPathStore(l_fields[0], l_fields[6]);
+    l_count++;
+  }
+  g_unit_state_primes++;
+  g_unit_state_primed = l_count;
+  g_unit_state_prime_us = UnitStateNow() - l_start;
+  pthread_mutex_unlock(&g_unit_state_lock);
+  dbus_message_unref(l_reply);
+  log_message("Unit State Cache : Primed %d units in %llu us\n", l_count, g_unit_state_prime_us);
+  return l_count;
+}
+
+/* Function responsible to drop the cached states */
+void UnitStateTerminate()
+{
+  pthread_mutex_lock(&g_unit_state_lock);
+  g_unit_state_tracking = false;
+  if (g_unit_states) {
+    g_hash_table_destroy(g_unit_states);
+    g_unit_states = NULL;
+  }
+  pthread_mutex_unlock(&g_unit_state_lock);
+}
+
+/* Function responsible to log the unit state cache counters */
+void UnitStateLogCounters()
+{
+  pthread_mutex_lock(&g_unit_state_lock);
+  log_message("Unit State Cache : tracking=%d units=%u signals=%lu hits=%lu misses=%lu primes=%lu "
+              "last_primed=%lu last_prime_us=%llu\n",
+              g_unit_state_tracking, g_unit_states ? g_hash_table_size(g_unit_states) : 0,
+              g_unit_state_signals, g_unit_state_hits, g_unit_state_misses, g_unit_state_primes,
+              g_unit_state_primed, g_unit_state_prime_us);
+  pthread_mutex_unlock(&g_unit_state_lock);
+}
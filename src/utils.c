@@ -18,6 +18,9 @@
 * 
 */
 
+/* mempcpy() */
+#define _GNU_SOURCE
+
 #include <ctype.h>
 #include <dbus/dbus.h>
 #include <dirent.h>
@@ -43,6 +46,17 @@
 
 #include "al-daemon.h"
 #include "utils.h"
+#include "pid_index.h"
+#include "cgroup.h"
+#include "procfs.h"
+#include "notifier.h"
+#include "unit_state.h"
+#include "unit_catalog.h"
+#include "unit_desc.h"
+#include "unit_dropin.h"
+#include "unit_file.h"
+#include "unit_path.h"
+#include "sysd_job.h"
 
 /* Function responsible with the daemonization procedure */
 void AlDaemonize()
@@ -109,151 +123,274 @@ void AlDaemonShutdown(){
 	system("killall al-daemon");
 }
 
+/* record buffer reused by the lookups of each thread */
+static __thread ProcBuffer g_proc_buf;
+
+/* Function to extract the binary name (basename of argv[0]) of a process from its cmdline */
+int AppBinaryNameFromPid(pid_t p_pid, char *p_name)
+{
+  /* binary name inside the record */
+  const char *l_name;
+  size_t l_name_len;
+  /* kernel threads have an empty command line */
+  if (ProcReadRecord(p_pid, "cmdline", &g_proc_buf) <= 0
+      || !ProcCmdlineBinaryName(g_proc_buf.data, g_proc_buf.len, &l_name, &l_name_len))
+    return 0;
+  if (l_name_len >= DIM_MAX)
+    l_name_len = DIM_MAX - 1;
+  memcpy(p_name, l_name, l_name_len);
+  p_name[l_name_len] = '\0';
+  return 1;
+}
+
+/* Function to extract the main PID of a service unit, 0 if it has no process */
+pid_t UnitMainPid(const char *p_unit)
+{
+  /* run state and ExecMainPID reported by systemd */
+  AlUnitState l_state;
+  /* processes of the unit */
+  pid_t l_pids[AL_MAX_UNIT_PIDS];
+  /* number of processes and index */
+  int l_count, l_i;
+  /* main pid candidate, its start time and whether the start times could be read */
+  pid_t l_pid = 0;
+  unsigned long long l_start = 0;
+  bool l_timed = true;
+  /* parsed stat record */
+  ProcStat l_stat;
+  /* systemd knows the main process; ExecMainPID is kept after the service exited */
+  if (UnitStateLookup(p_unit, &l_state, UNIT_STATE_RUN | UNIT_STATE_MAIN_PID) == 0 && l_state.main_pid != 0
+      && (l_state.active == AL_ACTIVE_ACTIVE || l_state.active == AL_ACTIVE_ACTIVATING
+          || l_state.active == AL_ACTIVE_RELOADING || l_state.active == AL_ACTIVE_DEACTIVATING))
+    return (pid_t)l_state.main_pid;
+  /* otherwise the earliest started process of the unit cgroup; pids wrap around */
+  if ((l_count = CgroupPidsFromUnit((char *)p_unit, l_pids, AL_MAX_UNIT_PIDS)) <= 0)
+    return 0;
+  for (l_i = 0; l_i < l_count && l_timed; l_i++) {
+    /* exited meanwhile */
+    if (ProcReadRecord(l_pids[l_i], "stat", &g_proc_buf) <= 0)
+      continue;
+    if (!ProcStatParse(g_proc_buf.data, g_proc_buf.len, &l_stat) || l_stat.start_time == 0) {
+      l_timed = false;
+      break;
+    }
+    if (!l_pid || l_stat.start_time < l_start) {
+      l_pid = l_pids[l_i];
+      l_start = l_stat.start_time;
+    }
+  }
+  if (l_timed)
+    return l_pid;
+  /* last resort : the lowest pid */
+  l_pid = l_pids[0];
+  for (l_i = 1; l_i < l_count; l_i++)
+    if (l_pids[l_i] < l_pid)
+      l_pid = l_pids[l_i];
+  return l_pid;
+}
+
+/* Function to extract the main PID of an application from its service unit */
+pid_t AppPidFromUnit(char *p_app_name)
+{
+  /* unit name for the cgroup lookup */
+  char l_unit[AL_UNIT_NAME_MAX];
+  snprintf(l_unit, sizeof(l_unit), "%s.service", p_app_name);
+  return UnitMainPid(l_unit);
+}
+
 /* Function to extract PID value using the name of an application */
 pid_t AppPidFromName(char *p_app_name)
 {
-  /* define the directory to scan */
-  DIR *l_dir;
-  /* pointer to the next directory entry */
-  struct dirent *l_next;
-  /* buffer size to save the name */
-  int l_buff_size = DIM_MAX;
   /* to store the PID */
   pid_t l_pid;
-  /* open the directory to scan */
-  l_dir = opendir("/proc");
-  /* error handler */
-  if (!l_dir) {
-    log_error_message
-	("Application Pid Extractor : Cannot open directory for %s\n!",
-	 p_app_name);
+  /* exact answer from the unit cgroup */
+  if ((l_pid = AppPidFromUnit(p_app_name)) != 0)
+    return l_pid;
+  /* serve the lookup from the proc connector index when it is available */
+  if (PidIndexIsActive())
+    return PidIndexLookup(p_app_name);
+  /* last resort : walk the process table */
+  return ProcScanPidByName(p_app_name, &g_proc_buf);
+}
+
+
+/* Find application name from PID */
+int AppNameFromPid(int p_pid, char *p_app_name)
+{
+  /* owning unit */
+  char l_unit[AL_UNIT_NAME_MAX];
+  /* the owning service unit gives the exact application name, template instances included */
+  if (CgroupUnitFromPid(p_pid, l_unit, sizeof(l_unit)) && g_str_has_suffix(l_unit, ".service")) {
+    /* the application name is shorter than its unit, the callers hold DIM_MAX bytes */
+    if (strlen(l_unit) >= DIM_MAX)
+      return 0;
+    /* applications started with RunAs run in their transient unit */
+    if (RunAsUnitParse(l_unit, p_app_name, NULL, NULL))
+      return 1;
+    l_unit[strlen(l_unit) - strlen(".service")] = '\0';
+    strcpy(p_app_name, l_unit);
+    return 1;
+  }
+  /* not started by systemd : guess the name from the command line */
+  return AppBinaryNameFromPid(p_pid, p_app_name);
+}
+
+/* Function responsible to form the transient unit name of an application started with RunAs */
+void RunAsUnitName(const char *p_app_name, int p_uid, int p_gid, char *p_unit, size_t p_size)
+{
+  snprintf(p_unit, p_size, AL_RUNAS_UNIT_PREFIX "%d-%d-%s.service", p_uid, p_gid, p_app_name);
+}
+
+/*
+ * Function responsible to split a RunAs transient unit name into application, uid and gid;
+ * returns 0 if the unit is not a RunAs unit. Any output may be NULL.
+ */
+int RunAsUnitParse(const char *p_unit, char *p_app_name, int *p_uid, int *p_gid)
+{
+  /* parse cursor */
+  char *l_cur;
+  /* credentials */
+  long l_uid, l_gid;
+  if (!g_str_has_prefix(p_unit, AL_RUNAS_UNIT_PREFIX) || !g_str_has_suffix(p_unit, ".service"))
+    return 0;
+  l_uid = strtol(p_unit + strlen(AL_RUNAS_UNIT_PREFIX), &l_cur, 10);
+  if (*l_cur != '-')
     return 0;
+  l_gid = strtol(l_cur + 1, &l_cur, 10);
+  if (*l_cur != '-' || strlen(l_cur + 1) <= strlen(".service"))
+    return 0;
+  if (p_app_name) {
+    strcpy(p_app_name, l_cur + 1);
+    p_app_name[strlen(p_app_name) - strlen(".service")] = '\0';
   }
-  /* while there are more entries */
-  while ((l_next = readdir(l_dir)) != NULL) {
-    /* current file in the directory */
-    FILE *l_status;
-    /* file handling variables */
-    char l_filename[l_buff_size];
-    /* aux buffer */
-    char l_buffer[l_buff_size];
-    /* application name with full path */
-    char l_name[l_buff_size];
-    /* extracted application name */
-    char l_aname[l_buff_size];
-    /* binary name start position */
-    char *l_start_pos;
-    /* binary name end position */
-    char *l_last_pos;
-    /* binary length name */
-    int l_len = 0;
-    /* current index */
-    char *l_idx;
-    /* test if we are out of the proc directory */
-    if (strcmp(l_next->d_name, "..") == 0)
-      continue;
-    /* test if the current dir name is formed from digits */
-    if (!isdigit(*l_next->d_name))
-      continue;
-    /* extract names from PID dirs */
-    sprintf(l_filename, "/proc/%s/cmdline", l_next->d_name);
-    if (!(l_status = fopen(l_filename, "r"))) {
-      continue;
-    }
-    /* buffer to store all app names */
-    if (fgets(l_buffer, l_buff_size - 1, l_status) == NULL) {
-      fclose(l_status);
+  if (p_uid)
+    *p_uid = (int)l_uid;
+  if (p_gid)
+    *p_gid = (int)l_gid;
+  return 1;
+}
+
+/*
+ * Function responsible to expand the instance specifiers of a template unit setting
+ * (%i, %I, %p, %P, %n, %N and %%) for an application name
+ */
+static char *UnitSpecifierExpand(const char *p_val, const char *p_app_name)
+{
+  /* expanded value */
+  GString *l_out = g_string_sized_new(strlen(p_val) + 32);
+  /* template marker */
+  const char *l_at = strchr(p_app_name, '@');
+  for (; *p_val; p_val++) {
+    if (*p_val != '%' || !p_val[1]) {
+      g_string_append_c(l_out, *p_val);
       continue;
     }
-    fclose(l_status);
-    /* fill the buffer from /proc */
-    sscanf(l_buffer, "%s", l_name);
-    /* extract the name from the absolute path  */
-    /* compute the start position */
-    l_start_pos = strrchr(l_name, '/');
-    if (l_start_pos)
-      /* compute the current index */
-      l_idx = (l_start_pos + 1);
-    else
-      l_idx = l_name;
-    /* compute the end position */
-    l_last_pos = strchr(l_name, ' ');
-    if (!l_last_pos)
-      /* compute length */
-      l_len = strlen(l_idx);
-    else if (l_start_pos)
-      l_len = l_last_pos - l_start_pos;
-    else
-      l_len = l_last_pos - l_idx;
-    /* create the name to test */
-    strncpy(l_aname, l_idx, l_len);
-    l_aname[l_len] = '\0';
-    /* check if the name parameter is the name is identical to the extracted value */
-    if (strcmp(l_aname, p_app_name) == 0) {
-      l_pid = strtol(l_next->d_name, NULL, 0);
-      return l_pid;
+    switch (*++p_val) {
+    case 'i':
+    case 'I':
+      if (l_at)
+        g_string_append(l_out, l_at + 1);
+      break;
+    case 'p':
+    case 'P':
+      if (l_at)
+        g_string_append_len(l_out, p_app_name, l_at - p_app_name);
+      else
+        g_string_append(l_out, p_app_name);
+      break;
+    case 'n':
+      g_string_append_printf(l_out, "%s.service", p_app_name);
+      break;
+    case 'N':
+      g_string_append(l_out, p_app_name);
+      break;
+    case '%':
+      g_string_append_c(l_out, '%');
+      break;
+    default:
+      g_string_append_c(l_out, '%');
+      g_string_append_c(l_out, *p_val);
+      break;
     }
   }
-  return (pid_t) 0;
+  return g_string_free(l_out, FALSE);
 }
 
+/* Function responsible to expand an optional [Service] setting of the unit file cache */
+static char *UnitFileServiceValue(const char *p_raw, const char *p_app_name)
+{
+  return p_raw ? UnitSpecifierExpand(p_raw, p_app_name) : NULL;
+}
 
-/* Find application name from PID */
-int AppNameFromPid(int p_pid, char *p_app_name)
+/*
+ * Function responsible to read the command and the service settings of an application
+ * unit file into the properties of a transient service; returns 0 on success.
+ * As with the other unit file accesses only the last occurrence of a key is seen.
+ */
+int UnitFileTransientProps(char *p_file, const char *p_app_name, SysdTransientProps *p_props)
 {
-  /* file descriptor */
-  FILE *l_fp;
-  /* working buffer */
-  char l_buf[DIM_MAX];
-  /* absolute path from where the info is extracted */
-  char l_path[DIM_MAX];
-  /* current line */
-  char l_line[DIM_MAX];
-  /* extracted application name */
-  char l_aline[DIM_MAX];
-/* binary name start position */
-  char *l_start_pos;
-  /* binary name end position */
-  char *l_last_pos;
-  /* binary length name */
-  int l_len = 0;
-  /* current index */
-  char *l_idx;
-  /* convert pid intro string */
-  sprintf(l_buf, "%d", p_pid);
-  /* acces the commandline */
-  sprintf(l_path, "/proc/%s/cmdline", l_buf);
-  /* open the cmdline to extract the name of app */
-  l_fp = fopen(l_path, "r");
-  /* extract the name pf the app */
-  if(l_fp == NULL)
-	return 0;
-  fgets(l_line, sizeof(char) * DIM_MAX, l_fp);
-  /* save the name in non-local var to avoid stack clear */
-  /* extract the name from the absolute path  */
-  /* compute the start position */
-  l_start_pos = strrchr(l_line, '/');
-  if (l_start_pos)
-    /* compute the current index */
-    l_idx = (l_start_pos + 1);
-  else
-    l_idx = l_line;
-  /* compute the end position */
-  l_last_pos = strchr(l_line, ' ');
-  if (!l_last_pos)
-    /* compute length */
-    l_len = strlen(l_idx);
-  else if (l_start_pos)
-    l_len = l_last_pos - l_start_pos;
-  else
-    l_len = l_last_pos - l_idx;
-  /* create the name to test */
-  strncpy(l_aline, l_idx, l_len);
-  l_aline[l_len] = '\0';
-  strcpy(p_app_name, l_aline);
-  /* free the file descriptor */
-  fclose(l_fp);
-  return 1;
+  /* parsed unit file */
+  AlUnitFileInfo *l_info;
+  /* ExecStart value and its command part */
+  char *l_exec, *l_cmd;
+  /* environment assignments */
+  char *l_env;
+  /* argv[0] is given after the binary */
+  int l_argv0 = 0;
+  /* parse error */
+  GError *l_err = NULL;
+  memset(p_props, 0, sizeof(*p_props));
+  if (!(l_info = UnitFileInfoGet(p_file)))
+    return -1;
+  if (!(l_exec = UnitFileServiceValue(l_info->exec_start, p_app_name))) {
+    log_error_message("Transient Unit Setup : No ExecStart in %s !\n", p_file);
+    UnitFileInfoUnref(l_info);
+    return -1;
+  }
+  /* "-" ignores the exit status, "@" passes argv[0] separately, "+" and "!" are not carried over */
+  for (l_cmd = l_exec; *l_cmd == '-' || *l_cmd == '@' || *l_cmd == '+' || *l_cmd == '!'; l_cmd++) {
+    if (*l_cmd == '-')
+      p_props->exec_ignore_failure = 1;
+    if (*l_cmd == '@')
+      l_argv0 = 1;
+  }
+  if (!g_shell_parse_argv(l_cmd, NULL, &p_props->exec_argv, &l_err)) {
+    log_error_message("Transient Unit Setup : Cannot parse ExecStart of %s ! Err : %s\n", p_file, l_err->message);
+    g_error_free(l_err);
+    g_free(l_exec);
+    UnitFileInfoUnref(l_info);
+    return -1;
+  }
+  if (l_argv0 && p_props->exec_argv[1]) {
+    /* the binary is followed by the whole argv */
+    p_props->exec_path = p_props->exec_argv[0];
+    memmove(p_props->exec_argv, p_props->exec_argv + 1, g_strv_length(p_props->exec_argv) * sizeof(char *));
+  } else {
+    p_props->exec_path = g_strdup(p_props->exec_argv[0]);
+  }
+  g_free(l_exec);
+  p_props->description = g_strdup_printf("%s (RunAs)", p_app_name);
+  p_props->type = UnitFileServiceValue(l_info->type, p_app_name);
+  p_props->working_directory = UnitFileServiceValue(l_info->working_directory, p_app_name);
+  if ((l_env = UnitFileServiceValue(l_info->environment, p_app_name)) != NULL) {
+    if (!g_shell_parse_argv(l_env, NULL, &p_props->environment, NULL))
+      p_props->environment = NULL;
+    g_free(l_env);
+  }
+  UnitFileInfoUnref(l_info);
+  return 0;
+}
+
+/* Function responsible to release the properties read by UnitFileTransientProps() */
+void TransientPropsFree(SysdTransientProps *p_props)
+{
+  g_free(p_props->description);
+  g_free(p_props->exec_path);
+  g_strfreev(p_props->exec_argv);
+  g_free(p_props->type);
+  g_free(p_props->working_directory);
+  g_strfreev(p_props->environment);
+  memset(p_props, 0, sizeof(*p_props));
 }
 
 /* 
@@ -264,29 +401,8 @@ int AppNameFromPid(int p_pid, char *p_app_name)
  */
 int AppExistsInSystem(char *p_app_name)
 {
-  /* full name string */
-  char full_name_srv[DIM_MAX];
-  char full_name_trg[DIM_MAX];
-  /* check if template */
-  char *l_temp = ExtractUnitNameTemplate(p_app_name);
-  /* get the full path name */
-  sprintf(full_name_srv, "/lib/systemd/system/%s.service", l_temp);
-  sprintf(full_name_trg, "/lib/systemd/system/%s.target", p_app_name);
-  /* contains stat info for service / target */
-  struct stat file_stat;
-  int ret = -1;
-  /* get stat information for service */
-  if ((ret = stat(full_name_srv, &file_stat))==0) {
-    /* service file was found */
-    return 1;
-  }
-  /* get stat information for target */
-  if ((ret = stat(full_name_trg, &file_stat))==0) {
-    /* target file was found */
-    return 2;
-  }
-  /* nor service file, nor target file found */
-  return 0;
+  /* served from the unit catalog, which follows the systemd search path and precedence */
+  return UnitCatalogAppType(p_app_name);
 }
 
 /* 
@@ -296,17 +412,13 @@ int AppExistsInSystem(char *p_app_name)
 
 GKeyFile *ParseUnitFile(char *p_file)
 {
-  /* key file group length */
-  gsize l_groups_length;
-  /* store the groups in the keyfile */
-  char **l_groups;
   /* the created GKeyFile for the given file on disk */
   GKeyFile *l_out_new_key_file = g_key_file_new();
   /* initialize the error */
   GError *l_err = NULL;
   /* load key file structure from file on disk */
   if (!g_key_file_load_from_file
-      (l_out_new_key_file, p_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, &l_err)) {
+      (l_out_new_key_file, p_file, G_KEY_FILE_NONE, &l_err)) {
    /* test if unit is a timer or a normal service */
    if(strstr(p_file, ".timer")==NULL){
     log_error_message
@@ -321,204 +433,120 @@ GKeyFile *ParseUnitFile(char *p_file)
     g_key_file_free(l_out_new_key_file);
     return NULL;
   }
-  /* extract groups from key file structure */
-  l_groups = g_key_file_get_groups(l_out_new_key_file, &l_groups_length);
-  if (l_groups == NULL) {
-   if(strstr(p_file,".timer")==NULL){
-    log_error_message
-	("Unit File Parser : Could not retrieve groups from %s service unit file!\n",
-	 p_file);
-    }else{	
-    log_error_message
-	("Unit File Parser : Could not retrieve groups from %s timer unit file!\n",
-	 p_file);
-    }
-    return NULL;
-  }
-  unsigned long l_i;
-  /* loop to get keys from key fle structure */
-  for (l_i = 0; l_i < l_groups_length; l_i++) {
-    gsize l_keys_length;
-    char **l_keys;
-    /* get current key from file */
-    l_keys =
-	g_key_file_get_keys(l_out_new_key_file, l_groups[l_i],
-			    &l_keys_length, &l_err);
-    /* check if the file is properly structured */
-    if (l_keys == NULL) {
-     if(strstr(p_file,".timer")==NULL){
-       log_error_message
-	  ("Unit File Parser : Error in retrieving keys in service unit file! (%d: %s)",
-	   l_err->code, l_err->message);
-     }else{
-      log_error_message
-	  ("Unit File Parser : Error in retrieving keys in timer unit file! (%d: %s)",
-	   l_err->code, l_err->message);
-     } 
-     g_error_free(l_err);
-    } else {
-      unsigned long l_j;
-      /* loop to get key values */
-      for (l_j = 0; l_j < l_keys_length; l_j++) {
-	char *l_str_value;
-	/* extract current value for a given key */
-	l_str_value =
-	    g_key_file_get_string(l_out_new_key_file, l_groups[l_i],
-				  l_keys[l_j], &l_err);
-	/* check value validity */
-	if (l_str_value == NULL) {
-	  if(strstr(p_file,".timer")==NULL){
-	   log_error_message
-	      ("Unit File Parser : Error retrieving key's value in service unit file. (%d, %s)\n",
-	       l_err->code, l_err->message);
-	  }else{
-	   log_error_message
-	      ("Unit File Parser : Error retrieving key's value in timer unit file. (%d, %s)\n",
-	       l_err->code, l_err->message);
-	  }
-	  g_error_free(l_err);
-	}
-      }
-    }
-  }
   /* return the parsed key file structure */
   return l_out_new_key_file;
 }
 
-/* 
- * Function responsible to parse the .timer unit and setup the triggering key value
- * also it can setup the specific egid and euid values 
+/*
+ * Function responsible to setup a key of a .timer or .service unit in a runtime drop-in,
+ * the unit file itself is left untouched; a missing reboot/poweroff timer is provided as
+ * a runtime unit. Returns 1 if the setting changed and systemd must be reloaded, 0 if it
+ * was already in effect, -1 on error
  */
 
-void SetupUnitFileKey(char *p_file, char *p_key, char *p_val, char *p_unit)
+int SetupUnitFileKey(char *p_file, char *p_key, char *p_val, char *p_unit, char *p_path, size_t p_size)
 {
-  /* key file handlers */
-  FILE *l_fd_open; 
-  int l_fd_create;
-  /* variable to store stat info */
-  struct stat l_buf;
-  /* test application service file existence and exit with error if it doesn't exist */
-  if(strstr(p_file,".timer")==NULL){
-	log_debug_message("Service Unit Setup : Test service file existence for %s\n", p_unit);
-	if(g_stat(p_file,&l_buf)!=0){
-		log_error_message("Service Unit Setup : Service file %s stat !\n",
-		p_file);
-		return;
-	}
-	/* open the corresponding key file for the service to write */
-	log_debug_message("Service Unit Setup : Test service file open for %s\n", p_unit);
-        if ((l_fd_open = g_fopen(p_file, "r+"))==NULL) {
-      	  log_error_message
-	    ("Service Unit Setup : Cannot open service unit file %s for adding data !\n",
-	     p_file);
-          return;
-        }
-  }else{
-  log_debug_message("Service Unit Setup : Test timer file existence for %s\n", p_unit);
-  /* test timer file existence and create if not exists */
-  if(g_stat(p_file,&l_buf)!=0){
-    /* initialize the error */
-    GError *l_error = NULL;
-    /* entries for the special reboot and poweroff units */
-    char *l_reboot_entry =
-	"[Unit]\n Description=Timer for deferred reboot\n [Timer]\n OnActiveSec=0s\n Unit=reboot.service\n";
-    char *l_shutdown_entry =
-	"[Unit]\n Description=Timer for deferred shutdown\n [Timer]\n OnActiveSec=0s\n Unit=poweroff.service\n";
-    /* create the key file with permissions */
-    log_debug_message("Timer Unit Setup : Creating timer file for %s\n", p_unit);
-    l_fd_create = g_creat(p_file, O_RDWR | O_CREAT);
-    if(l_fd_create==-1){
-	log_error_message("Timer Unit Setup : Cannot create timer file for %s\n", p_unit);
- 	return;
-    }
-    log_debug_message("Timer Unit Setup : Timer file %s created !\n", p_file);
-    /* open the key file for write */
-    if ((l_fd_open = g_fopen(p_file, "r+"))==NULL) {
-      log_error_message
-	  ("Timer Unit Setup : Cannot open timer unit file %s for adding data !\n",
-	   p_file);
-      return;
-    }
+  /* unit named by the file */
+  gchar *l_unit = g_path_get_basename(p_file);
+  /* the unit is a timer */
+  bool l_timer = g_str_has_suffix(l_unit, ".timer");
+  /* unit file in effect */
+  char l_unit_path[PATH_MAX];
+  /* drop-in name, the lowercase key */
+  gchar *l_name;
+  /* drop-in result */
+  int l_ret;
+  /* entries for the special reboot and poweroff units */
+  const char *l_reboot_entry =
+      "[Unit]\nDescription=Timer for deferred reboot\n[Timer]\nOnActiveSec=0s\nUnit=reboot.service\n";
+  const char *l_shutdown_entry =
+      "[Unit]\nDescription=Timer for deferred shutdown\n[Timer]\nOnActiveSec=0s\nUnit=poweroff.service\n";
+  if (!UnitCatalogPath(l_unit, l_unit_path, sizeof(l_unit_path))) {
     /* the timer units are available only for reboot and shutdown */
-    if (strcmp(p_unit, "reboot") == 0) {
-      g_file_set_contents(p_file, l_reboot_entry, strlen(l_reboot_entry),
-			  &l_error);
+    if (!l_timer || (strcmp(p_unit, "reboot") != 0 && strcmp(p_unit, "poweroff") != 0)) {
+      log_error_message("Unit Setup : Unit file %s not found for %s !\n", l_unit, p_unit);
+      g_free(l_unit);
+      return -1;
     }
-    /* the timer units are available only for reboot and shutdown */
-    if (strcmp(p_unit, "poweroff") == 0) {
-      g_file_set_contents(p_file, l_shutdown_entry,
-			  strlen(l_shutdown_entry), &l_error);
+    log_debug_message("Timer Unit Setup : Creating runtime timer %s for %s\n", l_unit, p_unit);
+    if (UnitDropInWriteUnit(UNIT_DROPIN_RUNTIME, l_unit,
+                            strcmp(p_unit, "reboot") == 0 ? l_reboot_entry : l_shutdown_entry) < 0) {
+      log_error_message("Timer Unit Setup : Cannot create timer file for %s\n", p_unit);
+      g_free(l_unit);
+      return -1;
     }
-
-   log_debug_message("Timer Unit Setup : File %s is wrote !\n",
-		p_file);
-   }
-  }
-  /* parse the key value file */
-  GKeyFile *l_key_file = ParseUnitFile(p_file);
-  log_debug_message("Unit Setup : Key file %s was parsed !\n",
-		p_file);
-  /* key file length */
-  gsize l_file_length;
-  log_debug_message("Unit Setup : Key file %s is checked !\n",
-		p_file);
-  /* test key file validity */
-  if(!l_key_file){
-	log_error_message("Unit Setup : Key file %s could not be parsed !\n",
-		p_file);
-	return;
   }
-  log_debug_message("Unit Setup : Setup entry for unit type (timer/service) for %s!\n",
-		p_file);
-  /* modify the entries according input params  */
-  if(strstr(p_file,".timer")==NULL){
-  	/* if the unit file is an application service file */
-  	/* the setup will be done in the Service group adding values for User and Group */
-  	g_key_file_set_string(l_key_file, "Service", p_key, p_val);
-  }else{
-  	/* if the unit is a timer access the Timerstr group in the key file */
-  	g_key_file_set_string(l_key_file, "Timer", p_key, p_val);
+  /* timers accumulate OnActiveSec= values, the drop-in replaces the ones of the unit file */
+  l_name = g_ascii_strdown(p_key, -1);
+  l_ret = UnitDropInSet(UNIT_DROPIN_RUNTIME, l_unit, l_name, l_timer ? "Timer" : "Service",
+                        p_key, p_val, l_timer, p_path, p_size);
+  if (l_ret < 0)
+    log_error_message("Unit Setup : Cannot setup %s for %s !\n", p_key, l_unit);
+  g_free(l_name);
+  g_free(l_unit);
+  return l_ret;
+}
+
+/*
+ * Function responsible to get the unit name of a systemd unit object path, undoing the
+ * "_xx" escaping of systemd; returns 1 if the path is the one of a unit
+ */
+int UnitNameFromObjectPath(const char *p_path, char *p_unit, size_t p_size)
+{
+  /* position in the escaped name and in the output */
+  const char *l_in;
+  size_t l_out = 0;
+  /* escaped byte */
+  int l_hi, l_lo;
+  if (!p_path || !g_str_has_prefix(p_path, AL_SYSD_UNIT_PATH_PREFIX) || p_size == 0)
+    return 0;
+  for (l_in = p_path + strlen(AL_SYSD_UNIT_PATH_PREFIX); *l_in && l_out + 1 < p_size; l_in++) {
+    if (*l_in == '_' && (l_hi = g_ascii_xdigit_value(l_in[1])) >= 0
+        && (l_lo = g_ascii_xdigit_value(l_in[2])) >= 0) {
+      p_unit[l_out++] = (char)((l_hi << 4) | l_lo);
+      l_in += 2;
+    } else {
+      p_unit[l_out++] = *l_in;
+    }
   }
-  
-  /* setup the error */
-  GError *l_err = NULL;
-  /* write new data to file */
-  gchar *l_new_file_data =
-      g_key_file_to_data(l_key_file, &l_file_length, &l_err);
-  /* test if file is accessible */
-  if (l_new_file_data == NULL) {
-   /* if the key file is for a service file */
-   if(strstr(p_file,".timer")==NULL){
-    log_error_message
-	("Service Unit Setup : Could not get new file data for service unit! (%d: %s)",
-	 l_err->code, l_err->message);
-    g_error_free(l_err);
-    return;
-   }else{ /* if the key file corresponds to timer file */
-    log_error_message
-	("Timer Unit Setup : Could not get new file data for timer unit! (%d: %s)",
-	 l_err->code, l_err->message);
-    g_error_free(l_err);
-    return;
-   }
+  p_unit[l_out] = '\0';
+  return (*l_in == '\0') && (l_out > 0);
+}
+
+/*
+ * Function responsible to get the object path systemd publishes a unit under : every
+ * byte but [A-Za-z0-9], and a leading digit, is escaped as "_xx" (bus_label_escape() of
+ * systemd); returns 0 on success, -1 if size is too small
+ */
+int UnitObjectPathFromName(const char *p_unit, char *p_path, size_t p_size)
+{
+  /* position in the name and in the output */
+  const unsigned char *l_in;
+  size_t l_out;
+  if (!p_unit || (l_out = strlen(AL_SYSD_UNIT_PATH_PREFIX)) >= p_size)
+    return -1;
+  memcpy(p_path, AL_SYSD_UNIT_PATH_PREFIX, l_out);
+  /* systemd escapes the empty label as a lone '_' */
+  if (*p_unit == '\0') {
+    if (l_out + 2 > p_size)
+      return -1;
+    p_path[l_out++] = '_';
   }
-  /* setup the new content in the key value file */
-  if (!g_file_set_contents(p_file, l_new_file_data, l_file_length, &l_err)) {
-   /* if the key file corresponds to a service file */
-   if(strstr(p_file,".timer")==NULL){
-    log_error_message
-	("Service Unit Setup : Could not save new file for service unit! (%d: %s)",
-	 l_err->code, l_err->message);
-    g_error_free(l_err);
-    return;
-   }else{ /* if the key file corresponds to timer file */
-    log_error_message
-	("Timer Unit Setup : Could not save new file for timer unit! (%d: %s)",
-	 l_err->code, l_err->message);
-    g_error_free(l_err);
-    return;
-   }
+  for (l_in = (const unsigned char *)p_unit; *l_in; l_in++) {
+    /* an object path element cannot start with a digit */
+    if (g_ascii_isalpha(*l_in) || (g_ascii_isdigit(*l_in) && l_in != (const unsigned char *)p_unit)) {
+      if (l_out + 2 > p_size)
+        return -1;
+      p_path[l_out++] = *l_in;
+    } else {
+      if (l_out + 4 > p_size)
+        return -1;
+      snprintf(p_path + l_out, 4, "_%02x", *l_in);
+      l_out += 3;
+    }
   }
+  p_path[l_out] = '\0';
+  return 0;
 }
 
 /**
@@ -527,206 +555,84 @@ void SetupUnitFileKey(char *p_file, char *p_key, char *p_val, char *p_unit)
  * */
 char *GetUnitObjectPath(DBusConnection *p_conn, char *p_unit_name)
 {
-  /* initialize message and reply */
-  DBusMessage *l_msg = NULL, *l_reply = NULL;
-  /* error definition*/
-  DBusError l_error;
-  /* initialize the path */
-  const char *l_path = NULL;
-
-  /* error initialization */
-  dbus_error_init(&l_error);
-
-  /* new method call to get unit information */
-  if (NULL == (l_msg = dbus_message_new_method_call("org.freedesktop.systemd1",
-                                                    "/org/freedesktop/systemd1",
-                                                    "org.freedesktop.systemd1.Manager",
-                                                    "GetUnit"))) 
-  {
-    log_error_message
-            ("Get Unit Object Path : Could not allocate message for %s\n", p_unit_name);
-    goto free_res;
-  }
-
-  /* append application name as argument to method call */
-  if (FALSE == dbus_message_append_args(l_msg,
-                                        DBUS_TYPE_STRING, &p_unit_name,
-                                        DBUS_TYPE_INVALID))
-  {
-    log_error_message
-            ("Get Unit Object Path : Could not append arguments to message for %s\n", p_unit_name);
-    goto free_res;
-  }
-
-  /* send the message on the bus and wait for a reply */
-  if (NULL == (l_reply = dbus_connection_send_with_reply_and_block(p_conn, l_msg, -1, &l_error))) 
-  {
-    log_error_message
-            ("Get Unit Object Path : Unknown information for %s \n", p_unit_name);
-    if (dbus_error_is_set(&l_error))
-    {
-      log_error_message
-              ("Get Unit Object Path : Error [%s: %s]\n", l_error.name, l_error.message);
-    }
-    goto free_res;
-  }
-
-  /* extract arguments from the reply; the object path is useful for property fetch */
-  if (FALSE == dbus_message_get_args(l_reply, &l_error,
-                                     DBUS_TYPE_OBJECT_PATH, &l_path,
-                                     DBUS_TYPE_INVALID)) 
-  {
-    log_error_message
-            ("Get Unit Object Path : Failed to parse reply for %s\n", p_unit_name);
-    if (dbus_error_is_set(&l_error))
-    {
-      log_error_message
-              ("Get Unit Object Path : Error [%s: %s]\n", l_error.name, l_error.message);
-    }
-    goto free_res;
-  }
-
-  dbus_message_unref(l_msg);
-  dbus_message_unref(l_reply);
-  return strdup(l_path);
-
-free_res:
-  if (l_msg)
-    dbus_message_unref(l_msg);
-  if (l_reply)
-    dbus_message_unref(l_reply);
-  dbus_error_free(&l_error);
-  return NULL;
+  return UnitPathGet(p_conn, p_unit_name);
 }
 
-/* 
- * Function responsible to setup the (fg/bg) state when starting the application
- * for the first time using Run or RunAs */
-int SetupApplicationStartupState(DBusConnection *p_conn, char *p_app, bool l_fg_state)
+/* Function responsible to build the property set message for the (fg/bg) state of an application */
+static DBusMessage *StartupStateMessage(AlUnitDesc *p_desc, bool p_fg_state)
 {
-  /* DBus message and reply for task change state */
-  DBusMessage *l_msg_state, *l_reply_state;
-  /* error */
-  DBusError l_err;
-  /* object path for the application */
-  char *l_path;
+  /* DBus message for task change state */
+  DBusMessage *l_msg_state = NULL;
+  /* object path for the application, resolved with its descriptor */
+  const char *l_path = p_desc->object_path;
   /* iterators for variant type embedding for state info */
   DBusMessageIter l_iter, l_variant;
   /* full unit name */
-  char *l_unit = malloc(DIM_MAX*sizeof(l_unit));
-  strcpy(l_unit, p_app);
-  strcat(l_unit, ".service");
-  /* error initialization */
-  dbus_error_init(&l_err);
-  /* get unit object path */ 
-  if (NULL == (l_path = GetUnitObjectPath(p_conn, l_unit)))
+  const char *l_unit = p_desc->unit;
+  /* interface and property to set */
+  const char *l_iface = "org.freedesktop.systemd1.Service";
+  const char *l_prop = "Foreground";
+  /* property value */
+  dbus_bool_t l_state = (dbus_bool_t)p_fg_state;
+  /* only services carry the foreground property */
+  if (p_desc->type != UNIT_CATALOG_SERVICE || NULL == l_path)
   {
           log_error_message
-                  ("Setup Application Startup State : Unable to extract object path for %s", l_unit);
-          return -1;
+                  ("Setup Application Startup State : No service object path for %s\n", l_unit);
+          return NULL;
   }
   log_debug_message
-          ("Setup Application Startup State : Extracted object path for %s\n",
-           l_unit);
-
-  /* send state (fg/bg) property setup method call to systemd */
+          ("Setup Application Startup State : Using object path %s for %s\n",
+           l_path, l_unit);
+  /* state (fg/bg) property setup method call to systemd */
   if (!(l_msg_state =
        dbus_message_new_method_call("org.freedesktop.systemd1",  
 				    l_path, 
 				    "org.freedesktop.DBus.Properties", 
 				    "Set"))) { 
-
     log_error_message
-	("Method Call Listener : Could not allocate message when setting state property to systemd! \n %s \n",
-	 l_err.message);
-    if (l_msg_state)
-      dbus_message_unref(l_msg_state);
-    if (l_reply_state)
-      dbus_message_unref(l_reply_state);
-    dbus_error_free(&l_err);
-    return -1;
-  }
-  log_debug_message
-	("Setup Application Startup State  : Called property set method call for %s\n",
-	 p_app);
-   /* initialize the iterator for arguments append */
-   dbus_message_iter_init_append(l_msg_state, &l_iter);
-  log_debug_message
-	("Setup Application Startup State  : Initialized iterator for property value setup method call for %s\n", l_unit);
-   /* append interface for property setting */
-   char *l_iface = "org.freedesktop.systemd1.Service";
-   if(!dbus_message_iter_append_basic(&l_iter, 
-				      DBUS_TYPE_STRING, 
-				      &l_iface)){
-	log_error_message
-	("Setup Application Startup State : Could not append interface to message for %s \n",
-	 p_app);
-	return -1;
-   }
-   log_debug_message
-	("Setup Application Startup State  : Appended interface name for property set for %s\n",
-	 l_unit);
-   /* append property name */
-   char *l_prop = "Foreground";
-   if(!dbus_message_iter_append_basic(&l_iter, 
-				      DBUS_TYPE_STRING, 
-				      &l_prop)){ 
-	log_error_message
-	("Setup Application Startup State : Could not append property to message for %s \n",
-	 l_unit);
-	return -1;
-   }
-   log_debug_message
-	("Setup Application Startup State  : Appended property name to setup for %s\n",
-	 l_unit);
-   /* append the variant that stores the value for the foreground state property */
-    if(!dbus_message_iter_open_container(&l_iter, 
-				     DBUS_TYPE_VARIANT, 
-				     DBUS_TYPE_BOOLEAN_AS_STRING,
-				     &l_variant)){
-	log_error_message("Setup Application Startup State : Not enough memory to open container \n", 0);
-	return -1;
-    }
-    log_debug_message
-	("Setup Application Startup State  : Opened container for property value setup for %s\n",
+	("Method Call Listener : Could not allocate message when setting state property to systemd for %s !\n",
 	 l_unit);
-    dbus_bool_t l_state = (dbus_bool_t)l_fg_state;
-    if(!dbus_message_iter_append_basic (&l_variant, 
-				        DBUS_TYPE_BOOLEAN,  
-                                        &l_state)){
-    	log_error_message
-	("Setup Application Startup State : Could not append property value to message for %s \n",
+    return NULL;
+  }
+  /* interface, property name and the variant that stores the value for the foreground state property */
+  dbus_message_iter_init_append(l_msg_state, &l_iter);
+  if (!dbus_message_iter_append_basic(&l_iter, DBUS_TYPE_STRING, &l_iface)
+      || !dbus_message_iter_append_basic(&l_iter, DBUS_TYPE_STRING, &l_prop)
+      || !dbus_message_iter_open_container(&l_iter, DBUS_TYPE_VARIANT, DBUS_TYPE_BOOLEAN_AS_STRING, &l_variant)
+      || !dbus_message_iter_append_basic(&l_variant, DBUS_TYPE_BOOLEAN, &l_state)
+      || !dbus_message_iter_close_container(&l_iter, &l_variant)) {
+    log_error_message
+	("Setup Application Startup State : Could not append the state property to message for %s \n",
 	 l_unit);
-     	return -1;
-    }
-    log_debug_message
+    dbus_message_unref(l_msg_state);
+    return NULL;
+  }
+  log_debug_message
 	("Setup Application Startup State  : Set the state (fg/bg) value in variant for %s\n",
 	 l_unit);
-    if(!dbus_message_iter_close_container (&l_iter, 
-					   &l_variant)){
-	log_error_message("AL Daemon Setup Application Startup State : Not enough memory to close container \n", 0);
-	return -1;
-    }
-    log_debug_message
-	("Setup Application Startup State  : Closed container for property value setup for %s\n",
-	 l_unit);     
-   /* wait for the reply from systemd after setting the state (fg/bg) property */
-   if (!(l_reply_state =
-       dbus_connection_send_with_reply_and_block(p_conn, l_msg_state,
-						 -1, &l_err))) {
-    	log_error_message
-	("Method Call Listener : Didn't received a reply for state property method call: %s \n",l_err.message);
-    if (l_msg_state)
-      dbus_message_unref(l_msg_state);
-    if (l_reply_state)
-      dbus_message_unref(l_reply_state);
-    dbus_error_free(&l_err);
+  return l_msg_state;
+}
+
+/*
+ * Function responsible to send the (fg/bg) state of an application without waiting for
+ * the reply; systemd handles it before the jobs requested afterwards on the same connection
+ */
+int SendApplicationStartupState(DBusConnection *p_conn, AlUnitDesc *p_desc, bool p_fg_state)
+{
+  /* DBus message for task change state */
+  DBusMessage *l_msg_state;
+  /* return code */
+  int l_ret = 0;
+  if (!(l_msg_state = StartupStateMessage(p_desc, p_fg_state)))
     return -1;
-   }
-   log_debug_message("Method Call Listener Setup Application Startup State : Reply after setting state for %s was received!\n ", l_unit);
-   if (NULL != l_path)
-           free(l_path);
-  return 0;
+  dbus_message_set_no_reply(l_msg_state, TRUE);
+  if (!dbus_connection_send(p_conn, l_msg_state, NULL)) {
+    log_error_message("Setup Application Startup State : Cannot send the state of %s !\n", p_desc->unit);
+    l_ret = -1;
+  }
+  dbus_message_unref(l_msg_state);
+  return l_ret;
 }
 
 /* 